@@ -81,6 +81,12 @@ describe(const fs::path& filename)
 #if HAVE_ARCHIVE_H
     static constexpr auto RAW_FORMAT_NAME = "raw"_frag;
     static constexpr auto GZ_FILTER_NAME = "gzip"_frag;
+#ifdef HAVE_BZLIB_H
+    static constexpr auto BZ2_FILTER_NAME = "bzip2"_frag;
+#endif
+#ifdef HAVE_ZSTD_H
+    static constexpr auto ZSTD_FILTER_NAME = "zstd"_frag;
+#endif
 
     auto_mem<archive> arc(archive_read_free);
 
@@ -108,10 +114,24 @@ describe(const fs::path& filename)
                     return Ok(describe_result{unknown_file{}});
                 }
 
+                // Single compressed files that the line_buffer can read
+                // directly do not need to be extracted.
                 const auto* first_filter_name = archive_filter_name(arc, 0);
                 if (filter_count == 2 && GZ_FILTER_NAME == first_filter_name) {
                     return Ok(describe_result{unknown_file{}});
                 }
+#ifdef HAVE_BZLIB_H
+                if (filter_count == 2 && BZ2_FILTER_NAME == first_filter_name)
+                {
+                    return Ok(describe_result{unknown_file{}});
+                }
+#endif
+#ifdef HAVE_ZSTD_H
+                if (filter_count == 2 && ZSTD_FILTER_NAME == first_filter_name)
+                {
+                    return Ok(describe_result{unknown_file{}});
+                }
+#endif
             }
             log_info(
                 "detected archive: %s -- %s", filename.c_str(), format_name);
@@ -192,7 +212,10 @@ copy_data(const std::string& filename,
           struct archive_entry* entry,
           struct archive* aw,
           const fs::path& entry_path,
-          struct extract_progress* ep)
+          struct extract_progress* ep,
+          size_t min_free_space,
+          const std::function<void()>& started,
+          const cancel_cb& is_cancelled)
 {
     int r;
     const void* buff;
@@ -200,18 +223,24 @@ copy_data(const std::string& filename,
     la_int64_t offset;
 
     for (;;) {
+        if (is_cancelled()) {
+            return Err(fmt::format(
+                FMT_STRING("extraction of '{}' from archive '{}' was "
+                           "cancelled"),
+                archive_entry_pathname_utf8(entry),
+                filename));
+        }
         if (total >= next_space_check) {
-            const auto& cfg = injector::get<const config&>();
             auto tmp_space = fs::space(entry_path);
 
-            if (tmp_space.available < cfg.amc_min_free_space) {
+            if (tmp_space.available < min_free_space) {
                 return Err(fmt::format(
                     FMT_STRING("available space on disk ({}) is below the "
                                "minimum-free threshold ({}).  Unable to unpack "
                                "'{}' to '{}'"),
                     humanize::file_size(tmp_space.available,
                                         humanize::alignment::none),
-                    humanize::file_size(cfg.amc_min_free_space,
+                    humanize::file_size(min_free_space,
                                         humanize::alignment::none),
                     entry_path.filename().string(),
                     entry_path.parent_path().string()));
@@ -221,6 +250,9 @@ copy_data(const std::string& filename,
 
         r = archive_read_data_block(ar, &buff, &size, &offset);
         if (r == ARCHIVE_EOF) {
+            if (total == 0) {
+                started();
+            }
             return Ok();
         }
         if (r != ARCHIVE_OK) {
@@ -237,13 +269,43 @@ copy_data(const std::string& filename,
                                    archive_error_string(aw)));
         }
 
+        if (total == 0) {
+            started();
+        }
         total += size;
         ep->ep_out_size.fetch_add(size);
     }
 }
 
 static walk_result_t
-extract(const std::string& filename, const extract_cb& cb)
+walk_cached_files(const fs::path& tmp_path, const member_cb& member_callback)
+{
+    std::error_code ec;
+    for (const auto& entry : fs::recursive_directory_iterator(tmp_path, ec)) {
+        if (!entry.is_regular_file()) {
+            continue;
+        }
+
+        member_callback(tmp_path,
+                        member_info{
+                            entry.path(),
+                            entry.file_size(),
+                        });
+    }
+    if (ec) {
+        return Err(fmt::format(FMT_STRING("failed to walk temp dir: {} -- {}"),
+                               tmp_path.string(),
+                               ec.message()));
+    }
+
+    return Ok();
+}
+
+static walk_result_t
+extract(const std::string& filename,
+        const extract_cb& cb,
+        const member_cb& member_callback,
+        const cancel_cb& is_cancelled)
 {
     static const int FLAGS = ARCHIVE_EXTRACT_TIME | ARCHIVE_EXTRACT_PERM
         | ARCHIVE_EXTRACT_ACL | ARCHIVE_EXTRACT_FFLAGS;
@@ -278,7 +340,7 @@ extract(const std::string& filename, const extract_cb& cb)
             fs::last_write_time(done_path, now);
             log_info("%s: archive has already been extracted!",
                      done_path.c_str());
-            return Ok();
+            return walk_cached_files(tmp_path, member_callback);
         }
         log_warning("%s: archive cache has been damaged, re-extracting",
                     done_path.c_str());
@@ -286,6 +348,8 @@ extract(const std::string& filename, const extract_cb& cb)
         fs::remove(done_path);
     }
 
+    const auto& cfg = injector::get<const config&>();
+    const auto min_free_space = cfg.amc_min_free_space;
     auto_mem<archive> arc(archive_free);
     auto_mem<archive> ext(archive_free);
 
@@ -305,6 +369,12 @@ extract(const std::string& filename, const extract_cb& cb)
 
     log_info("extracting %s to %s", filename.c_str(), tmp_path.c_str());
     while (true) {
+        if (is_cancelled()) {
+            return Err(fmt::format(
+                FMT_STRING("extraction of archive '{}' was cancelled"),
+                filename));
+        }
+
         struct archive_entry* entry = nullptr;
         auto r = archive_read_next_header(arc, &entry);
         if (r == ARCHIVE_EOF) {
@@ -349,9 +419,33 @@ extract(const std::string& filename, const extract_cb& cb)
                             archive_error_string(ext)));
         }
 
+        // Regular files are handed off once the first block has been
+        // written so they can be read while the rest of the data is copied.
+        auto started = [&]() {
+            if (archive_entry_filetype(entry) != AE_IFREG) {
+                return;
+            }
+
+            auto size = archive_entry_size_is_set(entry)
+                    && archive_entry_hardlink(entry) == nullptr
+                ? std::make_optional(archive_entry_size(entry))
+                : std::nullopt;
+
+            member_callback(tmp_path, member_info{entry_path, size});
+        };
         if (!archive_entry_size_is_set(entry) || archive_entry_size(entry) > 0)
         {
-            TRY(copy_data(filename, arc, entry, ext, entry_path, prog));
+            TRY(copy_data(filename,
+                          arc,
+                          entry,
+                          ext,
+                          entry_path,
+                          prog,
+                          min_free_space,
+                          started,
+                          is_cancelled));
+        } else {
+            started();
         }
         r = archive_write_finish_entry(ext);
         if (r != ARCHIVE_OK) {
@@ -371,36 +465,16 @@ extract(const std::string& filename, const extract_cb& cb)
 #endif
 
 walk_result_t
-walk_archive_files(
-    const std::string& filename,
-    const extract_cb& cb,
-    const std::function<void(const fs::path&, const fs::directory_entry&)>&
-        callback)
+walk_archive_files(const std::string& filename,
+                   const extract_cb& cb,
+                   const member_cb& member_callback,
+                   const cancel_cb& is_cancelled)
 {
 #if HAVE_ARCHIVE_H
-    auto tmp_path = filename_to_tmp_path(filename);
-
-    auto result = extract(filename, cb);
-    if (result.isErr()) {
-        fs::remove_all(tmp_path);
-        return result;
-    }
-
-    std::error_code ec;
-    for (const auto& entry : fs::recursive_directory_iterator(tmp_path, ec)) {
-        if (!entry.is_regular_file()) {
-            continue;
-        }
-
-        callback(tmp_path, entry);
-    }
-    if (ec) {
-        return Err(fmt::format(FMT_STRING("failed to walk temp dir: {} -- {}"),
-                               tmp_path.string(),
-                               ec.message()));
-    }
-
-    return Ok();
+    // The members that were already handed off might be open, so the
+    // extracted files are left alone.  Since the archive is not marked as
+    // done, it will be extracted again the next time it is opened.
+    return extract(filename, cb, member_callback, is_cancelled);
 #else
     return Err(std::string("not compiled with libarchive"));
 #endif
@@ -34,6 +34,7 @@
 
 #include <atomic>
 #include <functional>
+#include <optional>
 #include <string>
 
 #include "base/file_range.hh"
@@ -78,19 +79,39 @@ std::filesystem::path filename_to_tmp_path(const std::string& filename);
 
 using walk_result_t = Result<void, std::string>;
 
+struct member_info {
+    /** The path to the member's file in the extraction directory. */
+    std::filesystem::path mi_path;
+    /** The size of the member, if it is known. */
+    std::optional<file_ssize_t> mi_size;
+};
+
+using member_cb = std::function<void(const std::filesystem::path&,
+                                     const member_info&)>;
+
+/** Returns true if an extraction should be stopped. */
+using cancel_cb = std::function<bool()>;
+
 /**
+ * Extract the files in an archive to the cache directory.  The member
+ * callback is called for each regular file as soon as its extraction
+ * begins, so the file can be read while the rest of the archive is
+ * unpacked.  If the archive was extracted previously, the callback is
+ * called for each of the files in the cache.
  *
  * @feature f0:archive
  *
- * @param filename
- * @param cb
- * @return
+ * @param filename The path to the archive.
+ * @param cb Called to get the progress tracker for each member.
+ * @param member_callback Called for each regular file in the archive.
+ * @param is_cancelled Checked while extracting to see if it should stop.
+ * @return An error if the archive could not be extracted.  The files that
+ *   were already passed to the member callback are left in place.
  */
-walk_result_t walk_archive_files(
-    const std::string& filename,
-    const extract_cb& cb,
-    const std::function<void(const std::filesystem::path&,
-                             const std::filesystem::directory_entry&)>&);
+walk_result_t walk_archive_files(const std::string& filename,
+                                 const extract_cb& cb,
+                                 const member_cb& member_callback,
+                                 const cancel_cb& is_cancelled);
 
 void cleanup_cache();
 
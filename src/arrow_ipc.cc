@@ -0,0 +1,728 @@
+/**
+ * Copyright (c) 2025, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <string_view>
+#include <unordered_map>
+
+#include "arrow_ipc.hh"
+
+#include "config.h"
+#include "fmt/format.h"
+
+namespace {
+
+constexpr uint32_t CONTINUATION_MARKER = 0xffffffff;
+constexpr uint64_t METADATA_VERSION_V5 = 4;
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+constexpr uint64_t HOST_ENDIANNESS = 1;
+#else
+constexpr uint64_t HOST_ENDIANNESS = 0;
+#endif
+
+/** The values of the MessageHeader union in Message.fbs. */
+enum class message_header : uint8_t {
+    schema = 1,
+    dictionary_batch = 2,
+    record_batch = 3,
+};
+
+/** The values of the Type union in Schema.fbs. */
+enum class type_id : uint8_t {
+    integer = 2,
+    floating_point = 3,
+    utf8 = 5,
+};
+
+/**
+ * A minimal flatbuffer builder for the Arrow metadata.  Unlike the
+ * flatbuffers library, which builds back-to-front, the buffer is built
+ * front-to-back: a table is written with placeholders for its offset
+ * fields and the children are appended after it and patched in.  All
+ * offsets point forward, which is what the format expects.
+ */
+class flatbuffer_builder {
+public:
+    struct field {
+        uint16_t f_id;
+        /** The size of a scalar field or zero for an offset to a child. */
+        uint8_t f_size;
+        uint64_t f_value;
+    };
+
+    struct table_ref {
+        size_t tr_pos;
+        /** The position of each field, in the order they were given. */
+        std::vector<size_t> tr_slots;
+    };
+
+    flatbuffer_builder() { this->fb_buf.resize(sizeof(uint32_t)); }
+
+    table_ref add_table(const std::vector<field>& fields)
+    {
+        table_ref retval;
+        std::vector<uint16_t> offsets(fields.size());
+        uint16_t max_id = 0;
+        size_t table_size = sizeof(int32_t);
+
+        // Lay out the fields by decreasing alignment after the vtable
+        // offset, with the eight-byte fields on an eight-byte boundary.
+        for (const size_t slot_size : {4, 2, 1}) {
+            for (size_t lpc = 0; lpc < fields.size(); lpc++) {
+                if (field_size(fields[lpc]) == slot_size) {
+                    offsets[lpc] = table_size;
+                    table_size += slot_size;
+                }
+            }
+        }
+        for (size_t lpc = 0; lpc < fields.size(); lpc++) {
+            if (field_size(fields[lpc]) == 8) {
+                table_size = align_to(table_size, 8);
+                offsets[lpc] = table_size;
+                table_size += 8;
+            }
+        }
+        for (const auto& fi : fields) {
+            max_id = std::max(max_id, fi.f_id);
+        }
+
+        std::vector<uint16_t> vtable(fields.empty() ? 0 : max_id + 1);
+        for (size_t lpc = 0; lpc < fields.size(); lpc++) {
+            vtable[fields[lpc].f_id] = offsets[lpc];
+        }
+
+        this->align(2);
+        const auto vt_pos = this->fb_buf.size();
+        this->append(4 + 2 * vtable.size(), 2);
+        this->append(table_size, 2);
+        for (const auto off : vtable) {
+            this->append(off, 2);
+        }
+
+        this->align(8);
+        retval.tr_pos = this->fb_buf.size();
+        this->append(retval.tr_pos - vt_pos, 4);
+        this->fb_buf.resize(retval.tr_pos + table_size);
+        for (size_t lpc = 0; lpc < fields.size(); lpc++) {
+            const auto slot = retval.tr_pos + offsets[lpc];
+
+            if (fields[lpc].f_size > 0) {
+                this->put(slot, fields[lpc].f_value, fields[lpc].f_size);
+            }
+            retval.tr_slots.emplace_back(slot);
+        }
+
+        return retval;
+    }
+
+    size_t add_string(const std::string& str)
+    {
+        this->align(4);
+        const auto retval = this->fb_buf.size();
+        this->append(str.size(), 4);
+        this->fb_buf.append(str);
+        this->fb_buf.push_back('\0');
+
+        return retval;
+    }
+
+    /**
+     * Add a vector of offsets to tables.  The offset for element N is at
+     * the returned position plus 4 * (N + 1).
+     */
+    size_t add_offset_vector(size_t count)
+    {
+        this->align(4);
+        const auto retval = this->fb_buf.size();
+        this->append(count, 4);
+        this->fb_buf.resize(retval + 4 * (count + 1));
+
+        return retval;
+    }
+
+    /** Add a vector of the FieldNode or Buffer structs. */
+    size_t add_struct_vector(const std::vector<std::pair<int64_t, int64_t>>& v)
+    {
+        // The length is followed by the elements, which need to be on an
+        // eight-byte boundary.
+        this->align(8);
+        this->append(0, 4);
+        const auto retval = this->fb_buf.size();
+        this->append(v.size(), 4);
+        for (const auto& [first, second] : v) {
+            this->append(first, 8);
+            this->append(second, 8);
+        }
+
+        return retval;
+    }
+
+    void patch(size_t slot, size_t target)
+    {
+        this->put(slot, target - slot, sizeof(uint32_t));
+    }
+
+    std::string finish(size_t root)
+    {
+        this->patch(0, root);
+        this->align(8);
+
+        return std::move(this->fb_buf);
+    }
+
+private:
+    static size_t field_size(const field& fi)
+    {
+        return fi.f_size == 0 ? sizeof(uint32_t) : fi.f_size;
+    }
+
+    static size_t align_to(size_t value, size_t alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    void align(size_t alignment)
+    {
+        this->fb_buf.resize(align_to(this->fb_buf.size(), alignment));
+    }
+
+    void put(size_t pos, uint64_t value, size_t size)
+    {
+        for (size_t lpc = 0; lpc < size; lpc++) {
+            this->fb_buf[pos + lpc] = (char) ((value >> (8 * lpc)) & 0xff);
+        }
+    }
+
+    void append(uint64_t value, size_t size)
+    {
+        const auto pos = this->fb_buf.size();
+        this->fb_buf.resize(pos + size);
+        this->put(pos, value, size);
+    }
+
+    std::string fb_buf;
+};
+
+struct validity_bitmap {
+    explicit validity_bitmap(size_t rows)
+        : vb_bits((rows + 7) / 8), vb_nulls(rows)
+    {
+    }
+
+    void set_valid(size_t row)
+    {
+        this->vb_bits[row / 8] |= 1U << (row % 8);
+        this->vb_nulls -= 1;
+    }
+
+    std::vector<uint8_t> vb_bits;
+    size_t vb_nulls;
+};
+
+/** The body of a record or dictionary batch message. */
+struct batch_body {
+    void add_node(size_t rows, const validity_bitmap& validity)
+    {
+        this->bb_nodes.emplace_back(rows, validity.vb_nulls);
+        if (validity.vb_nulls == 0) {
+            this->add_buffer(nullptr, 0);
+        } else {
+            this->add_buffer(validity.vb_bits.data(), validity.vb_bits.size());
+        }
+    }
+
+    void add_buffer(const void* data, size_t len)
+    {
+        this->bb_buffers.emplace_back(this->bb_data.size(), len);
+        if (len > 0) {
+            this->bb_data.append(static_cast<const char*>(data), len);
+        }
+        this->bb_data.resize((this->bb_data.size() + 7) & ~size_t{7});
+    }
+
+    template<typename T>
+    void add_buffer(const std::vector<T>& values)
+    {
+        this->add_buffer(values.data(), values.size() * sizeof(T));
+    }
+
+    std::vector<std::pair<int64_t, int64_t>> bb_nodes;
+    std::vector<std::pair<int64_t, int64_t>> bb_buffers;
+    std::string bb_data;
+};
+
+template<typename F>
+std::string
+message_metadata(message_header type, size_t body_length, F add_header)
+{
+    flatbuffer_builder fbb;
+    auto msg = fbb.add_table({
+        {0, 2, METADATA_VERSION_V5},
+        {1, 1, (uint64_t) type},
+        {2, 0, 0},
+        {3, 8, body_length},
+    });
+
+    fbb.patch(msg.tr_slots[2], add_header(fbb));
+
+    return fbb.finish(msg.tr_pos);
+}
+
+size_t
+add_int_type(flatbuffer_builder& fbb, uint64_t bit_width)
+{
+    return fbb
+        .add_table({
+            {0, 4, bit_width},
+            {1, 1, 1},
+        })
+        .tr_pos;
+}
+
+size_t
+add_field(flatbuffer_builder& fbb,
+          const lnav::arrow_ipc::column& col,
+          size_t dict_id)
+{
+    using lnav::arrow_ipc::column_type;
+
+    type_id tid = type_id::utf8;
+    switch (col.c_type) {
+        case column_type::int64:
+            tid = type_id::integer;
+            break;
+        case column_type::float64:
+            tid = type_id::floating_point;
+            break;
+        case column_type::dict_utf8:
+            break;
+    }
+
+    const auto is_dict = col.c_type == column_type::dict_utf8;
+    std::vector<flatbuffer_builder::field> fields = {
+        {0, 0, 0},
+        {1, 1, 1},
+        {2, 1, (uint64_t) tid},
+        {3, 0, 0},
+        {5, 0, 0},
+    };
+    if (is_dict) {
+        fields.push_back({4, 0, 0});
+    }
+
+    auto field = fbb.add_table(fields);
+    fbb.patch(field.tr_slots[0], fbb.add_string(col.c_name));
+    switch (tid) {
+        case type_id::integer:
+            fbb.patch(field.tr_slots[3], add_int_type(fbb, 64));
+            break;
+        case type_id::floating_point:
+            // Precision.DOUBLE
+            fbb.patch(field.tr_slots[3], fbb.add_table({{0, 2, 2}}).tr_pos);
+            break;
+        case type_id::utf8:
+            fbb.patch(field.tr_slots[3], fbb.add_table({}).tr_pos);
+            break;
+    }
+    fbb.patch(field.tr_slots[4], fbb.add_offset_vector(0));
+    if (is_dict) {
+        auto dict = fbb.add_table({
+            {0, 8, dict_id},
+            {1, 0, 0},
+        });
+        fbb.patch(field.tr_slots[5], dict.tr_pos);
+        fbb.patch(dict.tr_slots[1], add_int_type(fbb, 32));
+    }
+
+    return field.tr_pos;
+}
+
+size_t
+add_record_batch(flatbuffer_builder& fbb, size_t rows, const batch_body& body)
+{
+    auto rb = fbb.add_table({
+        {0, 8, rows},
+        {1, 0, 0},
+        {2, 0, 0},
+    });
+
+    fbb.patch(rb.tr_slots[1], fbb.add_struct_vector(body.bb_nodes));
+    fbb.patch(rb.tr_slots[2], fbb.add_struct_vector(body.bb_buffers));
+
+    return rb.tr_pos;
+}
+
+/**
+ * The distinct values of a string column in a batch.  The keys refer to
+ * the text in the batch or the formatted numbers kept here.
+ */
+struct dictionary {
+    int32_t lookup(std::string_view value)
+    {
+        auto [iter, inserted]
+            = this->d_indexes.emplace(value, (int32_t) this->size());
+
+        if (inserted) {
+            this->d_data.append(value);
+            this->d_offsets.push_back(this->d_data.size());
+        }
+
+        return iter->second;
+    }
+
+    template<typename T>
+    int32_t lookup_number(T value)
+    {
+        auto str = fmt::to_string(value);
+        auto iter = this->d_indexes.find(str);
+
+        if (iter != this->d_indexes.end()) {
+            return iter->second;
+        }
+
+        this->d_formatted.emplace_back(std::move(str));
+        return this->lookup(this->d_formatted.back());
+    }
+
+    size_t size() const { return this->d_offsets.size() - 1; }
+
+    std::unordered_map<std::string_view, int32_t> d_indexes;
+    std::deque<std::string> d_formatted;
+    /** The end offset of each value, starting with a zero. */
+    std::vector<int32_t> d_offsets{0};
+    std::string d_data;
+};
+
+}  // namespace
+
+namespace lnav::arrow_ipc {
+
+void
+column_values::append_null()
+{
+    this->cv_kinds.push_back(value_kind::null);
+    this->cv_numbers.push_back(0);
+    this->cv_text_ends.push_back(this->cv_text.size());
+}
+
+void
+column_values::append_integer(int64_t value)
+{
+    this->cv_kinds.push_back(value_kind::integer);
+    this->cv_numbers.push_back(value);
+    this->cv_text_ends.push_back(this->cv_text.size());
+}
+
+void
+column_values::append_real(double value)
+{
+    int64_t bits;
+
+    memcpy(&bits, &value, sizeof(bits));
+    this->cv_kinds.push_back(value_kind::real);
+    this->cv_numbers.push_back(bits);
+    this->cv_text_ends.push_back(this->cv_text.size());
+}
+
+void
+column_values::append_text(string_fragment value)
+{
+    this->cv_kinds.push_back(value_kind::text);
+    this->cv_numbers.push_back(0);
+    this->cv_text.append(value.data(), value.length());
+    this->cv_text_ends.push_back(this->cv_text.size());
+}
+
+column_type
+column_values::infer_type() const
+{
+    auto has_integer = false;
+    auto has_real = false;
+
+    for (const auto kind : this->cv_kinds) {
+        switch (kind) {
+            case value_kind::null:
+                break;
+            case value_kind::integer:
+                has_integer = true;
+                break;
+            case value_kind::real:
+                has_real = true;
+                break;
+            case value_kind::text:
+                return column_type::dict_utf8;
+        }
+    }
+
+    if (has_real) {
+        return column_type::float64;
+    }
+    if (has_integer) {
+        return column_type::int64;
+    }
+
+    return column_type::dict_utf8;
+}
+
+size_t
+batch::text_size() const
+{
+    size_t retval = 0;
+
+    for (const auto& cv : this->b_columns) {
+        retval += cv.text_size();
+    }
+
+    return retval;
+}
+
+stream_writer::stream_writer(FILE* file, std::vector<std::string> names)
+    : sw_file(file)
+{
+    for (auto& name : names) {
+        this->sw_columns.emplace_back(
+            column{std::move(name), column_type::dict_utf8});
+    }
+}
+
+Result<void, std::string>
+stream_writer::write_schema()
+{
+    auto metadata = message_metadata(
+        message_header::schema, 0, [this](flatbuffer_builder& fbb) {
+            auto schema = fbb.add_table({
+                {0, 2, HOST_ENDIANNESS},
+                {1, 0, 0},
+            });
+            auto fields = fbb.add_offset_vector(this->sw_columns.size());
+
+            fbb.patch(schema.tr_slots[1], fields);
+            for (size_t lpc = 0; lpc < this->sw_columns.size(); lpc++) {
+                fbb.patch(fields + 4 * (lpc + 1),
+                          add_field(fbb, this->sw_columns[lpc], lpc));
+            }
+
+            return schema.tr_pos;
+        });
+
+    this->sw_wrote_schema = true;
+    return this->write_message(metadata, {});
+}
+
+Result<size_t, std::string>
+stream_writer::write_batch(const batch& b)
+{
+    using value_kind = column_values::value_kind;
+
+    if (!this->sw_wrote_schema) {
+        for (size_t lpc = 0; lpc < this->sw_columns.size(); lpc++) {
+            this->sw_columns[lpc].c_type = b.b_columns[lpc].infer_type();
+        }
+        TRY(this->write_schema());
+    }
+
+    const auto rows = b.rows();
+    size_t retval = 0;
+    batch_body record_body;
+
+    for (size_t col = 0; col < this->sw_columns.size(); col++) {
+        const auto& cv = b.b_columns[col];
+        validity_bitmap validity(rows);
+
+        switch (this->sw_columns[col].c_type) {
+            case column_type::int64: {
+                std::vector<int64_t> values(rows);
+
+                for (size_t row = 0; row < rows; row++) {
+                    switch (cv.cv_kinds[row]) {
+                        case value_kind::null:
+                            break;
+                        case value_kind::integer:
+                            values[row] = cv.cv_numbers[row];
+                            validity.set_valid(row);
+                            break;
+                        case value_kind::real:
+                        case value_kind::text:
+                            retval += 1;
+                            break;
+                    }
+                }
+                record_body.add_node(rows, validity);
+                record_body.add_buffer(values);
+                break;
+            }
+            case column_type::float64: {
+                std::vector<double> values(rows);
+
+                for (size_t row = 0; row < rows; row++) {
+                    switch (cv.cv_kinds[row]) {
+                        case value_kind::null:
+                            break;
+                        case value_kind::integer:
+                            values[row] = (double) cv.cv_numbers[row];
+                            validity.set_valid(row);
+                            break;
+                        case value_kind::real:
+                            memcpy(&values[row],
+                                   &cv.cv_numbers[row],
+                                   sizeof(double));
+                            validity.set_valid(row);
+                            break;
+                        case value_kind::text:
+                            retval += 1;
+                            break;
+                    }
+                }
+                record_body.add_node(rows, validity);
+                record_body.add_buffer(values);
+                break;
+            }
+            case column_type::dict_utf8: {
+                std::vector<int32_t> indexes(rows);
+                dictionary dict;
+                const std::string_view text = cv.cv_text;
+
+                for (size_t row = 0; row < rows; row++) {
+                    switch (cv.cv_kinds[row]) {
+                        case value_kind::null:
+                            continue;
+                        case value_kind::integer:
+                            indexes[row]
+                                = dict.lookup_number(cv.cv_numbers[row]);
+                            break;
+                        case value_kind::real: {
+                            double value;
+
+                            memcpy(&value, &cv.cv_numbers[row], sizeof(value));
+                            indexes[row] = dict.lookup_number(value);
+                            break;
+                        }
+                        case value_kind::text: {
+                            const auto begin
+                                = row == 0 ? 0 : cv.cv_text_ends[row - 1];
+
+                            indexes[row] = dict.lookup(text.substr(
+                                begin, cv.cv_text_ends[row] - begin));
+                            break;
+                        }
+                    }
+                    validity.set_valid(row);
+                }
+
+                batch_body dict_body;
+                const auto dict_size = dict.size();
+
+                dict_body.add_node(dict_size, validity_bitmap{0});
+                dict_body.add_buffer(dict.d_offsets);
+                dict_body.add_buffer(dict.d_data.data(), dict.d_data.size());
+
+                auto dict_metadata = message_metadata(
+                    message_header::dictionary_batch,
+                    dict_body.bb_data.size(),
+                    [&](flatbuffer_builder& fbb) {
+                        auto db = fbb.add_table({
+                            {0, 8, col},
+                            {1, 0, 0},
+                        });
+
+                        fbb.patch(
+                            db.tr_slots[1],
+                            add_record_batch(fbb, dict_size, dict_body));
+                        return db.tr_pos;
+                    });
+                TRY(this->write_message(dict_metadata, dict_body.bb_data));
+
+                record_body.add_node(rows, validity);
+                record_body.add_buffer(indexes);
+                break;
+            }
+        }
+    }
+
+    auto metadata = message_metadata(message_header::record_batch,
+                                     record_body.bb_data.size(),
+                                     [&](flatbuffer_builder& fbb) {
+                                         return add_record_batch(
+                                             fbb, rows, record_body);
+                                     });
+    TRY(this->write_message(metadata, record_body.bb_data));
+
+    return Ok(retval);
+}
+
+Result<void, std::string>
+stream_writer::finish()
+{
+    if (!this->sw_wrote_schema) {
+        TRY(this->write_schema());
+    }
+
+    const uint32_t eos[] = {CONTINUATION_MARKER, 0};
+    if (fwrite(eos, sizeof(eos), 1, this->sw_file) != 1) {
+        return Err(fmt::format(FMT_STRING("unable to write stream -- {}"),
+                               strerror(errno)));
+    }
+
+    return Ok();
+}
+
+Result<void, std::string>
+stream_writer::write_message(const std::string& metadata,
+                             const std::string& body) const
+{
+    // The metadata length is always little-endian and the metadata was
+    // padded so that the body starts on an eight-byte boundary.
+    const uint8_t prefix[] = {
+        0xff,
+        0xff,
+        0xff,
+        0xff,
+        (uint8_t) (metadata.size() & 0xff),
+        (uint8_t) ((metadata.size() >> 8) & 0xff),
+        (uint8_t) ((metadata.size() >> 16) & 0xff),
+        (uint8_t) ((metadata.size() >> 24) & 0xff),
+    };
+
+    if (fwrite(prefix, sizeof(prefix), 1, this->sw_file) != 1
+        || fwrite(metadata.data(), 1, metadata.size(), this->sw_file)
+            != metadata.size()
+        || fwrite(body.data(), 1, body.size(), this->sw_file) != body.size())
+    {
+        return Err(fmt::format(FMT_STRING("unable to write stream -- {}"),
+                               strerror(errno)));
+    }
+
+    return Ok();
+}
+
+}  // namespace lnav::arrow_ipc
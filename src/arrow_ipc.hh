@@ -0,0 +1,149 @@
+/**
+ * Copyright (c) 2025, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef lnav_arrow_ipc_hh
+#define lnav_arrow_ipc_hh
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "base/intern_string.hh"
+#include "base/result.h"
+
+namespace lnav::arrow_ipc {
+
+enum class column_type {
+    int64,
+    float64,
+    /** UTF-8 strings that are dictionary-encoded with int32 indexes. */
+    dict_utf8,
+};
+
+struct column {
+    std::string c_name;
+    column_type c_type;
+};
+
+/**
+ * The values of one column in a batch of rows, kept as they were returned
+ * by SQLite.  They are converted to the type of the column when the batch
+ * is written.
+ */
+class column_values {
+public:
+    void append_null();
+
+    void append_integer(int64_t value);
+
+    void append_real(double value);
+
+    void append_text(string_fragment value);
+
+    size_t size() const { return this->cv_kinds.size(); }
+
+    size_t text_size() const { return this->cv_text.size(); }
+
+    /** @return The narrowest column type that can hold all of the values. */
+    column_type infer_type() const;
+
+private:
+    friend class stream_writer;
+
+    enum class value_kind : uint8_t {
+        null,
+        integer,
+        real,
+        text,
+    };
+
+    std::vector<value_kind> cv_kinds;
+    /** The integer value or the bits of the real value. */
+    std::vector<int64_t> cv_numbers;
+    /** The end offset of each text value in cv_text. */
+    std::vector<uint32_t> cv_text_ends;
+    std::string cv_text;
+};
+
+struct batch {
+    explicit batch(size_t column_count) : b_columns(column_count) {}
+
+    size_t rows() const
+    {
+        return this->b_columns.empty() ? 0 : this->b_columns[0].size();
+    }
+
+    size_t text_size() const;
+
+    std::vector<column_values> b_columns;
+};
+
+/**
+ * Writes batches of rows in the Arrow IPC streaming format.  The schema is
+ * written before the first batch with the column types inferred from the
+ * values in that batch.  Each batch is written as a record batch that is
+ * preceded by a dictionary batch for each of the string columns.  A
+ * dictionary only has the values in its batch and replaces the dictionary
+ * of the previous batch, so memory use is bounded by the batch size.
+ */
+class stream_writer {
+public:
+    stream_writer(FILE* file, std::vector<std::string> names);
+
+    /**
+     * Convert the values in the batch to the types of the columns and write
+     * them.  Values that cannot be converted, like text in an integer
+     * column, are written as nulls.
+     *
+     * @return The number of values that were written as nulls because they
+     *   could not be converted.
+     */
+    Result<size_t, std::string> write_batch(const batch& b);
+
+    /** Write the schema, if needed, and the end-of-stream marker. */
+    Result<void, std::string> finish();
+
+    const std::vector<column>& get_columns() const { return this->sw_columns; }
+
+private:
+    Result<void, std::string> write_schema();
+
+    Result<void, std::string> write_message(const std::string& metadata,
+                                            const std::string& body) const;
+
+    FILE* sw_file;
+    std::vector<column> sw_columns;
+    bool sw_wrote_schema{false};
+};
+
+}  // namespace lnav::arrow_ipc
+
+#endif
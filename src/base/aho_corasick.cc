@@ -0,0 +1,169 @@
+/**
+ * Copyright (c) 2025, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <queue>
+
+#include "aho_corasick.hh"
+
+#include "config.h"
+
+namespace lnav {
+
+static uint8_t
+fold_byte(uint8_t ch)
+{
+    if ('A' <= ch && ch <= 'Z') {
+        return ch + ('a' - 'A');
+    }
+    return ch;
+}
+
+aho_corasick::literal_id
+aho_corasick::add(string_fragment lit)
+{
+    std::string folded;
+
+    folded.reserve(lit.length());
+    for (auto ch : lit) {
+        folded.push_back(fold_byte(ch));
+    }
+
+    auto iter = std::find(
+        this->ac_literals.begin(), this->ac_literals.end(), folded);
+    if (iter != this->ac_literals.end()) {
+        return std::distance(this->ac_literals.begin(), iter);
+    }
+
+    this->ac_literals.emplace_back(std::move(folded));
+    return this->ac_literals.size() - 1;
+}
+
+void
+aho_corasick::compile()
+{
+    static constexpr uint32_t NO_STATE = UINT32_MAX;
+
+    this->ac_classes.fill(0);
+    this->ac_class_count = 1;
+    for (const auto& lit : this->ac_literals) {
+        for (auto ch : lit) {
+            auto& cls = this->ac_classes[(uint8_t) ch];
+
+            if (cls == 0) {
+                cls = this->ac_class_count;
+                this->ac_class_count += 1;
+            }
+        }
+    }
+    // The matching is done on folded bytes, so upper-case letters map to
+    // the same class as their lower-case versions.
+    for (int ch = 'A'; ch <= 'Z'; ch++) {
+        this->ac_classes[ch] = this->ac_classes[fold_byte(ch)];
+    }
+
+    // Build the trie.
+    this->ac_transitions.assign(this->ac_class_count, NO_STATE);
+    this->ac_outputs.assign(1, {});
+    for (size_t lit_id = 0; lit_id < this->ac_literals.size(); lit_id++) {
+        uint32_t state = 0;
+
+        for (auto ch : this->ac_literals[lit_id]) {
+            auto cls = this->ac_classes[(uint8_t) ch];
+            auto& next
+                = this->ac_transitions[state * this->ac_class_count + cls];
+
+            if (next == NO_STATE) {
+                next = this->ac_outputs.size();
+                this->ac_outputs.emplace_back();
+                this->ac_transitions.resize(
+                    this->ac_transitions.size() + this->ac_class_count,
+                    NO_STATE);
+            }
+            state = this->ac_transitions[state * this->ac_class_count + cls];
+        }
+        this->ac_outputs[state].emplace_back(lit_id);
+    }
+
+    // Turn the trie into a DFA by following the failure links in
+    // breadth-first order.
+    std::vector<uint32_t> fail(this->ac_outputs.size(), 0);
+    std::queue<uint32_t> pending;
+
+    for (uint32_t cls = 0; cls < this->ac_class_count; cls++) {
+        auto& next = this->ac_transitions[cls];
+
+        if (next == NO_STATE) {
+            next = 0;
+        } else {
+            fail[next] = 0;
+            pending.push(next);
+        }
+    }
+    while (!pending.empty()) {
+        auto state = pending.front();
+
+        pending.pop();
+        const auto& fail_outputs = this->ac_outputs[fail[state]];
+        this->ac_outputs[state].insert(this->ac_outputs[state].end(),
+                                       fail_outputs.begin(),
+                                       fail_outputs.end());
+        for (uint32_t cls = 0; cls < this->ac_class_count; cls++) {
+            auto& next
+                = this->ac_transitions[state * this->ac_class_count + cls];
+            auto fail_next = this->goto_state(fail[state], cls);
+
+            if (next == NO_STATE) {
+                next = fail_next;
+            } else {
+                fail[next] = fail_next;
+                pending.push(next);
+            }
+        }
+    }
+}
+
+void
+aho_corasick::find_all(string_fragment in, std::vector<bool>& found_out) const
+{
+    uint32_t state = 0;
+
+    found_out.assign(this->ac_literals.size(), false);
+    if (this->ac_transitions.empty()) {
+        return;
+    }
+    for (auto ch : in) {
+        state = this->goto_state(state, this->ac_classes[(uint8_t) ch]);
+        for (auto lit_id : this->ac_outputs[state]) {
+            found_out[lit_id] = true;
+        }
+    }
+}
+
+}  // namespace lnav
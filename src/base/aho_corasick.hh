@@ -0,0 +1,93 @@
+/**
+ * Copyright (c) 2025, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef lnav_aho_corasick_hh
+#define lnav_aho_corasick_hh
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "intern_string.hh"
+
+namespace lnav {
+
+/**
+ * Matcher that finds any number of literal strings in a single pass over
+ * the input using the Aho-Corasick algorithm.  Literals are matched
+ * without regard to the case of ASCII letters.
+ */
+class aho_corasick {
+public:
+    using literal_id = uint32_t;
+
+    /**
+     * Add a literal to be searched for.  Adding the same literal more than
+     * once returns the same ID.  The matcher needs to be compiled before
+     * it can be used again.
+     *
+     * @param lit The literal, which must not be empty.
+     * @return The ID that find_all() will use for the literal.
+     */
+    literal_id add(string_fragment lit);
+
+    /** Build the automaton from the literals that have been added. */
+    void compile();
+
+    size_t size() const { return this->ac_literals.size(); }
+
+    bool empty() const { return this->ac_literals.empty(); }
+
+    /**
+     * Scan the input for the literals.
+     *
+     * @param in The input to scan.
+     * @param found_out Sized to the number of literals with the entries
+     *   for the literals that were found set to true.
+     */
+    void find_all(string_fragment in, std::vector<bool>& found_out) const;
+
+private:
+    uint32_t goto_state(uint32_t state, uint8_t cls) const
+    {
+        return this->ac_transitions[state * this->ac_class_count + cls];
+    }
+
+    std::vector<std::string> ac_literals;
+    /** Bytes that do not appear in any literal share class zero. */
+    std::array<uint8_t, 256> ac_classes{};
+    uint32_t ac_class_count{1};
+    std::vector<uint32_t> ac_transitions;
+    std::vector<std::vector<literal_id>> ac_outputs;
+};
+
+}  // namespace lnav
+
+#endif
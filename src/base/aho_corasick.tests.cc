@@ -0,0 +1,66 @@
+/**
+ * Copyright (c) 2025, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+
+#include "aho_corasick.hh"
+
+#include "doctest/doctest.h"
+
+TEST_CASE("aho_corasick::find_all")
+{
+    lnav::aho_corasick ac;
+    std::vector<bool> found;
+
+    auto he_id = ac.add("he"_frag);
+    auto she_id = ac.add("she"_frag);
+    auto his_id = ac.add("HIS"_frag);
+    auto hers_id = ac.add("hers"_frag);
+
+    CHECK(ac.add("He"_frag) == he_id);
+    CHECK(ac.size() == 4);
+
+    ac.compile();
+
+    ac.find_all("ushers"_frag, found);
+    CHECK(found.size() == 4);
+    CHECK(found[he_id]);
+    CHECK(found[she_id]);
+    CHECK_FALSE(found[his_id]);
+    CHECK(found[hers_id]);
+
+    ac.find_all("This Is"_frag, found);
+    CHECK_FALSE(found[he_id]);
+    CHECK_FALSE(found[she_id]);
+    CHECK(found[his_id]);
+    CHECK_FALSE(found[hers_id]);
+
+    ac.find_all(""_frag, found);
+    CHECK(std::none_of(found.begin(), found.end(), [](auto b) { return b; }));
+}
@@ -229,8 +229,9 @@ date_time_scanner::scan(const char* time_dest,
                 tm_out->et_tm.tm_zone = nullptr;
             }
 #endif
-            if (ptime_fmt(
-                    time_fmt[curr_time_fmt], tm_out, time_dest, off, time_len)
+            const auto* prog = this->program_for(time_fmt, curr_time_fmt);
+
+            if (prog->parse(tm_out, time_dest, off, time_len)
                 && (time_dest[off] == '.' || time_dest[off] == ','
                     || off == (off_t) time_len))
             {
@@ -329,6 +330,22 @@ date_time_scanner::scan(const char* time_dest,
     return retval;
 }
 
+const ptime_program*
+date_time_scanner::program_for(const char* const time_fmt[], int index)
+{
+    if ((size_t) index >= this->dts_compiled_formats.size()) {
+        this->dts_compiled_formats.resize(index + 1);
+    }
+
+    auto& cf = this->dts_compiled_formats[index];
+    if (cf.cf_format != time_fmt[index]) {
+        cf.cf_format = time_fmt[index];
+        cf.cf_program = ptime_program::lookup(time_fmt[index]);
+    }
+
+    return cf.cf_program;
+}
+
 void
 date_time_scanner::clear()
 {
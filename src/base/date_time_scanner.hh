@@ -34,12 +34,15 @@
 
 #include <ctime>
 #include <string>
+#include <vector>
 
 #include <sys/types.h>
 
 #include "date/tz.h"
 #include "time_util.hh"
 
+class ptime_program;
+
 /**
  * Scans a timestamp string to discover the date-time format using the custom
  * ptimec parser.  Once a format is found, it is locked in so that the next
@@ -102,6 +105,17 @@ struct date_time_scanner {
     tm dts_localtime_cached_tm{};
     const date::time_zone* dts_default_zone{nullptr};
 
+    struct compiled_format {
+        const char* cf_format{nullptr};
+        const ptime_program* cf_program{nullptr};
+    };
+
+    /**
+     * The compiled programs for the custom formats that have been used
+     * with this scanner, indexed the same as the format array.
+     */
+    std::vector<compiled_format> dts_compiled_formats;
+
     static const int EXPIRE_TIME = 15 * 60;
 
     const char* scan(const char* time_src,
@@ -111,6 +125,9 @@ struct date_time_scanner {
                      struct timeval& tv_out,
                      bool convert_local = true);
 
+    const ptime_program* program_for(const char* const time_fmt[],
+                                     int index);
+
     size_t ftime(char* dst,
                  size_t len,
                  const char* const time_fmt[],
@@ -25,10 +25,157 @@
  * SUCH DAMAGE.
  */
 
+#include <string.h>
+
 #include "is_utf8.hh"
 
 #include "config.h"
 
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#    include <immintrin.h>
+#    define IS_UTF8_X86_SIMD 1
+#endif
+
+namespace {
+
+/*
+  The following functions return the length of the prefix of the given
+  buffer that consists of plain ASCII, meaning bytes that are less than 0x80
+  and are not the stop byte, an ESC, or a backspace.  The number of tabs in
+  the prefix is added to `tabs` since they affect the column width guess.
+  Callers that do not have a terminator should pass ESC as the stop byte.
+*/
+
+size_t
+ascii_span_scalar(const unsigned char* buf,
+                  size_t len,
+                  unsigned char stop,
+                  size_t& tabs)
+{
+    size_t i = 0;
+
+    for (; i < len; i++) {
+        const auto ch = buf[i];
+
+        if (ch >= 0x80 || ch == stop || ch == '\x1b' || ch == '\b') {
+            break;
+        }
+        if (ch == '\t') {
+            tabs += 1;
+        }
+    }
+
+    return i;
+}
+
+#ifdef IS_UTF8_X86_SIMD
+size_t
+ascii_span_sse2(const unsigned char* buf,
+                size_t len,
+                unsigned char stop,
+                size_t& tabs)
+{
+    const auto v_stop = _mm_set1_epi8((char) stop);
+    const auto v_esc = _mm_set1_epi8('\x1b');
+    const auto v_bs = _mm_set1_epi8('\b');
+    const auto v_tab = _mm_set1_epi8('\t');
+    size_t i = 0;
+
+    for (; i + 16 <= len; i += 16) {
+        const auto block = _mm_loadu_si128((const __m128i*) (buf + i));
+        const auto special
+            = _mm_or_si128(_mm_cmpeq_epi8(block, v_stop),
+                           _mm_or_si128(_mm_cmpeq_epi8(block, v_esc),
+                                        _mm_cmpeq_epi8(block, v_bs)));
+        // The high-bit of non-ASCII bytes is already set in the block.
+        const uint32_t stop_mask
+            = _mm_movemask_epi8(_mm_or_si128(block, special));
+        const uint32_t tab_mask
+            = _mm_movemask_epi8(_mm_cmpeq_epi8(block, v_tab));
+
+        if (stop_mask != 0) {
+            const auto off = __builtin_ctz(stop_mask);
+
+            tabs += __builtin_popcount(tab_mask & ((1U << off) - 1U));
+            return i + off;
+        }
+        tabs += __builtin_popcount(tab_mask);
+    }
+
+    return i + ascii_span_scalar(buf + i, len - i, stop, tabs);
+}
+
+__attribute__((target("avx2"))) size_t
+ascii_span_avx2(const unsigned char* buf,
+                size_t len,
+                unsigned char stop,
+                size_t& tabs)
+{
+    const auto v_stop = _mm256_set1_epi8((char) stop);
+    const auto v_esc = _mm256_set1_epi8('\x1b');
+    const auto v_bs = _mm256_set1_epi8('\b');
+    const auto v_tab = _mm256_set1_epi8('\t');
+    size_t i = 0;
+
+    for (; i + 32 <= len; i += 32) {
+        const auto block = _mm256_loadu_si256((const __m256i*) (buf + i));
+        const auto special
+            = _mm256_or_si256(_mm256_cmpeq_epi8(block, v_stop),
+                              _mm256_or_si256(_mm256_cmpeq_epi8(block, v_esc),
+                                              _mm256_cmpeq_epi8(block, v_bs)));
+        const uint32_t stop_mask
+            = _mm256_movemask_epi8(_mm256_or_si256(block, special));
+        const uint32_t tab_mask
+            = _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, v_tab));
+
+        if (stop_mask != 0) {
+            const auto off = __builtin_ctz(stop_mask);
+
+            tabs += __builtin_popcount(tab_mask & ((1U << off) - 1U));
+            return i + off;
+        }
+        tabs += __builtin_popcount(tab_mask);
+    }
+
+    return i + ascii_span_sse2(buf + i, len - i, stop, tabs);
+}
+#endif
+
+using ascii_span_func = size_t (*)(const unsigned char*,
+                                   size_t,
+                                   unsigned char,
+                                   size_t&);
+
+ascii_span_func
+select_ascii_span()
+{
+#ifdef IS_UTF8_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return ascii_span_avx2;
+    }
+    return ascii_span_sse2;
+#else
+    return ascii_span_scalar;
+#endif
+}
+
+size_t
+ascii_span(const unsigned char* buf,
+           size_t len,
+           unsigned char stop,
+           size_t& tabs)
+{
+    static const auto IMPL = select_ascii_span();
+
+    return IMPL(buf, len, stop, tabs);
+}
+
+/* Spans shorter than this are not worth the overhead of the block scan. */
+constexpr ssize_t MIN_ASCII_SPAN = 16;
+
+}  // namespace
+
 /*
   Check if the given unsigned char * is a valid utf-8 sequence.
 
@@ -67,16 +214,50 @@ is_utf8(string_fragment str, std::optional<unsigned char> terminator)
     ssize_t i = 0, valid_end = 0;
 
     while (i < str.length()) {
+        if (retval.usr_message != nullptr) {
+            /*
+             * Once the string is known to be invalid, all that is left to do
+             * is find the terminator.
+             */
+            const void* term_ptr = nullptr;
+
+            if (terminator) {
+                term_ptr
+                    = memchr(&ustr[i], terminator.value(), str.length() - i);
+            }
+            if (term_ptr == nullptr) {
+                retval.usr_column_width_guess += str.length() - i;
+                i = str.length();
+            } else {
+                auto term_index = (const unsigned char*) term_ptr - ustr;
+
+                retval.usr_column_width_guess += term_index - i;
+                retval.usr_remaining = str.substr(term_index + 1);
+                i = term_index;
+            }
+            break;
+        }
+
+        if (ustr[i] < 0x80 && str.length() - i >= MIN_ASCII_SPAN) {
+            size_t tabs = 0;
+            auto span = ascii_span(&ustr[i],
+                                   str.length() - i,
+                                   terminator.value_or('\x1b'),
+                                   tabs);
+
+            if (span > 0) {
+                retval.usr_column_width_guess += span + tabs * 7;
+                i += span;
+                continue;
+            }
+        }
+
         if (terminator && ustr[i] == terminator.value()) {
             retval.usr_remaining = str.substr(i + 1);
             break;
         }
 
         retval.usr_column_width_guess += 1;
-        if (retval.usr_message != nullptr) {
-            i += 1;
-            continue;
-        }
 
         valid_end = i;
         if (ustr[i] <= 0x7F) /* 00..7F */ {
@@ -312,3 +493,52 @@ is_utf8(string_fragment str, std::optional<unsigned char> terminator)
     }
     return retval;
 }
+
+void
+scan_utf8_lines(string_fragment frag,
+                std::vector<uint32_t>& line_starts,
+                std::vector<bool>& line_is_utf,
+                std::vector<bool>& line_has_ansi)
+{
+    const auto* ustr = frag.udata();
+    const size_t len = frag.length();
+    size_t line_start = 0;
+    size_t i = 0;
+    auto has_ansi = false;
+
+    while (line_start < len) {
+        size_t tabs = 0;
+
+        i += ascii_span(&ustr[i], len - i, '\n', tabs);
+        if (i < len && ustr[i] == '\n') {
+            line_starts.emplace_back(line_start);
+            line_is_utf.emplace_back(true);
+            line_has_ansi.emplace_back(has_ansi);
+            i += 1;
+            line_start = i;
+            has_ansi = false;
+            continue;
+        }
+        if (i < len && ustr[i] < 0x80) {
+            // ESC or backspace
+            has_ansi = true;
+            i += 1;
+            continue;
+        }
+
+        /*
+         * Either the end of the buffer was reached or there is a non-ASCII
+         * byte, let the full validator take care of the rest of the line.
+         */
+        auto scan_res = is_utf8(frag.substr(i), '\n');
+        line_starts.emplace_back(line_start);
+        line_is_utf.emplace_back(scan_res.is_valid());
+        line_has_ansi.emplace_back(has_ansi || scan_res.usr_has_ansi);
+        if (!scan_res.usr_remaining) {
+            break;
+        }
+        line_start = scan_res.usr_remaining->data() - frag.data();
+        i = line_start;
+        has_ansi = false;
+    }
+}
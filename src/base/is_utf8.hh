@@ -29,6 +29,9 @@
 #define _IS_UTF8_H
 
 #include <optional>
+#include <vector>
+
+#include <stdint.h>
 
 #include "intern_string.hh"
 
@@ -55,4 +58,16 @@ utf8_scan_result is_utf8(string_fragment frag,
                          std::optional<unsigned char> terminator
                          = std::nullopt);
 
+/**
+ * Scan a buffer of newline-terminated lines in a single pass.  For each line,
+ * the offset of its start relative to the beginning of the buffer, whether it
+ * is valid UTF-8, and whether it contains escape sequences are appended to
+ * the given vectors.  A trailing line without a newline is also recorded.
+ * The results are the same as calling is_utf8(line, '\n') on each line.
+ */
+void scan_utf8_lines(string_fragment frag,
+                     std::vector<uint32_t>& line_starts,
+                     std::vector<bool>& line_is_utf,
+                     std::vector<bool>& line_has_ansi);
+
 #endif /* _IS_UTF8_H */
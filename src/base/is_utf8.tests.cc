@@ -0,0 +1,151 @@
+/**
+ * Copyright (c) 2025, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string>
+#include <vector>
+
+#include "base/is_utf8.hh"
+
+#include "config.h"
+#include "doctest/doctest.h"
+
+TEST_CASE("is_utf8-ascii")
+{
+    std::string line(100, 'a');
+
+    line[20] = '\t';
+    line[70] = '\t';
+    auto frag = string_fragment::from_str(line);
+    auto res = is_utf8(frag);
+    CHECK(res.is_valid());
+    CHECK(!res.usr_has_ansi);
+    CHECK(res.usr_column_width_guess == 100 + 2 * 7);
+    CHECK(res.usr_valid_frag.length() == 100);
+    CHECK(!res.usr_remaining);
+
+    line[90] = '\n';
+    frag = string_fragment::from_str(line);
+    res = is_utf8(frag, '\n');
+    CHECK(res.is_valid());
+    CHECK(res.usr_column_width_guess == 90 + 2 * 7);
+    CHECK(res.usr_valid_frag.length() == 90);
+    REQUIRE(res.usr_remaining);
+    CHECK(res.usr_remaining->length() == 9);
+}
+
+TEST_CASE("is_utf8-ansi")
+{
+    std::string line(64, 'a');
+
+    line[40] = '\x1b';
+    auto res = is_utf8(string_fragment::from_str(line), '\n');
+    CHECK(res.is_valid());
+    CHECK(res.usr_has_ansi);
+    CHECK(res.usr_column_width_guess == 64);
+
+    line[40] = '\b';
+    res = is_utf8(string_fragment::from_str(line), '\n');
+    CHECK(res.usr_has_ansi);
+}
+
+TEST_CASE("is_utf8-multibyte")
+{
+    std::string line(50, 'a');
+
+    line.insert(33, "\xc3\xa9");
+    auto res = is_utf8(string_fragment::from_str(line), '\n');
+    CHECK(res.is_valid());
+    CHECK(res.usr_valid_frag.length() == 52);
+    CHECK(res.usr_column_width_guess == 51);
+
+    line.insert(45, "\xff");
+    line.append("\nabc");
+    res = is_utf8(string_fragment::from_str(line), '\n');
+    CHECK(!res.is_valid());
+    CHECK(res.usr_faulty_bytes == 1);
+    CHECK(res.usr_valid_frag.length() == 45);
+    REQUIRE(res.usr_remaining);
+    CHECK(res.usr_remaining->to_string() == "abc");
+}
+
+TEST_CASE("scan_utf8_lines")
+{
+    std::string buf;
+    std::vector<uint32_t> expected_starts;
+    std::vector<bool> expected_utf;
+    std::vector<bool> expected_ansi;
+
+    for (int lpc = 0; lpc < 40; lpc++) {
+        expected_starts.emplace_back(buf.size());
+        buf.append(lpc * 3, 'x');
+        switch (lpc % 4) {
+            case 0:
+                expected_utf.emplace_back(true);
+                expected_ansi.emplace_back(false);
+                break;
+            case 1:
+                buf.append("\x1b[1mbold\x1b[0m");
+                expected_utf.emplace_back(true);
+                expected_ansi.emplace_back(true);
+                break;
+            case 2:
+                buf.append("caf\xc3\xa9 \xe2\x9c\x93");
+                expected_utf.emplace_back(true);
+                expected_ansi.emplace_back(false);
+                break;
+            case 3:
+                buf.append("\x1b[0mbad \xc3\x28 end");
+                expected_utf.emplace_back(false);
+                expected_ansi.emplace_back(true);
+                break;
+        }
+        buf.append(lpc * 2, 'y');
+        buf.push_back('\n');
+    }
+    expected_starts.emplace_back(buf.size());
+    expected_utf.emplace_back(true);
+    expected_ansi.emplace_back(false);
+    buf.append("partial line");
+
+    std::vector<uint32_t> starts;
+    std::vector<bool> is_utf;
+    std::vector<bool> has_ansi;
+    scan_utf8_lines(string_fragment::from_str(buf), starts, is_utf, has_ansi);
+
+    CHECK(starts == expected_starts);
+    CHECK(is_utf == expected_utf);
+    CHECK(has_ansi == expected_ansi);
+
+    starts.clear();
+    is_utf.clear();
+    has_ansi.clear();
+    buf.push_back('\n');
+    scan_utf8_lines(string_fragment::from_str(buf), starts, is_utf, has_ansi);
+    CHECK(starts == expected_starts);
+}
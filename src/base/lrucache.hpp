@@ -61,6 +61,20 @@ public:
 
     size_t size() const { return _cache_items_map.size(); }
 
+    template<typename P>
+    void erase_if(P pred)
+    {
+        auto it = _cache_items_list.begin();
+        while (it != _cache_items_list.end()) {
+            if (pred(it->first)) {
+                _cache_items_map.erase(it->first);
+                it = _cache_items_list.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
     void set_max_size(size_t max_size) { this->_max_size = max_size; }
 
     void clear()
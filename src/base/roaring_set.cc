@@ -0,0 +1,675 @@
+/**
+ * Copyright (c) 2025, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+
+#include "roaring_set.hh"
+
+#include "config.h"
+
+namespace lnav {
+
+namespace {
+
+uint32_t
+popcount(uint64_t word)
+{
+    return __builtin_popcountll(word);
+}
+
+/**
+ * @return The number of the first set bit at or after the given one or
+ *   CHUNK_SIZE if there are none.
+ */
+uint32_t
+next_set_bit(const std::vector<uint64_t>& bits, uint32_t start)
+{
+    if (start >= roaring_set_base::CHUNK_SIZE) {
+        return roaring_set_base::CHUNK_SIZE;
+    }
+
+    auto word_index = start / 64;
+    auto word = bits[word_index] & (~0ULL << (start % 64));
+
+    while (true) {
+        if (word != 0) {
+            return word_index * 64 + __builtin_ctzll(word);
+        }
+        word_index += 1;
+        if (word_index == roaring_set_base::BITMAP_WORDS) {
+            return roaring_set_base::CHUNK_SIZE;
+        }
+        word = bits[word_index];
+    }
+}
+
+/**
+ * @return The number of the last set bit before the given one.
+ */
+std::optional<uint32_t>
+prev_set_bit(const std::vector<uint64_t>& bits, uint32_t end)
+{
+    if (end == 0) {
+        return std::nullopt;
+    }
+
+    auto last = end - 1;
+    auto word_index = last / 64;
+    auto shift = 63 - (last % 64);
+    auto word = (bits[word_index] << shift) >> shift;
+
+    while (true) {
+        if (word != 0) {
+            return word_index * 64 + (63 - __builtin_clzll(word));
+        }
+        if (word_index == 0) {
+            return std::nullopt;
+        }
+        word_index -= 1;
+        word = bits[word_index];
+    }
+}
+
+}  // namespace
+
+bool
+roaring_set_base::chunk::contains(uint16_t low) const
+{
+    if (this->is_bitmap()) {
+        return (this->c_bits[low / 64] >> (low % 64)) & 1;
+    }
+
+    return std::binary_search(this->c_array.begin(), this->c_array.end(), low);
+}
+
+std::pair<uint32_t, bool>
+roaring_set_base::chunk::insert(uint16_t low)
+{
+    if (this->is_bitmap()) {
+        auto& word = this->c_bits[low / 64];
+        auto mask = 1ULL << (low % 64);
+
+        if (word & mask) {
+            return std::make_pair(low, false);
+        }
+        word |= mask;
+        this->c_count += 1;
+        return std::make_pair(low, true);
+    }
+
+    // Lines are usually added in order, so check the end first.
+    auto iter = this->c_array.end();
+    if (!this->c_array.empty() && this->c_array.back() >= low) {
+        iter = std::lower_bound(this->c_array.begin(), this->c_array.end(), low);
+        if (*iter == low) {
+            return std::make_pair(iter - this->c_array.begin(), false);
+        }
+    }
+    if (this->c_array.size() == ARRAY_MAX) {
+        this->to_bitmap();
+        return this->insert(low);
+    }
+
+    iter = this->c_array.insert(iter, low);
+    this->c_count += 1;
+    return std::make_pair(iter - this->c_array.begin(), true);
+}
+
+bool
+roaring_set_base::chunk::erase(uint16_t low)
+{
+    if (this->is_bitmap()) {
+        auto& word = this->c_bits[low / 64];
+        auto mask = 1ULL << (low % 64);
+
+        if (!(word & mask)) {
+            return false;
+        }
+        word &= ~mask;
+        this->c_count -= 1;
+        // Leave some room before switching back so that a chunk near the
+        // threshold does not keep flipping between the two forms.
+        if (this->c_count < ARRAY_MAX / 2) {
+            this->to_array();
+        }
+        return true;
+    }
+
+    auto iter
+        = std::lower_bound(this->c_array.begin(), this->c_array.end(), low);
+    if (iter == this->c_array.end() || *iter != low) {
+        return false;
+    }
+    this->c_array.erase(iter);
+    this->c_count -= 1;
+    return true;
+}
+
+uint32_t
+roaring_set_base::chunk::lower_pos(uint32_t low) const
+{
+    if (this->is_bitmap()) {
+        return next_set_bit(this->c_bits, low);
+    }
+
+    return std::lower_bound(this->c_array.begin(), this->c_array.end(), low)
+        - this->c_array.begin();
+}
+
+uint32_t
+roaring_set_base::chunk::next_pos(uint32_t pos) const
+{
+    if (this->is_bitmap()) {
+        return next_set_bit(this->c_bits, pos + 1);
+    }
+
+    return pos + 1;
+}
+
+std::optional<uint32_t>
+roaring_set_base::chunk::prev_pos(uint32_t pos) const
+{
+    if (this->is_bitmap()) {
+        return prev_set_bit(this->c_bits, pos);
+    }
+
+    if (pos == 0) {
+        return std::nullopt;
+    }
+    return pos - 1;
+}
+
+uint32_t
+roaring_set_base::chunk::rank(uint32_t low) const
+{
+    if (this->is_bitmap()) {
+        uint32_t retval = 0;
+        auto full_words = low / 64;
+
+        for (uint32_t lpc = 0; lpc < full_words; lpc++) {
+            retval += popcount(this->c_bits[lpc]);
+        }
+        if (low % 64) {
+            retval += popcount(this->c_bits[full_words]
+                               & ((1ULL << (low % 64)) - 1));
+        }
+        return retval;
+    }
+
+    return this->lower_pos(low);
+}
+
+void
+roaring_set_base::chunk::to_bitmap()
+{
+    this->c_bits.resize(BITMAP_WORDS);
+    for (const auto low : this->c_array) {
+        this->c_bits[low / 64] |= 1ULL << (low % 64);
+    }
+    this->c_array.clear();
+    this->c_array.shrink_to_fit();
+}
+
+void
+roaring_set_base::chunk::to_array()
+{
+    this->c_array.reserve(this->c_count);
+    for (uint32_t word_index = 0; word_index < BITMAP_WORDS; word_index++) {
+        auto word = this->c_bits[word_index];
+
+        while (word != 0) {
+            this->c_array.push_back(word_index * 64 + __builtin_ctzll(word));
+            word &= word - 1;
+        }
+    }
+    this->c_bits.clear();
+    this->c_bits.shrink_to_fit();
+}
+
+roaring_set_base::const_iterator&
+roaring_set_base::const_iterator::operator++()
+{
+    const auto& chunks = this->i_set->rs_chunks;
+    const auto& ch = chunks[this->i_chunk];
+
+    this->i_pos = ch.next_pos(this->i_pos);
+    if (this->i_pos == ch.end_pos()) {
+        this->i_chunk += 1;
+        this->i_pos = this->i_chunk < chunks.size()
+            ? chunks[this->i_chunk].lower_pos(0)
+            : 0;
+    }
+
+    return *this;
+}
+
+roaring_set_base::const_iterator&
+roaring_set_base::const_iterator::operator--()
+{
+    const auto& chunks = this->i_set->rs_chunks;
+
+    if (this->i_chunk < chunks.size()) {
+        auto prev_opt = chunks[this->i_chunk].prev_pos(this->i_pos);
+
+        if (prev_opt) {
+            this->i_pos = prev_opt.value();
+            return *this;
+        }
+    }
+
+    this->i_chunk -= 1;
+    const auto& ch = chunks[this->i_chunk];
+    this->i_pos = ch.prev_pos(ch.end_pos()).value();
+
+    return *this;
+}
+
+size_t
+roaring_set_base::chunk_index(uint64_t key) const
+{
+    if (!this->rs_chunks.empty() && this->rs_chunks.back().c_key < key) {
+        return this->rs_chunks.size();
+    }
+
+    return std::lower_bound(this->rs_chunks.begin(),
+                            this->rs_chunks.end(),
+                            key,
+                            [](const chunk& ch, uint64_t k) {
+                                return ch.c_key < k;
+                            })
+        - this->rs_chunks.begin();
+}
+
+roaring_set_base::const_iterator
+roaring_set_base::begin() const
+{
+    if (this->rs_chunks.empty()) {
+        return this->end();
+    }
+
+    return const_iterator{this, 0, this->rs_chunks.front().lower_pos(0)};
+}
+
+std::pair<roaring_set_base::const_iterator, bool>
+roaring_set_base::insert(uint64_t value)
+{
+    auto key = value >> 16;
+    auto index = this->chunk_index(key);
+
+    if (index == this->rs_chunks.size() || this->rs_chunks[index].c_key != key)
+    {
+        auto iter = this->rs_chunks.emplace(this->rs_chunks.begin() + index);
+
+        iter->c_key = key;
+    }
+
+    auto [pos, added] = this->rs_chunks[index].insert(value & 0xffff);
+    if (added) {
+        this->rs_size += 1;
+    }
+
+    return std::make_pair(const_iterator{this, index, pos}, added);
+}
+
+size_t
+roaring_set_base::erase(uint64_t value)
+{
+    auto key = value >> 16;
+    auto index = this->chunk_index(key);
+
+    if (index == this->rs_chunks.size() || this->rs_chunks[index].c_key != key)
+    {
+        return 0;
+    }
+
+    auto& ch = this->rs_chunks[index];
+    if (!ch.erase(value & 0xffff)) {
+        return 0;
+    }
+    this->rs_size -= 1;
+    if (ch.c_count == 0) {
+        this->rs_chunks.erase(this->rs_chunks.begin() + index);
+    }
+
+    return 1;
+}
+
+void
+roaring_set_base::erase_range(uint64_t low, uint64_t high)
+{
+    if (low >= high) {
+        return;
+    }
+
+    auto low_key = low >> 16;
+    auto high_key = (high - 1) >> 16;
+    auto first = this->chunk_index(low_key);
+    auto index = first;
+    auto whole_start = this->rs_chunks.size();
+    auto whole_end = whole_start;
+
+    for (; index < this->rs_chunks.size()
+         && this->rs_chunks[index].c_key <= high_key;
+         index++)
+    {
+        auto& ch = this->rs_chunks[index];
+        auto chunk_low = ch.c_key == low_key ? (low & 0xffff) : 0;
+        auto chunk_high = ch.c_key == high_key ? ((high - 1) & 0xffff) + 1
+                                               : CHUNK_SIZE;
+
+        if (chunk_low == 0 && chunk_high == CHUNK_SIZE) {
+            if (whole_start == this->rs_chunks.size()) {
+                whole_start = index;
+            }
+            whole_end = index + 1;
+            this->rs_size -= ch.c_count;
+            continue;
+        }
+
+        std::vector<uint16_t> to_del;
+        for (auto pos = ch.lower_pos(chunk_low); pos != ch.end_pos();
+             pos = ch.next_pos(pos))
+        {
+            auto val = ch.value_at(pos);
+            if (val >= chunk_high) {
+                break;
+            }
+            to_del.emplace_back(val);
+        }
+        for (const auto val : to_del) {
+            ch.erase(val);
+        }
+        this->rs_size -= to_del.size();
+    }
+
+    // Only the first and last chunks in the range can be partially
+    // cleared, everything in between is dropped as a whole.
+    if (whole_start < whole_end) {
+        this->rs_chunks.erase(this->rs_chunks.begin() + whole_start,
+                              this->rs_chunks.begin() + whole_end);
+    }
+    this->rs_chunks.erase(
+        std::remove_if(this->rs_chunks.begin() + first,
+                       this->rs_chunks.end(),
+                       [](const chunk& ch) { return ch.c_count == 0; }),
+        this->rs_chunks.end());
+}
+
+bool
+roaring_set_base::exists(uint64_t value) const
+{
+    auto key = value >> 16;
+    auto index = this->chunk_index(key);
+
+    return index < this->rs_chunks.size()
+        && this->rs_chunks[index].c_key == key
+        && this->rs_chunks[index].contains(value & 0xffff);
+}
+
+roaring_set_base::const_iterator
+roaring_set_base::find(uint64_t value) const
+{
+    auto retval = this->lower_bound(value);
+
+    if (retval != this->end() && *retval != value) {
+        return this->end();
+    }
+    return retval;
+}
+
+roaring_set_base::const_iterator
+roaring_set_base::lower_bound(uint64_t value) const
+{
+    auto key = value >> 16;
+    auto index = this->chunk_index(key);
+
+    if (index < this->rs_chunks.size() && this->rs_chunks[index].c_key == key)
+    {
+        const auto& ch = this->rs_chunks[index];
+        auto pos = ch.lower_pos(value & 0xffff);
+
+        if (pos != ch.end_pos()) {
+            return const_iterator{this, index, pos};
+        }
+        index += 1;
+    }
+    if (index == this->rs_chunks.size()) {
+        return this->end();
+    }
+
+    return const_iterator{this, index, this->rs_chunks[index].lower_pos(0)};
+}
+
+roaring_set_base::const_iterator
+roaring_set_base::upper_bound(uint64_t value) const
+{
+    if (value == UINT64_MAX) {
+        return this->end();
+    }
+
+    return this->lower_bound(value + 1);
+}
+
+size_t
+roaring_set_base::rank(uint64_t value) const
+{
+    auto key = value >> 16;
+    auto index = this->chunk_index(key);
+    size_t retval = 0;
+
+    for (size_t lpc = 0; lpc < index; lpc++) {
+        retval += this->rs_chunks[lpc].c_count;
+    }
+    if (index < this->rs_chunks.size() && this->rs_chunks[index].c_key == key)
+    {
+        retval += this->rs_chunks[index].rank(value & 0xffff);
+    }
+
+    return retval;
+}
+
+roaring_set_base&
+roaring_set_base::operator|=(const roaring_set_base& rhs)
+{
+    std::vector<chunk> merged;
+    auto lhs_iter = this->rs_chunks.begin();
+    auto rhs_iter = rhs.rs_chunks.begin();
+
+    merged.reserve(this->rs_chunks.size() + rhs.rs_chunks.size());
+    this->rs_size = 0;
+    while (lhs_iter != this->rs_chunks.end() || rhs_iter != rhs.rs_chunks.end())
+    {
+        if (rhs_iter == rhs.rs_chunks.end()
+            || (lhs_iter != this->rs_chunks.end()
+                && lhs_iter->c_key < rhs_iter->c_key))
+        {
+            merged.emplace_back(std::move(*lhs_iter));
+            ++lhs_iter;
+        } else if (lhs_iter == this->rs_chunks.end()
+                   || rhs_iter->c_key < lhs_iter->c_key)
+        {
+            merged.emplace_back(*rhs_iter);
+            ++rhs_iter;
+        } else {
+            auto ch = std::move(*lhs_iter);
+
+            if (!ch.is_bitmap() && !rhs_iter->is_bitmap()
+                && ch.c_count + rhs_iter->c_count <= ARRAY_MAX)
+            {
+                std::vector<uint16_t> vals;
+
+                vals.reserve(ch.c_count + rhs_iter->c_count);
+                std::set_union(ch.c_array.begin(),
+                               ch.c_array.end(),
+                               rhs_iter->c_array.begin(),
+                               rhs_iter->c_array.end(),
+                               std::back_inserter(vals));
+                ch.c_array = std::move(vals);
+                ch.c_count = ch.c_array.size();
+            } else {
+                if (!ch.is_bitmap()) {
+                    ch.to_bitmap();
+                }
+                if (rhs_iter->is_bitmap()) {
+                    for (uint32_t lpc = 0; lpc < BITMAP_WORDS; lpc++) {
+                        ch.c_bits[lpc] |= rhs_iter->c_bits[lpc];
+                    }
+                } else {
+                    for (const auto low : rhs_iter->c_array) {
+                        ch.c_bits[low / 64] |= 1ULL << (low % 64);
+                    }
+                }
+                ch.c_count = 0;
+                for (const auto word : ch.c_bits) {
+                    ch.c_count += popcount(word);
+                }
+            }
+            merged.emplace_back(std::move(ch));
+            ++lhs_iter;
+            ++rhs_iter;
+        }
+        this->rs_size += merged.back().c_count;
+    }
+    this->rs_chunks = std::move(merged);
+
+    return *this;
+}
+
+roaring_set_base&
+roaring_set_base::operator&=(const roaring_set_base& rhs)
+{
+    std::vector<chunk> merged;
+    auto rhs_iter = rhs.rs_chunks.begin();
+
+    this->rs_size = 0;
+    for (auto& ch : this->rs_chunks) {
+        while (rhs_iter != rhs.rs_chunks.end() && rhs_iter->c_key < ch.c_key) {
+            ++rhs_iter;
+        }
+        if (rhs_iter == rhs.rs_chunks.end()) {
+            break;
+        }
+        if (rhs_iter->c_key != ch.c_key) {
+            continue;
+        }
+
+        if (ch.is_bitmap() && rhs_iter->is_bitmap()) {
+            ch.c_count = 0;
+            for (uint32_t lpc = 0; lpc < BITMAP_WORDS; lpc++) {
+                ch.c_bits[lpc] &= rhs_iter->c_bits[lpc];
+                ch.c_count += popcount(ch.c_bits[lpc]);
+            }
+            if (ch.c_count < ARRAY_MAX / 2) {
+                ch.to_array();
+            }
+        } else {
+            const auto& small = ch.is_bitmap() ? *rhs_iter : ch;
+            const auto& large = ch.is_bitmap() ? ch : *rhs_iter;
+            std::vector<uint16_t> vals;
+
+            for (const auto low : small.c_array) {
+                if (large.contains(low)) {
+                    vals.emplace_back(low);
+                }
+            }
+            ch.c_bits.clear();
+            ch.c_bits.shrink_to_fit();
+            ch.c_array = std::move(vals);
+            ch.c_count = ch.c_array.size();
+        }
+        if (ch.c_count > 0) {
+            this->rs_size += ch.c_count;
+            merged.emplace_back(std::move(ch));
+        }
+    }
+    this->rs_chunks = std::move(merged);
+
+    return *this;
+}
+
+size_t
+roaring_set_base::intersection_size(const roaring_set_base& rhs) const
+{
+    size_t retval = 0;
+    auto rhs_iter = rhs.rs_chunks.begin();
+
+    for (const auto& ch : this->rs_chunks) {
+        while (rhs_iter != rhs.rs_chunks.end() && rhs_iter->c_key < ch.c_key) {
+            ++rhs_iter;
+        }
+        if (rhs_iter == rhs.rs_chunks.end()) {
+            break;
+        }
+        if (rhs_iter->c_key != ch.c_key) {
+            continue;
+        }
+
+        if (ch.is_bitmap() && rhs_iter->is_bitmap()) {
+            for (uint32_t lpc = 0; lpc < BITMAP_WORDS; lpc++) {
+                retval += popcount(ch.c_bits[lpc] & rhs_iter->c_bits[lpc]);
+            }
+        } else {
+            const auto& small = ch.is_bitmap() ? *rhs_iter : ch;
+            const auto& large = ch.is_bitmap() ? ch : *rhs_iter;
+
+            for (const auto low : small.c_array) {
+                if (large.contains(low)) {
+                    retval += 1;
+                }
+            }
+        }
+    }
+
+    return retval;
+}
+
+bool
+roaring_set_base::operator==(const roaring_set_base& rhs) const
+{
+    if (this->rs_size != rhs.rs_size) {
+        return false;
+    }
+
+    return std::equal(this->begin(), this->end(), rhs.begin(), rhs.end());
+}
+
+size_t
+roaring_set_base::memory_usage() const
+{
+    size_t retval = this->rs_chunks.capacity() * sizeof(chunk);
+
+    for (const auto& ch : this->rs_chunks) {
+        retval += ch.c_array.capacity() * sizeof(uint16_t);
+        retval += ch.c_bits.capacity() * sizeof(uint64_t);
+    }
+
+    return retval;
+}
+
+}  // namespace lnav
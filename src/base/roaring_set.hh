@@ -0,0 +1,408 @@
+/**
+ * Copyright (c) 2025, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef lnav_roaring_set_hh
+#define lnav_roaring_set_hh
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace lnav {
+
+/**
+ * A compressed set of unsigned integers in the style of a Roaring bitmap.
+ * Values are grouped into chunks by their upper 48 bits.  A chunk keeps a
+ * sorted array of the lower 16 bits while it is sparse and switches to a
+ * plain bitmap once it holds more than ARRAY_MAX values, so a dense run of
+ * lines costs a bit each instead of a tree node.
+ *
+ * Iterators are invalidated by any change to the set.
+ */
+class roaring_set_base {
+public:
+    static constexpr uint32_t CHUNK_SIZE = 65536;
+    static constexpr uint32_t ARRAY_MAX = 4096;
+    static constexpr uint32_t BITMAP_WORDS = CHUNK_SIZE / 64;
+
+    struct chunk {
+        uint64_t c_key{0};
+        uint32_t c_count{0};
+        std::vector<uint16_t> c_array;
+        std::vector<uint64_t> c_bits;
+
+        bool is_bitmap() const { return !this->c_bits.empty(); }
+
+        bool contains(uint16_t low) const;
+
+        /**
+         * @return The position of the value and true if it was added.
+         */
+        std::pair<uint32_t, bool> insert(uint16_t low);
+
+        bool erase(uint16_t low);
+
+        /**
+         * Positions are indexes into the array or bit numbers in the bitmap.
+         * The end position is one past the last valid position.
+         */
+        uint32_t end_pos() const
+        {
+            return this->is_bitmap() ? CHUNK_SIZE : this->c_array.size();
+        }
+
+        /** @return The position of the first value that is >= low. */
+        uint32_t lower_pos(uint32_t low) const;
+
+        uint32_t next_pos(uint32_t pos) const;
+
+        /** @return The position before the given one, if there is one. */
+        std::optional<uint32_t> prev_pos(uint32_t pos) const;
+
+        uint16_t value_at(uint32_t pos) const
+        {
+            return this->is_bitmap() ? pos : this->c_array[pos];
+        }
+
+        /** @return The number of values that are < low. */
+        uint32_t rank(uint32_t low) const;
+
+        void to_bitmap();
+
+        void to_array();
+    };
+
+    class const_iterator {
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = uint64_t;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const uint64_t*;
+        using reference = uint64_t;
+
+        const_iterator() = default;
+
+        const_iterator(const roaring_set_base* set,
+                       size_t chunk_index,
+                       uint32_t pos)
+            : i_set(set), i_chunk(chunk_index), i_pos(pos)
+        {
+        }
+
+        uint64_t operator*() const
+        {
+            const auto& ch = this->i_set->rs_chunks[this->i_chunk];
+
+            return ch.c_key << 16 | ch.value_at(this->i_pos);
+        }
+
+        const_iterator& operator++();
+
+        const_iterator operator++(int)
+        {
+            auto retval = *this;
+
+            ++(*this);
+            return retval;
+        }
+
+        const_iterator& operator--();
+
+        const_iterator operator--(int)
+        {
+            auto retval = *this;
+
+            --(*this);
+            return retval;
+        }
+
+        bool operator==(const const_iterator& rhs) const
+        {
+            return this->i_chunk == rhs.i_chunk && this->i_pos == rhs.i_pos;
+        }
+
+        bool operator!=(const const_iterator& rhs) const
+        {
+            return !(*this == rhs);
+        }
+
+    private:
+        friend class roaring_set_base;
+
+        const roaring_set_base* i_set{nullptr};
+        size_t i_chunk{0};
+        uint32_t i_pos{0};
+    };
+
+    size_t size() const { return this->rs_size; }
+
+    bool empty() const { return this->rs_size == 0; }
+
+    void clear()
+    {
+        this->rs_chunks.clear();
+        this->rs_size = 0;
+    }
+
+    const_iterator begin() const;
+
+    const_iterator end() const
+    {
+        return const_iterator{this, this->rs_chunks.size(), 0};
+    }
+
+    std::pair<const_iterator, bool> insert(uint64_t value);
+
+    size_t erase(uint64_t value);
+
+    void erase(const_iterator iter) { this->erase(*iter); }
+
+    /** Remove all of the values in the range [low, high). */
+    void erase_range(uint64_t low, uint64_t high);
+
+    bool exists(uint64_t value) const;
+
+    const_iterator find(uint64_t value) const;
+
+    /** @return An iterator to the first value that is >= the given one. */
+    const_iterator lower_bound(uint64_t value) const;
+
+    /** @return An iterator to the first value that is > the given one. */
+    const_iterator upper_bound(uint64_t value) const;
+
+    /** @return The number of values in the set that are < the given one. */
+    size_t rank(uint64_t value) const;
+
+    /** @return The number of values in the range [low, high). */
+    size_t count_range(uint64_t low, uint64_t high) const
+    {
+        return low < high ? this->rank(high) - this->rank(low) : 0;
+    }
+
+    roaring_set_base& operator|=(const roaring_set_base& rhs);
+
+    roaring_set_base& operator&=(const roaring_set_base& rhs);
+
+    /** @return The size of the intersection without building it. */
+    size_t intersection_size(const roaring_set_base& rhs) const;
+
+    bool operator==(const roaring_set_base& rhs) const;
+
+    bool operator!=(const roaring_set_base& rhs) const
+    {
+        return !(*this == rhs);
+    }
+
+    /** @return The approximate number of bytes used by the values. */
+    size_t memory_usage() const;
+
+private:
+    size_t chunk_index(uint64_t key) const;
+
+    std::vector<chunk> rs_chunks;
+    size_t rs_size{0};
+};
+
+/**
+ * Typed front-end for roaring_set_base that works with strongly-typed
+ * line numbers.  Negative values are never in the set, which lets callers
+ * use -1 as a "before the first line" sentinel in searches.
+ */
+template<typename T>
+class roaring_set {
+public:
+    class const_iterator {
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T*;
+        using reference = T;
+
+        const_iterator() = default;
+
+        explicit const_iterator(roaring_set_base::const_iterator iter)
+            : i_iter(iter)
+        {
+        }
+
+        T operator*() const { return T(*this->i_iter); }
+
+        const_iterator& operator++()
+        {
+            ++this->i_iter;
+            return *this;
+        }
+
+        const_iterator operator++(int)
+        {
+            return const_iterator{this->i_iter++};
+        }
+
+        const_iterator& operator--()
+        {
+            --this->i_iter;
+            return *this;
+        }
+
+        const_iterator operator--(int)
+        {
+            return const_iterator{this->i_iter--};
+        }
+
+        bool operator==(const const_iterator& rhs) const
+        {
+            return this->i_iter == rhs.i_iter;
+        }
+
+        bool operator!=(const const_iterator& rhs) const
+        {
+            return this->i_iter != rhs.i_iter;
+        }
+
+    private:
+        friend class roaring_set;
+
+        roaring_set_base::const_iterator i_iter;
+    };
+    using iterator = const_iterator;
+
+    size_t size() const { return this->rs_base.size(); }
+
+    bool empty() const { return this->rs_base.empty(); }
+
+    void clear() { this->rs_base.clear(); }
+
+    const_iterator begin() const { return const_iterator{this->rs_base.begin()}; }
+
+    const_iterator end() const { return const_iterator{this->rs_base.end()}; }
+
+    std::pair<const_iterator, bool> insert(T value)
+    {
+        auto [iter, added] = this->rs_base.insert(to_raw(value));
+
+        return std::make_pair(const_iterator{iter}, added);
+    }
+
+    size_t erase(T value)
+    {
+        if (is_negative(value)) {
+            return 0;
+        }
+        return this->rs_base.erase(to_raw(value));
+    }
+
+    void erase(const_iterator iter) { this->rs_base.erase(iter.i_iter); }
+
+    void erase_range(T low, T high)
+    {
+        this->rs_base.erase_range(clamp(low), clamp(high));
+    }
+
+    bool exists(T value) const
+    {
+        return !is_negative(value) && this->rs_base.exists(to_raw(value));
+    }
+
+    const_iterator find(T value) const
+    {
+        if (is_negative(value)) {
+            return this->end();
+        }
+        return const_iterator{this->rs_base.find(to_raw(value))};
+    }
+
+    const_iterator lower_bound(T value) const
+    {
+        return const_iterator{this->rs_base.lower_bound(clamp(value))};
+    }
+
+    const_iterator upper_bound(T value) const
+    {
+        if (is_negative(value)) {
+            return this->begin();
+        }
+        return const_iterator{this->rs_base.upper_bound(to_raw(value))};
+    }
+
+    size_t rank(T value) const { return this->rs_base.rank(clamp(value)); }
+
+    size_t count_range(T low, T high) const
+    {
+        return this->rs_base.count_range(clamp(low), clamp(high));
+    }
+
+    roaring_set& operator|=(const roaring_set& rhs)
+    {
+        this->rs_base |= rhs.rs_base;
+        return *this;
+    }
+
+    roaring_set& operator&=(const roaring_set& rhs)
+    {
+        this->rs_base &= rhs.rs_base;
+        return *this;
+    }
+
+    size_t intersection_size(const roaring_set& rhs) const
+    {
+        return this->rs_base.intersection_size(rhs.rs_base);
+    }
+
+    bool operator==(const roaring_set& rhs) const
+    {
+        return this->rs_base == rhs.rs_base;
+    }
+
+    bool operator!=(const roaring_set& rhs) const
+    {
+        return this->rs_base != rhs.rs_base;
+    }
+
+    size_t memory_usage() const { return this->rs_base.memory_usage(); }
+
+private:
+    static bool is_negative(T value) { return static_cast<int64_t>(value) < 0; }
+
+    static uint64_t to_raw(T value) { return static_cast<int64_t>(value); }
+
+    static uint64_t clamp(T value)
+    {
+        return is_negative(value) ? 0 : to_raw(value);
+    }
+
+    roaring_set_base rs_base;
+};
+
+}  // namespace lnav
+
+#endif
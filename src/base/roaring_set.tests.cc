@@ -0,0 +1,179 @@
+/**
+ * Copyright (c) 2025, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <iterator>
+#include <set>
+
+#include <stdlib.h>
+
+#include "roaring_set.hh"
+
+#include "doctest/doctest.h"
+
+namespace {
+
+void
+check_same(const lnav::roaring_set_base& rs, const std::set<uint64_t>& expected)
+{
+    CHECK(rs.size() == expected.size());
+    CHECK(std::equal(rs.begin(), rs.end(), expected.begin(), expected.end()));
+}
+
+}  // namespace
+
+TEST_CASE("roaring_set-basic")
+{
+    lnav::roaring_set_base rs;
+
+    CHECK(rs.empty());
+    CHECK(rs.begin() == rs.end());
+
+    auto [iter, added] = rs.insert(10);
+    CHECK(added);
+    CHECK(*iter == 10);
+    CHECK_FALSE(rs.insert(10).second);
+    rs.insert(3);
+    rs.insert(70000);
+
+    check_same(rs, {3, 10, 70000});
+    CHECK(rs.exists(3));
+    CHECK_FALSE(rs.exists(4));
+    CHECK(*rs.lower_bound(4) == 10);
+    CHECK(*rs.upper_bound(10) == 70000);
+    CHECK(rs.upper_bound(70000) == rs.end());
+    CHECK(rs.find(11) == rs.end());
+    CHECK(rs.rank(10) == 1);
+    CHECK(rs.rank(100000) == 3);
+    CHECK(rs.count_range(4, 70001) == 2);
+
+    auto last = rs.end();
+    --last;
+    CHECK(*last == 70000);
+    --last;
+    CHECK(*last == 10);
+    --last;
+    CHECK(last == rs.begin());
+
+    CHECK(rs.erase(10) == 1);
+    CHECK(rs.erase(10) == 0);
+    check_same(rs, {3, 70000});
+    rs.erase(rs.find(70000));
+    check_same(rs, {3});
+}
+
+TEST_CASE("roaring_set-dense")
+{
+    lnav::roaring_set_base rs;
+    std::set<uint64_t> expected;
+
+    for (uint64_t lpc = 0; lpc < 200000; lpc += 3) {
+        rs.insert(lpc);
+        expected.insert(lpc);
+    }
+    check_same(rs, expected);
+    // The first chunks are bitmaps now and should be much smaller than the
+    // equivalent array of 64-bit values.
+    CHECK(rs.memory_usage() < expected.size() * 2);
+
+    auto iter = rs.lower_bound(65535);
+    CHECK(*iter == 65535);
+    --iter;
+    CHECK(*iter == 65532);
+    CHECK(rs.rank(65536) == 21846);
+
+    for (uint64_t lpc = 0; lpc < 200000; lpc += 6) {
+        rs.erase(lpc);
+        expected.erase(lpc);
+    }
+    check_same(rs, expected);
+
+    rs.erase_range(1000, 140000);
+    expected.erase(expected.lower_bound(1000), expected.lower_bound(140000));
+    check_same(rs, expected);
+}
+
+TEST_CASE("roaring_set-bulk")
+{
+    lnav::roaring_set_base lhs, rhs;
+    std::set<uint64_t> lhs_expected, rhs_expected;
+
+    srandom(1);
+    for (int lpc = 0; lpc < 20000; lpc++) {
+        auto lval = random() % 300000;
+        auto rval = random() % 300000;
+
+        lhs.insert(lval);
+        lhs_expected.insert(lval);
+        rhs.insert(rval);
+        rhs_expected.insert(rval);
+    }
+    for (uint64_t lpc = 100000; lpc < 120000; lpc++) {
+        lhs.insert(lpc);
+        lhs_expected.insert(lpc);
+    }
+
+    std::set<uint64_t> union_expected, inter_expected;
+    std::set_union(lhs_expected.begin(),
+                   lhs_expected.end(),
+                   rhs_expected.begin(),
+                   rhs_expected.end(),
+                   std::inserter(union_expected, union_expected.end()));
+    std::set_intersection(lhs_expected.begin(),
+                          lhs_expected.end(),
+                          rhs_expected.begin(),
+                          rhs_expected.end(),
+                          std::inserter(inter_expected, inter_expected.end()));
+
+    CHECK(lhs.intersection_size(rhs) == inter_expected.size());
+
+    auto union_rs = lhs;
+    union_rs |= rhs;
+    check_same(union_rs, union_expected);
+
+    auto inter_rs = lhs;
+    inter_rs &= rhs;
+    check_same(inter_rs, inter_expected);
+    CHECK(inter_rs != union_rs);
+}
+
+TEST_CASE("roaring_set-typed")
+{
+    lnav::roaring_set<int> rs;
+
+    rs.insert(5);
+    rs.insert(7);
+
+    CHECK(*rs.upper_bound(-1) == 5);
+    CHECK(*rs.lower_bound(-1) == 5);
+    CHECK_FALSE(rs.exists(-1));
+    CHECK(rs.find(-1) == rs.end());
+    CHECK(rs.rank(-1) == 0);
+    CHECK(rs.rank(7) == 1);
+}
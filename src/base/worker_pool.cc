@@ -0,0 +1,104 @@
+/**
+ * Copyright (c) 2025, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+
+#include "worker_pool.hh"
+
+#include "config.h"
+#include "lnav_log.hh"
+
+namespace lnav {
+
+worker_pool&
+worker_pool::singleton()
+{
+    static worker_pool retval;
+
+    return retval;
+}
+
+worker_pool::worker_pool()
+{
+    auto count = std::max(1U, std::thread::hardware_concurrency());
+
+    log_info("starting %u worker threads", count);
+    for (unsigned lpc = 0; lpc < count; lpc++) {
+        this->wp_threads.emplace_back(&worker_pool::run, this);
+    }
+}
+
+worker_pool::~worker_pool()
+{
+    {
+        std::lock_guard<std::mutex> lg(this->wp_mutex);
+
+        this->wp_stopping = true;
+    }
+    this->wp_cond.notify_all();
+    for (auto& th : this->wp_threads) {
+        th.join();
+    }
+}
+
+void
+worker_pool::submit(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lg(this->wp_mutex);
+
+        this->wp_tasks.emplace_back(std::move(task));
+    }
+    this->wp_cond.notify_one();
+}
+
+void
+worker_pool::run()
+{
+    while (true) {
+        std::function<void()> task;
+
+        {
+            std::unique_lock<std::mutex> lk(this->wp_mutex);
+
+            this->wp_cond.wait(lk, [this]() {
+                return this->wp_stopping || !this->wp_tasks.empty();
+            });
+            if (this->wp_tasks.empty()) {
+                return;
+            }
+            task = std::move(this->wp_tasks.front());
+            this->wp_tasks.pop_front();
+        }
+
+        task();
+    }
+}
+
+}  // namespace lnav
@@ -0,0 +1,79 @@
+/**
+ * Copyright (c) 2025, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef lnav_worker_pool_hh
+#define lnav_worker_pool_hh
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace lnav {
+
+/**
+ * A pool of threads for CPU-bound work that is split up by the UI thread,
+ * like matching lines for a search or checking them against the filters.
+ * The threads are started on first use and live until the process exits,
+ * so handing off a small batch of work does not pay for thread startup.
+ *
+ * Tasks are run in the order they are submitted.  They must not block on
+ * the UI thread, since it may be waiting for them to finish.
+ */
+class worker_pool {
+public:
+    static worker_pool& singleton();
+
+    ~worker_pool();
+
+    worker_pool(const worker_pool&) = delete;
+    worker_pool& operator=(const worker_pool&) = delete;
+
+    /** @return The number of threads in the pool. */
+    size_t size() const { return this->wp_threads.size(); }
+
+    void submit(std::function<void()> task);
+
+private:
+    worker_pool();
+
+    void run();
+
+    std::mutex wp_mutex;
+    std::condition_variable wp_cond;
+    std::deque<std::function<void()>> wp_tasks;
+    bool wp_stopping{false};
+    std::vector<std::thread> wp_threads;
+};
+
+}  // namespace lnav
+
+#endif
@@ -32,6 +32,9 @@
 #ifndef lnav_big_array_hh
 #define lnav_big_array_hh
 
+#include <algorithm>
+
+#include <string.h>
 #include <sys/mman.h>
 #include <unistd.h>
 
@@ -42,21 +45,24 @@ template<typename T>
 struct big_array {
     static const size_t DEFAULT_INCREMENT = 100 * 1000;
 
+    /**
+     * Make sure there is room for the given number of elements.  The
+     * existing elements are preserved if the array needs to be moved.
+     *
+     * @param size The number of elements to make room for.
+     * @return True if the array was moved to a new allocation.
+     */
     bool reserve(size_t size)
     {
         if (size < this->ba_capacity) {
             return false;
         }
 
-        if (this->ba_ptr) {
-            munmap(this->ba_ptr,
-                   roundup_size(this->ba_capacity * sizeof(T), getpagesize()));
-        }
-
-        this->ba_capacity = size + DEFAULT_INCREMENT;
+        auto new_capacity = std::max(size + DEFAULT_INCREMENT,
+                                     this->ba_capacity + this->ba_capacity / 2);
         void* result
             = mmap(nullptr,
-                   roundup_size(this->ba_capacity * sizeof(T), getpagesize()),
+                   roundup_size(new_capacity * sizeof(T), getpagesize()),
                    PROT_READ | PROT_WRITE,
                    MAP_ANONYMOUS | MAP_PRIVATE,
                    -1,
@@ -64,6 +70,13 @@ struct big_array {
 
         ensure(result != MAP_FAILED);
 
+        if (this->ba_ptr) {
+            memcpy(result, this->ba_ptr, this->ba_size * sizeof(T));
+            munmap(this->ba_ptr,
+                   roundup_size(this->ba_capacity * sizeof(T), getpagesize()));
+        }
+
+        this->ba_capacity = new_capacity;
         this->ba_ptr = (T*) result;
 
         return true;
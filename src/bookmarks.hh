@@ -40,7 +40,7 @@
 
 #include "base/intern_string.hh"
 #include "base/lnav_log.hh"
-#include "tlx/container/btree_set.hpp"
+#include "base/roaring_set.hh"
 
 struct logmsg_annotations {
     std::map<std::string, std::string> la_pairs;
@@ -97,25 +97,23 @@ struct bookmark_metadata {
 };
 
 /**
- * Extension of the STL vector that is used to store bookmarks for
- * files being viewed, where a bookmark is just a particular line in
- * the file(s).  The value-added over the standard vector are some
- * methods for doing content-wise iteration.  In other words, given a
- * value that may or may not be in the vector, find the next or
- * previous value that is in the vector.
+ * Set of bookmarks for files being viewed, where a bookmark is just a
+ * particular line in the file(s).  The value-added over a plain set are
+ * some methods for doing content-wise iteration.  In other words, given a
+ * value that may or may not be in the set, find the next or previous value
+ * that is in the set.  The lines are kept in a compressed bitmap since
+ * searches can match millions of lines.
  *
  * @param LineType The type used to store line numbers.  (e.g.
  *   vis_line_t or content_line_t)
- *
- * @note The vector is expected to be sorted.
  */
 template<typename LineType>
 class bookmark_vector {
 public:
-    using iterator = typename tlx::btree_set<LineType>::iterator;
-    using const_iterator = typename tlx::btree_set<LineType>::const_iterator;
+    using iterator = typename lnav::roaring_set<LineType>::iterator;
+    using const_iterator = typename lnav::roaring_set<LineType>::const_iterator;
 
-    tlx::btree_set<LineType> bv_tree;
+    lnav::roaring_set<LineType> bv_tree;
 
     std::size_t size() const
     {
@@ -156,6 +154,32 @@ public:
         return std::make_pair(lb, up);
     }
 
+    /**
+     * Remove the bookmarks in the range [start, stop).
+     */
+    void erase_range(LineType start, LineType stop)
+    {
+        this->bv_tree.erase_range(start, stop);
+    }
+
+    /**
+     * @return The number of bookmarks that come before the given line,
+     *   which is the index of the line if it is a bookmark.
+     */
+    std::size_t rank(LineType vl) const { return this->bv_tree.rank(vl); }
+
+    bookmark_vector& operator|=(const bookmark_vector& rhs)
+    {
+        this->bv_tree |= rhs.bv_tree;
+        return *this;
+    }
+
+    bookmark_vector& operator&=(const bookmark_vector& rhs)
+    {
+        this->bv_tree &= rhs.bv_tree;
+        return *this;
+    }
+
     /**
      * @param start The value to start the search for the next bookmark.
      * @return The next bookmark value in the vector or -1 if there are
@@ -139,10 +139,9 @@ bottom_status_source::update_marks(listview_curses* lc)
         if (!bv.empty() || !tc->get_current_search().empty()) {
             auto vl = tc->get_selection();
             if (vl) {
-                auto lb = bv.bv_tree.find(vl.value());
-                if (lb != bv.bv_tree.end()) {
+                if (bv.bv_tree.exists(vl.value())) {
                     retval = sf.set_value("  Hit %'d of %'d for ",
-                                          (lb - bv.bv_tree.begin()) + 1,
+                                          bv.rank(vl.value()) + 1,
                                           tc->get_match_count());
                 } else {
                     retval = sf.set_value("  %'d hits for ",
@@ -201,6 +200,7 @@ bottom_status_source::update_loading(file_off_t off,
     require_ge(total, off);
 
     if (total == 0) {
+        this->bss_loading_detail.clear();
         sf.set_cylon(false);
         sf.set_role(role_t::VCR_STATUS);
         if (this->bss_paused) {
@@ -83,6 +83,20 @@ public:
                         file_ssize_t total,
                         const char* term = "Loading");
 
+    /**
+     * Set a longer description of the operation in progress than fits in
+     * the loading field.  It is cleared when loading finishes.
+     */
+    void set_loading_detail(std::string detail)
+    {
+        this->bss_loading_detail = std::move(detail);
+    }
+
+    const std::string& get_loading_detail() const
+    {
+        return this->bss_loading_detail;
+    }
+
 private:
     status_field bss_prompt{1024, role_t::VCR_STATUS};
     status_field bss_error{1024, role_t::VCR_ALERT_STATUS};
@@ -90,6 +104,7 @@ private:
     status_field bss_fields[BSF__MAX];
     int bss_hit_spinner{0};
     int bss_load_percent{0};
+    std::string bss_loading_detail;
     bool bss_paused{false};
 };
 
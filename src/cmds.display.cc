@@ -141,6 +141,9 @@ com_toggle_field(exec_context& ec,
                     missing_fields.push_back(args[lpc]);
                 }
             }
+            if (!found_fields.empty()) {
+                lnav_data.ld_log_source.invalidate_rendered_lines();
+            }
         }
         if (missing_fields.empty()) {
             auto visibility = hide ? "hiding" : "showing";
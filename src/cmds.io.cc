@@ -27,17 +27,20 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
-#include <regex>
-
 #include <fnmatch.h>
 #include <glob.h>
 
+#include <future>
+#include <memory>
+
+#include "arrow_ipc.hh"
 #include "base/attr_line.builder.hh"
 #include "base/fs_util.hh"
 #include "base/humanize.hh"
 #include "base/humanize.network.hh"
 #include "base/itertools.hh"
 #include "base/paths.hh"
+#include "base/worker_pool.hh"
 #include "bound_tags.hh"
 #include "curl_looper.hh"
 #include "external_opener.hh"
@@ -67,34 +70,35 @@ const char* curl_url_strerror(CURLUcode error);
 #endif
 
 static bool
-csv_needs_quoting(const std::string& str)
+csv_needs_quoting(string_fragment sf)
 {
-    return (str.find_first_of(",\"\r\n") != std::string::npos);
-}
-
-static std::string
-csv_quote_string(const std::string& str)
-{
-    static const std::regex csv_column_quoter("\"");
-
-    std::string retval = std::regex_replace(str, csv_column_quoter, "\"\"");
-
-    retval.insert(0, 1, '\"');
-    retval.append(1, '\"');
-
-    return retval;
+    return std::any_of(sf.begin(), sf.end(), [](char ch) {
+        return ch == ',' || ch == '"' || ch == '\r' || ch == '\n';
+    });
 }
 
 static void
-csv_write_string(FILE* outfile, const std::string& str)
+csv_write_string(FILE* outfile, string_fragment sf)
 {
-    if (csv_needs_quoting(str)) {
-        std::string quoted_str = csv_quote_string(str);
+    if (!csv_needs_quoting(sf)) {
+        fwrite(sf.data(), 1, sf.length(), outfile);
+        return;
+    }
 
-        fmt::fprintf(outfile, "%s", quoted_str);
-    } else {
-        fmt::fprintf(outfile, "%s", str);
+    fputc('"', outfile);
+    while (!sf.empty()) {
+        const auto* quote = (const char*) memchr(sf.data(), '"', sf.length());
+        if (quote == nullptr) {
+            fwrite(sf.data(), 1, sf.length(), outfile);
+            break;
+        }
+
+        auto run_len = quote - sf.data() + 1;
+        fwrite(sf.data(), 1, run_len, outfile);
+        fputc('"', outfile);
+        sf = sf.substr(run_len);
     }
+    fputc('"', outfile);
 }
 
 static void
@@ -119,6 +123,42 @@ write_progress(size_t row, size_t total)
     return lnav_data.ld_status_refresher(lnav::func::op_type::blocking);
 }
 
+/**
+ * Write a cell that contains JSON as a nested value.  If the text cannot be
+ * parsed, it is written as a plain string instead.
+ */
+static void
+json_write_text(yajl_gen handle, string_fragment json_in)
+{
+    unsigned char* err;
+    json_ptr jp("");
+    json_op jo(jp);
+
+    jo.jo_ptr_callbacks = json_op::gen_callbacks;
+    jo.jo_ptr_data = handle;
+    auto parse_handle = yajlpp::alloc_handle(&json_op::ptr_callbacks, &jo);
+
+    auto status
+        = yajl_parse(parse_handle.in(), json_in.udata(), json_in.length());
+    if (status == yajl_status_ok) {
+        status = yajl_complete_parse(parse_handle.in());
+    }
+    switch (status) {
+        case yajl_status_error:
+        case yajl_status_client_canceled: {
+            err = yajl_get_error(
+                parse_handle.in(), 0, json_in.udata(), json_in.length());
+            log_error("unable to parse JSON cell: %s", err);
+            yajlpp_generator gen(handle);
+            gen(json_in);
+            yajl_free_error(parse_handle.in(), err);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
 static void
 json_write_row(yajl_gen handle,
                int row,
@@ -148,49 +188,7 @@ json_write_row(yajl_gen handle,
                 break;
             case lnav::cell_type::CT_TEXT: {
                 if (hm.hm_sub_type == JSON_SUBTYPE) {
-                    unsigned char* err;
-                    json_ptr jp("");
-                    json_op jo(jp);
-
-                    jo.jo_ptr_callbacks = json_op::gen_callbacks;
-                    jo.jo_ptr_data = handle;
-                    auto parse_handle
-                        = yajlpp::alloc_handle(&json_op::ptr_callbacks, &jo);
-
-                    const auto json_in = cursor->get_text();
-                    switch (yajl_parse(
-                        parse_handle.in(), json_in.udata(), json_in.length()))
-                    {
-                        case yajl_status_error:
-                        case yajl_status_client_canceled: {
-                            err = yajl_get_error(parse_handle.in(),
-                                                 0,
-                                                 json_in.udata(),
-                                                 json_in.length());
-                            log_error("unable to parse JSON cell: %s", err);
-                            obj_map.gen(cursor->get_text());
-                            yajl_free_error(parse_handle.in(), err);
-                            return;
-                        }
-                        default:
-                            break;
-                    }
-
-                    switch (yajl_complete_parse(parse_handle.in())) {
-                        case yajl_status_error:
-                        case yajl_status_client_canceled: {
-                            err = yajl_get_error(parse_handle.in(),
-                                                 0,
-                                                 json_in.udata(),
-                                                 json_in.length());
-                            log_error("unable to parse JSON cell: %s", err);
-                            obj_map.gen(cursor->get_text());
-                            yajl_free_error(parse_handle.in(), err);
-                            return;
-                        }
-                        default:
-                            break;
-                    }
+                    json_write_text(handle, cursor->get_text());
                 } else if (anonymize) {
                     obj_map.gen(ta.next(cursor->get_text()));
                 } else {
@@ -337,12 +335,12 @@ com_save_to(exec_context& ec,
 
         for (auto& dls_header : dls.dls_headers) {
             if (!first) {
-                fprintf(outfile, ",");
+                fputc(',', outfile);
             }
             csv_write_string(outfile, dls_header.hm_name);
             first = false;
         }
-        fprintf(outfile, "\n");
+        fputc('\n', outfile);
 
         ArenaAlloc::Alloc<char> cell_alloc{1024};
         for (auto row = size_t{0}; row < dls.dls_row_cursors.size(); row++) {
@@ -357,17 +355,19 @@ com_save_to(exec_context& ec,
                  lpc++, cursor = cursor->next())
             {
                 if (!first) {
-                    fprintf(outfile, ",");
+                    fputc(',', outfile);
                 }
 
                 auto cell_sf = cursor->to_string_fragment(cell_alloc);
-                auto cell_str = anonymize ? ta.next(cell_sf)
-                                          : cell_sf.to_string();
-                csv_write_string(outfile, cell_str);
+                if (anonymize) {
+                    csv_write_string(outfile, ta.next(cell_sf));
+                } else {
+                    csv_write_string(outfile, cell_sf);
+                }
                 first = false;
                 cell_alloc.reset();
             }
-            fprintf(outfile, "\n");
+            fputc('\n', outfile);
 
             if (row > 0 && row % 1000 == 0) {
                 if (write_progress(row, dls.dls_row_cursors.size())
@@ -821,6 +821,361 @@ com_save_to(exec_context& ec,
     return Ok(retval);
 }
 
+/**
+ * The state of an ":export-*-to" command.  The rows produced by the query
+ * are written by export_sql_callback() as they are stepped instead of being
+ * collected in the DB view first.
+ */
+struct query_export {
+    enum class format_t {
+        csv,
+        jsonlines,
+        arrow,
+    };
+
+    FILE* qe_file{nullptr};
+    format_t qe_format{format_t::csv};
+    bool qe_anonymize{false};
+    bool qe_wrote_header{false};
+    size_t qe_rows{0};
+    lnav::text_anonymizer qe_anonymizer;
+    yajlpp_gen qe_gen;
+
+    std::unique_ptr<lnav::arrow_ipc::stream_writer> qe_arrow_writer;
+    /** The rows that have been stepped since the last batch was flushed. */
+    std::shared_ptr<lnav::arrow_ipc::batch> qe_batch;
+    /** The result of writing the previous batch on the worker pool. */
+    std::future<Result<size_t, std::string>> qe_pending;
+    /** The number of values that did not match their column type. */
+    size_t qe_nulled{0};
+    std::optional<std::string> qe_error;
+};
+
+static constexpr size_t ARROW_BATCH_ROWS = 64 * 1024;
+static constexpr size_t ARROW_BATCH_TEXT_SIZE = 64 * 1024 * 1024;
+
+static query_export* active_export = nullptr;
+
+static void
+wait_for_arrow_batch(query_export& qe)
+{
+    if (!qe.qe_pending.valid()) {
+        return;
+    }
+
+    auto res = qe.qe_pending.get();
+    if (res.isErr()) {
+        if (!qe.qe_error) {
+            qe.qe_error = res.unwrapErr();
+        }
+    } else {
+        qe.qe_nulled += res.unwrap();
+    }
+}
+
+/**
+ * Hand the current batch to the worker pool so that it is encoded and
+ * written while the next one is being stepped.  Only one batch is in
+ * flight at a time so that they are written in order.
+ */
+static void
+flush_arrow_batch(query_export& qe)
+{
+    wait_for_arrow_batch(qe);
+    if (qe.qe_error || !qe.qe_batch || qe.qe_batch->rows() == 0) {
+        return;
+    }
+
+    auto ncols = qe.qe_batch->b_columns.size();
+    auto b = std::exchange(qe.qe_batch,
+                           std::make_shared<lnav::arrow_ipc::batch>(ncols));
+    auto promise
+        = std::make_shared<std::promise<Result<size_t, std::string>>>();
+    qe.qe_pending = promise->get_future();
+    lnav::worker_pool::singleton().submit(
+        [promise, writer = qe.qe_arrow_writer.get(), b]() {
+            promise->set_value(writer->write_batch(*b));
+        });
+}
+
+static int
+export_sql_callback(exec_context& ec, sqlite3_stmt* stmt)
+{
+    auto& qe = *active_export;
+    const auto ncols = sqlite3_column_count(stmt);
+
+    if (!qe.qe_wrote_header) {
+        qe.qe_wrote_header = true;
+        if (qe.qe_format == query_export::format_t::arrow) {
+            std::vector<std::string> names;
+
+            for (int lpc = 0; lpc < ncols; lpc++) {
+                names.emplace_back(sqlite3_column_name(stmt, lpc));
+            }
+            qe.qe_arrow_writer = std::make_unique<lnav::arrow_ipc::stream_writer>(
+                qe.qe_file, std::move(names));
+            qe.qe_batch = std::make_shared<lnav::arrow_ipc::batch>(ncols);
+        } else if (qe.qe_format == query_export::format_t::csv) {
+            for (int lpc = 0; lpc < ncols; lpc++) {
+                if (lpc > 0) {
+                    fputc(',', qe.qe_file);
+                }
+                csv_write_string(qe.qe_file,
+                                 string_fragment::from_c_str(
+                                     sqlite3_column_name(stmt, lpc)));
+            }
+            fputc('\n', qe.qe_file);
+        }
+    }
+
+    if (!sqlite3_stmt_busy(stmt)) {
+        return 0;
+    }
+
+    if (qe.qe_format == query_export::format_t::arrow) {
+        if (qe.qe_error) {
+            return 0;
+        }
+
+        auto& b = *qe.qe_batch;
+        for (int lpc = 0; lpc < ncols; lpc++) {
+            auto& cv = b.b_columns[lpc];
+
+            switch (sqlite3_column_type(stmt, lpc)) {
+                case SQLITE_NULL:
+                    cv.append_null();
+                    break;
+                case SQLITE_INTEGER:
+                    cv.append_integer(sqlite3_column_int64(stmt, lpc));
+                    break;
+                case SQLITE_FLOAT:
+                    cv.append_real(sqlite3_column_double(stmt, lpc));
+                    break;
+                default: {
+                    auto sf = string_fragment::from_bytes(
+                        sqlite3_column_text(stmt, lpc),
+                        sqlite3_column_bytes(stmt, lpc));
+
+                    if (qe.qe_anonymize) {
+                        cv.append_text(qe.qe_anonymizer.next(sf));
+                    } else {
+                        cv.append_text(sf);
+                    }
+                    break;
+                }
+            }
+        }
+        if (b.rows() >= ARROW_BATCH_ROWS
+            || b.text_size() >= ARROW_BATCH_TEXT_SIZE)
+        {
+            flush_arrow_batch(qe);
+        }
+    } else if (qe.qe_format == query_export::format_t::jsonlines) {
+        {
+            yajlpp_map obj_map(qe.qe_gen);
+
+            for (int lpc = 0; lpc < ncols; lpc++) {
+                obj_map.gen(sqlite3_column_name(stmt, lpc));
+                switch (sqlite3_column_type(stmt, lpc)) {
+                    case SQLITE_NULL:
+                        obj_map.gen();
+                        break;
+                    case SQLITE_INTEGER:
+                        obj_map.gen((int64_t) sqlite3_column_int64(stmt, lpc));
+                        break;
+                    case SQLITE_FLOAT:
+                        obj_map.gen(sqlite3_column_double(stmt, lpc));
+                        break;
+                    default: {
+                        auto sf = string_fragment::from_bytes(
+                            sqlite3_column_text(stmt, lpc),
+                            sqlite3_column_bytes(stmt, lpc));
+                        auto* raw_value = sqlite3_column_value(stmt, lpc);
+
+                        if (sqlite3_value_subtype(raw_value) == JSON_SUBTYPE) {
+                            json_write_text(qe.qe_gen, sf);
+                        } else if (qe.qe_anonymize) {
+                            obj_map.gen(qe.qe_anonymizer.next(sf));
+                        } else {
+                            obj_map.gen(sf);
+                        }
+                        break;
+                    }
+                }
+            }
+        }
+        yajl_gen_reset(qe.qe_gen, "\n");
+    } else {
+        for (int lpc = 0; lpc < ncols; lpc++) {
+            fmt::memory_buffer buf;
+            string_fragment sf;
+
+            if (lpc > 0) {
+                fputc(',', qe.qe_file);
+            }
+            switch (sqlite3_column_type(stmt, lpc)) {
+                case SQLITE_NULL:
+                    sf = string_fragment::from_const("<NULL>");
+                    break;
+                case SQLITE_INTEGER:
+                    fmt::format_to(std::back_inserter(buf),
+                                   FMT_STRING("{}"),
+                                   (int64_t) sqlite3_column_int64(stmt, lpc));
+                    sf = string_fragment::from_bytes(buf.data(), buf.size());
+                    break;
+                case SQLITE_FLOAT:
+                    fmt::format_to(std::back_inserter(buf),
+                                   FMT_STRING("{}"),
+                                   sqlite3_column_double(stmt, lpc));
+                    sf = string_fragment::from_bytes(buf.data(), buf.size());
+                    break;
+                default:
+                    sf = string_fragment::from_bytes(
+                        sqlite3_column_text(stmt, lpc),
+                        sqlite3_column_bytes(stmt, lpc));
+                    break;
+            }
+            if (qe.qe_anonymize) {
+                csv_write_string(qe.qe_file, qe.qe_anonymizer.next(sf));
+            } else {
+                csv_write_string(qe.qe_file, sf);
+            }
+        }
+        fputc('\n', qe.qe_file);
+    }
+
+    qe.qe_rows += 1;
+
+    return 0;
+}
+
+static Result<std::string, lnav::console::user_message>
+com_export_to(exec_context& ec,
+              std::string cmdline,
+              std::vector<std::string>& args)
+{
+    size_t path_index = 1;
+    auto anonymize = false;
+
+    if (args.size() > path_index && args[path_index] == "--anonymize") {
+        anonymize = true;
+        path_index += 1;
+    }
+    if (args.size() <= path_index) {
+        return ec.make_error(
+            "expecting file name or '-' to write to the terminal");
+    }
+    if (args.size() <= path_index + 1) {
+        return ec.make_error("expecting a query to execute");
+    }
+
+    std::string fn;
+    shlex lexer(args[path_index]);
+    if (!lexer.eval(fn, ec.create_resolver())) {
+        return ec.make_error("unable to parse file name -- {}",
+                             args[path_index]);
+    }
+    auto query = trim(remaining_args(cmdline, args, path_index + 1));
+
+    if (ec.ec_dry_run) {
+        return Ok(fmt::format(
+            FMT_STRING("info: query results will be written to -- {}"), fn));
+    }
+
+    auto_mem<FILE> outfile(fclose);
+    auto to_term = false;
+
+    if (fn == "-" || fn == "/dev/stdout") {
+        auto ec_out = ec.get_output();
+
+        if (!ec_out) {
+            outfile = auto_mem<FILE>::leak(stdout);
+
+            if (ec.ec_ui_callbacks.uc_pre_stdout_write) {
+                ec.ec_ui_callbacks.uc_pre_stdout_write();
+            }
+            setvbuf(stdout, nullptr, _IONBF, 0);
+            to_term = true;
+            fprintf(outfile,
+                    "\n---------------- Press any key to exit lo-fi display "
+                    "----------------\n\n");
+        } else {
+            outfile = auto_mem<FILE>::leak(ec_out.value());
+        }
+        if (outfile.in() == stdout) {
+            lnav_data.ld_stdout_used = true;
+        }
+    } else if (lnav_data.ld_flags & LNF_SECURE_MODE) {
+        return ec.make_error("{} -- unavailable in secure mode", args[0]);
+    } else if ((outfile = fopen(fn.c_str(), "we")) == nullptr) {
+        return ec.make_error("unable to open file -- {}", fn);
+    }
+
+    query_export qe;
+
+    qe.qe_file = outfile.in();
+    if (args[0] == "export-jsonlines-to") {
+        qe.qe_format = query_export::format_t::jsonlines;
+    } else if (args[0] == "export-arrow-to") {
+        qe.qe_format = query_export::format_t::arrow;
+    }
+    qe.qe_anonymize = anonymize;
+    if (qe.qe_format == query_export::format_t::jsonlines) {
+        yajl_gen_config(qe.qe_gen, yajl_gen_beautify, 0);
+        yajl_gen_config(
+            qe.qe_gen, yajl_gen_print_callback, yajl_writer, qe.qe_file);
+    }
+
+    std::string alt_msg;
+    auto exec_res = [&]() {
+        auto cb_guard = ec.push_callback(export_sql_callback);
+        auto prev_export = std::exchange(active_export, &qe);
+        auto fin = finally([prev_export]() { active_export = prev_export; });
+
+        return execute_sql(ec, query, alt_msg);
+    }();
+
+    if (qe.qe_arrow_writer) {
+        // The pending batch refers to the file, so it has to be finished
+        // even if the query failed.
+        if (exec_res.isOk()) {
+            flush_arrow_batch(qe);
+        }
+        wait_for_arrow_batch(qe);
+        if (exec_res.isOk() && !qe.qe_error) {
+            auto fin_res = qe.qe_arrow_writer->finish();
+            if (fin_res.isErr()) {
+                qe.qe_error = fin_res.unwrapErr();
+            }
+        }
+    }
+    fflush(outfile.in());
+    if (to_term) {
+        if (ec.ec_ui_callbacks.uc_post_stdout_write) {
+            ec.ec_ui_callbacks.uc_post_stdout_write();
+        }
+    }
+    if (exec_res.isErr()) {
+        return exec_res;
+    }
+    if (qe.qe_error) {
+        return ec.make_error("{}", qe.qe_error.value());
+    }
+    if (qe.qe_nulled > 0) {
+        return Ok(fmt::format(
+            FMT_STRING("info: wrote {} row(s) to -- {}; {} value(s) did not "
+                       "match the type of their column and were written as "
+                       "nulls"),
+            qe.qe_rows,
+            fn,
+            qe.qe_nulled));
+    }
+
+    return Ok(fmt::format(FMT_STRING("info: wrote {} row(s) to -- {}"),
+                          qe.qe_rows,
+                          fn));
+}
+
 static Result<std::string, lnav::console::user_message>
 com_open(exec_context& ec, std::string cmdline, std::vector<std::string>& args)
 {
@@ -1875,6 +2230,72 @@ static readline_context::command_t IO_COMMANDS[] = {
             .with_example({"To write SQL results as text to /tmp/table.txt",
                            "/tmp/table.txt"}),
     },
+    {
+        "export-csv-to",
+        com_export_to,
+
+        help_text(":export-csv-to")
+            .with_summary("Execute a query and write the results to the given "
+                          "file in CSV format as they are produced")
+            .with_parameter(
+                help_text("--anonymize", "Anonymize the row contents").flag())
+            .with_parameter(
+                help_text("path", "The path to the file to write")
+                    .with_format(help_parameter_format_t::HPF_LOCAL_FILENAME))
+            .with_parameter(
+                help_text("query", "The SQL query to execute")
+                    .with_format(help_parameter_format_t::HPF_SQL))
+            .with_tags({"io", "scripting", "sql"})
+            .with_example({"To write the number of requests for each path in "
+                           "the access_log as CSV to /tmp/paths.csv",
+                           "/tmp/paths.csv SELECT cs_uri_stem, count(*) FROM "
+                           "access_log GROUP BY cs_uri_stem"}),
+    },
+    {
+        "export-jsonlines-to",
+        com_export_to,
+
+        help_text(":export-jsonlines-to")
+            .with_summary("Execute a query and write the results to the given "
+                          "file in JSON Lines format as they are produced")
+            .with_parameter(
+                help_text("--anonymize", "Anonymize the JSON values").flag())
+            .with_parameter(
+                help_text("path", "The path to the file to write")
+                    .with_format(help_parameter_format_t::HPF_LOCAL_FILENAME))
+            .with_parameter(
+                help_text("query", "The SQL query to execute")
+                    .with_format(help_parameter_format_t::HPF_SQL))
+            .with_tags({"io", "scripting", "sql"})
+            .with_example({"To write the error messages in the logs as JSON "
+                           "Lines to /tmp/errors.json",
+                           "/tmp/errors.json SELECT log_time, log_body FROM "
+                           "all_logs WHERE log_level = 'error'"}),
+    },
+    {
+        "export-arrow-to",
+        com_export_to,
+
+        help_text(":export-arrow-to")
+            .with_summary("Execute a query and write the results to the given "
+                          "file in the Arrow IPC stream format as they are "
+                          "produced.  Text columns are dictionary-encoded and "
+                          "the column types are taken from the first batch "
+                          "of rows.")
+            .with_parameter(
+                help_text("--anonymize", "Anonymize the text values").flag())
+            .with_parameter(
+                help_text("path", "The path to the file to write")
+                    .with_format(help_parameter_format_t::HPF_LOCAL_FILENAME))
+            .with_parameter(
+                help_text("query", "The SQL query to execute")
+                    .with_format(help_parameter_format_t::HPF_SQL))
+            .with_tags({"io", "scripting", "sql"})
+            .with_example({"To write the log messages as an Arrow stream to "
+                           "/tmp/logs.arrows",
+                           "/tmp/logs.arrows SELECT log_time, log_level, "
+                           "log_body FROM all_logs"}),
+    },
     {
         "write-raw-to",
         com_save_to,
@@ -27,6 +27,10 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <thread>
 #include <vector>
 
 #include "command_executor.hh"
@@ -69,9 +73,25 @@ exec_context INIT_EXEC_CONTEXT;
 
 static sig_atomic_t sql_counter = 0;
 
+/**
+ * State of the statements being executed, used to report progress while
+ * SQLite is stepping.
+ */
+static struct {
+    std::optional<std::chrono::steady_clock::time_point> sqp_start;
+    /** The number of rows returned so far. */
+    size_t sqp_rows{0};
+    /** The number of result rows that were in the DB view at last update. */
+    size_t sqp_shown_rows{0};
+    /** True if the user asked for the query to be cancelled. */
+    bool sqp_cancelled{false};
+} sql_query_progress;
+
 int
 sql_progress(const log_cursor& lc)
 {
+    static constexpr auto MIN_RATE_ELAPSED = 100ms;
+
     if (lnav_data.ld_window == nullptr) {
         return 0;
     }
@@ -80,15 +100,65 @@ sql_progress(const log_cursor& lc)
         return 1;
     }
 
+    if (!sql_query_progress.sqp_start) {
+        sql_query_progress.sqp_start = std::chrono::steady_clock::now();
+    }
+
     if (ui_periodic_timer::singleton().time_to_update(sql_counter)) {
         ssize_t total = lnav_data.ld_log_source.text_line_count();
         off_t off = lc.lc_curr_line;
+        auto elapsed = std::chrono::steady_clock::now()
+            - sql_query_progress.sqp_start.value();
+        auto elapsed_secs
+            = std::chrono::duration_cast<std::chrono::duration<double>>(elapsed)
+                  .count();
 
-        if (off >= 0 && off <= total) {
+        if (off > 0 && off <= total) {
             lnav_data.ld_bottom_source.update_loading(off, total);
-            lnav_data.ld_status[LNS_BOTTOM].set_needs_update();
+        } else {
+            // The query is not scanning a log table, so there is no
+            // position to report.
+            lnav_data.ld_bottom_source.update_loading(1, 1);
+        }
+        if (sql_query_progress.sqp_rows == 0) {
+            lnav_data.ld_bottom_source.set_loading_detail(
+                fmt::format(FMT_STRING("query running for {:.1f}s"),
+                            elapsed_secs));
+        } else if (elapsed < MIN_RATE_ELAPSED) {
+            // Too early for the rate to mean anything.
+            lnav_data.ld_bottom_source.set_loading_detail(
+                fmt::format(FMT_STRING("query returned {:L} row{}"),
+                            sql_query_progress.sqp_rows,
+                            sql_query_progress.sqp_rows == 1 ? "" : "s"));
+        } else {
+            lnav_data.ld_bottom_source.set_loading_detail(fmt::format(
+                FMT_STRING("query returned {:L} row{} in {:.1f}s ({:L} "
+                           "rows/s)"),
+                sql_query_progress.sqp_rows,
+                sql_query_progress.sqp_rows == 1 ? "" : "s",
+                elapsed_secs,
+                (size_t) (sql_query_progress.sqp_rows / elapsed_secs)));
+        }
+        lnav_data.ld_status[LNS_BOTTOM].set_needs_update();
+
+        // Show the rows that have arrived so far if the results are
+        // already on screen, like when re-running a query from the DB view.
+        auto& db_tc = lnav_data.ld_views[LNV_DB];
+        auto db_rows = lnav_data.ld_db_row_source.dls_row_cursors.size();
+        if (lnav_data.ld_view_stack.top().value_or(nullptr) == &db_tc
+            && db_rows != sql_query_progress.sqp_shown_rows)
+        {
+            sql_query_progress.sqp_shown_rows = db_rows;
+            db_tc.reload_data();
+        }
+
+        if (lnav_data.ld_status_refresher(lnav::func::op_type::blocking)
+            == lnav::progress_result_t::interrupt)
+        {
+            log_info("SQL query cancelled by user");
+            sql_query_progress.sqp_cancelled = true;
+            return 1;
         }
-        lnav_data.ld_status_refresher(lnav::func::op_type::blocking);
     }
 
     return 0;
@@ -97,6 +167,11 @@ sql_progress(const log_cursor& lc)
 void
 sql_progress_finished()
 {
+    sql_query_progress.sqp_start = std::nullopt;
+    sql_query_progress.sqp_rows = 0;
+    sql_query_progress.sqp_shown_rows = 0;
+    sql_query_progress.sqp_cancelled = false;
+
     if (sql_counter == 0) {
         return;
     }
@@ -113,6 +188,338 @@ sql_progress_finished()
     lnav_data.ld_views[LNV_DB].redo_search();
 }
 
+namespace {
+
+/**
+ * Queries that only read tables in attached database files do not touch the
+ * log tables or the views.  They are run on this second connection, which
+ * only has the built-in SQL functions and is not allowed to change
+ * anything.  The statement is stepped on a separate thread so that the UI
+ * thread can keep indexing and handle the rows as they arrive.
+ */
+struct sql_worker_db {
+    auto_sqlite3 swd_db;
+    /** The attached schema names and the files they are for. */
+    std::map<std::string, std::string> swd_attached;
+
+    /**
+     * Attach the same database files as the main connection.
+     *
+     * @return False if there are no database files to query.
+     */
+    bool sync_attachments();
+
+    /**
+     * Prepare the given statement on this connection, if it only reads
+     * tables in attached database files that are not hidden by a table of
+     * the same name in the main connection.
+     */
+    auto_mem<sqlite3_stmt> prepare(const char* sql, int len);
+};
+
+sql_worker_db sql_worker;
+
+bool
+sql_worker_db::sync_attachments()
+{
+    std::map<std::string, std::string> wanted;
+    auto_mem<sqlite3_stmt> stmt(sqlite3_finalize);
+
+    if (sqlite3_prepare_v2(
+            lnav_data.ld_db.in(), "PRAGMA database_list", -1, stmt.out(), nullptr)
+        != SQLITE_OK)
+    {
+        return false;
+    }
+    while (sqlite3_step(stmt.in()) == SQLITE_ROW) {
+        auto name = std::string(
+            (const char*) sqlite3_column_text(stmt.in(), 1));
+        const auto* file = (const char*) sqlite3_column_text(stmt.in(), 2);
+
+        if (name == "main" || name == "temp" || file == nullptr
+            || file[0] == '\0')
+        {
+            continue;
+        }
+        wanted.emplace(name, file);
+    }
+
+    if (wanted.empty() && this->swd_db.in() == nullptr) {
+        return false;
+    }
+
+    if (this->swd_db.in() == nullptr) {
+        if (sqlite3_open_v2(":memory:",
+                            this->swd_db.out(),
+                            SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE
+                                | SQLITE_OPEN_FULLMUTEX,
+                            nullptr)
+            != SQLITE_OK)
+        {
+            log_error("unable to open SQL worker connection: %s",
+                      sqlite3_errmsg(this->swd_db.in()));
+            this->swd_db.reset();
+            return false;
+        }
+        sqlite3_exec(
+            this->swd_db.in(), "PRAGMA query_only = 1", nullptr, nullptr, nullptr);
+    }
+
+    for (auto iter = this->swd_attached.begin();
+         iter != this->swd_attached.end();)
+    {
+        auto wanted_iter = wanted.find(iter->first);
+
+        if (wanted_iter != wanted.end() && wanted_iter->second == iter->second)
+        {
+            ++iter;
+            continue;
+        }
+
+        auto_mem<sqlite3_stmt> detach_stmt(sqlite3_finalize);
+
+        log_info("SQL worker detaching: %s", iter->first.c_str());
+        sqlite3_prepare_v2(
+            this->swd_db.in(), "DETACH DATABASE ?", -1, detach_stmt.out(), nullptr);
+        sqlite3_bind_text(detach_stmt.in(),
+                          1,
+                          iter->first.c_str(),
+                          iter->first.size(),
+                          SQLITE_TRANSIENT);
+        sqlite3_step(detach_stmt.in());
+        iter = this->swd_attached.erase(iter);
+    }
+
+    for (const auto& pair : wanted) {
+        if (this->swd_attached.count(pair.first) > 0) {
+            continue;
+        }
+
+        auto_mem<sqlite3_stmt> attach_stmt(sqlite3_finalize);
+
+        log_info("SQL worker attaching %s as %s",
+                 pair.second.c_str(),
+                 pair.first.c_str());
+        sqlite3_prepare_v2(this->swd_db.in(),
+                           "ATTACH DATABASE ? AS ?",
+                           -1,
+                           attach_stmt.out(),
+                           nullptr);
+        sqlite3_bind_text(attach_stmt.in(),
+                          1,
+                          pair.second.c_str(),
+                          pair.second.size(),
+                          SQLITE_TRANSIENT);
+        sqlite3_bind_text(attach_stmt.in(),
+                          2,
+                          pair.first.c_str(),
+                          pair.first.size(),
+                          SQLITE_TRANSIENT);
+        if (sqlite3_step(attach_stmt.in()) != SQLITE_DONE) {
+            log_error("SQL worker unable to attach %s: %s",
+                      pair.second.c_str(),
+                      sqlite3_errmsg(this->swd_db.in()));
+            continue;
+        }
+        this->swd_attached.emplace(pair);
+    }
+
+    return !this->swd_attached.empty();
+}
+
+struct sql_worker_access {
+    bool swa_allowed{true};
+    std::set<std::string> swa_tables;
+};
+
+int
+sql_worker_authorizer(void* data,
+                      int action_code,
+                      const char* detail1,
+                      const char* detail2,
+                      const char* detail3,
+                      const char* detail4)
+{
+    auto* swa = static_cast<sql_worker_access*>(data);
+
+    switch (action_code) {
+        case SQLITE_SELECT:
+        case SQLITE_FUNCTION:
+        case SQLITE_RECURSIVE:
+            return SQLITE_OK;
+        case SQLITE_READ:
+            if (detail1 != nullptr) {
+                swa->swa_tables.emplace(detail1);
+            }
+            return SQLITE_OK;
+        default:
+            swa->swa_allowed = false;
+            return SQLITE_DENY;
+    }
+}
+
+auto_mem<sqlite3_stmt>
+sql_worker_db::prepare(const char* sql, int len)
+{
+    auto_mem<sqlite3_stmt> retval(sqlite3_finalize);
+
+    if (!this->sync_attachments()) {
+        return retval;
+    }
+
+    sql_worker_access swa;
+
+    sqlite3_set_authorizer(this->swd_db.in(), sql_worker_authorizer, &swa);
+    auto rc = sqlite3_prepare_v2(
+        this->swd_db.in(), sql, len, retval.out(), nullptr);
+    sqlite3_set_authorizer(this->swd_db.in(), nullptr, nullptr);
+    if (rc != SQLITE_OK || !swa.swa_allowed || retval.in() == nullptr
+        || swa.swa_tables.empty())
+    {
+        retval.reset();
+        return retval;
+    }
+
+    // An unqualified name is looked up in the main connection's own
+    // schemas first, so the query might mean a different table there.
+    auto_mem<sqlite3_stmt> shadow_stmt(sqlite3_finalize);
+
+    sqlite3_prepare_v2(lnav_data.ld_db.in(),
+                       "SELECT 1 FROM main.sqlite_master WHERE name = ?1 "
+                       "COLLATE NOCASE UNION ALL "
+                       "SELECT 1 FROM temp.sqlite_master WHERE name = ?1 "
+                       "COLLATE NOCASE",
+                       -1,
+                       shadow_stmt.out(),
+                       nullptr);
+    for (const auto& table : swa.swa_tables) {
+        sqlite3_reset(shadow_stmt.in());
+        sqlite3_bind_text(shadow_stmt.in(),
+                          1,
+                          table.c_str(),
+                          table.size(),
+                          SQLITE_TRANSIENT);
+        if (sqlite3_step(shadow_stmt.in()) != SQLITE_DONE) {
+            retval.reset();
+            return retval;
+        }
+    }
+
+    return retval;
+}
+
+/**
+ * Steps a statement on the worker connection from a separate thread.  The
+ * caller waits for each step to finish and calls the given tick function
+ * in the meantime.
+ */
+class sql_worker_stepper {
+public:
+    explicit sql_worker_stepper(sqlite3_stmt* stmt)
+        : sws_stmt(stmt), sws_thread([this]() { this->run(); })
+    {
+    }
+
+    ~sql_worker_stepper()
+    {
+        {
+            std::lock_guard<std::mutex> lg(this->sws_mutex);
+
+            this->sws_exit = true;
+        }
+        this->sws_cond.notify_all();
+        this->sws_thread.join();
+    }
+
+    template<typename F>
+    int step(F tick)
+    {
+        std::unique_lock<std::mutex> lk(this->sws_mutex);
+
+        this->sws_result = std::nullopt;
+        this->sws_step_requested = true;
+        this->sws_cond.notify_all();
+        while (!this->sws_cond.wait_for(
+            lk, 50ms, [this]() { return this->sws_result.has_value(); }))
+        {
+            lk.unlock();
+            tick();
+            lk.lock();
+        }
+
+        return this->sws_result.value();
+    }
+
+private:
+    void run()
+    {
+        std::unique_lock<std::mutex> lk(this->sws_mutex);
+
+        while (true) {
+            this->sws_cond.wait(lk, [this]() {
+                return this->sws_step_requested || this->sws_exit;
+            });
+            if (this->sws_exit) {
+                break;
+            }
+            this->sws_step_requested = false;
+            lk.unlock();
+            auto rc = sqlite3_step(this->sws_stmt);
+            lk.lock();
+            this->sws_result = rc;
+            this->sws_cond.notify_all();
+        }
+    }
+
+    sqlite3_stmt* sws_stmt;
+    std::mutex sws_mutex;
+    std::condition_variable sws_cond;
+    bool sws_step_requested{false};
+    bool sws_exit{false};
+    std::optional<int> sws_result;
+    std::thread sws_thread;
+};
+
+/**
+ * Called on the UI thread while the worker is stepping.  The progress is
+ * reported as for other queries and, since the worker does not read the
+ * logs, indexing keeps going if no other statement is reading them.
+ */
+void
+sql_worker_tick(sqlite3* worker_db)
+{
+    static bool in_tick = false;
+
+    if (in_tick) {
+        return;
+    }
+
+    in_tick = true;
+    auto fin = finally([]() { in_tick = false; });
+
+    if (sql_progress(log_cursor()) != 0) {
+        sqlite3_interrupt(worker_db);
+        return;
+    }
+
+    if (lnav_data.ld_window == nullptr) {
+        return;
+    }
+
+    for (auto* stmt = sqlite3_next_stmt(lnav_data.ld_db.in(), nullptr);
+         stmt != nullptr;
+         stmt = sqlite3_next_stmt(lnav_data.ld_db.in(), stmt))
+    {
+        if (sqlite3_stmt_busy(stmt)) {
+            return;
+        }
+    }
+
+    rebuild_indexes(ui_clock::now() + 10ms);
+}
+
+}  // namespace
+
 static Result<std::string, lnav::console::user_message> execute_from_file(
     exec_context& ec,
     const std::string& src,
@@ -418,27 +825,62 @@ execute_sql(exec_context& ec, const std::string& sql, std::string& alt_msg)
 #endif
         bool done = false;
 
-        auto bound_values = TRY(bind_sql_parameters(ec, stmt.in()));
+        auto* exec_db = lnav_data.ld_db.in();
+        auto* exec_stmt = stmt.in();
+        auto_mem<sqlite3_stmt> worker_stmt(sqlite3_finalize);
+        std::optional<sql_worker_stepper> worker_stepper;
         if (last_is_readonly) {
-            ec.ec_sql_callback(ec, stmt.in());
+            worker_stmt = sql_worker.prepare(curr_stmt, tail - curr_stmt);
+            if (worker_stmt.in() != nullptr) {
+                log_info("running statement on the SQL worker connection");
+                exec_db = sql_worker.swd_db.in();
+                exec_stmt = worker_stmt.in();
+                worker_stepper.emplace(exec_stmt);
+            }
+        }
+
+        auto bound_values = TRY(bind_sql_parameters(ec, exec_stmt));
+        if (last_is_readonly) {
+            ec.ec_sql_callback(ec, exec_stmt);
         }
         while (!done) {
-            retcode = sqlite3_step(stmt.in());
+            if (worker_stepper) {
+                retcode = worker_stepper->step(
+                    [exec_db]() { sql_worker_tick(exec_db); });
+            } else {
+                retcode = sqlite3_step(exec_stmt);
+            }
 
             switch (retcode) {
                 case SQLITE_OK:
                 case SQLITE_DONE: {
-                    auto changes = sqlite3_changes(lnav_data.ld_db.in());
-
-                    log_info("sqlite3_changes() -> %d", changes);
+                    auto changes = sqlite3_changes(exec_db);
+
+                    log_info("sqlite3_changes() -> %d; rows returned -> %zu",
+                             changes,
+                             sql_query_progress.sqp_rows);
+                    if (strncasecmp(curr_stmt, "PRAGMA", 6) == 0) {
+                        // The native filter plans depend on some pragmas.
+                        lnav_data.ld_log_source.clear_filter_plans();
+                    }
                     done = true;
                     break;
                 }
 
                 case SQLITE_ROW:
-                    ec.ec_sql_callback(ec, stmt.in());
+                    sql_query_progress.sqp_rows += 1;
+                    ec.ec_sql_callback(ec, exec_stmt);
                     break;
 
+                case SQLITE_INTERRUPT:
+                    if (std::exchange(sql_query_progress.sqp_cancelled, false))
+                    {
+                        return ec.make_error(
+                            "query was cancelled after {} row(s)",
+                            sql_query_progress.sqp_rows);
+                    }
+                    [[fallthrough]];
+
                 default: {
                     attr_line_t bound_note;
 
@@ -469,7 +911,7 @@ execute_sql(exec_context& ec, const std::string& sql, std::string& alt_msg)
                     }
 
                     log_error("sqlite3_step error code: %d", retcode);
-                    auto um = sqlite3_error_to_user_message(lnav_data.ld_db)
+                    auto um = sqlite3_error_to_user_message(exec_db)
                                   .with_context_snippets(ec.ec_source)
                                   .remove_internal_snippets()
                                   .with_note(bound_note)
@@ -517,6 +959,7 @@ execute_sql(exec_context& ec, const std::string& sql, std::string& alt_msg)
 
         lnav_data.ld_active_files.fc_files
             | lnav::itertools::for_each(&logfile::dump_stats);
+        lnav_data.ld_log_source.dump_stats();
         if (ec.ec_sql_callback != sql_callback) {
             retval = ec.ec_accumulator->get_string();
         } else {
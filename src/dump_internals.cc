@@ -100,6 +100,61 @@ dump_internals(const char* internals_dir)
                 cmd_pair.second->c_help, eval_example, sql_file.get());
         }
     }
+
+    auto mem_ref_path = std::filesystem::path(internals_dir) / "memory-ref.rst";
+    auto mem_file = std::unique_ptr<FILE, decltype(&fclose)>(
+        fopen(mem_ref_path.c_str(), "w+"), fclose);
+
+    if (mem_file != nullptr) {
+        const std::vector<std::pair<const char*, size_t>> line_structs = {
+            {"Log file index", sizeof(logline)},
+            {"Merged log index",
+             sizeof(logfile_sub_source::indexed_content)},
+            {"Filtered log index", sizeof(uint32_t)},
+        };
+
+        fmt::print(mem_file.get(),
+                   FMT_STRING(".. list-table:: Memory used per log line\n"
+                              "   :header-rows: 1\n"
+                              "\n"
+                              "   * - Structure\n"
+                              "     - Bytes per line\n"));
+        for (const auto& [name, size] : line_structs) {
+            fmt::print(mem_file.get(),
+                       FMT_STRING("   * - {}\n"
+                                  "     - {}\n"),
+                       name,
+                       size);
+        }
+
+        // Peak RSS of "lnav -n" counting the lines of a 165MB, 2M line
+        // syslog file, less the RSS for a 20 line file, divided by the
+        // number of lines.  The "before" column is for the 24 byte logline.
+        const std::vector<std::tuple<const char*, size_t, size_t>>
+            measured_rss = {
+                {"syslog, 2,000,000 lines", 55, 47},
+            };
+
+        fmt::print(mem_file.get(),
+                   FMT_STRING("\n"
+                              ".. list-table:: Measured resident memory per "
+                              "log line\n"
+                              "   :header-rows: 1\n"
+                              "\n"
+                              "   * - File\n"
+                              "     - Before (24 byte index entry)\n"
+                              "     - After ({} byte index entry)\n"),
+                   sizeof(logline));
+        for (const auto& [name, before, after] : measured_rss) {
+            fmt::print(mem_file.get(),
+                       FMT_STRING("   * - {}\n"
+                                  "     - {}\n"
+                                  "     - {}\n"),
+                       name,
+                       before,
+                       after);
+        }
+    }
 }
 
 }  // namespace lnav
@@ -37,12 +37,14 @@
 
 #include "base/fs_util.hh"
 #include "base/humanize.network.hh"
+#include "base/injector.bind.hh"
 #include "base/isc.hh"
 #include "base/itertools.hh"
 #include "base/opt_util.hh"
 #include "base/string_util.hh"
 #include "config.h"
 #include "file_converter_manager.hh"
+#include "file_watcher.hh"
 #include "logfile.hh"
 #include "service_tags.hh"
 #include "tailer/tailer.looper.hh"
@@ -254,6 +256,121 @@ file_collection::merge(file_collection& other)
     }
 }
 
+static auto bound_archive_looper
+    = injector::bind_multiple<isc::service_base>()
+          .add_singleton<archive_looper>();
+
+void
+archive_looper::submit(std::function<void(archive_looper&)> task)
+{
+    {
+        std::lock_guard<std::mutex> lg(this->al_mutex);
+
+        if (this->al_running) {
+            this->send(std::move(task));
+            return;
+        }
+    }
+
+    task(*this);
+}
+
+void*
+archive_looper::run()
+{
+    {
+        std::lock_guard<std::mutex> lg(this->al_mutex);
+
+        this->al_running = true;
+    }
+
+    auto* retval = isc::service<archive_looper>::run();
+
+    {
+        std::lock_guard<std::mutex> lg(this->al_mutex);
+
+        this->al_running = false;
+    }
+    // Anything sent before the flag was cleared is still in the port.
+    // Since the service has stopped looping, these extractions are
+    // cancelled right away, but they still need to run to finish their
+    // bookkeeping in the scan progress.
+    this->s_port.process_for(std::chrono::milliseconds(0));
+
+    return retval;
+}
+
+/**
+ * Extract an archive and publish its members and any error in the scan
+ * progress so that they can be picked up by the next rescan.
+ */
+static void
+extract_archive(const std::string& filename,
+                time_t mtime,
+                const std::shared_ptr<safe_scan_progress>& prog,
+                const archive_manager::cancel_cb& is_cancelled)
+{
+    std::optional<std::list<archive_manager::extract_progress>::iterator>
+        prog_iter_opt;
+
+    auto res = archive_manager::walk_archive_files(
+        filename,
+        [&prog, &prog_iter_opt](const auto& path, const auto total) {
+            safe::WriteAccess<safe_scan_progress> sp(*prog);
+
+            prog_iter_opt | [&sp](auto prog_iter) {
+                sp->sp_extractions.erase(prog_iter);
+            };
+            auto prog_iter = sp->sp_extractions.emplace(
+                sp->sp_extractions.begin(), path, total);
+            prog_iter_opt = prog_iter;
+
+            return &(*prog_iter);
+        },
+        [&filename, &prog](const auto& tmp_path, const auto& member) {
+            auto arc_path = std::filesystem::relative(member.mi_path, tmp_path);
+            auto custom_name = filename / arc_path;
+            bool is_visible = true;
+
+            if (member.mi_size && member.mi_size.value() == 0) {
+                log_info("hiding empty archive file: %s",
+                         member.mi_path.c_str());
+                is_visible = false;
+            }
+
+            log_info("adding file from archive: %s/%s",
+                     filename.c_str(),
+                     member.mi_path.c_str());
+            prog->writeAccess()
+                ->sp_archive_members[member.mi_path.string()]
+                .with_filename(custom_name.string())
+                .with_source(logfile_name_source::ARCHIVE)
+                .with_visibility(is_visible)
+                .with_non_utf_visibility(false)
+                .with_visible_size_limit(256 * 1024);
+        },
+        is_cancelled);
+
+    safe::WriteAccess<safe_scan_progress> sp(*prog);
+
+    if (res.isErr() && is_cancelled()) {
+        log_info("%s", res.unwrapErr().c_str());
+    } else if (res.isErr()) {
+        // The members that were already published are kept since they
+        // have been extracted, at least in part.
+        log_error("archive extraction failed: %s", res.unwrapErr().c_str());
+        sp->sp_archive_errors.emplace(filename,
+                                      file_error_info{
+                                          mtime,
+                                          res.unwrapErr(),
+                                      });
+    }
+    prog_iter_opt | [&sp](auto prog_iter) {
+        sp->sp_extractions.erase(prog_iter);
+    };
+    sp->sp_active_archives -= 1;
+}
+
 /**
  * Functor used to compare files based on their device and inode number.
  */
@@ -461,74 +578,27 @@ file_collection::watch_logfile(const std::string& filename,
                 }
 
                 case file_format_t::ARCHIVE: {
-                    std::optional<
-                        std::list<archive_manager::extract_progress>::iterator>
-                        prog_iter_opt;
-
                     if (loo.loo_source == logfile_name_source::ARCHIVE) {
                         // Don't try to open nested archives
                         return retval;
                     }
 
-                    auto res = archive_manager::walk_archive_files(
-                        filename,
-                        [prog, &prog_iter_opt](const auto& path,
-                                               const auto total) {
-                            safe::WriteAccess<safe_scan_progress> sp(*prog);
-
-                            prog_iter_opt | [&sp](auto prog_iter) {
-                                sp->sp_extractions.erase(prog_iter);
-                            };
-                            auto prog_iter = sp->sp_extractions.emplace(
-                                sp->sp_extractions.begin(), path, total);
-                            prog_iter_opt = prog_iter;
-
-                            return &(*prog_iter);
-                        },
-                        [&filename, &retval](const auto& tmp_path,
-                                             const auto& entry) {
-                            auto arc_path = std::filesystem::relative(
-                                entry.path(), tmp_path);
-                            auto custom_name = filename / arc_path;
-                            bool is_visible = true;
-
-                            if (entry.file_size() == 0) {
-                                log_info("hiding empty archive file: %s",
-                                         entry.path().c_str());
-                                is_visible = false;
-                            }
-
-                            log_info("adding file from archive: %s/%s",
-                                     filename.c_str(),
-                                     entry.path().c_str());
-                            retval.fc_file_names[entry.path().string()]
-                                .with_filename(custom_name.string())
-                                .with_source(logfile_name_source::ARCHIVE)
-                                .with_visibility(is_visible)
-                                .with_non_utf_visibility(false)
-                                .with_visible_size_limit(256 * 1024);
+                    // The archive is extracted in the background and the
+                    // members are picked up by later rescans as soon as
+                    // they start extracting.
+                    prog->writeAccess()->sp_active_archives += 1;
+                    auto& looper = injector::get<archive_looper&>();
+                    auto extract = [filename, mtime = st.st_mtime, prog](
+                                       auto& al) {
+                        extract_archive(filename, mtime, prog, [&al]() {
+                            return !al.is_looping();
                         });
-                    if (res.isErr()) {
-                        log_error("archive extraction failed: %s",
-                                  res.unwrapErr().c_str());
-                        retval.clear();
-                        retval.fc_name_to_errors->writeAccess()->emplace(
-                            filename,
-                            file_error_info{
-                                st.st_mtime,
-                                res.unwrapErr(),
-                            });
-                    } else {
-                        auto& ofd = retval.fc_other_files[filename];
-                        ofd.ofd_format = ff_res.dffr_file_format;
-                        ofd.ofd_details = ff_res.dffr_details;
-                    }
-                    {
-                        prog_iter_opt | [&prog](auto prog_iter) {
-                            prog->writeAccess()->sp_extractions.erase(
-                                prog_iter);
-                        };
-                    }
+                    };
+                    looper.submit(std::move(extract));
+
+                    auto& ofd = retval.fc_other_files[filename];
+                    ofd.ofd_format = ff_res.dffr_file_format;
+                    ofd.ofd_details = ff_res.dffr_details;
                     break;
                 }
 
@@ -779,10 +849,36 @@ file_collection::expand_filename(
     }
 }
 
+/**
+ * @return The directory to watch for new files that match the given name
+ * or nullopt if the name cannot be watched.
+ */
+static std::optional<std::filesystem::path>
+dir_to_watch(const std::string& path)
+{
+    if (lnav::filesystem::is_url(path)) {
+        return std::nullopt;
+    }
+
+    auto dir = std::filesystem::path(path).parent_path();
+    if (dir.empty()) {
+        dir = ".";
+    }
+    if (dir.native().find_first_of("*?[") != std::string::npos) {
+        return std::nullopt;
+    }
+
+    return dir;
+}
+
 file_collection
 file_collection::rescan_files(bool required)
 {
+    static auto& fw = injector::get<file_watcher&>();
+
     file_collection retval;
+    auto dirs_watched = fw.is_active() && !this->fc_recursive
+        && this->fc_child_pollers.empty();
     lnav::futures::future_queue<file_collection> fq(
         [this, &retval](std::future<file_collection>& fc) {
             try {
@@ -803,12 +899,51 @@ file_collection::rescan_files(bool required)
             return lnav::progress_result_t::interrupt;
         });
 
+    {
+        safe::WriteAccess<safe_scan_progress> sp(*this->fc_progress);
+
+        if (!sp->sp_archive_members.empty()) {
+            retval.fc_file_names.insert(sp->sp_archive_members.begin(),
+                                        sp->sp_archive_members.end());
+            sp->sp_archive_members.clear();
+        }
+        if (!sp->sp_archive_errors.empty()) {
+            retval.fc_name_to_errors->writeAccess()->insert(
+                sp->sp_archive_errors.begin(), sp->sp_archive_errors.end());
+            sp->sp_archive_errors.clear();
+        }
+        if (!sp->empty()) {
+            dirs_watched = false;
+        }
+    }
+
+    if (fw.is_active()) {
+        // The file watcher only adds watches for the names it has not seen
+        // and drops them for names that have been removed.
+        std::map<std::string, std::filesystem::path> name_dirs;
+
+        for (const auto& pair : this->fc_file_names) {
+            auto dir = pair.second.loo_piper ? std::nullopt
+                                             : dir_to_watch(pair.first);
+
+            if (dir) {
+                name_dirs.emplace(pair.first, dir.value());
+            } else {
+                dirs_watched = false;
+            }
+        }
+        if (!fw.watch_names(name_dirs)) {
+            dirs_watched = false;
+        }
+    }
+
     this->fc_new_stats.clear();
     for (auto& pair : this->fc_file_names) {
         if (this->fc_files.size() + retval.fc_files.size()
             >= get_limits().l_open_files)
         {
             log_debug("too many files open, breaking...");
+            dirs_watched = false;
             break;
         }
 
@@ -837,11 +972,13 @@ file_collection::rescan_files(bool required)
 
         if (retval.fc_files.size() >= 100) {
             log_debug("too many new files, breaking...");
+            dirs_watched = false;
             break;
         }
     }
 
     fq.pop_to();
+    retval.fc_dirs_watched = dirs_watched;
 
     return retval;
 }
@@ -36,6 +36,7 @@
 #include <future>
 #include <list>
 #include <map>
+#include <mutex>
 #include <set>
 #include <string>
 #include <vector>
@@ -45,6 +46,7 @@
 #include "archive_manager.hh"
 #include "base/auto_pid.hh"
 #include "base/future_util.hh"
+#include "base/isc.hh"
 #include "base/string_util.hh"
 #include "file_format.hh"
 #include "logfile_fwd.hh"
@@ -54,18 +56,64 @@ struct tailer_progress {
     std::string tp_message;
 };
 
+struct file_error_info {
+    const time_t fei_mtime;
+    const std::string fei_description;
+};
+
 struct scan_progress {
     std::list<archive_manager::extract_progress> sp_extractions;
     std::map<std::string, tailer_progress> sp_tailers;
 
+    /** The number of archives being extracted in the background. */
+    size_t sp_active_archives{0};
+    /**
+     * Archive members that have started extracting and have not been picked
+     * up by a rescan yet.
+     */
+    std::map<std::string, logfile_open_options> sp_archive_members;
+    /** Errors from background extractions not picked up by a rescan yet. */
+    std::map<std::string, file_error_info> sp_archive_errors;
+
+    bool archives_pending() const
+    {
+        return this->sp_active_archives > 0
+            || !this->sp_archive_members.empty()
+            || !this->sp_archive_errors.empty();
+    }
+
     bool empty() const
     {
-        return this->sp_extractions.empty() && this->sp_tailers.empty();
+        return this->sp_extractions.empty() && this->sp_tailers.empty()
+            && !this->archives_pending();
     }
 };
 
 using safe_scan_progress = safe::Safe<scan_progress>;
 
+/**
+ * Archives are extracted on this service instead of the rescan threads.
+ * When the service is stopped, the extraction in progress is cancelled and
+ * the service thread is joined.
+ */
+class archive_looper : public isc::service<archive_looper> {
+public:
+    /**
+     * Run an extraction on the service thread.  If the thread is not
+     * running, because the service has not been started or has already
+     * been stopped, the extraction is done on the caller's thread.  Either
+     * way, the task is run exactly once.
+     */
+    void submit(std::function<void(archive_looper&)> task);
+
+protected:
+    void* run() override;
+
+private:
+    std::mutex al_mutex;
+    bool al_running{false};
+};
+
 struct other_file_descriptor {
     file_format_t ofd_format;
     std::string ofd_description;
@@ -78,11 +126,6 @@ struct other_file_descriptor {
     }
 };
 
-struct file_error_info {
-    const time_t fei_mtime;
-    const std::string fei_description;
-};
-
 using safe_name_to_errors = safe::Safe<std::map<std::string, file_error_info>>;
 
 struct file_collection;
@@ -150,6 +193,12 @@ struct file_collection {
 
     bool fc_recursive{false};
     bool fc_rotated{false};
+    /**
+     * Set by rescan_files() when the file watcher will report changes to
+     * the directories of all the file names, so rescans can be less
+     * frequent.
+     */
+    bool fc_dirs_watched{false};
 
     std::shared_ptr<safe_name_to_errors> fc_name_to_errors{
         std::make_shared<safe_name_to_errors>()};
@@ -0,0 +1,432 @@
+/**
+ * Copyright (c) 2025, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file file_watcher.cc
+ */
+
+#include <algorithm>
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "file_watcher.hh"
+
+#include "config.h"
+
+#ifdef HAVE_SYS_INOTIFY_H
+#    include <sys/inotify.h>
+#    include <sys/vfs.h>
+#endif
+
+#include "base/injector.bind.hh"
+#include "base/lnav_log.hh"
+
+static auto bound_file_watcher = injector::bind_multiple<isc::service_base>()
+                                     .add_singleton<file_watcher>();
+
+#ifdef HAVE_SYS_INOTIFY_H
+
+static constexpr uint32_t FILE_EVENTS
+    = IN_MODIFY | IN_ATTRIB | IN_MOVE_SELF | IN_DELETE_SELF;
+static constexpr uint32_t DIR_EVENTS
+    = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR;
+
+/**
+ * @return True if changes made to files on the filesystem containing the
+ * given path are reported by inotify.  Changes made by other hosts to
+ * network and FUSE filesystems are not.
+ */
+static bool
+is_notifying_filesystem(const std::filesystem::path& path)
+{
+    static constexpr unsigned long UNSUPPORTED_FS_TYPES[] = {
+        0x6969, /* NFS */
+        0x517B, /* SMB */
+        0xFE534D42, /* SMB2 */
+        0xFF534D42, /* CIFS */
+        0x65735546, /* FUSE */
+        0x01021997, /* 9P */
+        0x00C36400, /* CEPH */
+        0x5346414F, /* AFS */
+        0x73757245, /* CODA */
+        0x01161970, /* GFS2 */
+        0x7461636F, /* OCFS2 */
+        0x0BD00BD0, /* LUSTRE */
+    };
+
+    struct statfs sfs;
+
+    if (statfs(path.c_str(), &sfs) == -1) {
+        return false;
+    }
+
+    for (const auto fs_type : UNSUPPORTED_FS_TYPES) {
+        if ((unsigned long) sfs.f_type == fs_type) {
+            log_info("file system of %s does not support notifications: %lx",
+                     path.c_str(),
+                     (unsigned long) sfs.f_type);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+#endif
+
+file_watcher::file_watcher()
+{
+#ifdef HAVE_SYS_INOTIFY_H
+    this->fw_fd = auto_fd(inotify_init1(IN_NONBLOCK | IN_CLOEXEC));
+    if (!this->fw_fd.has_value()) {
+        log_error("unable to initialize inotify: %s", strerror(errno));
+    }
+#endif
+}
+
+std::shared_ptr<file_watch_state>
+file_watcher::watch_file(const std::filesystem::path& path)
+{
+#ifdef HAVE_SYS_INOTIFY_H
+    if (!this->fw_fd.has_value() || !is_notifying_filesystem(path)) {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lg(this->fw_mutex);
+
+    auto wd = inotify_add_watch(this->fw_fd, path.c_str(), FILE_EVENTS);
+    if (wd == -1) {
+        log_warning("unable to watch file %s: %s",
+                    path.c_str(),
+                    strerror(errno));
+        return nullptr;
+    }
+
+    auto retval = std::make_shared<file_watch_state>();
+    auto& wf = this->fw_files[wd];
+    wf.wf_path = path;
+    wf.wf_states.emplace_back(retval);
+    if (wf.wf_dir_wd != -1) {
+        return retval;
+    }
+
+    auto parent = path.parent_path();
+    auto dir_wd = inotify_add_watch(this->fw_fd, parent.c_str(), DIR_EVENTS);
+    if (dir_wd == -1) {
+        log_warning("unable to watch directory %s: %s",
+                    parent.c_str(),
+                    strerror(errno));
+    } else {
+        auto& wd_entry = this->fw_dirs[dir_wd];
+        wd_entry.wd_path = parent;
+        wd_entry.wd_file_refs += 1;
+        wf.wf_dir_wd = dir_wd;
+    }
+
+    return retval;
+#else
+    return nullptr;
+#endif
+}
+
+bool
+file_watcher::watch_names(
+    const std::map<std::string, std::filesystem::path>& names)
+{
+#ifdef HAVE_SYS_INOTIFY_H
+    if (!this->fw_fd.has_value()) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lg(this->fw_mutex);
+    auto retval = true;
+
+    for (auto iter = this->fw_names.begin(); iter != this->fw_names.end();) {
+        if (names.count(iter->first) > 0) {
+            ++iter;
+            continue;
+        }
+
+        this->release_name(iter->second);
+        iter = this->fw_names.erase(iter);
+    }
+
+    for (const auto& name_pair : names) {
+        if (this->fw_names.count(name_pair.first) > 0) {
+            continue;
+        }
+
+        const auto& path = name_pair.second;
+        if (!is_notifying_filesystem(path)) {
+            retval = false;
+            continue;
+        }
+
+        auto wd = inotify_add_watch(this->fw_fd, path.c_str(), DIR_EVENTS);
+        if (wd == -1) {
+            retval = false;
+            continue;
+        }
+        auto& wd_entry = this->fw_dirs[wd];
+        wd_entry.wd_path = path;
+        wd_entry.wd_name_refs += 1;
+        this->fw_names[name_pair.first] = wd;
+    }
+
+    return retval;
+#else
+    return false;
+#endif
+}
+
+void
+file_watcher::force_check()
+{
+    std::lock_guard<std::mutex> lg(this->fw_mutex);
+
+    for (auto& wf_pair : this->fw_files) {
+        for (auto& state : wf_pair.second.wf_states) {
+            auto fws = state.lock();
+            if (fws) {
+                fws->fws_changed = true;
+            }
+        }
+    }
+}
+
+bool
+file_watcher::check_file(file_watch_state& fws) const
+{
+    auto now = std::chrono::steady_clock::now();
+
+    if (!this->fw_active || !fws.fws_watched
+        || now - fws.fws_last_check >= POLL_INTERVAL
+        || fws.fws_changed.exchange(false))
+    {
+        fws.fws_last_check = now;
+        return true;
+    }
+
+    return false;
+}
+
+void*
+file_watcher::run()
+{
+    this->fw_active = this->fw_fd.has_value();
+    auto retval = isc::service<file_watcher>::run();
+    this->fw_active = false;
+
+    return retval;
+}
+
+void
+file_watcher::loop_body()
+{
+#ifdef HAVE_SYS_INOTIFY_H
+    using namespace std::chrono_literals;
+
+    if (!this->fw_fd.has_value()) {
+        std::this_thread::sleep_for(1s);
+        return;
+    }
+
+    struct pollfd pfd = {this->fw_fd, POLLIN, 0};
+    auto rc = poll(&pfd, 1, 100);
+
+    if (rc > 0) {
+        alignas(struct inotify_event) char buffer[16 * 1024];
+
+        while (true) {
+            auto len = read(this->fw_fd, buffer, sizeof(buffer));
+            if (len <= 0) {
+                break;
+            }
+
+            std::lock_guard<std::mutex> lg(this->fw_mutex);
+            for (const char* ptr = buffer; ptr < buffer + len;) {
+                const auto* event
+                    = reinterpret_cast<const struct inotify_event*>(ptr);
+
+                ptr += sizeof(struct inotify_event) + event->len;
+                if (event->mask & IN_Q_OVERFLOW) {
+                    log_warning("inotify queue overflowed, polling all files");
+                    for (auto& wf_pair : this->fw_files) {
+                        for (auto& state : wf_pair.second.wf_states) {
+                            auto fws = state.lock();
+                            if (fws) {
+                                fws->fws_changed = true;
+                            }
+                        }
+                    }
+                    this->fw_file_changes = true;
+                    this->fw_dir_changes = true;
+                    continue;
+                }
+
+                auto file_iter = this->fw_files.find(event->wd);
+                if (file_iter != this->fw_files.end()) {
+                    auto gone = (event->mask & IN_IGNORED) != 0;
+
+                    for (auto& state : file_iter->second.wf_states) {
+                        auto fws = state.lock();
+                        if (fws) {
+                            fws->fws_changed = true;
+                            if (gone) {
+                                fws->fws_watched = false;
+                            }
+                        }
+                    }
+                    this->fw_file_changes = true;
+                    if (event->mask & (IN_MOVE_SELF | IN_DELETE_SELF)) {
+                        this->fw_dir_changes = true;
+                    }
+                    if (gone) {
+                        log_debug("stopped watching file: %s",
+                                  file_iter->second.wf_path.c_str());
+                        this->release_dir(file_iter->second.wf_dir_wd);
+                        this->fw_files.erase(file_iter);
+                    }
+                    continue;
+                }
+
+                auto dir_iter = this->fw_dirs.find(event->wd);
+                if (dir_iter != this->fw_dirs.end()) {
+                    this->fw_dir_changes = true;
+                    if (event->mask & IN_IGNORED) {
+                        log_debug("stopped watching directory: %s",
+                                  dir_iter->second.wd_path.c_str());
+                        this->fw_dirs.erase(dir_iter);
+                        // The names are watched again by the next call to
+                        // watch_names(), if the directory comes back.
+                        for (auto name_iter = this->fw_names.begin();
+                             name_iter != this->fw_names.end();)
+                        {
+                            if (name_iter->second == event->wd) {
+                                name_iter = this->fw_names.erase(name_iter);
+                            } else {
+                                ++name_iter;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    } else if (rc == -1 && errno != EINTR) {
+        log_error("unable to poll inotify fd: %s", strerror(errno));
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (now - this->fw_last_cleanup >= 1s) {
+        this->fw_last_cleanup = now;
+        this->drop_unused_watches();
+    }
+#else
+    using namespace std::chrono_literals;
+
+    std::this_thread::sleep_for(1s);
+#endif
+}
+
+void
+file_watcher::release_dir(int dir_wd)
+{
+#ifdef HAVE_SYS_INOTIFY_H
+    auto iter = this->fw_dirs.find(dir_wd);
+    if (iter == this->fw_dirs.end()) {
+        return;
+    }
+
+    auto& wd_entry = iter->second;
+    if (wd_entry.wd_file_refs > 0) {
+        wd_entry.wd_file_refs -= 1;
+    }
+    this->remove_dir_if_unused(iter);
+#endif
+}
+
+void
+file_watcher::release_name(int dir_wd)
+{
+#ifdef HAVE_SYS_INOTIFY_H
+    auto iter = this->fw_dirs.find(dir_wd);
+    if (iter == this->fw_dirs.end()) {
+        return;
+    }
+
+    auto& wd_entry = iter->second;
+    if (wd_entry.wd_name_refs > 0) {
+        wd_entry.wd_name_refs -= 1;
+    }
+    this->remove_dir_if_unused(iter);
+#endif
+}
+
+void
+file_watcher::remove_dir_if_unused(std::map<int, watched_dir>::iterator iter)
+{
+#ifdef HAVE_SYS_INOTIFY_H
+    const auto& wd_entry = iter->second;
+    if (wd_entry.wd_file_refs == 0 && wd_entry.wd_name_refs == 0) {
+        log_debug("no longer watching directory: %s",
+                  wd_entry.wd_path.c_str());
+        inotify_rm_watch(this->fw_fd, iter->first);
+        this->fw_dirs.erase(iter);
+    }
+#endif
+}
+
+void
+file_watcher::drop_unused_watches()
+{
+#ifdef HAVE_SYS_INOTIFY_H
+    std::lock_guard<std::mutex> lg(this->fw_mutex);
+
+    for (auto iter = this->fw_files.begin(); iter != this->fw_files.end();) {
+        auto& states = iter->second.wf_states;
+
+        states.erase(std::remove_if(states.begin(),
+                                    states.end(),
+                                    [](const auto& state) {
+                                        return state.expired();
+                                    }),
+                     states.end());
+        if (states.empty()) {
+            log_debug("no longer watching file: %s",
+                      iter->second.wf_path.c_str());
+            inotify_rm_watch(this->fw_fd, iter->first);
+            this->release_dir(iter->second.wf_dir_wd);
+            iter = this->fw_files.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
+#endif
+}
@@ -0,0 +1,194 @@
+/**
+ * Copyright (c) 2025, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file file_watcher.hh
+ */
+
+#ifndef lnav_file_watcher_hh
+#define lnav_file_watcher_hh
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "base/auto_fd.hh"
+#include "base/isc.hh"
+#include "config.h"
+
+/**
+ * The change state of a file that is being watched by the file_watcher.
+ * The state is shared between the watcher thread, which sets the changed
+ * flag when a notification is received, and the owner of the file, which
+ * consumes it.
+ */
+struct file_watch_state {
+    std::atomic<bool> fws_changed{true};
+    /** False if the kernel stopped watching the file. */
+    std::atomic<bool> fws_watched{true};
+    std::chrono::steady_clock::time_point fws_last_check;
+};
+
+/**
+ * A service that uses inotify(7) to find out when open files are written
+ * to and when files are created, renamed, or deleted in the directories
+ * that hold them.  Files on filesystems where notifications are not
+ * reliable, like NFS, are not watched and need to be polled.
+ */
+class file_watcher : public isc::service<file_watcher> {
+public:
+    /**
+     * A watched file is still checked at this interval in case a
+     * notification was missed.
+     */
+    static constexpr auto POLL_INTERVAL = std::chrono::seconds(10);
+
+    /**
+     * The interval between rescans of the file names when all of the
+     * directories are watched.
+     */
+    static constexpr auto RESCAN_INTERVAL = std::chrono::seconds(5);
+
+    file_watcher();
+
+    /**
+     * Start watching a file for changes.
+     *
+     * @param path The resolved path to the file.
+     * @return The state to pass to check_file() or nullptr if the file
+     *   cannot be watched and needs to be polled.
+     */
+    std::shared_ptr<file_watch_state> watch_file(
+        const std::filesystem::path& path);
+
+    /**
+     * Watch the directories that hold the given file names for new,
+     * renamed, and deleted files.  Only the names that were not passed in
+     * the previous call are added.  The directories of names that are no
+     * longer passed are not watched anymore, unless an open file is in
+     * them.
+     *
+     * @param names The file names and the directories that hold them.
+     * @return True if the directories of all of the names are watched.
+     */
+    bool watch_names(
+        const std::map<std::string, std::filesystem::path>& names);
+
+    /**
+     * Make the next check_file() of every watched file return true.  This
+     * is used when the files are known to have changed and the
+     * notification might not have been read yet.
+     */
+    void force_check();
+
+    /**
+     * Check if a file needs to be polled for new data.  This consumes the
+     * change notification.
+     *
+     * @return True if the file might have changed since the last check.
+     */
+    bool check_file(file_watch_state& fws) const;
+
+    /**
+     * @return True if any watched file has changed since the last call.
+     */
+    bool consume_file_changes() { return this->fw_file_changes.exchange(false); }
+
+    /**
+     * @return True if the contents of any watched directory have changed
+     * since the last call.
+     */
+    bool consume_dir_changes() { return this->fw_dir_changes.exchange(false); }
+
+    /**
+     * @return True if the watcher thread is running and handling
+     * notifications.
+     */
+    bool is_active() const { return this->fw_active; }
+
+protected:
+    void* run() override;
+
+    void loop_body() override;
+
+    std::chrono::milliseconds compute_timeout(
+        mstime_t current_time) const override
+    {
+        return std::chrono::milliseconds{0};
+    }
+
+private:
+    struct watched_file {
+        std::filesystem::path wf_path;
+        std::vector<std::weak_ptr<file_watch_state>> wf_states;
+        /** The watch descriptor of the parent directory or -1. */
+        int wf_dir_wd{-1};
+    };
+
+    struct watched_dir {
+        std::filesystem::path wd_path;
+        /** The number of watched files in this directory. */
+        size_t wd_file_refs{0};
+        /** The number of names passed to watch_names() in this directory. */
+        size_t wd_name_refs{0};
+    };
+
+    /**
+     * Drop a reference to the directory of a file that is no longer
+     * watched and stop watching the directory if it was the last one.
+     */
+    void release_dir(int dir_wd);
+
+    /**
+     * Drop a reference to the directory of a name that is no longer
+     * watched and stop watching the directory if it was the last one.
+     */
+    void release_name(int dir_wd);
+
+    void remove_dir_if_unused(std::map<int, watched_dir>::iterator iter);
+
+    void drop_unused_watches();
+
+    std::atomic<bool> fw_active{false};
+    std::atomic<bool> fw_file_changes{false};
+    std::atomic<bool> fw_dir_changes{false};
+    std::chrono::steady_clock::time_point fw_last_cleanup;
+
+    std::mutex fw_mutex;
+    auto_fd fw_fd;
+    std::map<int, watched_file> fw_files;
+    std::map<int, watched_dir> fw_dirs;
+    /** The names passed to watch_names() and their directory watches. */
+    std::map<std::string, int> fw_names;
+};
+
+#endif
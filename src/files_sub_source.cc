@@ -586,6 +586,26 @@ files_sub_source::text_selection_changed(textview_curses& tc)
                                      .append(": ")
                                      .append(lnav::roles::number(fmt::format(
                                          FMT_STRING("{:L}"), lf->size()))));
+            const auto& activity = lf->get_activity();
+            if (activity.la_detect_lines > 0) {
+                details.emplace_back(
+                    attr_line_t()
+                        .append("Detection"_h3)
+                        .right_justify(NAME_WIDTH)
+                        .append(": ")
+                        .append(lnav::roles::number(fmt::format(
+                            FMT_STRING("{:L}"), activity.la_detect_lines)))
+                        .append(" lines in ")
+                        .append(humanize::time::duration::from_tv(
+                                    to_timeval(activity.la_detect_time))
+                                    .to_string())
+                        .append(" (")
+                        .append(lnav::roles::number(fmt::format(
+                            FMT_STRING("{:.1f}"),
+                            (double) activity.la_detect_time.count()
+                                / activity.la_detect_lines)))
+                        .append("us per line)"));
+            }
             if (format != nullptr && lf->size() > 0) {
                 details.emplace_back(attr_line_t()
                                          .append("Time Range"_h3)
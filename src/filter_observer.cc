@@ -29,6 +29,7 @@
 
 #include <algorithm>
 #include <iterator>
+#include <vector>
 
 #include "filter_observer.hh"
 
@@ -49,24 +50,52 @@ line_filter_observer::logline_new_lines(const logfile& lf,
 
     auto retval = false;
 
+    this->lfo_filter_state.ensure_filter_capacity(
+        this->lfo_filter_stack.index_limit());
     this->lfo_filter_state.resize(lf.size());
     if (this->lfo_filter_stack.empty()) {
         return retval;
     }
 
+    auto matcher = this->lfo_filter_stack.get_matcher();
+    filter_mask_t needed;
+    auto any_covered = false;
+    for (const auto& filter : this->lfo_filter_stack) {
+        if (filter->lf_deleted) {
+            continue;
+        }
+        if (offset >= (ssize_t) this->lfo_filter_state
+                          .tfs_filter_count[filter->get_index()])
+        {
+            needed.set(filter->get_index());
+            if (matcher->covers(*filter)) {
+                any_covered = true;
+            }
+        }
+    }
+
+    std::vector<bool> literal_hits;
+    filter_mask_t hits;
     for (; ll_begin != ll_end; ++ll_begin) {
         auto sbr_copy = sbr.clone();
         if (lf.get_format() != nullptr) {
             lf.get_format()->get_subline(*ll_begin, sbr_copy);
         }
         sbr_copy.erase_ansi();
+        if (any_covered) {
+            matcher->match(
+                sbr_copy.to_string_fragment(), needed, literal_hits, hits);
+        }
         for (const auto& filter : this->lfo_filter_stack) {
-            if (filter->lf_deleted) {
+            if (filter->lf_deleted || !needed.test(filter->get_index())) {
                 continue;
             }
-            if (offset >= (ssize_t) this->lfo_filter_state
-                              .tfs_filter_count[filter->get_index()])
-            {
+            if (matcher->covers(*filter)) {
+                auto matched = hits.test(filter->get_index());
+
+                filter->add_match(this->lfo_filter_state, ll_begin, matched);
+                retval = matched || retval;
+            } else {
                 retval = filter->add_line(
                              this->lfo_filter_state, ll_begin, sbr_copy)
                     || retval;
@@ -80,6 +109,8 @@ line_filter_observer::logline_new_lines(const logfile& lf,
 void
 line_filter_observer::logline_eof(const logfile& lf)
 {
+    this->lfo_filter_state.ensure_filter_capacity(
+        this->lfo_filter_stack.index_limit());
     this->lfo_filter_state.reserve(lf.size() + lf.estimated_remaining_lines());
     for (const auto& iter : this->lfo_filter_stack) {
         if (iter->lf_deleted) {
@@ -89,6 +120,25 @@ line_filter_observer::logline_eof(const logfile& lf)
     }
 }
 
+bool
+line_filter_observer::is_thread_safe() const
+{
+    // SQL filters are evaluated using the main database connection.
+    return std::none_of(
+        this->lfo_filter_stack.begin(),
+        this->lfo_filter_stack.end(),
+        [](const auto& filter) {
+            return !filter->lf_deleted
+                && filter->get_lang() == filter_lang_t::SQL;
+        });
+}
+
+bool
+line_filter_observer::is_line_content_needed() const
+{
+    return !this->lfo_filter_stack.empty();
+}
+
 size_t
 line_filter_observer::get_min_count(size_t max) const
 {
@@ -100,7 +150,7 @@ line_filter_observer::get_min_count(size_t max) const
         }
         retval = std::min(
             retval,
-            this->lfo_filter_state.tfs_filter_count[filter->get_index()]);
+            this->lfo_filter_state.get_filter_count(filter->get_index()));
     }
 
     return retval;
@@ -109,7 +159,7 @@ line_filter_observer::get_min_count(size_t max) const
 void
 line_filter_observer::clear_deleted_filter_state()
 {
-    uint32_t used_mask = 0;
+    filter_mask_t used_mask;
 
     for (auto& filter : this->lfo_filter_stack) {
         if (filter->lf_deleted) {
@@ -119,7 +169,7 @@ line_filter_observer::clear_deleted_filter_state()
                       filter->get_lang());
             continue;
         }
-        used_mask |= (1UL << filter->get_index());
+        used_mask.set(filter->get_index());
     }
     this->lfo_filter_state.clear_deleted_filter_state(used_mask);
 }
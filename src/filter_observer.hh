@@ -47,6 +47,8 @@ public:
 
     void logline_restart(const logfile& lf, file_size_t rollback_size) override
     {
+        this->lfo_filter_state.ensure_filter_capacity(
+            this->lfo_filter_stack.index_limit());
         for (const auto& filter : this->lfo_filter_stack) {
             filter->revert_to_last(this->lfo_filter_state, rollback_size);
         }
@@ -59,14 +61,18 @@ public:
 
     void logline_eof(const logfile& lf) override;
 
-    bool excluded(uint32_t filter_in_mask,
-                  uint32_t filter_out_mask,
+    bool is_thread_safe() const override;
+
+    bool is_line_content_needed() const override;
+
+    bool excluded(const filter_mask_t& filter_in_mask,
+                  const filter_mask_t& filter_out_mask,
                   size_t offset) const
     {
-        bool filtered_in = (filter_in_mask == 0)
-            || (this->lfo_filter_state.tfs_mask[offset] & filter_in_mask) != 0;
+        bool filtered_in = filter_in_mask.none()
+            || this->lfo_filter_state.line_intersects(offset, filter_in_mask);
         bool filtered_out
-            = (this->lfo_filter_state.tfs_mask[offset] & filter_out_mask) != 0;
+            = this->lfo_filter_state.line_intersects(offset, filter_out_mask);
         return !filtered_in || filtered_out;
     }
 
@@ -163,14 +163,8 @@ filter_sub_source::list_input_handle_key(listview_curses& lv, const ncinput& ch)
             auto& fs = tss->get_filters();
             auto filter_index = fs.next_index();
 
-            if (!filter_index) {
-                lnav_data.ld_filter_help_status_source.fss_error.set_value(
-                    "error: too many filters");
-                return true;
-            }
-
             auto ef = std::make_shared<empty_filter>(
-                text_filter::type_t::INCLUDE, *filter_index);
+                text_filter::type_t::INCLUDE, filter_index);
             fs.add_filter(ef);
             lv.set_selection(vis_line_t(fs.size() - 1));
             lv.reload_data();
@@ -195,14 +189,8 @@ filter_sub_source::list_input_handle_key(listview_curses& lv, const ncinput& ch)
             auto& fs = tss->get_filters();
             auto filter_index = fs.next_index();
 
-            if (!filter_index) {
-                lnav_data.ld_filter_help_status_source.fss_error.set_value(
-                    "error: too many filters");
-                return true;
-            }
-
             auto ef = std::make_shared<empty_filter>(
-                text_filter::type_t::EXCLUDE, *filter_index);
+                text_filter::type_t::EXCLUDE, filter_index);
             fs.add_filter(ef);
             lv.set_selection(vis_line_t(fs.size() - 1));
             lv.reload_data();
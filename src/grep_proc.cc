@@ -31,24 +31,36 @@
 
 #include "grep_proc.hh"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+
 #include <errno.h>
-#include <fcntl.h>
-#include <signal.h>
-#include <stdio.h>
 #include <string.h>
-#include <sys/wait.h>
 #include <unistd.h>
 
-#include "base/auto_pid.hh"
 #include "base/itertools.enumerate.hh"
 #include "base/lnav_log.hh"
-#include "base/opt_util.hh"
-#include "base/string_util.hh"
+#include "base/worker_pool.hh"
 #include "config.h"
-#include "lnav_util.hh"
-#include "scn/scan.h"
 #include "vis_line.hh"
 
+namespace {
+
+void
+write_wakeup(auto_pipe& pipe)
+{
+    static const char WAKEUP = '\0';
+
+    // A full pipe is already readable, so EAGAIN can be ignored.
+    if (write(pipe.write_end(), &WAKEUP, 1) < 0 && errno != EAGAIN) {
+        log_error("unable to wake up grep_proc: %s", strerror(errno));
+    }
+}
+
+}  // namespace
+
 template<typename LineType>
 grep_proc<LineType>::grep_proc(std::shared_ptr<lnav::pcre2pp::code> code,
                                grep_proc_source<LineType>& gps,
@@ -73,15 +85,9 @@ grep_proc<LineType>::start()
 {
     require(this->invariant());
 
-    if (this->gp_sink) {
-        // XXX hack to make sure threads used by line_buffer are not active
-        // before the fork.
-        this->gp_sink->grep_quiesce();
-    }
-
     log_info(
         "grep_proc(%p): start with highest %d", this, this->gp_highest_line);
-    if (this->gp_child_started || this->gp_queue.empty()) {
+    if (this->gp_started || this->gp_queue.empty()) {
         log_debug("grep_proc(%p): nothing to do?", this);
         return;
     }
@@ -90,123 +96,88 @@ grep_proc<LineType>::start()
         log_info("  queue[%d]: [%d:%d)", index, elem.first, elem.second);
     }
 
-    auto_pipe in_pipe(STDIN_FILENO);
-    auto_pipe out_pipe(STDOUT_FILENO);
-    auto_pipe err_pipe(STDERR_FILENO);
-
-    /* Get ahold of some pipes for stdout and stderr. */
-    if (out_pipe.open() < 0) {
+    auto wakeup_pipe = std::make_shared<auto_pipe>();
+    if (wakeup_pipe->open() < 0) {
         throw error(errno);
     }
+    wakeup_pipe->read_end().non_blocking();
+    wakeup_pipe->write_end().non_blocking();
 
-    if (err_pipe.open() < 0) {
-        throw error(errno);
-    }
-
-    if ((this->gp_child = fork()) < 0) {
-        throw error(errno);
-    }
-
-    in_pipe.after_fork(this->gp_child);
-    out_pipe.after_fork(this->gp_child);
-    err_pipe.after_fork(this->gp_child);
+    this->gp_wakeup_pipe = std::move(wakeup_pipe);
+    this->gp_started = true;
+    this->gp_started_count = this->gp_queue.size();
+    this->gp_started_queue = std::move(this->gp_queue);
+    this->gp_queue.clear();
+    this->wakeup();
 
-    if (this->gp_child != 0) {
-        log_perror(fcntl(out_pipe.read_end(), F_SETFL, O_NONBLOCK));
-        log_perror(fcntl(out_pipe.read_end(), F_SETFD, 1));
-        this->gp_line_buffer.set_fd(out_pipe.read_end());
+    ensure(this->invariant());
+}
 
-        log_perror(fcntl(err_pipe.read_end(), F_SETFL, O_NONBLOCK));
-        log_perror(fcntl(err_pipe.read_end(), F_SETFD, 1));
-        require(this->gp_err_pipe.get() == -1);
-        this->gp_err_pipe = std::move(err_pipe.read_end());
-        this->gp_child_started = true;
-        this->gp_child_queue_size = this->gp_queue.size();
+template<typename LineType>
+void
+grep_proc<LineType>::wakeup()
+{
+    write_wakeup(*this->gp_wakeup_pipe);
+}
 
-        this->gp_queue.clear();
+template<typename LineType>
+std::shared_ptr<typename grep_proc<LineType>::chunk>
+grep_proc<LineType>::read_chunk()
+{
+    auto& ar = this->gp_active.value();
+    auto retval = std::make_shared<chunk>();
+    bool eof = false;
+
+    retval->c_lines.reserve(CHUNK_SIZE);
+    retval->c_values.reserve(CHUNK_SIZE);
+    while (ar.ar_line != -1 && (ar.ar_stop == -1 || ar.ar_line < ar.ar_stop)
+           && retval->c_lines.size() < CHUNK_SIZE)
+    {
+        std::string value;
+        auto val_res = this->gp_source.grep_value_for_line(ar.ar_line, value);
 
-        log_debug("grep_proc(%p): started child %d", this, this->gp_child);
-        return;
+        this->gp_source.grep_next_line(ar.ar_line);
+        if (!val_res) {
+            eof = true;
+            break;
+        }
+        retval->c_lines.emplace_back(ar.ar_line - LineType(1));
+        retval->c_values.emplace_back(std::move(value));
+        retval->c_valid_utf8.emplace_back(
+            val_res.value().li_utf8_scan_result.is_valid());
     }
 
-    /* In the child... */
-    lnav::pid::in_child = true;
-
-    /*
-     * Restore the default signal handlers so we don't hang around
-     * forever if there is a problem.
-     */
-    signal(SIGINT, SIG_DFL);
-    signal(SIGTERM, SIG_DFL);
-
-    this->child_init();
-
-    this->child_loop();
+    if (eof || ar.ar_line == -1
+        || (ar.ar_stop != -1 && ar.ar_line >= ar.ar_stop))
+    {
+        if (ar.ar_line != -1 && ar.ar_stop == -1) {
+            // When scanning to the end of the source, we need to remember
+            // the highest line that was seen so that the next request that
+            // continues from the end works properly.
+            this->gp_highest_line = ar.ar_line - LineType(1);
+        }
+        this->gp_active = std::nullopt;
+    }
 
-    _exit(0);
+    return retval;
 }
 
 template<typename LineType>
 void
-grep_proc<LineType>::child_loop()
+grep_proc<LineType>::deliver_chunks()
 {
-    auto md = lnav::pcre2pp::match_data::unitialized();
-    char outbuf[BUFSIZ * 2];
-    std::string line_value;
-
-    /* Make sure buffering is on, not sure of the state in the parent. */
-    if (setvbuf(stdout, outbuf, _IOFBF, BUFSIZ * 2) < 0) {
-        perror("setvbuf");
-    }
-    lnav_log_file
-        = make_optional_from_nullable(fopen("/tmp/lnav.grep.err", "a"));
-    line_value.reserve(BUFSIZ * 2);
-    while (!this->gp_queue.empty()) {
-        LineType start_line = this->gp_queue.front().first;
-        LineType stop_line = this->gp_queue.front().second;
-        bool done = false;
-        LineType line;
-
-        this->gp_queue.pop_front();
-        for (line = this->gp_source.grep_initial_line(start_line,
-                                                      this->gp_highest_line);
-             line != -1 && (stop_line == -1 || line < stop_line) && !done;
-             this->gp_source.grep_next_line(line))
-        {
-            line_value.clear();
-            auto val_res
-                = this->gp_source.grep_value_for_line(line, line_value);
-            if (!val_res) {
-                done = true;
-            } else {
-                auto li = val_res.value();
-                uint32_t re_opts = 0;
-                if (li.li_utf8_scan_result.is_valid()) {
-                    re_opts = PCRE2_NO_UTF_CHECK;
-                }
-                auto match_res = this->gp_pcre->capture_from(line_value)
-                                     .into(md)
-                                     .matches(re_opts)
-                                     .ignore_error();
-                if (match_res) {
-                    fmt::println(stdout, FMT_STRING("{}"), (int) line);
-                }
-            }
+    while (!this->gp_pending.empty() && this->gp_pending.front()->c_done) {
+        auto ch = std::move(this->gp_pending.front());
 
-            if (((line + 1) % 10000) == 0) {
-                /* Periodically flush the buffer so the parent sees progress */
-                this->child_batch();
-            }
+        this->gp_pending.pop_front();
+        if (this->gp_sink == nullptr) {
+            continue;
         }
-
-        if (line != -1 && stop_line == -1) {
-            // When scanning to the end of the source, we need to return the
-            // highest line that was seen so that the next request that
-            // continues from the end works properly.
-            fmt::println(stdout, FMT_STRING("h{}"), line - 1);
+        for (size_t lpc = 0; lpc < ch->c_matched.size(); lpc++) {
+            if (ch->c_matched[lpc]) {
+                this->gp_sink->grep_match(*this, ch->c_lines[lpc]);
+            }
         }
-        this->gp_highest_line = line - 1_vl;
-        this->child_term();
     }
 }
 
@@ -214,33 +185,24 @@ template<typename LineType>
 void
 grep_proc<LineType>::cleanup()
 {
-    if (this->gp_child != -1 && this->gp_child != 0) {
-        int status = 0;
-
-        kill(this->gp_child, SIGTERM);
-        while (waitpid(this->gp_child, &status, 0) < 0 && (errno == EINTR)) {
-            ;
-        }
-        require(!WIFSIGNALED(status) || WTERMSIG(status) != SIGABRT);
-
-        log_info("cleaned up grep child %d", this->gp_child);
-        this->gp_child = -1;
-        this->gp_child_started = false;
-
+    if (this->gp_started) {
+        log_info("grep_proc(%p): finished", this);
+        this->gp_started = false;
+        this->gp_started_queue.clear();
+        this->gp_active = std::nullopt;
+        // Any tasks that are still running hold on to their chunk and the
+        // pipe, so they can be dropped here.
+        this->gp_pending.clear();
+        this->gp_wakeup_pipe.reset();
+
+        auto started_count = std::exchange(this->gp_started_count, 0);
         if (this->gp_sink) {
-            for (size_t lpc = 0; lpc < this->gp_child_queue_size; lpc++) {
+            for (size_t lpc = 0; lpc < started_count; lpc++) {
                 this->gp_sink->grep_end(*this);
             }
         }
     }
 
-    if (this->gp_err_pipe != -1) {
-        this->gp_err_pipe.reset();
-    }
-
-    this->gp_pipe_range.clear();
-    this->gp_line_buffer.reset();
-
     ensure(this->invariant());
 
     if (!this->gp_queue.empty()) {
@@ -248,108 +210,86 @@ grep_proc<LineType>::cleanup()
     }
 }
 
-template<typename LineType>
-void
-grep_proc<LineType>::dispatch_line(const string_fragment& line)
-{
-    require(line.is_valid());
-
-    auto sv = line.to_string_view();
-    auto h_scan_res = scn::scan<int>(sv, "h{}");
-    if (h_scan_res) {
-        this->gp_highest_line = LineType{h_scan_res->value()};
-    } else {
-        auto ll_scan_res = scn::scan<int>(sv, "{}");
-        if (ll_scan_res) {
-            this->gp_last_line = LineType{ll_scan_res->value()};
-            /* Starting a new line with matches. */
-            ensure(this->gp_last_line >= 0);
-            /* Pass the match offsets to the sink delegate. */
-            if (this->gp_sink != nullptr) {
-                this->gp_sink->grep_match(*this, this->gp_last_line);
-            }
-        } else {
-            log_error("bad line from child -- %s", line);
-        }
-    }
-}
-
 template<typename LineType>
 void
 grep_proc<LineType>::check_poll_set(const std::vector<struct pollfd>& pollfds)
 {
     require(this->invariant());
 
-    if (this->gp_err_pipe != -1 && pollfd_ready(pollfds, this->gp_err_pipe)) {
-        char buffer[1024 + 1];
-        ssize_t rc;
-
-        rc = read(this->gp_err_pipe, buffer, sizeof(buffer) - 1);
-        if (rc > 0) {
-            static const char* PREFIX = ": ";
-
-            buffer[rc] = '\0';
-            if (strncmp(buffer, PREFIX, strlen(PREFIX)) == 0) {
-                char* lf;
-
-                if ((lf = strchr(buffer, '\n')) != nullptr) {
-                    *lf = '\0';
-                }
-                if (this->gp_control != nullptr) {
-                    this->gp_control->grep_error(&buffer[strlen(PREFIX)]);
-                }
-            }
-        } else if (rc == 0) {
-            this->gp_err_pipe.reset();
-        }
+    if (!this->gp_started
+        || !pollfd_ready(pollfds, this->gp_wakeup_pipe->read_end()))
+    {
+        return;
     }
 
-    if (this->gp_line_buffer.get_fd() != -1
-        && pollfd_ready(pollfds, this->gp_line_buffer.get_fd()))
+    // Drain the pipe before looking at the chunks so that a chunk that is
+    // finished after this point wakes us up again.
+    char buffer[64];
+    while (read(this->gp_wakeup_pipe->read_end(), buffer, sizeof(buffer)) > 0)
     {
-        try {
-            static const int MAX_LOOPS = 100;
-
-            int loop_count = 0;
-            bool drained = false;
+    }
 
-            while (loop_count < MAX_LOOPS) {
-                auto load_result
-                    = this->gp_line_buffer.load_next_line(this->gp_pipe_range);
+    this->deliver_chunks();
 
-                if (load_result.isErr()) {
-                    log_error("failed to read from grep_proc child: %s",
-                              load_result.unwrapErr().c_str());
-                    break;
-                }
+    auto& pool = lnav::worker_pool::singleton();
+    const auto max_pending = pool.size() * CHUNKS_PER_THREAD;
+    const auto deadline = std::chrono::steady_clock::now() + TIME_SLICE;
+    while (this->gp_pending.size() < max_pending
+           && std::chrono::steady_clock::now() < deadline)
+    {
+        if (!this->gp_active) {
+            if (this->gp_started_queue.empty()) {
+                break;
+            }
 
-                auto li = load_result.unwrap();
+            auto [start_line, stop_line] = this->gp_started_queue.front();
+            this->gp_started_queue.pop_front();
+            this->gp_active = active_request{
+                this->gp_source.grep_initial_line(start_line,
+                                                  this->gp_highest_line),
+                stop_line,
+            };
+        }
 
-                if (li.li_file_range.empty()) {
-                    drained = true;
-                    break;
-                }
+        auto ch = this->read_chunk();
+        if (ch->c_lines.empty()) {
+            continue;
+        }
 
-                this->gp_pipe_range = li.li_file_range;
-                this->gp_line_buffer.read_range(li.li_file_range)
-                    .then([this](auto sbr) {
-                        sbr.rtrim(is_line_ending);
-                        this->dispatch_line(sbr.to_string_fragment());
-                    });
+        this->gp_pending.emplace_back(ch);
+        pool.submit([ch, code = this->gp_pcre, pipe = this->gp_wakeup_pipe]() {
+            auto md = code->create_match_data();
 
-                loop_count += 1;
+            ch->c_matched.resize(ch->c_values.size());
+            for (size_t lpc = 0; lpc < ch->c_values.size(); lpc++) {
+                uint32_t re_opts = 0;
+                if (ch->c_valid_utf8[lpc]) {
+                    re_opts = PCRE2_NO_UTF_CHECK;
+                }
+                auto match_res = code->capture_from(ch->c_values[lpc])
+                                     .into(md)
+                                     .matches(re_opts)
+                                     .ignore_error();
+                ch->c_matched[lpc] = match_res.has_value();
             }
+            ch->c_done = true;
+            write_wakeup(*pipe);
+        });
+    }
 
-            if (this->gp_sink != nullptr) {
-                this->gp_sink->grep_end_batch(*this);
-            }
+    if (this->gp_sink != nullptr) {
+        this->gp_sink->grep_end_batch(*this);
+    }
 
-            if (drained && this->gp_line_buffer.is_pipe_closed()) {
-                this->cleanup();
-            }
-        } catch (line_buffer::error& e) {
-            this->cleanup();
-        }
+    if (!this->gp_active && this->gp_started_queue.empty()
+        && this->gp_pending.empty())
+    {
+        this->cleanup();
+    } else if ((this->gp_active || !this->gp_started_queue.empty())
+               && this->gp_pending.size() < max_pending)
+    {
+        // There are lines left to read, so come back on the next pass.
+        this->wakeup();
     }
 
     ensure(this->invariant());
@@ -373,12 +313,9 @@ template<typename LineType>
 void
 grep_proc<LineType>::update_poll_set(std::vector<struct pollfd>& pollfds)
 {
-    if (this->gp_line_buffer.get_fd() != -1) {
+    if (this->gp_wakeup_pipe != nullptr) {
         pollfds.push_back(
-            (struct pollfd) {this->gp_line_buffer.get_fd(), POLLIN, 0});
-    }
-    if (this->gp_err_pipe.get() != -1) {
-        pollfds.push_back((struct pollfd) {this->gp_err_pipe, POLLIN, 0});
+            (struct pollfd) {this->gp_wakeup_pipe->read_end(), POLLIN, 0});
     }
 }
 
@@ -32,8 +32,12 @@
 #ifndef grep_proc_hh
 #define grep_proc_hh
 
+#include <atomic>
+#include <chrono>
 #include <deque>
 #include <exception>
+#include <memory>
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -106,8 +110,6 @@ class grep_proc_sink {
 public:
     virtual ~grep_proc_sink() = default;
 
-    virtual void grep_quiesce() {}
-
     /** Called at the start of a new grep run. */
     virtual void grep_begin(grep_proc<LineType>& gp,
                             LineType start,
@@ -133,11 +135,14 @@ public:
 };
 
 /**
- * "Grep" that runs in a separate process so it doesn't stall user-interaction.
- * This class manages the child process and any interactions between the parent
- * and child.  The source data to be matched comes from the grep_proc_source
- * delegate and the results are sent to the grep_proc_sink delegate in the
- * parent process.
+ * "Grep" that runs in the background so it doesn't stall user-interaction.
+ * The sources are not thread-safe, so the lines are read from the
+ * grep_proc_source delegate on the main thread in chunks and the chunks are
+ * matched by a persistent pool of threads.  Reading stops when the time
+ * slice for a pass through the event loop is used up.  The pool signals the
+ * wakeup pipe as chunks are finished and the matches are sent to the
+ * grep_proc_sink delegate in line order, so the main thread never waits on
+ * the pool.
  *
  * Note: The "grep" executable is not actually used, instead we use the pcre(3)
  * library directly.
@@ -154,7 +159,7 @@ public:
 
     /**
      * Construct a grep_proc object.  You must call the start() method
-     * to fork off the child process and begin processing.
+     * to begin processing.
      *
      * @param code The pcre code to run over the lines of input.
      * @param gps The source of the data to match.
@@ -218,63 +223,84 @@ public:
     /** Check the invariants for this object. */
     bool invariant()
     {
-        if (this->gp_child_started) {
-            require(this->gp_child > 0);
-            require(this->gp_line_buffer.get_fd() != -1);
+        if (this->gp_started) {
+            require(this->gp_wakeup_pipe != nullptr);
+            require(this->gp_wakeup_pipe->read_end() != -1);
         } else {
-            /* require(this->gp_child == -1); XXX doesnt work with static destr
-             */
-            require(this->gp_line_buffer.get_fd() == -1);
+            require(this->gp_wakeup_pipe == nullptr);
+            require(!this->gp_active);
+            require(this->gp_pending.empty());
         }
 
         return true;
     }
 
 protected:
-    /**
-     * Dispatch a line received from the child.
-     */
-    void dispatch_line(const string_fragment& line);
+    /** The number of lines in a chunk that is matched by one task. */
+    static constexpr size_t CHUNK_SIZE = 256;
+
+    /** The number of chunks that can be in flight per pool thread. */
+    static constexpr size_t CHUNKS_PER_THREAD = 4;
+
+    /** The time spent reading lines each time through the event loop. */
+    static constexpr auto TIME_SLICE = std::chrono::milliseconds(50);
+
+    struct chunk {
+        std::vector<LineType> c_lines;
+        std::vector<std::string> c_values;
+        std::vector<bool> c_valid_utf8;
+        std::vector<char> c_matched;
+        std::atomic<bool> c_done{false};
+    };
 
     /**
-     * Free any resources used by the object and make sure the child has been
-     * terminated.
+     * Read the next chunk of lines for the active request.  The active
+     * request is cleared when all of its lines have been read.
      */
-    void cleanup();
+    std::shared_ptr<chunk> read_chunk();
 
-    void child_loop();
+    /** Send the matches in the finished chunks at the front of the queue. */
+    void deliver_chunks();
 
-    virtual void child_init() {};
+    /** Make the wakeup pipe readable so the event loop calls us again. */
+    void wakeup();
 
-    virtual void child_batch() { fflush(stdout); }
+    /**
+     * Free any resources used by the object and notify the sink of the end
+     * of any requests that were started.
+     */
+    void cleanup();
 
-    virtual void child_term() { fflush(stdout); }
+    struct active_request {
+        LineType ar_line;
+        LineType ar_stop;
+    };
 
     std::shared_ptr<lnav::pcre2pp::code> gp_pcre;
     grep_proc_source<LineType>& gp_source; /*< The data source delegate. */
 
-    auto_fd gp_err_pipe; /*< Standard error from the child. */
-    line_buffer gp_line_buffer; /*< Standard out from the child. */
-    file_range gp_pipe_range;
+    /**
+     * Pipe that is made readable while there are lines left to read and
+     * when the pool finishes a chunk.  It is shared with the pool tasks so
+     * that it stays open until the last one is done.
+     */
+    std::shared_ptr<auto_pipe> gp_wakeup_pipe;
 
-    pid_t gp_child{-1}; /*<
-                         * The child's pid or zero in the
-                         * child.
-                         */
-    bool gp_child_started{false}; /*< True if the child was start()'d. */
-    size_t gp_child_queue_size{0};
+    bool gp_started{false}; /*< True if the requests were start()'d. */
+    size_t gp_started_count{0};
 
     /** The queue of search requests. */
     std::deque<std::pair<LineType, LineType> > gp_queue;
-    LineType gp_last_line{0}; /*<
-                               * The last line number received from
-                               * the child.  For multiple matches,
-                               * the line number is only sent once.
-                               */
+    /** The requests that were started and are being processed. */
+    std::deque<std::pair<LineType, LineType> > gp_started_queue;
+    /** The request that is currently being read. */
+    std::optional<active_request> gp_active;
+    /** The chunks that were handed to the pool, in line order. */
+    std::deque<std::shared_ptr<chunk>> gp_pending;
     LineType gp_highest_line; /*< The highest numbered line processed
-                               * by the grep child process.  This
-                               * value is used when the start line
-                               * for a queued request is -1.
+                               * by a search to the end of the source.
+                               * This value is used when the start
+                               * line for a queued request is -1.
                                */
     grep_proc_sink<LineType>* gp_sink{nullptr}; /*< The sink delegate. */
     grep_proc_control* gp_control{nullptr}; /*< The control delegate. */
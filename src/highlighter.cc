@@ -27,6 +27,8 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <algorithm>
+
 #include "highlighter.hh"
 
 #include "config.h"
@@ -115,3 +117,51 @@ highlighter::annotate(attr_line_t& al, const line_range& lr) const
             }
         });
 }
+
+void
+highlight_prefilter::add(const highlighter& hl)
+{
+    static constexpr size_t MAX_LITERALS_PER_HIGHLIGHTER = 3;
+
+    entry ent;
+
+    ent.e_regex = hl.h_regex;
+    if (hl.h_regex) {
+        auto lits = hl.h_regex->get_required_literals();
+
+        std::stable_sort(lits.begin(),
+                         lits.end(),
+                         [](const auto& lhs, const auto& rhs) {
+                             return lhs.size() > rhs.size();
+                         });
+        for (const auto& lit : lits) {
+            if (ent.e_literals.size() >= MAX_LITERALS_PER_HIGHLIGHTER
+                || lit.size() < 2)
+            {
+                break;
+            }
+            ent.e_literals.emplace_back(
+                this->hp_literals.add(string_fragment::from_str(lit)));
+        }
+    }
+    this->hp_entries.emplace_back(std::move(ent));
+}
+
+bool
+highlight_prefilter::may_match(size_t index)
+{
+    const auto& ent = this->hp_entries[index];
+
+    if (ent.e_literals.empty()) {
+        return true;
+    }
+
+    if (!this->hp_scanned) {
+        this->hp_literals.find_all(this->hp_line, this->hp_hits);
+        this->hp_scanned = true;
+    }
+
+    return std::all_of(ent.e_literals.begin(),
+                       ent.e_literals.end(),
+                       [this](auto id) { return this->hp_hits[id]; });
+}
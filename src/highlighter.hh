@@ -35,7 +35,9 @@
 #include <memory>
 #include <set>
 #include <string>
+#include <vector>
 
+#include "base/aho_corasick.hh"
 #include "base/attr_line.hh"
 #include "base/intern_string.hh"
 #include "base/string_attr_type.hh"
@@ -114,4 +116,75 @@ struct highlighter {
     bool h_nestable{true};
 };
 
+/**
+ * Decides which of a sequence of highlighters could possibly match a line
+ * by scanning the line once for the literals that each highlighter's
+ * pattern requires.  Highlighters whose literals are not all present can
+ * be skipped without running their regex.
+ */
+class highlight_prefilter {
+public:
+    /**
+     * @return True if the prefilter was built for the highlighters in the
+     *   given map, in the same order.
+     */
+    template<typename M>
+    bool is_for(const M& hl_map) const
+    {
+        if (hl_map.size() != this->hp_entries.size()) {
+            return false;
+        }
+
+        auto iter = this->hp_entries.begin();
+        for (const auto& hl_pair : hl_map) {
+            if (hl_pair.second.h_regex != iter->e_regex) {
+                return false;
+            }
+            ++iter;
+        }
+
+        return true;
+    }
+
+    /** Build the prefilter for the highlighters in the given map. */
+    template<typename M>
+    void rebuild(const M& hl_map)
+    {
+        this->hp_entries.clear();
+        this->hp_literals = lnav::aho_corasick{};
+        for (const auto& hl_pair : hl_map) {
+            this->add(hl_pair.second);
+        }
+        this->hp_literals.compile();
+    }
+
+    /** Start checking a new line, the scan is done on the first need. */
+    void start_line(string_fragment line)
+    {
+        this->hp_line = line;
+        this->hp_scanned = false;
+    }
+
+    /**
+     * @param index The position of the highlighter in the map that was
+     *   used to build the prefilter.
+     * @return False if the highlighter cannot match the current line.
+     */
+    bool may_match(size_t index);
+
+private:
+    void add(const highlighter& hl);
+
+    struct entry {
+        std::shared_ptr<lnav::pcre2pp::code> e_regex;
+        std::vector<lnav::aho_corasick::literal_id> e_literals;
+    };
+
+    lnav::aho_corasick hp_literals;
+    std::vector<entry> hp_entries;
+    string_fragment hp_line;
+    bool hp_scanned{false};
+    std::vector<bool> hp_hits;
+};
+
 #endif
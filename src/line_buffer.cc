@@ -41,8 +41,13 @@
 #    include <bzlib.h>
 #endif
 
+#ifdef HAVE_ZSTD_H
+#    include <zstd.h>
+#endif
+
 #include <algorithm>
 #include <set>
+#include <thread>
 
 #include "base/auto_mem.hh"
 #include "base/auto_pid.hh"
@@ -66,6 +71,7 @@ static const ssize_t INITIAL_REQUEST_SIZE = 16 * 1024;
 static const ssize_t DEFAULT_INCREMENT = 128 * 1024;
 static const ssize_t INITIAL_COMPRESSED_BUFFER_SIZE = 5 * 1024 * 1024;
 static const ssize_t MAX_COMPRESSED_BUFFER_SIZE = 32 * 1024 * 1024;
+static const ssize_t BLOCK_FILL_SIZE = 1024 * 1024;
 
 const ssize_t line_buffer::DEFAULT_LINE_BUFFER_SIZE = 256 * 1024;
 const ssize_t line_buffer::MAX_LINE_BUFFER_SIZE
@@ -86,51 +92,6 @@ force_linking(io_looper_tag anno)
 }
 }  // namespace injector
 
-/*
- * XXX REMOVE ME
- *
- * The stock bzipped file code does not use pread, so we need to use a lock to
- * get exclusive access to the file.  In the future, we should just rewrite
- * the bzipped file code to use pread.
- */
-class lock_hack {
-public:
-    class guard {
-    public:
-        guard() : g_lock(singleton()) { this->g_lock.lock(); }
-
-        ~guard() { this->g_lock.unlock(); }
-
-    private:
-        lock_hack& g_lock;
-    };
-
-    static lock_hack& singleton()
-    {
-        static lock_hack retval;
-
-        return retval;
-    }
-
-    void lock() { lockf(this->lh_fd, F_LOCK, 0); }
-
-    void unlock() { lockf(this->lh_fd, F_ULOCK, 0); }
-
-private:
-    lock_hack()
-    {
-        char lockname[64];
-
-        snprintf(lockname, sizeof(lockname), "/tmp/lnav.%d.lck", getpid());
-        this->lh_fd = open(lockname, O_CREAT | O_RDWR, 0600);
-        log_perror(fcntl(this->lh_fd, F_SETFD, FD_CLOEXEC));
-        unlink(lockname);
-    }
-
-    auto_fd lh_fd;
-};
-/* XXX END */
-
 #define Z_BUFSIZE      65536U
 #define SYNCPOINT_SIZE (1024 * 1024)
 line_buffer::gz_indexed::gz_indexed()
@@ -372,9 +333,943 @@ line_buffer::gz_indexed::read(void* buf, size_t offset, size_t size)
     return bytes;
 }
 
+static constexpr ssize_t BLOCK_SCAN_SIZE = 1024 * 1024;
+/** The amount of decompressed block data to keep around for reuse. */
+static constexpr size_t MAX_CACHED_SIZE = 64 * 1024 * 1024;
+/** zstd frames larger than this are streamed instead of decoded at once. */
+static constexpr file_ssize_t MAX_WHOLE_BLOCK_SIZE = 16 * 1024 * 1024;
+
+static constexpr uint64_t BZ_BLOCK_MAGIC = 0x314159265359ULL;
+static constexpr uint64_t BZ_EOS_MAGIC = 0x177245385090ULL;
+static constexpr uint64_t BZ_MAGIC_MASK = 0xffffffffffffULL;
+static constexpr file_off_t BZ_MAGIC_BITS = 48;
+
+static constexpr uint32_t ZSTD_FRAME_MAGIC = 0xfd2fb528U;
+static constexpr uint32_t ZSTD_SKIPPABLE_MAGIC = 0x184d2a50U;
+static constexpr uint32_t ZSTD_SKIPPABLE_MASK = 0xfffffff0U;
+static constexpr uint32_t ZSTD_SEEK_TABLE_MAGIC = 0x184d2a5eU;
+static constexpr uint32_t ZSTD_SEEKABLE_MAGIC = 0x8f92eab1U;
+static constexpr file_ssize_t ZSTD_SEEK_FOOTER_SIZE = 9;
+
+static uint64_t
+read_le(const unsigned char* buf, size_t len)
+{
+    uint64_t retval = 0;
+
+    for (size_t lpc = len; lpc > 0; lpc--) {
+        retval = (retval << 8) | buf[lpc - 1];
+    }
+    return retval;
+}
+
+static ssize_t
+pread_fully(int fd, void* buf, size_t size, file_off_t off)
+{
+    size_t total = 0;
+
+    while (total < size) {
+        auto rc = pread(fd, (char*) buf + total, size - total, off + total);
+        if (rc < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return rc;
+        }
+        if (rc == 0) {
+            break;
+        }
+        total += rc;
+    }
+
+    return total;
+}
+
+static size_t
+max_parallel_blocks()
+{
+    static const size_t retval
+        = std::clamp(std::thread::hardware_concurrency(), 1U, 8U);
+
+    return retval;
+}
+
+/**
+ * A bzip2 block can start at any bit offset, so a byte-at-a-time scan
+ * checks all eight shifts of the mark.  The byte preceding the last byte
+ * of a mark is always fully covered by the mark, so this table is used to
+ * quickly find the shifts worth checking for a given byte value.
+ */
+static const std::array<uint8_t, 256>&
+bz_mark_table()
+{
+    static const auto retval = [] {
+        std::array<uint8_t, 256> table{};
+
+        for (int shift = 0; shift < 8; shift++) {
+            for (auto magic : {BZ_BLOCK_MAGIC, BZ_EOS_MAGIC}) {
+                table[(magic >> (8 - shift)) & 0xff] |= 1U << shift;
+            }
+        }
+        return table;
+    }();
+
+    return retval;
+}
+
+using block_decode_result = Result<std::vector<char>, std::string>;
+
+#ifdef HAVE_BZLIB_H
+/**
+ * Decompress a single bzip2 block.  libbz2 can only decode whole streams,
+ * so the bits of the block are shifted to a byte boundary and wrapped in a
+ * stream header and an end-of-stream mark.  The combined CRC of a stream
+ * with one block is the same as the block's CRC.
+ */
+static block_decode_result
+bz_decode_block(int fd, char level, file_off_t start_bit, file_off_t end_bit)
+{
+    static constexpr file_off_t HEADER_BITS = 4 * 8;
+    static constexpr file_off_t CRC_BITS = 32;
+
+    auto nbits = end_bit - start_bit;
+    if (nbits < BZ_MAGIC_BITS + CRC_BITS) {
+        return Err(fmt::format(
+            FMT_STRING("bzip2 block at bit offset {} is too short"),
+            start_bit));
+    }
+
+    auto start_byte = start_bit / 8;
+    std::vector<unsigned char> in((end_bit + 7) / 8 - start_byte);
+    auto rc = pread_fully(fd, in.data(), in.size(), start_byte);
+    if (rc != (ssize_t) in.size()) {
+        return Err(
+            fmt::format(FMT_STRING("unable to read bzip2 block at {} -- {}"),
+                        start_byte,
+                        rc < 0 ? strerror(errno) : "unexpected end-of-file"));
+    }
+
+    auto nbytes = (nbits + 7) / 8;
+    auto shift = start_bit % 8;
+    std::vector<unsigned char> strm_in(4 + nbytes + 11);
+    strm_in[0] = 'B';
+    strm_in[1] = 'Z';
+    strm_in[2] = 'h';
+    strm_in[3] = level;
+    for (file_off_t lpc = 0; lpc < nbytes; lpc++) {
+        unsigned int value = in[lpc] << shift;
+
+        if (shift > 0 && lpc + 1 < (file_off_t) in.size()) {
+            value |= in[lpc + 1] >> (8 - shift);
+        }
+        strm_in[4 + lpc] = value & 0xff;
+    }
+    if (nbits % 8) {
+        strm_in[4 + nbytes - 1] &= 0xff << (8 - nbits % 8);
+    }
+
+    auto get_bits = [&strm_in](file_off_t off, int count) {
+        uint64_t retval = 0;
+
+        for (int lpc = 0; lpc < count; lpc++, off++) {
+            retval = (retval << 1) | ((strm_in[off / 8] >> (7 - off % 8)) & 1);
+        }
+        return retval;
+    };
+    auto bit_pos = HEADER_BITS + nbits;
+    auto put_bits = [&strm_in, &bit_pos](uint64_t value, int count) {
+        for (int lpc = count - 1; lpc >= 0; lpc--, bit_pos++) {
+            if ((value >> lpc) & 1) {
+                strm_in[bit_pos / 8] |= 0x80 >> (bit_pos % 8);
+            }
+        }
+    };
+
+    put_bits(BZ_EOS_MAGIC, BZ_MAGIC_BITS);
+    put_bits(get_bits(HEADER_BITS + BZ_MAGIC_BITS, CRC_BITS), CRC_BITS);
+    strm_in.resize((bit_pos + 7) / 8);
+
+    bz_stream strm{};
+    if (BZ2_bzDecompressInit(&strm, 0, 0) != BZ_OK) {
+        throw std::bad_alloc();
+    }
+
+    std::vector<char> retval(1024 * 1024);
+    size_t produced = 0;
+    int bz_rc;
+
+    strm.next_in = (char*) strm_in.data();
+    strm.avail_in = strm_in.size();
+    while (true) {
+        if (produced == retval.size()) {
+            retval.resize(retval.size() * 2);
+        }
+        strm.next_out = retval.data() + produced;
+        strm.avail_out = retval.size() - produced;
+        bz_rc = BZ2_bzDecompress(&strm);
+        produced = retval.size() - strm.avail_out;
+        if (bz_rc != BZ_OK || (strm.avail_in == 0 && strm.avail_out > 0)) {
+            break;
+        }
+    }
+    BZ2_bzDecompressEnd(&strm);
+
+    if (bz_rc != BZ_STREAM_END) {
+        return Err(fmt::format(
+            FMT_STRING("bzip2 error ({}) in block at bit offset {}"),
+            bz_rc,
+            start_bit));
+    }
+
+    retval.resize(produced);
+    return Ok(std::move(retval));
+}
+#endif
+
+#ifdef HAVE_ZSTD_H
+static block_decode_result
+zstd_decode_frame(int fd, file_off_t start, file_off_t end, size_t out_size)
+{
+    std::vector<char> in(end - start);
+    auto rc = pread_fully(fd, in.data(), in.size(), start);
+    if (rc != (ssize_t) in.size()) {
+        return Err(
+            fmt::format(FMT_STRING("unable to read zstd frame at {} -- {}"),
+                        start,
+                        rc < 0 ? strerror(errno) : "unexpected end-of-file"));
+    }
+
+    std::vector<char> retval(out_size);
+    auto zrc
+        = ZSTD_decompress(retval.data(), retval.size(), in.data(), in.size());
+    if (ZSTD_isError(zrc)) {
+        return Err(fmt::format(FMT_STRING("zstd error in frame at {} -- {}"),
+                               start,
+                               ZSTD_getErrorName(zrc)));
+    }
+
+    retval.resize(zrc);
+    return Ok(std::move(retval));
+}
+#endif
+
+static block_decode_result
+decode_block(int fd,
+             line_buffer::block_indexed::format_t fmt,
+             line_buffer::block_indexed::block blk)
+{
+    switch (fmt) {
+        case line_buffer::block_indexed::format_t::bzip2:
+#ifdef HAVE_BZLIB_H
+            return bz_decode_block(
+                fd, blk.b_level, blk.b_in_bit, blk.b_in_end_bit);
+#else
+            break;
+#endif
+        case line_buffer::block_indexed::format_t::zstd:
+#ifdef HAVE_ZSTD_H
+            return zstd_decode_frame(
+                fd, blk.b_in_bit / 8, blk.b_in_end_bit / 8, blk.b_out_size);
+#else
+            break;
+#endif
+    }
+
+    return Err(std::string("decompression is not supported"));
+}
+
+struct line_buffer::block_indexed::stream_state {
+#ifdef HAVE_ZSTD_H
+    ~stream_state() { ZSTD_freeDCtx(this->ss_dctx); }
+
+    ZSTD_DCtx* ss_dctx{ZSTD_createDCtx()};
+#endif
+    bool ss_active{false};
+    size_t ss_index{0};
+    file_off_t ss_in{0};
+    file_off_t ss_out{0};
+    std::vector<char> ss_inbuf = std::vector<char>(Z_BUFSIZE);
+    size_t ss_inbuf_pos{0};
+    size_t ss_inbuf_size{0};
+};
+
+line_buffer::block_indexed::block_indexed() = default;
+
+line_buffer::block_indexed::~block_indexed() = default;
+
+void
+line_buffer::block_indexed::close()
+{
+    this->bi_fd.reset();
+    this->bi_source_size = 0;
+    this->bi_source_offset = 0;
+    this->bi_blocks.clear();
+    this->bi_known = 0;
+    this->bi_marks.clear();
+    this->bi_scan_offset = 0;
+    this->bi_scan_window = 0;
+    this->bi_scan_level = '9';
+    this->bi_scan_done = false;
+    this->bi_cache.clear();
+    this->bi_cache_size = 0;
+    this->bi_stream.reset();
+    this->bi_random_access = std::nullopt;
+}
+
+void
+line_buffer::block_indexed::open(int fd, format_t fmt)
+{
+    struct stat st;
+
+    this->close();
+    if (fstat(fd, &st) == -1) {
+        ::close(fd);
+        throw error(errno);
+    }
+    this->bi_fd = auto_fd(fd);
+    this->bi_format = fmt;
+    this->bi_source_size = st.st_size;
+
+    if (fmt != format_t::zstd
+        || this->bi_source_size < 8 + ZSTD_SEEK_FOOTER_SIZE)
+    {
+        return;
+    }
+
+    /*
+     * Files in the zstd seekable format end with a skippable frame that
+     * contains the sizes of all the frames in the file.
+     */
+    unsigned char footer[ZSTD_SEEK_FOOTER_SIZE];
+    auto footer_off = this->bi_source_size - ZSTD_SEEK_FOOTER_SIZE;
+    if (pread_fully(fd, footer, sizeof(footer), footer_off) != sizeof(footer)
+        || read_le(&footer[5], 4) != ZSTD_SEEKABLE_MAGIC)
+    {
+        return;
+    }
+
+    auto frame_count = read_le(&footer[0], 4);
+    auto entry_size = (footer[4] & 0x80) ? 12 : 8;
+    auto table_size = frame_count * entry_size + ZSTD_SEEK_FOOTER_SIZE;
+    auto table_off = this->bi_source_size - (file_ssize_t) table_size - 8;
+    if (table_off < 0) {
+        return;
+    }
+
+    std::vector<unsigned char> table(table_size + 8);
+    if (pread_fully(fd, table.data(), table.size(), table_off)
+            != (ssize_t) table.size()
+        || read_le(&table[0], 4) != ZSTD_SEEK_TABLE_MAGIC
+        || read_le(&table[4], 4) != table_size)
+    {
+        log_warning("%d: invalid zstd seek table", fd);
+        return;
+    }
+
+    std::vector<block> blocks;
+    file_off_t in_off = 0;
+    for (size_t lpc = 0; lpc < frame_count; lpc++) {
+        const auto* entry = &table[8 + lpc * entry_size];
+        auto comp_size = read_le(&entry[0], 4);
+        block blk;
+
+        blk.b_in_bit = in_off * 8;
+        in_off += comp_size;
+        blk.b_in_end_bit = in_off * 8;
+        blk.b_out_size = read_le(&entry[4], 4);
+        blocks.emplace_back(blk);
+    }
+    if (in_off != table_off) {
+        log_warning("%d: zstd seek table does not match the file", fd);
+        return;
+    }
+
+    log_info("%d: loaded zstd seek table with %d frames", fd, frame_count);
+    this->bi_blocks = std::move(blocks);
+    this->bi_scan_offset = this->bi_source_size;
+    this->bi_scan_done = true;
+    this->update_known();
+}
+
+void
+line_buffer::block_indexed::set_error(std::string msg)
+{
+    log_error("%d: %s", this->bi_fd.get(), msg.c_str());
+    this->parent->lb_decompress_error = std::move(msg);
+}
+
+bool
+line_buffer::block_indexed::is_streamed(const block& blk) const
+{
+    return this->bi_format == format_t::zstd
+        && (blk.b_out_size == -1 || blk.b_out_size > MAX_WHOLE_BLOCK_SIZE);
+}
+
+bool
+line_buffer::block_indexed::is_random_access()
+{
+    if (this->bi_random_access) {
+        return this->bi_random_access.value();
+    }
+
+    auto retval = true;
+    if (this->bi_format == format_t::zstd) {
+        for (size_t lpc = 0; this->ensure_scanned(lpc); lpc++) {
+            if (this->is_streamed(this->bi_blocks[lpc])) {
+                retval = false;
+                break;
+            }
+        }
+    }
+
+    // The answer is only final once the whole frame index has been built.
+    // Once a streamed frame is found, the file is treated as sequential.
+    if (!retval || this->bi_format == format_t::bzip2 || this->bi_scan_done) {
+        this->bi_random_access = retval;
+    }
+
+    return retval;
+}
+
+void
+line_buffer::block_indexed::update_known()
+{
+    while (this->bi_known < this->bi_blocks.size()) {
+        auto& blk = this->bi_blocks[this->bi_known];
+
+        if (this->bi_known == 0) {
+            blk.b_out = 0;
+        } else {
+            const auto& prev = this->bi_blocks[this->bi_known - 1];
+
+            blk.b_out = prev.b_out + prev.b_out_size;
+        }
+        if (blk.b_out_size == -1) {
+            break;
+        }
+        this->bi_known += 1;
+    }
+}
+
+bool
+line_buffer::block_indexed::ensure_scanned(size_t index)
+{
+    while (index >= this->bi_blocks.size()
+           || this->bi_blocks[index].b_in_end_bit == -1)
+    {
+        if (this->bi_scan_done) {
+            return false;
+        }
+
+        auto scanned = this->bi_format == format_t::bzip2 ? this->scan_bzip2()
+                                                          : this->scan_zstd();
+        if (!scanned) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool
+line_buffer::block_indexed::scan_bzip2()
+{
+    const auto& mark_table = bz_mark_table();
+    std::vector<unsigned char> buf(BLOCK_SCAN_SIZE);
+
+    auto rc = pread_fully(
+        this->bi_fd, buf.data(), buf.size(), this->bi_scan_offset);
+    if (rc < 0) {
+        this->set_error(fmt::format(FMT_STRING("unable to read bzip2 file -- {}"),
+                                    strerror(errno)));
+        return false;
+    }
+
+    for (ssize_t lpc = 0; lpc < rc; lpc++) {
+        auto window = (this->bi_scan_window << 8) | buf[lpc];
+        auto shifts = mark_table[(window >> 8) & 0xff];
+
+        this->bi_scan_window = window;
+        while (shifts != 0) {
+            auto shift = __builtin_ctz(shifts);
+            auto end_bit = (this->bi_scan_offset + lpc + 1) * 8 - shift;
+            auto start_bit = end_bit - BZ_MAGIC_BITS;
+            auto mark = (window >> shift) & BZ_MAGIC_MASK;
+
+            shifts &= shifts - 1;
+            if (start_bit < 0 || (mark != BZ_BLOCK_MAGIC && mark != BZ_EOS_MAGIC))
+            {
+                continue;
+            }
+
+            this->bi_marks.emplace_back(start_bit);
+            if (!this->bi_blocks.empty()
+                && this->bi_blocks.back().b_in_end_bit == -1)
+            {
+                this->bi_blocks.back().b_in_end_bit = start_bit;
+            }
+            if (mark == BZ_EOS_MAGIC) {
+                continue;
+            }
+
+            // The first block in a stream follows the "BZh" header, which
+            // has the block size used by the stream.
+            unsigned char hdr[4];
+            if (start_bit % 8 == 0 && start_bit >= 32
+                && pread_fully(this->bi_fd, hdr, sizeof(hdr), start_bit / 8 - 4)
+                    == sizeof(hdr)
+                && memcmp(hdr, "BZh", 3) == 0 && '1' <= hdr[3] && hdr[3] <= '9')
+            {
+                this->bi_scan_level = hdr[3];
+            }
+
+            block blk;
+
+            blk.b_in_bit = start_bit;
+            blk.b_level = this->bi_scan_level;
+            this->bi_blocks.emplace_back(blk);
+        }
+    }
+    this->bi_scan_offset += rc;
+    if (rc < BLOCK_SCAN_SIZE) {
+        this->bi_scan_done = true;
+        if (!this->bi_blocks.empty()
+            && this->bi_blocks.back().b_in_end_bit == -1)
+        {
+            this->bi_blocks.back().b_in_end_bit = this->bi_scan_offset * 8;
+        }
+        log_info("%d: found %d bzip2 blocks",
+                 this->bi_fd.get(),
+                 this->bi_blocks.size());
+    }
+    this->update_known();
+
+    return true;
+}
+
+bool
+line_buffer::block_indexed::scan_zstd()
+{
+    auto off = this->bi_scan_offset;
+
+    if (off >= this->bi_source_size) {
+        this->bi_scan_done = true;
+        return true;
+    }
+
+    unsigned char hdr[18];
+    auto rc = pread_fully(this->bi_fd, hdr, sizeof(hdr), off);
+    if (rc < 8) {
+        this->set_error(
+            fmt::format(FMT_STRING("unable to read zstd frame at {} -- {}"),
+                        off,
+                        rc < 0 ? strerror(errno) : "unexpected end-of-file"));
+        return false;
+    }
+
+    auto magic = read_le(&hdr[0], 4);
+    if ((magic & ZSTD_SKIPPABLE_MASK) == ZSTD_SKIPPABLE_MAGIC) {
+        this->bi_scan_offset += 8 + read_le(&hdr[4], 4);
+        return true;
+    }
+    if (magic != ZSTD_FRAME_MAGIC) {
+        this->set_error(
+            fmt::format(FMT_STRING("unknown zstd frame type at {}"), off));
+        return false;
+    }
+
+    static constexpr int DICT_ID_SIZES[] = {0, 1, 2, 4};
+    static constexpr int CONTENT_SIZE_SIZES[] = {0, 2, 4, 8};
+
+    auto descriptor = hdr[4];
+    auto single_segment = (descriptor >> 5) & 1;
+    auto has_checksum = (descriptor >> 2) & 1;
+    auto content_size_size = CONTENT_SIZE_SIZES[descriptor >> 6];
+    ssize_t hdr_size = 5 + (single_segment ? 0 : 1)
+        + DICT_ID_SIZES[descriptor & 3];
+    if (content_size_size == 0 && single_segment) {
+        content_size_size = 1;
+    }
+    if (hdr_size + content_size_size > rc) {
+        this->set_error(
+            fmt::format(FMT_STRING("truncated zstd frame header at {}"), off));
+        return false;
+    }
+
+    block blk;
+
+    blk.b_in_bit = off * 8;
+    if (content_size_size > 0) {
+        blk.b_out_size = read_le(&hdr[hdr_size], content_size_size);
+        if (content_size_size == 2) {
+            blk.b_out_size += 256;
+        }
+    }
+
+    auto block_off = off + hdr_size + content_size_size;
+    while (true) {
+        unsigned char block_hdr[3];
+
+        if (pread_fully(this->bi_fd, block_hdr, sizeof(block_hdr), block_off)
+            != sizeof(block_hdr))
+        {
+            this->set_error(fmt::format(
+                FMT_STRING("truncated zstd frame at {}"), block_off));
+            return false;
+        }
+
+        auto value = read_le(block_hdr, sizeof(block_hdr));
+        auto last = value & 1;
+        auto type = (value >> 1) & 3;
+        auto size = value >> 3;
+
+        // RLE blocks are a single byte that is repeated "size" times.
+        block_off += sizeof(block_hdr) + (type == 1 ? 1 : size);
+        if (last) {
+            break;
+        }
+    }
+    if (has_checksum) {
+        block_off += 4;
+    }
+    blk.b_in_end_bit = block_off * 8;
+    this->bi_blocks.emplace_back(blk);
+    this->bi_scan_offset = block_off;
+    this->update_known();
+
+    return true;
+}
+
+const std::vector<char>*
+line_buffer::block_indexed::cached(size_t index) const
+{
+    for (const auto& entry : this->bi_cache) {
+        if (entry.first == index) {
+            return &entry.second;
+        }
+    }
+
+    return nullptr;
+}
+
+bool
+line_buffer::block_indexed::decode_run(size_t index, size_t size)
+{
+    static constexpr int MAX_MERGES = 8;
+
+    for (int merges = 0;; merges++) {
+        std::vector<size_t> indexes;
+        file_ssize_t covered = 0;
+        file_ssize_t avg_size = 900 * 1000;
+
+        if (this->bi_known > 0) {
+            const auto& last = this->bi_blocks[this->bi_known - 1];
+
+            avg_size = std::max(file_ssize_t{1},
+                                (last.b_out + last.b_out_size)
+                                    / (file_ssize_t) this->bi_known);
+        }
+        for (auto lpc = index; indexes.size() < max_parallel_blocks()
+             && covered < (file_ssize_t) size;
+             lpc++)
+        {
+            if (!this->ensure_scanned(lpc)) {
+                break;
+            }
+
+            const auto& blk = this->bi_blocks[lpc];
+            if (this->is_streamed(blk)) {
+                break;
+            }
+            if (this->cached(lpc) == nullptr) {
+                indexes.emplace_back(lpc);
+            }
+            covered += blk.b_out_size == -1 ? avg_size : blk.b_out_size;
+        }
+        if (indexes.empty()) {
+            return false;
+        }
+
+        std::vector<std::future<block_decode_result>> futures;
+        for (size_t lpc = 1; lpc < indexes.size(); lpc++) {
+            futures.emplace_back(std::async(std::launch::async,
+                                            decode_block,
+                                            this->bi_fd.get(),
+                                            this->bi_format,
+                                            this->bi_blocks[indexes[lpc]]));
+        }
+
+        auto first_res = decode_block(
+            this->bi_fd.get(), this->bi_format, this->bi_blocks[indexes[0]]);
+        if (first_res.isErr()) {
+            for (auto& fut : futures) {
+                fut.wait();
+            }
+
+            /*
+             * The 48-bit block mark can show up by chance inside of the
+             * compressed data.  In that case, the block is extended up to
+             * the next mark and decoding is tried again.
+             */
+            auto& blk = this->bi_blocks[indexes[0]];
+            auto next_mark = std::upper_bound(
+                this->bi_marks.begin(), this->bi_marks.end(), blk.b_in_end_bit);
+            if (this->bi_format != format_t::bzip2 || merges >= MAX_MERGES
+                || blk.b_in_end_bit >= this->bi_source_size * 8)
+            {
+                this->set_error(first_res.unwrapErr());
+                return false;
+            }
+            while (next_mark == this->bi_marks.end() && !this->bi_scan_done) {
+                if (!this->scan_bzip2()) {
+                    return false;
+                }
+                next_mark = std::upper_bound(this->bi_marks.begin(),
+                                             this->bi_marks.end(),
+                                             this->bi_blocks[indexes[0]].b_in_end_bit);
+            }
+
+            auto& bad_blk = this->bi_blocks[indexes[0]];
+            auto new_end = next_mark == this->bi_marks.end()
+                ? this->bi_source_size * 8
+                : *next_mark;
+            auto next_index = indexes[0] + 1;
+            log_warning("%d: extending bzip2 block at bit %lld to %lld",
+                        this->bi_fd.get(),
+                        bad_blk.b_in_bit,
+                        new_end);
+            if (next_index < this->bi_blocks.size()
+                && this->bi_blocks[next_index].b_in_bit < new_end)
+            {
+                this->bi_blocks.erase(this->bi_blocks.begin() + next_index);
+            }
+            this->bi_blocks[indexes[0]].b_in_end_bit = new_end;
+            this->bi_cache.clear();
+            this->bi_cache_size = 0;
+            continue;
+        }
+
+        auto store = [this](size_t index, std::vector<char> data) {
+            auto& blk = this->bi_blocks[index];
+
+            if (blk.b_out_size == -1) {
+                blk.b_out_size = data.size();
+            }
+            this->bi_source_offset = blk.b_in_end_bit / 8;
+            this->bi_cache_size += data.size();
+            this->bi_cache.emplace_back(index, std::move(data));
+            while (this->bi_cache_size > MAX_CACHED_SIZE
+                   && this->bi_cache.size() > max_parallel_blocks() * 2)
+            {
+                this->bi_cache_size -= this->bi_cache.front().second.size();
+                this->bi_cache.erase(this->bi_cache.begin());
+            }
+        };
+
+        store(indexes[0], first_res.unwrap());
+        for (size_t lpc = 0; lpc < futures.size(); lpc++) {
+            auto res = futures[lpc].get();
+
+            if (res.isErr()) {
+                // Leave it to the next run to sort out.
+                break;
+            }
+            store(indexes[lpc + 1], res.unwrap());
+        }
+        this->update_known();
+        return true;
+    }
+}
+
+std::optional<size_t>
+line_buffer::block_indexed::locate(file_off_t offset, size_t size)
+{
+    while (true) {
+        if (this->bi_known > 0) {
+            const auto& last = this->bi_blocks[this->bi_known - 1];
+
+            if (offset < last.b_out + last.b_out_size) {
+                auto iter = std::upper_bound(
+                    this->bi_blocks.begin(),
+                    this->bi_blocks.begin() + this->bi_known,
+                    offset,
+                    [](file_off_t off, const block& blk) {
+                        return off < blk.b_out;
+                    });
+                size_t index = std::distance(this->bi_blocks.begin(), iter) - 1;
+
+                if (!this->is_streamed(this->bi_blocks[index])
+                    && this->cached(index) == nullptr
+                    && !this->decode_run(index, size))
+                {
+                    return std::nullopt;
+                }
+                return index;
+            }
+        }
+
+        auto next_index = this->bi_known;
+        if (!this->ensure_scanned(next_index)) {
+            return std::nullopt;
+        }
+        this->update_known();
+        if (next_index == this->bi_known) {
+            if (this->is_streamed(this->bi_blocks[next_index])) {
+                return next_index;
+            }
+            if (!this->decode_run(next_index, size)) {
+                return std::nullopt;
+            }
+        }
+    }
+}
+
+ssize_t
+line_buffer::block_indexed::stream_read(size_t index,
+                                        char* buf,
+                                        file_off_t offset,
+                                        size_t size)
+{
+#ifdef HAVE_ZSTD_H
+    if (!this->bi_stream) {
+        this->bi_stream = std::make_unique<stream_state>();
+    }
+
+    auto& ss = *this->bi_stream;
+    auto& blk = this->bi_blocks[index];
+    if (!ss.ss_active || ss.ss_index != index || offset < ss.ss_out) {
+        ZSTD_DCtx_reset(ss.ss_dctx, ZSTD_reset_session_only);
+        ss.ss_active = true;
+        ss.ss_index = index;
+        ss.ss_in = blk.b_in_bit / 8;
+        ss.ss_out = 0;
+        ss.ss_inbuf_pos = 0;
+        ss.ss_inbuf_size = 0;
+    }
+
+    char scratch[Z_BUFSIZE];
+    size_t retval = 0;
+    auto frame_end = blk.b_in_end_bit / 8;
+    while (retval < size) {
+        if (ss.ss_inbuf_pos == ss.ss_inbuf_size) {
+            auto to_read = std::min((file_off_t) ss.ss_inbuf.size(),
+                                    frame_end - ss.ss_in);
+            auto rc = to_read <= 0
+                ? 0
+                : pread_fully(this->bi_fd, ss.ss_inbuf.data(), to_read, ss.ss_in);
+            if (rc <= 0) {
+                ss.ss_active = false;
+                this->set_error(fmt::format(
+                    FMT_STRING("unable to read zstd frame at {} -- {}"),
+                    ss.ss_in,
+                    rc < 0 ? strerror(errno) : "unexpected end-of-frame"));
+                return -1;
+            }
+            ss.ss_in += rc;
+            ss.ss_inbuf_pos = 0;
+            ss.ss_inbuf_size = rc;
+        }
+
+        auto skipping = ss.ss_out < offset;
+        ZSTD_outBuffer out;
+        if (skipping) {
+            out = {scratch,
+                   std::min(sizeof(scratch), (size_t) (offset - ss.ss_out)),
+                   0};
+        } else {
+            out = {buf + retval, size - retval, 0};
+        }
+        ZSTD_inBuffer in = {ss.ss_inbuf.data(), ss.ss_inbuf_size, ss.ss_inbuf_pos};
+        auto zrc = ZSTD_decompressStream(ss.ss_dctx, &out, &in);
+        if (ZSTD_isError(zrc)) {
+            ss.ss_active = false;
+            this->set_error(
+                fmt::format(FMT_STRING("zstd error in frame at {} -- {}"),
+                            blk.b_in_bit / 8,
+                            ZSTD_getErrorName(zrc)));
+            return -1;
+        }
+        ss.ss_inbuf_pos = in.pos;
+        ss.ss_out += out.pos;
+        if (!skipping) {
+            retval += out.pos;
+        }
+        this->bi_source_offset = ss.ss_in;
+        if (zrc == 0) {
+            ss.ss_active = false;
+            if (blk.b_out_size == -1) {
+                blk.b_out_size = ss.ss_out;
+                this->update_known();
+            }
+            break;
+        }
+    }
+
+    return retval;
+#else
+    return -1;
+#endif
+}
+
+ssize_t
+line_buffer::block_indexed::read(void* buf, file_off_t offset, size_t size)
+{
+    auto* out = (char*) buf;
+    size_t retval = 0;
+
+    while (retval < size) {
+        auto pos = offset + (file_off_t) retval;
+        auto index_opt = this->locate(pos, size - retval);
+        if (!index_opt) {
+            break;
+        }
+
+        auto index = index_opt.value();
+        auto blk = this->bi_blocks[index];
+        if (this->is_streamed(blk)) {
+            auto rc = this->stream_read(
+                index, out + retval, pos - blk.b_out, size - retval);
+            if (rc < 0 || (rc == 0 && blk.b_out_size != -1)) {
+                break;
+            }
+            retval += rc;
+            continue;
+        }
+
+        const auto* data = this->cached(index);
+        if (data == nullptr) {
+            break;
+        }
+
+        auto block_off = pos - blk.b_out;
+        auto to_copy = std::min(size - retval, data->size() - block_off);
+        memcpy(out + retval, data->data() + block_off, to_copy);
+        retval += to_copy;
+    }
+
+    return retval;
+}
+
+static std::optional<line_buffer::block_indexed::format_t>
+block_format_of(const char* id)
+{
+#ifdef HAVE_BZLIB_H
+    if (id[0] == 'B' && id[1] == 'Z' && id[2] == 'h') {
+        return line_buffer::block_indexed::format_t::bzip2;
+    }
+#endif
+#ifdef HAVE_ZSTD_H
+    if (read_le((const unsigned char*) id, 4) == ZSTD_FRAME_MAGIC) {
+        return line_buffer::block_indexed::format_t::zstd;
+    }
+#endif
+
+    return std::nullopt;
+}
+
 line_buffer::line_buffer()
 {
     this->lb_gz_file.writeAccess()->parent = this;
+    this->lb_block_file.writeAccess()->parent = this;
 
     ensure(this->invariant());
 }
@@ -405,8 +1300,12 @@ line_buffer::set_fd(auto_fd& fd)
         }
     }
 
-    if (this->lb_bz_file) {
-        this->lb_bz_file = false;
+    {
+        safe::WriteAccess<safe_block_indexed> bi(this->lb_block_file);
+
+        if (*bi) {
+            bi->close();
+        }
     }
 
     if (fd != -1) {
@@ -473,24 +1372,23 @@ line_buffer::set_fd(auto_fd& fd)
                     }
                     this->resize_buffer(INITIAL_COMPRESSED_BUFFER_SIZE);
                 }
-#ifdef HAVE_BZLIB_H
-                else if (gz_id[0] == 'B' && gz_id[1] == 'Z')
+                else if (auto block_fmt = block_format_of(gz_id); block_fmt)
                 {
-                    if (lseek(fd, 0, SEEK_SET) < 0) {
-                        throw error(errno);
-                    }
-                    this->lb_bz_file = true;
+                    int bifd = dup(fd);
+
+                    log_perror(fcntl(bifd, F_SETFD, FD_CLOEXEC));
+                    this->lb_block_file.writeAccess()->open(bifd,
+                                                            block_fmt.value());
                     this->lb_compressed = true;
 
                     /*
-                     * Loading data from a bzip2 file is pretty slow, so we try
-                     * to keep as much in memory as possible.
+                     * Blocks are decompressed as a whole, so we try to keep
+                     * as much in memory as possible.
                      */
                     this->resize_buffer(INITIAL_COMPRESSED_BUFFER_SIZE);
 
                     this->lb_compressed_offset = 0;
                 }
-#endif
             }
             this->lb_seekable = true;
         }
@@ -569,10 +1467,15 @@ line_buffer::ensure_available(file_off_t start,
             require(start <= this->lb_file_size);
             /*
              * If the start is near the end of the file, move the offset back a
-             * bit so we can get more of the file in the cache.
+             * bit so we can get more of the file in the cache.  Files that
+             * can be decompressed a block at a time are left alone since
+             * the extra data would need to be decompressed as well.
              */
+            safe::WriteAccess<safe_block_indexed> bi(this->lb_block_file);
+
             if (start + (ssize_t) this->lb_buffer.capacity()
-                > this->lb_file_size)
+                    > this->lb_file_size
+                && !(*bi && bi->is_random_access()))
             {
                 this->lb_file_offset = this->lb_file_size
                     - std::min(this->lb_file_size,
@@ -624,6 +1527,7 @@ line_buffer::load_next_buffer()
     auto start = this->lb_loader_file_offset.value();
     ssize_t rc = 0;
     safe::WriteAccess<safe_gz_indexed> gi(this->lb_gz_file);
+    safe::WriteAccess<safe_block_indexed> bi(this->lb_block_file);
 
     // log_debug("BEGIN preload read");
     /* ... read in the new data. */
@@ -657,8 +1561,7 @@ line_buffer::load_next_buffer()
 #endif
         }
     }
-#ifdef HAVE_BZLIB_H
-    else if (!this->lb_cached_fd && this->lb_bz_file)
+    else if (!this->lb_cached_fd && *bi)
     {
         if (this->lb_file_size != (ssize_t) -1
             && (((ssize_t) start >= this->lb_file_size)
@@ -667,45 +1570,10 @@ line_buffer::load_next_buffer()
         {
             rc = 0;
         } else {
-            lock_hack::guard guard;
-            char scratch[32 * 1024];
-            BZFILE* bz_file;
-            file_off_t seek_to;
-            int bzfd;
-
-            /*
-             * Unfortunately, there is no bzseek, so we need to reopen the
-             * file every time we want to do a read.
-             */
-            bzfd = dup(this->lb_fd);
-            if (lseek(this->lb_fd, 0, SEEK_SET) < 0) {
-                close(bzfd);
-                throw error(errno);
-            }
-            if ((bz_file = BZ2_bzdopen(bzfd, "r")) == nullptr) {
-                close(bzfd);
-                if (errno == 0) {
-                    throw std::bad_alloc();
-                } else {
-                    throw error(errno);
-                }
-            }
-
-            seek_to = start + this->lb_alt_buffer.value().size();
-            while (seek_to > 0) {
-                int count;
-
-                count = BZ2_bzread(bz_file,
-                                   scratch,
-                                   std::min((size_t) seek_to, sizeof(scratch)));
-                seek_to -= count;
-            }
-            rc = BZ2_bzread(bz_file,
-                            this->lb_alt_buffer->end(),
-                            this->lb_alt_buffer->available());
-            this->lb_compressed_offset = lseek(bzfd, 0, SEEK_SET);
-            BZ2_bzclose(bz_file);
-
+            rc = bi->read(this->lb_alt_buffer.value().end(),
+                          start + this->lb_alt_buffer.value().size(),
+                          this->lb_alt_buffer.value().available());
+            this->lb_compressed_offset = bi->get_source_offset();
             if (rc != -1
                 && (rc < (ssize_t) (this->lb_alt_buffer.value().available()))
                 && (start + (ssize_t) this->lb_alt_buffer.value().size() + rc
@@ -719,7 +1587,6 @@ line_buffer::load_next_buffer()
             }
         }
     }
-#endif
     else
     {
         rc = pread(this->lb_cached_fd ? this->lb_cached_fd.value().get()
@@ -769,22 +1636,12 @@ line_buffer::load_next_buffer()
     // log_debug("END preload read");
 
     if (start > this->lb_last_line_offset) {
-        const auto* line_start = this->lb_alt_buffer.value().begin();
-
-        do {
-            auto before = line_start - this->lb_alt_buffer->begin();
-            const auto remaining = this->lb_alt_buffer.value().size() - before;
-            const auto frag
-                = string_fragment::from_bytes(line_start, remaining);
-            auto utf_scan_res = is_utf8(frag, '\n');
-            const auto* lf = utf_scan_res.remaining_ptr();
-            this->lb_alt_line_starts.emplace_back(before);
-            this->lb_alt_line_is_utf.emplace_back(utf_scan_res.is_valid());
-            this->lb_alt_line_has_ansi.emplace_back(utf_scan_res.usr_has_ansi);
-
-            line_start = lf;
-        } while (line_start != nullptr
-                 && line_start < this->lb_alt_buffer->end());
+        scan_utf8_lines(
+            string_fragment::from_bytes(this->lb_alt_buffer.value().begin(),
+                                        this->lb_alt_buffer.value().size()),
+            this->lb_alt_line_starts,
+            this->lb_alt_line_is_utf,
+            this->lb_alt_line_has_ansi);
     }
 
     return retval;
@@ -892,6 +1749,7 @@ line_buffer::fill_range(file_off_t start,
         this->ensure_available(start, max_length, dir);
 
         safe::WriteAccess<safe_gz_indexed> gi(this->lb_gz_file);
+        safe::WriteAccess<safe_block_indexed> bi(this->lb_block_file);
 
         /* ... read in the new data. */
         if (!this->lb_cached_fd && *gi) {
@@ -927,8 +1785,7 @@ line_buffer::fill_range(file_off_t start,
                       this->lb_buffer.capacity());
 #endif
         }
-#ifdef HAVE_BZLIB_H
-        else if (!this->lb_cached_fd && this->lb_bz_file)
+        else if (!this->lb_cached_fd && *bi)
         {
             if (this->lb_file_size != (ssize_t) -1
                 && (((ssize_t) start >= this->lb_file_size)
@@ -937,47 +1794,23 @@ line_buffer::fill_range(file_off_t start,
             {
                 rc = 0;
             } else {
-                lock_hack::guard guard;
-                char scratch[32 * 1024];
-                BZFILE* bz_file;
-                file_off_t seek_to;
-                int bzfd;
-
                 /*
-                 * Unfortunately, there is no bzseek, so we need to reopen the
-                 * file every time we want to do a read.
+                 * Only the blocks that overlap the request need to be
+                 * decompressed, so there is no need to fill the whole
+                 * buffer.  Bulk reads are left to the preloader.
                  */
-                bzfd = dup(this->lb_fd);
-                if (lseek(this->lb_fd, 0, SEEK_SET) < 0) {
-                    close(bzfd);
-                    throw error(errno);
-                }
-                if ((bz_file = BZ2_bzdopen(bzfd, "r")) == NULL) {
-                    close(bzfd);
-                    if (errno == 0) {
-                        throw std::bad_alloc();
-                    } else {
-                        throw error(errno);
-                    }
-                }
+                auto needed = start + max_length
+                    - (this->lb_file_offset + this->lb_buffer.size());
+                auto request
+                    = std::min((ssize_t) this->lb_buffer.available(),
+                               std::max((ssize_t) needed, BLOCK_FILL_SIZE));
 
-                seek_to = this->lb_file_offset + this->lb_buffer.size();
-                while (seek_to > 0) {
-                    int count;
-
-                    count = BZ2_bzread(
-                        bz_file,
-                        scratch,
-                        std::min((size_t) seek_to, sizeof(scratch)));
-                    seek_to -= count;
-                }
-                rc = BZ2_bzread(bz_file,
-                                this->lb_buffer.end(),
-                                this->lb_buffer.available());
-                this->lb_compressed_offset = lseek(bzfd, 0, SEEK_SET);
-                BZ2_bzclose(bz_file);
-
-                if (rc != -1 && (rc < (ssize_t) this->lb_buffer.available())) {
+                this->lb_stats.s_decompressions += 1;
+                rc = bi->read(this->lb_buffer.end(),
+                              this->lb_file_offset + this->lb_buffer.size(),
+                              request);
+                this->lb_compressed_offset = bi->get_source_offset();
+                if (rc != -1 && rc < request) {
                     this->lb_file_size
                         = (this->lb_file_offset + this->lb_buffer.size() + rc);
                     log_info("fd(%d): set file size to %llu",
@@ -986,7 +1819,6 @@ line_buffer::fill_range(file_off_t start,
                 }
             }
         }
-#endif
         else if (this->lb_seekable)
         {
             this->lb_stats.s_preads += 1;
@@ -1485,6 +2317,16 @@ line_buffer::enable_cache()
         return;
     }
 
+    {
+        safe::WriteAccess<safe_block_indexed> bi(this->lb_block_file);
+
+        if (*bi && bi->is_random_access()) {
+            log_info("%d: skipping cache request, file has a block index",
+                     this->lb_fd.get());
+            return;
+        }
+    }
+
     struct stat st;
 
     if (fstat(this->lb_fd, &st) == -1) {
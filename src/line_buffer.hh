@@ -35,6 +35,9 @@
 #include <array>
 #include <exception>
 #include <future>
+#include <memory>
+#include <optional>
+#include <string>
 #include <vector>
 
 #include <errno.h>
@@ -138,6 +141,99 @@ public:
         int gz_fd = -1; /*< The file to read data from. */
     };
 
+    /**
+     * A reader for compressed files that are made up of blocks that can be
+     * decompressed independently of each other, namely, bzip2 blocks and
+     * zstd frames.  The location of each block is discovered as the file is
+     * read so that random access only needs to decompress the blocks that
+     * overlap the requested range.  Runs of blocks are decompressed in
+     * parallel.
+     */
+    class block_indexed {
+    public:
+        enum class format_t {
+            bzip2,
+            zstd,
+        };
+
+        struct block {
+            /** The bit offset of the start of the block in the file. */
+            file_off_t b_in_bit{0};
+            /** The bit offset of the end of the block or -1 if not known. */
+            file_off_t b_in_end_bit{-1};
+            /** The offset of the block in the decompressed data. */
+            file_off_t b_out{-1};
+            /** The size of the decompressed data or -1 if not known. */
+            file_ssize_t b_out_size{-1};
+            /** The block size character from the bzip2 stream header. */
+            char b_level{'9'};
+        };
+
+        struct stream_state;
+
+        block_indexed();
+        ~block_indexed();
+
+        inline operator bool() const { return this->bi_fd != -1; }
+
+        void open(int fd, format_t fmt);
+        void close();
+
+        file_off_t get_source_offset() const
+        {
+            return this->bi_source_offset;
+        }
+
+        /**
+         * @return True if any offset can be read without decompressing the
+         * file from the start.  This is not the case for zstd files that
+         * were compressed as a single large frame.
+         */
+        bool is_random_access();
+
+        /**
+         * Decompress bytes from the file returning at most `size` bytes.
+         * offset is the byte-offset in the decompressed data stream.
+         */
+        ssize_t read(void* buf, file_off_t offset, size_t size);
+
+        line_buffer* parent{nullptr};
+
+    private:
+        bool is_streamed(const block& blk) const;
+        bool ensure_scanned(size_t index);
+        bool scan_bzip2();
+        bool scan_zstd();
+        void update_known();
+        std::optional<size_t> locate(file_off_t offset, size_t size);
+        bool decode_run(size_t index, size_t size);
+        const std::vector<char>* cached(size_t index) const;
+        ssize_t stream_read(size_t index,
+                            char* buf,
+                            file_off_t offset,
+                            size_t size);
+        void set_error(std::string msg);
+
+        auto_fd bi_fd;
+        format_t bi_format{format_t::bzip2};
+        file_ssize_t bi_source_size{0};
+        file_off_t bi_source_offset{0};
+        std::vector<block> bi_blocks;
+        /** The number of leading blocks with a known decompressed size. */
+        size_t bi_known{0};
+        /** The bit offsets of all the bzip2 block and end-of-stream marks. */
+        std::vector<file_off_t> bi_marks;
+        file_off_t bi_scan_offset{0};
+        uint64_t bi_scan_window{0};
+        char bi_scan_level{'9'};
+        bool bi_scan_done{false};
+        std::vector<std::pair<size_t, std::vector<char>>> bi_cache;
+        size_t bi_cache_size{0};
+        std::unique_ptr<stream_state> bi_stream;
+        /** The cached result of is_random_access(). */
+        std::optional<bool> bi_random_access;
+    };
+
     /** Construct an empty line_buffer. */
     line_buffer();
 
@@ -348,12 +444,14 @@ private:
     bool load_next_buffer();
 
     using safe_gz_indexed = safe::Safe<gz_indexed>;
+    using safe_block_indexed = safe::Safe<block_indexed>;
 
     shared_buffer lb_share_manager;
 
     auto_fd lb_fd; /*< The file to read data from. */
     safe_gz_indexed lb_gz_file; /*< File reader for gzipped files. */
-    bool lb_bz_file{false}; /*< Flag set for bzip2 compressed files. */
+    safe_block_indexed
+        lb_block_file; /*< File reader for bzip2 and zstd files. */
     bool lb_line_metadata{false};
     file_ssize_t lb_piper_header_size{0};
 
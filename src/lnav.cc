@@ -61,6 +61,10 @@
 #    include <bzlib.h>
 #endif
 
+#ifdef HAVE_ZSTD_H
+#    include <zstd.h>
+#endif
+
 #include "all_logs_vtab.hh"
 #include "base/ansi_scrubber.hh"
 #include "base/ansi_vars.hh"
@@ -84,6 +88,7 @@
 #include "environ_vtab.hh"
 #include "file_converter_manager.hh"
 #include "file_options.hh"
+#include "file_watcher.hh"
 #include "filter_sub_source.hh"
 #include "fstat_vtab.hh"
 #include "hist_source.hh"
@@ -1019,10 +1024,21 @@ struct refresh_status_bars {
                        .empty())
         {
             prompt.p_editor.clear_inactive_value();
-        } else if (prompt.p_editor.tc_inactive_value.al_string
-                   != cancel_msg.al_string)
-        {
-            prompt.p_editor.set_inactive_value(cancel_msg);
+        } else {
+            const auto& detail
+                = lnav_data.ld_bottom_source.get_loading_detail();
+            auto msg = detail.empty()
+                ? cancel_msg
+                : lnav::console::user_message::info(
+                      attr_line_t(detail)
+                          .append(", press ")
+                          .append("CTRL+]"_hotkey)
+                          .append(" to cancel"))
+                      .to_attr_line();
+
+            if (prompt.p_editor.tc_inactive_value.al_string != msg.al_string) {
+                prompt.p_editor.set_inactive_value(msg);
+            }
         }
 
         if (!lnav_data.ld_log_source.is_indexing_in_progress()) {
@@ -1878,6 +1894,7 @@ VALUES ('org.lnav.mouse-support', -1, DATETIME('now', '+1 minute'),
                 log_debug("file count %d",
                           lnav_data.ld_active_files.fc_files.size());
             }
+            auto dirs_watched = new_files.fc_dirs_watched;
             auto old_gen = lnav_data.ld_active_files.fc_files_generation;
             update_active_files(new_files);
             if (old_gen != lnav_data.ld_active_files.fc_files_generation) {
@@ -1893,8 +1910,26 @@ VALUES ('org.lnav.mouse-support', -1, DATETIME('now', '+1 minute'),
             }
 
             rescan_future = std::future<file_collection>{};
-            next_rescan_time
-                = ui_now + (std::exchange(rescan_needed, false) ? 0ms : 333ms);
+            if (std::exchange(rescan_needed, false)) {
+                next_rescan_time = ui_now;
+            } else if (dirs_watched) {
+                // The file watcher will tell us about new files, so this
+                // rescan is just a fallback.
+                next_rescan_time = ui_now + file_watcher::RESCAN_INTERVAL;
+            } else {
+                next_rescan_time = ui_now + 333ms;
+            }
+        }
+
+        {
+            static auto& fw = injector::get<file_watcher&>();
+
+            if (fw.consume_dir_changes()) {
+                next_rescan_time = ui_now;
+            }
+            if (fw.consume_file_changes()) {
+                next_rebuild_time = ui_now;
+            }
         }
 
         if (!rescan_future.valid()
@@ -2335,6 +2370,7 @@ VALUES ('org.lnav.mouse-support', -1, DATETIME('now', '+1 minute'),
 
                 if (!ran_cleanup) {
                     line_buffer::cleanup_cache();
+                    logfile::cleanup_index_cache();
                     archive_manager::cleanup_cache();
                     tailer::cleanup_cache();
                     lnav::piper::cleanup();
@@ -2368,6 +2404,7 @@ VALUES ('org.lnav.mouse-support', -1, DATETIME('now', '+1 minute'),
                         set_view_mode(ln_mode_t::PAGING);
                         lnav_data.ld_active_files.fc_files
                             | lnav::itertools::for_each(&logfile::dump_stats);
+                        lnav_data.ld_log_source.dump_stats();
 
                         check_for_file_zones();
                     } else {
@@ -3861,6 +3898,9 @@ SELECT tbl_name FROM sqlite_master WHERE sql LIKE 'CREATE VIRTUAL TABLE%'
 #ifdef HAVE_BZLIB_H
             log_info("  bzip=%s", BZ2_bzlibVersion());
 #endif
+#ifdef HAVE_ZSTD_H
+            log_info("  zstd=%s", ZSTD_versionString());
+#endif
 #ifdef HAVE_LIBCURL
             log_info("  curl=%s (%s)", LIBCURL_VERSION, LIBCURL_TIMESTAMP);
 #endif
@@ -3994,6 +4034,7 @@ SELECT tbl_name FROM sqlite_master WHERE sql LIKE 'CREATE VIRTUAL TABLE%'
                 archive_manager::cleanup_cache();
                 tailer::cleanup_cache();
                 line_buffer::cleanup_cache();
+                logfile::cleanup_index_cache();
                 lnav::piper::cleanup();
                 file_converter_manager::cleanup();
                 wait_for_pipers();
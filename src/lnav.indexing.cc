@@ -539,10 +539,15 @@ rescan_files(bool req)
         {
             return false;
         }
-        if (!all_synced) {
+        // Members of archives that are still being extracted are picked up
+        // by the following rescans.
+        auto archives_pending = lnav_data.ld_active_files.fc_progress
+                                    ->readAccess()
+                                    ->archives_pending();
+        if (!all_synced || archives_pending) {
             delay = 30ms;
         }
-        done = fc.fc_file_names.empty() && all_synced;
+        done = fc.fc_file_names.empty() && all_synced && !archives_pending;
         if (!done && !(lnav_data.ld_flags & LNF_HEADLESS)) {
             lnav_data.ld_files_view.set_needs_update();
             lnav_data.ld_files_view.do_update();
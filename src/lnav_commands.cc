@@ -60,6 +60,7 @@
 #include "date/tz.h"
 #include "db_sub_source.hh"
 #include "field_overlay_source.hh"
+#include "file_watcher.hh"
 #include "hasher.hh"
 #include "itertools.similar.hh"
 #include "lnav.indexing.hh"
@@ -183,14 +184,9 @@ combined_user_marks(vis_bookmarks& vb)
 {
     const auto& bv = vb[&textview_curses::BM_USER];
     const auto& bv_expr = vb[&textview_curses::BM_USER_EXPR];
-    bookmark_vector<vis_line_t> retval;
+    auto retval = bv;
 
-    for (const auto& row : bv.bv_tree) {
-        retval.insert_once(row);
-    }
-    for (const auto& row : bv_expr.bv_tree) {
-        retval.insert_once(row);
-    }
+    retval |= bv_expr;
     return retval;
 }
 
@@ -2164,14 +2160,13 @@ com_delete_tags(exec_context& ec,
             }
 
             if (line_meta->empty(bookmark_metadata::categories::notes)) {
-                size_t off = std::distance(vbm.bv_tree.begin(), iter);
                 auto vl = *iter;
                 tc->set_user_mark(&textview_curses::BM_META, vl, false);
                 if (line_meta->empty(bookmark_metadata::categories::any)) {
                     lss.erase_bookmark_metadata(vl);
                 }
 
-                iter = std::next(vbm.bv_tree.begin(), off);
+                iter = vbm.bv_tree.upper_bound(vl);
             } else {
                 ++iter;
             }
@@ -2798,6 +2793,9 @@ com_rebuild(exec_context& ec,
             std::vector<std::string>& args)
 {
     if (!ec.ec_dry_run) {
+        // The notification for a recent write might not have been read
+        // yet, so all of the files are checked.
+        injector::get<file_watcher&>().force_check();
         rescan_files(true);
         rebuild_indexes_repeatedly();
     }
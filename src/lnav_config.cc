@@ -1481,6 +1481,19 @@ static const struct json_path_container remote_handlers = {
         .with_example("3d")
         .with_example("12h")
         .for_field(&_lnav_config::lc_tailer, &tailer::config::c_cache_ttl),
+    yajlpp::property_handler("compression")
+        .with_synopsis("<bool>")
+        .with_description("Compress the file contents sent by the tailer on "
+                          "the remote host")
+        .for_field(&_lnav_config::lc_tailer, &tailer::config::c_compress),
+    yajlpp::property_handler("prefilter")
+        .with_synopsis("<regex>")
+        .with_description(
+            "A POSIX extended regular expression used by the tailer on the "
+            "remote host to select the lines to send.  Lines that do not "
+            "match are never transferred.")
+        .with_example("ERROR|WARN")
+        .for_field(&_lnav_config::lc_tailer, &tailer::config::c_prefilter),
     yajlpp::property_handler("ssh")
         .with_description(
             "Settings related to the ssh command used to contact remote "
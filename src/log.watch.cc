@@ -29,8 +29,11 @@
 
 #include "log.watch.hh"
 
+#include <chrono>
+
 #include <sqlite3.h>
 
+#include "base/injector.bind.hh"
 #include "base/injector.hh"
 #include "bound_tags.hh"
 #include "lnav.events.hh"
@@ -39,14 +42,31 @@
 #include "logfile_sub_source.cfg.hh"
 #include "readline_highlighters.hh"
 #include "sql_util.hh"
+#include "sql_filter_plan.hh"
 #include "sqlitepp.hh"
+#include "vtab_module.hh"
 #include "yajlpp/yajlpp_def.hh"
 
 namespace lnav::log::watch {
 
 struct compiled_watch_expr {
     auto_mem<sqlite3_stmt> cwe_stmt{sqlite3_finalize};
+    std::shared_ptr<sql_filter_plan> cwe_plan;
     bool cwe_enabled{true};
+
+    /** The number of messages checked against this expression. */
+    uint64_t cwe_lines{0};
+    /**
+     * The number of messages skipped because the format cannot have a
+     * field used in the expression.
+     */
+    uint64_t cwe_prefiltered{0};
+    /** The number of messages decided by the native predicate. */
+    uint64_t cwe_native{0};
+    /** The number of messages that were evaluated by SQLite. */
+    uint64_t cwe_sqlite{0};
+    uint64_t cwe_matches{0};
+    std::chrono::nanoseconds cwe_eval_time{0};
 };
 
 struct expressions : public lnav_config_listener {
@@ -98,6 +118,9 @@ struct expressions : public lnav_config_listener {
                 continue;
             }
 
+            cwe.cwe_plan = sql_filter_plan::create(cwe.cwe_stmt.in());
+            log_info("  native predicate: %s",
+                     cwe.cwe_plan->is_native() ? "yes" : "no");
             this->e_watch_exprs.emplace(pair.first, std::move(cwe));
         }
     }
@@ -109,279 +132,265 @@ struct expressions : public lnav_config_listener {
 
 static expressions exprs;
 
+bool
+is_active()
+{
+    return std::any_of(exprs.e_watch_exprs.begin(),
+                       exprs.e_watch_exprs.end(),
+                       [](const auto& elem) { return elem.second.cwe_enabled; });
+}
+
+/**
+ * @return True if messages in the given format might have all of the values
+ * that are referenced by the expression.
+ */
+static bool
+format_has_values(const log_format& format, const sql_filter_plan& plan)
+{
+    for (const auto& p : plan.fp_params) {
+        if (p.p_kind == sql_filter_plan::param_kind::value
+            && !format.may_have_value(p.p_value_name))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool
+line_has_values(sql_filter_plan::line_context& lc, const sql_filter_plan& plan)
+{
+    for (const auto& p : plan.fp_params) {
+        if (p.p_kind != sql_filter_plan::param_kind::value) {
+            continue;
+        }
+
+        const auto& values = lc.values().lvv_values;
+        auto found = std::any_of(
+            values.begin(), values.end(), [&p](const auto& lv) {
+                return lv.lv_meta.lvm_name == p.p_value_name;
+            });
+        if (!found) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void
+publish_match(const std::string& watch_name,
+              logfile& lf,
+              sql_filter_plan::line_context& lc)
+{
+    static auto& lnav_db = injector::get<auto_sqlite3&>();
+
+    char timestamp_buffer[64];
+    sql_strftime(timestamp_buffer,
+                 sizeof(timestamp_buffer),
+                 lc.lc_line->get_timeval(),
+                 'T');
+    auto lmd = lnav::events::log::msg_detected{
+        watch_name,
+        lf.get_filename(),
+        lf.get_format_name().to_string(),
+        lc.line_number(),
+        timestamp_buffer,
+    };
+    for (const auto& lv : lc.values().lvv_values) {
+        switch (lv.lv_meta.lvm_kind) {
+            case value_kind_t::VALUE_NULL:
+                lmd.md_values[lv.lv_meta.lvm_name.to_string()]
+                    = null_value_t{};
+                break;
+            case value_kind_t::VALUE_BOOLEAN:
+                lmd.md_values[lv.lv_meta.lvm_name.to_string()]
+                    = lv.lv_value.i ? true : false;
+                break;
+            case value_kind_t::VALUE_INTEGER:
+                lmd.md_values[lv.lv_meta.lvm_name.to_string()] = lv.lv_value.i;
+                break;
+            case value_kind_t::VALUE_FLOAT:
+                lmd.md_values[lv.lv_meta.lvm_name.to_string()] = lv.lv_value.d;
+                break;
+            default:
+                lmd.md_values[lv.lv_meta.lvm_name.to_string()]
+                    = lv.to_string();
+                break;
+        }
+    }
+    lnav::events::publish(lnav_db, lmd);
+}
+
 void
-eval_with(logfile& lf, logfile::iterator ll)
+eval_batch(logfile& lf, const std::vector<uint32_t>& line_numbers)
 {
-    if (std::none_of(exprs.e_watch_exprs.begin(),
-                     exprs.e_watch_exprs.end(),
-                     [](const auto& elem) { return elem.second.cwe_enabled; }))
-    {
+    if (line_numbers.empty() || !is_active()) {
         return;
     }
 
     static auto& lnav_db = injector::get<auto_sqlite3&>();
 
-    char timestamp_buffer[64] = "";
-    shared_buffer_ref raw_sbr;
-    logline_value_vector values;
-    lf.read_full_message(ll, values.lvv_sbr);
-    values.lvv_sbr.erase_ansi();
     auto format = lf.get_format();
-    string_attrs_t sa;
-    auto line_number = std::distance(lf.begin(), ll);
-    format->annotate(&lf, line_number, sa, values);
+    if (format == nullptr) {
+        return;
+    }
 
+    // Figure out which expressions could possibly match messages in this
+    // format so the rest can skip the whole batch.
+    std::vector<std::pair<const std::string*, compiled_watch_expr*>> active;
     for (auto& watch_pair : exprs.e_watch_exprs) {
-        if (!watch_pair.second.cwe_enabled) {
+        auto& cwe = watch_pair.second;
+
+        if (!cwe.cwe_enabled) {
             continue;
         }
 
-        auto* stmt = watch_pair.second.cwe_stmt.in();
-        sqlite3_reset(stmt);
+        cwe.cwe_lines += line_numbers.size();
+        if (!format_has_values(*format, *cwe.cwe_plan)) {
+            cwe.cwe_prefiltered += line_numbers.size();
+            continue;
+        }
+        active.emplace_back(&watch_pair.first, &cwe);
+    }
 
-        auto count = sqlite3_bind_parameter_count(stmt);
-        auto missing_column = false;
-        for (int lpc = 0; lpc < count; lpc++) {
-            const auto* name = sqlite3_bind_parameter_name(stmt, lpc + 1);
+    for (const auto line_number : line_numbers) {
+        sql_filter_plan::line_context lc(&lf, lf.cbegin() + line_number);
 
-            if (name[0] == '$') {
-                const char* env_value;
+        for (auto& act : active) {
+            auto& cwe = *act.second;
 
-                if ((env_value = getenv(&name[1])) != nullptr) {
-                    sqlite3_bind_text(
-                        stmt, lpc + 1, env_value, -1, SQLITE_STATIC);
-                }
-                continue;
-            }
-            if (strcmp(name, ":log_level") == 0) {
-                sqlite3_bind_text(
-                    stmt, lpc + 1, ll->get_level_name(), -1, SQLITE_STATIC);
-                continue;
-            }
-            if (strcmp(name, ":log_time") == 0) {
-                auto len = sql_strftime(timestamp_buffer,
-                                        sizeof(timestamp_buffer),
-                                        ll->get_timeval(),
-                                        'T');
-                sqlite3_bind_text(
-                    stmt, lpc + 1, timestamp_buffer, len, SQLITE_STATIC);
-                continue;
-            }
-            if (strcmp(name, ":log_time_msecs") == 0) {
-                sqlite3_bind_int64(
-                    stmt,
-                    lpc + 1,
-                    ll->get_time<std::chrono::milliseconds>().count());
-                continue;
-            }
-            if (strcmp(name, ":log_format") == 0) {
-                const auto format_name = format->get_name();
-                sqlite3_bind_text(stmt,
-                                  lpc + 1,
-                                  format_name.get(),
-                                  format_name.size(),
-                                  SQLITE_STATIC);
-                continue;
-            }
-            if (strcmp(name, ":log_format_regex") == 0) {
-                const auto pat_name = format->get_pattern_name(line_number);
-                sqlite3_bind_text(stmt,
-                                  lpc + 1,
-                                  pat_name.get(),
-                                  pat_name.size(),
-                                  SQLITE_STATIC);
-                continue;
-            }
-            if (strcmp(name, ":log_path") == 0) {
-                const auto& filename = lf.get_filename();
-                sqlite3_bind_text(stmt,
-                                  lpc + 1,
-                                  filename.c_str(),
-                                  filename.native().length(),
-                                  SQLITE_STATIC);
-                continue;
-            }
-            if (strcmp(name, ":log_unique_path") == 0) {
-                const auto& filename = lf.get_unique_path();
-                sqlite3_bind_text(stmt,
-                                  lpc + 1,
-                                  filename.c_str(),
-                                  filename.native().length(),
-                                  SQLITE_STATIC);
-                continue;
-            }
-            if (strcmp(name, ":log_text") == 0) {
-                sqlite3_bind_text(stmt,
-                                  lpc + 1,
-                                  values.lvv_sbr.get_data(),
-                                  values.lvv_sbr.length(),
-                                  SQLITE_STATIC);
-                continue;
-            }
-            if (strcmp(name, ":log_body") == 0) {
-                auto body_attr_opt = get_string_attr(sa, SA_BODY);
-                if (body_attr_opt) {
-                    const auto& sar
-                        = body_attr_opt.value().saw_string_attr->sa_range;
-
-                    sqlite3_bind_text(stmt,
-                                      lpc + 1,
-                                      values.lvv_sbr.get_data_at(sar.lr_start),
-                                      sar.length(),
-                                      SQLITE_STATIC);
-                } else {
-                    sqlite3_bind_null(stmt, lpc + 1);
-                }
-                continue;
-            }
-            if (strcmp(name, ":log_opid") == 0) {
-                if (values.lvv_opid_value) {
-                    sqlite3_bind_text(stmt,
-                                      lpc + 1,
-                                      values.lvv_opid_value->c_str(),
-                                      values.lvv_opid_value->length(),
-                                      SQLITE_STATIC);
-                } else {
-                    sqlite3_bind_null(stmt, lpc + 1);
-                }
-                continue;
-            }
-            if (strcmp(name, ":log_raw_text") == 0) {
-                auto res = lf.read_raw_message(ll);
-
-                if (res.isOk()) {
-                    raw_sbr = res.unwrap();
-                    sqlite3_bind_text(stmt,
-                                      lpc + 1,
-                                      raw_sbr.get_data(),
-                                      raw_sbr.length(),
-                                      SQLITE_STATIC);
-                }
+            if (!cwe.cwe_enabled) {
                 continue;
             }
-            if (strcmp(name, ":log_tags") == 0) {
-                const auto& bm = lf.get_bookmark_metadata();
-                auto bm_iter = bm.find(line_number);
-                if (bm_iter != bm.end() && !bm_iter->second.bm_tags.empty()) {
-                    const auto& meta = bm_iter->second;
-                    yajlpp_gen gen;
 
-                    yajl_gen_config(gen, yajl_gen_beautify, false);
+            auto start_time = std::chrono::steady_clock::now();
+            auto native_res = cwe.cwe_plan->eval(lc);
+            auto matched = false;
 
-                    {
-                        yajlpp_array arr(gen);
-
-                        for (const auto& str : meta.bm_tags) {
-                            arr.gen(str);
-                        }
-                    }
-
-                    string_fragment sf = gen.to_string_fragment();
-
-                    sqlite3_bind_text(stmt,
-                                      lpc + 1,
-                                      sf.data(),
-                                      sf.length(),
-                                      SQLITE_TRANSIENT);
-                }
-                continue;
-            }
-            auto found = false;
-            for (const auto& lv : values.lvv_values) {
-                if (lv.lv_meta.lvm_name != &name[1]) {
-                    continue;
+            if (native_res && !native_res.value()) {
+                cwe.cwe_native += 1;
+            } else if (!line_has_values(lc, *cwe.cwe_plan)) {
+                if (native_res) {
+                    cwe.cwe_native += 1;
                 }
-
-                found = true;
-                switch (lv.lv_meta.lvm_kind) {
-                    case value_kind_t::VALUE_BOOLEAN:
-                        sqlite3_bind_int64(stmt, lpc + 1, lv.lv_value.i);
-                        break;
-                    case value_kind_t::VALUE_FLOAT:
-                        sqlite3_bind_double(stmt, lpc + 1, lv.lv_value.d);
-                        break;
-                    case value_kind_t::VALUE_INTEGER:
-                        sqlite3_bind_int64(stmt, lpc + 1, lv.lv_value.i);
+            } else if (native_res) {
+                cwe.cwe_native += 1;
+                matched = true;
+            } else {
+                auto* stmt = cwe.cwe_stmt.in();
+
+                cwe.cwe_sqlite += 1;
+                sqlite3_reset(stmt);
+                sqlite3_clear_bindings(stmt);
+                cwe.cwe_plan->bind(stmt, lc);
+
+                auto step_res = sqlite3_step(stmt);
+                switch (step_res) {
+                    case SQLITE_OK:
+                    case SQLITE_DONE:
                         break;
-                    case value_kind_t::VALUE_NULL:
-                        sqlite3_bind_null(stmt, lpc + 1);
+                    case SQLITE_ROW:
+                        matched = true;
                         break;
-                    default:
-                        sqlite3_bind_text(stmt,
-                                          lpc + 1,
-                                          lv.text_value(),
-                                          lv.text_length(),
-                                          SQLITE_TRANSIENT);
+                    default: {
+                        log_error("failed to execute watch expression: %s -- %s",
+                                  act.first->c_str(),
+                                  sqlite3_errmsg(lnav_db));
+                        cwe.cwe_enabled = false;
                         break;
+                    }
                 }
-                break;
             }
-            if (!found) {
-                missing_column = true;
-                break;
+            cwe.cwe_eval_time += std::chrono::steady_clock::now() - start_time;
+
+            if (matched) {
+                cwe.cwe_matches += 1;
+                publish_match(*act.first, lf, lc);
             }
         }
+    }
+}
 
-        if (missing_column) {
-            continue;
-        }
+namespace {
+
+struct lnav_watch_expr_stats
+    : public tvt_iterator_cursor<lnav_watch_expr_stats> {
+    static constexpr const char* NAME = "lnav_watch_expr_stats";
+    static constexpr const char* CREATE_STMT = R"(
+-- Access statistics for the watch expressions through this table.
+CREATE TABLE lnav_watch_expr_stats (
+    name         TEXT,     -- The name of the watch expression.
+    enabled      INTEGER,  -- Indicates whether the expression is enabled.
+    native       INTEGER,  -- Indicates whether the expression has a native predicate.
+    lines        INTEGER,  -- The number of messages checked.
+    prefiltered  INTEGER,  -- The number of messages skipped because the format lacks a field.
+    native_evals INTEGER,  -- The number of messages decided without SQLite.
+    sqlite_evals INTEGER,  -- The number of messages evaluated by SQLite.
+    matches      INTEGER,  -- The number of messages that matched.
+    eval_time_us INTEGER   -- The time spent evaluating the expression.
+);
+)";
+
+    using iterator = std::map<std::string, compiled_watch_expr>::iterator;
+
+    iterator begin() { return exprs.e_watch_exprs.begin(); }
+
+    iterator end() { return exprs.e_watch_exprs.end(); }
+
+    sqlite_int64 get_rowid(iterator iter)
+    {
+        return std::distance(exprs.e_watch_exprs.begin(), iter);
+    }
 
-        auto step_res = sqlite3_step(stmt);
+    int get_column(cursor& vc, sqlite3_context* ctx, int col)
+    {
+        const auto& name = vc.iter->first;
+        const auto& cwe = vc.iter->second;
 
-        switch (step_res) {
-            case SQLITE_OK:
-            case SQLITE_DONE:
-                continue;
-            case SQLITE_ROW:
+        switch (col) {
+            case 0:
+                to_sqlite(ctx, name);
+                break;
+            case 1:
+                to_sqlite(ctx, cwe.cwe_enabled);
+                break;
+            case 2:
+                to_sqlite(ctx, cwe.cwe_plan->is_native());
+                break;
+            case 3:
+                to_sqlite(ctx, cwe.cwe_lines);
+                break;
+            case 4:
+                to_sqlite(ctx, cwe.cwe_prefiltered);
+                break;
+            case 5:
+                to_sqlite(ctx, cwe.cwe_native);
+                break;
+            case 6:
+                to_sqlite(ctx, cwe.cwe_sqlite);
+                break;
+            case 7:
+                to_sqlite(ctx, cwe.cwe_matches);
+                break;
+            case 8:
+                to_sqlite(
+                    ctx,
+                    std::chrono::duration_cast<std::chrono::microseconds>(
+                        cwe.cwe_eval_time)
+                        .count());
                 break;
-            default: {
-                log_error("failed to execute watch expression: %s -- %s",
-                          watch_pair.first.c_str(),
-                          sqlite3_errmsg(lnav_db));
-                watch_pair.second.cwe_enabled = false;
-                continue;
-            }
         }
 
-        if (!timestamp_buffer[0]) {
-            sql_strftime(timestamp_buffer,
-                         sizeof(timestamp_buffer),
-                         ll->get_timeval(),
-                         'T');
-        }
-        auto lmd = lnav::events::log::msg_detected{
-            watch_pair.first,
-            lf.get_filename(),
-            lf.get_format_name().to_string(),
-            (uint32_t) line_number,
-            timestamp_buffer,
-        };
-        for (const auto& lv : values.lvv_values) {
-            switch (lv.lv_meta.lvm_kind) {
-                case value_kind_t::VALUE_NULL:
-                    lmd.md_values[lv.lv_meta.lvm_name.to_string()]
-                        = null_value_t{};
-                    break;
-                case value_kind_t::VALUE_BOOLEAN:
-                    lmd.md_values[lv.lv_meta.lvm_name.to_string()]
-                        = lv.lv_value.i ? true : false;
-                    break;
-                case value_kind_t::VALUE_INTEGER:
-                    lmd.md_values[lv.lv_meta.lvm_name.to_string()]
-                        = lv.lv_value.i;
-                    break;
-                case value_kind_t::VALUE_FLOAT:
-                    lmd.md_values[lv.lv_meta.lvm_name.to_string()]
-                        = lv.lv_value.d;
-                    break;
-                default:
-                    lmd.md_values[lv.lv_meta.lvm_name.to_string()]
-                        = lv.to_string();
-                    break;
-            }
-        }
-        lnav::events::publish(lnav_db, lmd);
+        return SQLITE_OK;
     }
-}
+};
+
+auto watch_stats_binder
+    = injector::bind_multiple<vtab_module_base>()
+          .add<vtab_module<tvt_no_update<lnav_watch_expr_stats>>>();
+
+}  // namespace
 
-}  // namespace lnav::log::watch
\ No newline at end of file
+}  // namespace lnav::log::watch
@@ -30,11 +30,27 @@
 #ifndef lnav_log_watch_hh
 #define lnav_log_watch_hh
 
+#include <vector>
+
 #include "logfile.hh"
 
 namespace lnav::log::watch {
 
-void eval_with(logfile& lf, logfile::iterator ll);
+/**
+ * @return True if there are any enabled watch expressions.
+ */
+bool is_active();
+
+/**
+ * Evaluate the watch expressions against a batch of newly indexed messages
+ * and publish a "msg_detected" event for each match.  This must be called on
+ * the main thread since the expressions are evaluated using the lnav
+ * database connection.
+ *
+ * @param lf The file containing the messages.
+ * @param line_numbers The line numbers of the start of the messages.
+ */
+void eval_batch(logfile& lf, const std::vector<uint32_t>& line_numbers);
 
 }
 
@@ -28,7 +28,9 @@
  */
 
 #include <algorithm>
+#include <array>
 #include <memory>
+#include <mutex>
 
 #include <fnmatch.h>
 #include <stdio.h>
@@ -45,6 +47,7 @@
 #include "command_executor.hh"
 #include "config.h"
 #include "fmt/format.h"
+#include "hasher.hh"
 #include "lnav_util.hh"
 #include "log_format_ext.hh"
 #include "log_search_table.hh"
@@ -73,8 +76,10 @@ constexpr string_attr_type<void> L_OPID("opid");
 constexpr string_attr_type<bookmark_metadata*> L_META("meta");
 
 external_log_format::mod_map_t external_log_format::MODULE_FORMATS;
+static std::mutex MODULE_FORMATS_MUTEX;
 std::vector<std::shared_ptr<external_log_format>>
     external_log_format::GRAPH_ORDERED_FORMATS;
+lnav::aho_corasick external_log_format::PREFILTER;
 
 const intern_string_t log_format::LOG_TIME_STR
     = intern_string::lookup("log_time");
@@ -1391,6 +1396,324 @@ external_log_format::get_snippets() const
     return retval;
 }
 
+namespace {
+
+/**
+ * A quick structural pass over a JSON log line that looks for containers
+ * that do not hold any of the format's values.  The line is then given to
+ * yajl in segments with those containers replaced by empty ones.  The
+ * callbacks still see every value the format needs, but the parser does
+ * not have to tokenize the rest of the message.
+ *
+ * The skipped containers are only checked for balanced brackets and
+ * strings, anything else that is malformed results in the whole line
+ * being parsed as usual.
+ */
+class json_container_skipper {
+public:
+    using segment = std::pair<const unsigned char*, size_t>;
+
+    json_container_skipper(
+        const robin_hood::unordered_set<string_fragment, frag_hasher>& paths,
+        std::vector<segment>& segments,
+        std::string& path)
+        : jcs_paths(paths), jcs_segments(segments), jcs_path(path)
+    {
+    }
+
+    /**
+     * @return True if the line was split into segments with at least one
+     *   container skipped.
+     */
+    bool split(const string_fragment& line)
+    {
+        this->jcs_segments.clear();
+        this->jcs_path.clear();
+        this->jcs_end = line.data() + line.length();
+        this->jcs_segment_start = line.data();
+
+        auto* curr = this->skip_ws(line.data());
+        if (curr >= this->jcs_end || *curr != '{') {
+            return false;
+        }
+        curr = this->walk_object(curr);
+        if (curr == nullptr || this->jcs_segments.empty()) {
+            return false;
+        }
+        this->add_segment(this->jcs_end);
+
+        return true;
+    }
+
+private:
+    static constexpr size_t MAX_DEPTH = 64;
+
+    const char* skip_ws(const char* curr) const
+    {
+        while (curr < this->jcs_end
+               && (*curr == ' ' || *curr == '\t' || *curr == '\r'
+                   || *curr == '\n'))
+        {
+            curr += 1;
+        }
+        return curr;
+    }
+
+    const char* skip_string(const char* curr) const
+    {
+        auto* str_start = curr + 1;
+
+        curr = str_start;
+        while (true) {
+            auto* quote = (const char*) memchr(curr, '"', this->jcs_end - curr);
+            if (quote == nullptr) {
+                return nullptr;
+            }
+
+            auto* esc = quote;
+            while (esc > str_start && esc[-1] == '\\') {
+                esc -= 1;
+            }
+            if ((quote - esc) % 2 == 0) {
+                return quote + 1;
+            }
+            curr = quote + 1;
+        }
+    }
+
+    const char* skip_scalar(const char* curr) const
+    {
+        auto* start = curr;
+
+        while (curr < this->jcs_end) {
+            switch (*curr) {
+                case ',':
+                case '}':
+                case ']':
+                case ' ':
+                case '\t':
+                case '\r':
+                case '\n':
+                    return curr == start ? nullptr : curr;
+                default:
+                    curr += 1;
+                    break;
+            }
+        }
+        return nullptr;
+    }
+
+    const char* skip_container(const char* curr) const
+    {
+        static const auto STRUCTURAL = [] {
+            std::array<bool, 256> retval{};
+
+            for (const auto ch : {'"', '{', '}', '[', ']'}) {
+                retval[(unsigned char) ch] = true;
+            }
+            return retval;
+        }();
+        char closers[MAX_DEPTH];
+        size_t depth = 0;
+
+        while (curr < this->jcs_end) {
+            if (!STRUCTURAL[(unsigned char) *curr]) {
+                curr += 1;
+                continue;
+            }
+            switch (*curr) {
+                case '"':
+                    curr = this->skip_string(curr);
+                    if (curr == nullptr) {
+                        return nullptr;
+                    }
+                    continue;
+                case '{':
+                case '[':
+                    if (depth == MAX_DEPTH) {
+                        return nullptr;
+                    }
+                    closers[depth++] = *curr == '{' ? '}' : ']';
+                    break;
+                case '}':
+                case ']':
+                    if (depth == 0 || closers[--depth] != *curr) {
+                        return nullptr;
+                    }
+                    if (depth == 0) {
+                        return curr + 1;
+                    }
+                    break;
+                default:
+                    break;
+            }
+            curr += 1;
+        }
+        return nullptr;
+    }
+
+    void add_segment(const char* end)
+    {
+        this->jcs_segments.emplace_back(
+            (const unsigned char*) this->jcs_segment_start,
+            end - this->jcs_segment_start);
+    }
+
+    bool is_needed() const
+    {
+        return this->jcs_opaque_keys > 0
+            || this->jcs_paths.count(string_fragment::from_str(this->jcs_path))
+            > 0;
+    }
+
+    const char* walk_value(const char* curr)
+    {
+        switch (*curr) {
+            case '{':
+            case '[': {
+                if (this->is_needed()) {
+                    return *curr == '{' ? this->walk_object(curr)
+                                        : this->walk_array(curr);
+                }
+
+                auto* after = this->skip_container(curr);
+                if (after == nullptr) {
+                    return nullptr;
+                }
+                this->add_segment(curr);
+                this->jcs_segments.emplace_back(
+                    (const unsigned char*) (*curr == '{' ? "{}" : "[]"), 2);
+                this->jcs_segment_start = after;
+                return after;
+            }
+            case '"':
+                return this->skip_string(curr);
+            default:
+                return this->skip_scalar(curr);
+        }
+    }
+
+    const char* walk_object(const char* curr)
+    {
+        if (this->jcs_depth == MAX_DEPTH) {
+            return nullptr;
+        }
+
+        const auto path_size = this->jcs_path.size();
+
+        this->jcs_depth += 1;
+        curr = this->skip_ws(curr + 1);
+        if (curr < this->jcs_end && *curr == '}') {
+            this->jcs_depth -= 1;
+            return curr + 1;
+        }
+        while (curr < this->jcs_end) {
+            if (*curr != '"') {
+                return nullptr;
+            }
+
+            auto* key_end = this->skip_string(curr);
+            if (key_end == nullptr) {
+                return nullptr;
+            }
+
+            auto key = string_fragment::from_bytes(curr + 1,
+                                                   key_end - curr - 2);
+            // Keys that yajlpp would escape in the path are not looked up,
+            // the values under them are always parsed.
+            auto opaque = key.find('\\') || key.find('/') || key.find('#')
+                || key.find('~');
+
+            this->jcs_path.resize(path_size);
+            if (path_size > 0) {
+                this->jcs_path.push_back('/');
+            }
+            this->jcs_path.append(key.data(), key.length());
+
+            curr = this->skip_ws(key_end);
+            if (curr >= this->jcs_end || *curr != ':') {
+                return nullptr;
+            }
+            curr = this->skip_ws(curr + 1);
+            if (curr >= this->jcs_end) {
+                return nullptr;
+            }
+            if (opaque) {
+                this->jcs_opaque_keys += 1;
+            }
+            curr = this->walk_value(curr);
+            if (opaque) {
+                this->jcs_opaque_keys -= 1;
+            }
+            if (curr == nullptr) {
+                return nullptr;
+            }
+            curr = this->skip_ws(curr);
+            if (curr >= this->jcs_end) {
+                return nullptr;
+            }
+            if (*curr == '}') {
+                this->jcs_path.resize(path_size);
+                this->jcs_depth -= 1;
+                return curr + 1;
+            }
+            if (*curr != ',') {
+                return nullptr;
+            }
+            curr = this->skip_ws(curr + 1);
+        }
+        return nullptr;
+    }
+
+    const char* walk_array(const char* curr)
+    {
+        if (this->jcs_depth == MAX_DEPTH) {
+            return nullptr;
+        }
+
+        const auto path_size = this->jcs_path.size();
+
+        this->jcs_depth += 1;
+        this->jcs_path.push_back('#');
+        curr = this->skip_ws(curr + 1);
+        if (curr < this->jcs_end && *curr == ']') {
+            this->jcs_path.resize(path_size);
+            this->jcs_depth -= 1;
+            return curr + 1;
+        }
+        while (curr < this->jcs_end) {
+            curr = this->walk_value(curr);
+            if (curr == nullptr) {
+                return nullptr;
+            }
+            curr = this->skip_ws(curr);
+            if (curr >= this->jcs_end) {
+                return nullptr;
+            }
+            if (*curr == ']') {
+                this->jcs_path.resize(path_size);
+                this->jcs_depth -= 1;
+                return curr + 1;
+            }
+            if (*curr != ',') {
+                return nullptr;
+            }
+            curr = this->skip_ws(curr + 1);
+        }
+        return nullptr;
+    }
+
+    const robin_hood::unordered_set<string_fragment, frag_hasher>& jcs_paths;
+    std::vector<segment>& jcs_segments;
+    std::string& jcs_path;
+    const char* jcs_end{nullptr};
+    const char* jcs_segment_start{nullptr};
+    size_t jcs_depth{0};
+    size_t jcs_opaque_keys{0};
+};
+
+}  // namespace
+
 log_format::scan_result_t
 external_log_format::scan_json(std::vector<logline>& dst,
                                const line_info& li,
@@ -1448,7 +1771,28 @@ external_log_format::scan_json(std::vector<logline>& dst,
     jlu.jlu_line_size = sbr.length();
     jlu.jlu_handle = handle;
     jlu.jlu_format_hits.resize(this->jlf_line_format.size());
-    if (yajl_parse(handle, line_data, sbr.length()) == yajl_status_ok
+
+    auto parse_status = yajl_status_ok;
+    // Only lines with nested containers can have something to skip.
+    auto split = memchr(line_data + 1, '{', sbr.length() - 1) != nullptr
+        || memchr(line_data, '[', sbr.length()) != nullptr;
+    if (split) {
+        split = json_container_skipper(this->jlf_container_paths,
+                                       this->jlf_scan_segments,
+                                       this->jlf_scan_path)
+                    .split(line_frag);
+    }
+    if (split) {
+        for (const auto& seg : this->jlf_scan_segments) {
+            parse_status = yajl_parse(handle, seg.first, seg.second);
+            if (parse_status != yajl_status_ok) {
+                break;
+            }
+        }
+    } else {
+        parse_status = yajl_parse(handle, line_data, sbr.length());
+    }
+    if (parse_status == yajl_status_ok
         && yajl_complete_parse(handle) == yajl_status_ok)
     {
         if (ll.get_time<std::chrono::microseconds>().count() == 0) {
@@ -1540,16 +1884,31 @@ external_log_format::scan_json(std::vector<logline>& dst,
     } else {
         unsigned char* msg;
         int line_count = 2;
-
-        msg = yajl_get_error(
-            handle, 1, (const unsigned char*) sbr.get_data(), sbr.length());
+        auto err_handle = handle;
+
+        if (split) {
+            // The offsets in the handle are for the segments, so parse the
+            // whole line again without the callbacks to get an error that
+            // points into the line.
+            err_handle = yajl_alloc(nullptr, nullptr, nullptr);
+            yajl_config(err_handle, yajl_dont_validate_strings, 1);
+            if (yajl_parse(err_handle, line_data, sbr.length())
+                == yajl_status_ok)
+            {
+                yajl_complete_parse(err_handle);
+            }
+        }
+        msg = yajl_get_error(err_handle, 1, line_data, sbr.length());
         if (msg != nullptr) {
             auto msg_frag = string_fragment::from_c_str(msg);
             log_debug("Unable to parse line at offset %d: %s",
                       li.li_file_range.fr_offset,
                       msg);
             line_count = msg_frag.count('\n') + 1;
-            yajl_free_error(handle, msg);
+            yajl_free_error(err_handle, msg);
+        }
+        if (split) {
+            yajl_free(err_handle);
         }
         if (!this->lf_specialized) {
             return scan_no_match{"JSON parsing failed"};
@@ -1599,6 +1958,9 @@ external_log_format::scan(logfile& lf,
     int pat_index = orig_lock;
     auto line_sf = sbr.to_string_fragment();
     thread_local auto md = lnav::pcre2pp::match_data::unitialized();
+    thread_local std::vector<bool> local_prefilter_hits;
+    const auto* prefilter_hits = sbc.sbc_prefilter_hits;
+    auto tried_count = 0;
 
     while (::next_format(this->elf_pattern_order, curr_fmt, pat_index)) {
         auto* fpat = this->elf_pattern_order[curr_fmt].get();
@@ -1608,8 +1970,16 @@ external_log_format::scan(logfile& lf,
             continue;
         }
 
-        auto found_match
-            = pat->capture_from(line_sf).into(md).found_p(PCRE2_NO_UTF_CHECK);
+        // The first pattern tried is usually the one that matched the
+        // previous line, so only run the prefilter once that fails.
+        if (prefilter_hits == nullptr && tried_count > 0) {
+            PREFILTER.find_all(line_sf, local_prefilter_hits);
+            prefilter_hits = &local_prefilter_hits;
+        }
+        tried_count += 1;
+
+        auto found_match = fpat->could_match(line_sf, prefilter_hits)
+            && pat->capture_from(line_sf).into(md).found_p(PCRE2_NO_UTF_CHECK);
         if (!found_match) {
             if (!this->lf_pattern_locks.empty() && pat_index != -1) {
                 curr_fmt = -1;
@@ -1755,6 +2125,7 @@ external_log_format::scan(logfile& lf,
             if (mod_cap && body_cap) {
                 intern_string_t mod_name
                     = intern_string::lookup(mod_cap.value());
+                std::unique_lock<std::mutex> mod_lock(MODULE_FORMATS_MUTEX);
                 auto mod_iter = MODULE_FORMATS.find(mod_name);
 
                 if (mod_iter == MODULE_FORMATS.end()) {
@@ -1763,6 +2134,7 @@ external_log_format::scan(logfile& lf,
                 } else if (mod_iter->second.mf_mod_format) {
                     mod_index = mod_iter->second.mf_mod_format->lf_mod_index;
                 }
+                mod_lock.unlock();
 
                 if (mod_index && level_cap && body_cap) {
                     auto mod_elf
@@ -2099,9 +2471,12 @@ external_log_format::annotate(logfile* lf,
     bool did_mod_annotate_body = false;
     if (annotate_module && module_cap && body_cap && body_cap->is_valid()) {
         intern_string_t mod_name = intern_string::lookup(module_cap.value());
+        std::unique_lock<std::mutex> mod_lock(MODULE_FORMATS_MUTEX);
         auto mod_iter = MODULE_FORMATS.find(mod_name);
+        auto mod_end = MODULE_FORMATS.end();
+        mod_lock.unlock();
 
-        if (mod_iter != MODULE_FORMATS.end()
+        if (mod_iter != mod_end
             && mod_iter->second.mf_mod_format != nullptr)
         {
             auto& mf = mod_iter->second;
@@ -2281,11 +2656,12 @@ read_json_field(yajlpp_parse_context* ypc,
                 jlu->jlu_format->convert_level(frag, jlu->jlu_batch_context));
         }
     }
-    if (jlu->jlu_format->elf_level_field == field_name) {
+    if (field_name.empty()) {
+    } else if (jlu->jlu_format->elf_level_field == field_name) {
         jlu->jlu_base_line->set_level(
             jlu->jlu_format->convert_level(frag, jlu->jlu_batch_context));
     }
-    if (jlu->jlu_format->elf_opid_field == field_name) {
+    if (!field_name.empty() && jlu->jlu_format->elf_opid_field == field_name) {
         jlu->jlu_base_line->set_opid(frag.hash());
 
         auto& sbc = *jlu->jlu_batch_context;
@@ -3520,6 +3896,11 @@ external_log_format::build(std::vector<lnav::console::user_message>& errors)
     }
 
     if (!this->lf_timestamp_format.empty()) {
+        // Compile the custom timestamp formats now instead of interpreting
+        // the format strings for every message.
+        for (const auto* ts_fmt : this->lf_timestamp_format) {
+            ptime_program::lookup(ts_fmt);
+        }
         this->lf_timestamp_format.push_back(nullptr);
     }
     for (auto iter = this->elf_patterns.begin();
@@ -3843,10 +4224,54 @@ external_log_format::build(std::vector<lnav::console::user_message>& errors)
     }
 
     if (this->elf_type == elf_type_t::ELF_TYPE_JSON) {
+        auto add_container_paths = [this](const intern_string_t& field) {
+            if (field.empty()) {
+                return;
+            }
+
+            auto name = field.to_string_fragment();
+            if (name.startswith("/")) {
+                name = name.substr(1);
+            }
+            for (int lpc = 1; lpc < name.length(); lpc++) {
+                if (name[lpc] == '/' || name[lpc] == '#') {
+                    this->jlf_container_paths.emplace(
+                        name.sub_range(0, lpc));
+                }
+            }
+        };
+
         for (const auto& vd : this->elf_value_def_order) {
-            this->elf_value_def_frag_map[vd->vd_meta.lvm_name
-                                             .to_string_fragment()]
+            this->elf_value_def_frag_map[vd->vd_meta
+                                             .lvm_name.to_string_fragment()]
                 = vd.get();
+            add_container_paths(vd->vd_meta.lvm_name);
+        }
+
+        // The special fields are read from their path in the line, which
+        // is not always the name of their value definition (e.g. the opid
+        // is renamed to "log_opid").
+        for (const auto& field : {
+                 this->lf_timestamp_field,
+                 this->lf_subsecond_field,
+                 this->lf_time_field,
+                 this->elf_level_field,
+                 this->elf_body_field,
+                 this->elf_module_id_field,
+                 this->elf_opid_field,
+                 this->elf_subid_field,
+             })
+        {
+            add_container_paths(field);
+        }
+        for (const auto& desc_defs :
+             {this->lf_opid_description_def, this->lf_subid_description_def})
+        {
+            for (const auto& desc_pair : *desc_defs) {
+                for (const auto& od : *desc_pair.second.od_descriptors) {
+                    add_container_paths(od.od_field.pp_value);
+                }
+            }
         }
     }
 
@@ -4414,6 +4839,40 @@ external_log_format::specialized(int fmt_lock)
     return retval;
 }
 
+bool
+external_log_format::is_thread_safe() const
+{
+    // The root formats are shared by all the files that are still being
+    // detected, only the specialized copies are owned by a single file.
+    return this->lf_specialized;
+}
+
+std::optional<std::string>
+external_log_format::get_cache_key() const
+{
+    // The fields for self-describing formats come from the file itself.
+    if (this->lf_is_self_describing) {
+        return std::nullopt;
+    }
+
+    auto retval = hasher();
+
+    retval.update(std::string(VCS_PACKAGE_STRING))
+        .update(this->elf_name.to_string());
+    for (const auto& path : this->elf_format_source_order) {
+        retval.update(path.string());
+
+        auto stat_res = lnav::filesystem::stat_file(path);
+        if (stat_res.isOk()) {
+            auto st = stat_res.unwrap();
+
+            retval.update(st.st_mtime).update(st.st_size);
+        }
+    }
+
+    return retval.to_string();
+}
+
 log_format::match_name_result
 external_log_format::match_name(const std::string& filename)
 {
@@ -4779,6 +5238,23 @@ external_log_format::get_value_metadata() const
     return retval;
 }
 
+bool
+external_log_format::may_have_value(const intern_string_t name) const
+{
+    // JSON messages and module formats can bring in values that are not
+    // defined by this format.
+    if (this->elf_type != elf_type_t::ELF_TYPE_TEXT) {
+        return true;
+    }
+    for (const auto& pat : this->elf_pattern_order) {
+        if (pat->p_module_format || pat->p_module_field_index != -1) {
+            return true;
+        }
+    }
+
+    return this->has_value_def(name);
+}
+
 const logline_value_stats*
 external_log_format::stats_for_value(const intern_string_t& name) const
 {
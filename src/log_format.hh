@@ -517,6 +517,22 @@ public:
 
     virtual std::shared_ptr<log_format> specialized(int fmt_lock = -1) = 0;
 
+    /**
+     * @return True if this format instance can scan lines on a thread other
+     * than the main one while other formats are doing the same.
+     */
+    virtual bool is_thread_safe() const { return false; }
+
+    /**
+     * @return A key that changes when the definition of this format changes
+     * or nullopt if the results of scanning with this format should not be
+     * saved.
+     */
+    virtual std::optional<std::string> get_cache_key() const
+    {
+        return std::nullopt;
+    }
+
     virtual std::shared_ptr<log_vtab_impl> get_vtab_impl() const
     {
         return nullptr;
@@ -580,6 +596,16 @@ public:
         return {};
     }
 
+    /**
+     * @return False if messages in this format can never have a value with
+     * the given name.  The default is true since the values for most formats
+     * are not known ahead of time.
+     */
+    virtual bool may_have_value(const intern_string_t name) const
+    {
+        return true;
+    }
+
     virtual bool format_changed() { return false; }
 
     struct pattern_for_lines {
@@ -37,6 +37,7 @@
 #include <unordered_map>
 #include <vector>
 
+#include "base/aho_corasick.hh"
 #include "log_format.hh"
 #include "log_search_table_fwd.hh"
 #include "yajlpp/yajlpp.hh"
@@ -113,6 +114,36 @@ public:
         int p_timestamp_end{-1};
         bool p_module_format{false};
         std::set<size_t> p_matched_samples;
+        /** IDs of literals in the PREFILTER that the pattern requires. */
+        std::vector<lnav::aho_corasick::literal_id> p_prefilter_literals;
+        uint32_t p_min_length{0};
+
+        /**
+         * Check whether this pattern could possibly match a line without
+         * running the regex.
+         *
+         * @param line The line to be matched.
+         * @param prefilter_hits The result of running the PREFILTER over
+         *   the line or nullptr if only the length should be checked.
+         */
+        bool could_match(string_fragment line,
+                         const std::vector<bool>* prefilter_hits) const
+        {
+            if ((uint32_t) line.length() < this->p_min_length) {
+                return false;
+            }
+            if (prefilter_hits == nullptr) {
+                return true;
+            }
+            for (auto lit_id : this->p_prefilter_literals) {
+                if (lit_id < prefilter_hits->size()
+                    && !(*prefilter_hits)[lit_id])
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
     };
 
     struct level_pattern {
@@ -177,6 +208,10 @@ public:
 
     std::shared_ptr<log_format> specialized(int fmt_lock) override;
 
+    bool is_thread_safe() const override;
+
+    std::optional<std::string> get_cache_key() const override;
+
     const logline_value_stats* stats_for_value(
         const intern_string_t& name) const override;
 
@@ -294,6 +329,8 @@ public:
         return iter != this->elf_value_defs.end();
     }
 
+    bool may_have_value(const intern_string_t name) const override;
+
     std::string get_pattern_path(uint64_t line_number) const override
     {
         if (this->elf_type != elf_type_t::ELF_TYPE_TEXT) {
@@ -314,6 +351,12 @@ public:
     static mod_map_t MODULE_FORMATS;
     static std::vector<std::shared_ptr<external_log_format>>
         GRAPH_ORDERED_FORMATS;
+    /**
+     * Matcher for the literals required by the patterns in all of the text
+     * formats.  Running it once over a line lets the format detection skip
+     * the patterns that cannot match without calling into PCRE2.
+     */
+    static lnav::aho_corasick PREFILTER;
 
     std::set<std::string> elf_source_path;
     std::vector<std::filesystem::path> elf_format_source_order;
@@ -461,6 +504,14 @@ public:
     string_attrs_t jlf_line_attrs;
     std::shared_ptr<yajlpp_parse_context> jlf_parse_context;
     std::shared_ptr<yajl_handle_t> jlf_yajl_handle;
+    /**
+     * The paths of the JSON containers that hold a value definition.  Any
+     * other container in a line can be skipped when scanning.
+     */
+    robin_hood::unordered_set<string_fragment, frag_hasher>
+        jlf_container_paths;
+    std::vector<std::pair<const unsigned char*, size_t>> jlf_scan_segments;
+    std::string jlf_scan_path;
     shared_buffer jlf_share_manager;
 
 private:
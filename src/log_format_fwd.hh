@@ -32,6 +32,7 @@
 #ifndef lnav_log_format_fwd_hh
 #define lnav_log_format_fwd_hh
 
+#include <algorithm>
 #include <chrono>
 #include <cstdint>
 #include <optional>
@@ -127,6 +128,11 @@ struct scan_batch_context {
     std::string sbc_cached_level_strings[4];
     log_level_t sbc_cached_level_values[4];
     size_t sbc_cached_level_count{0};
+    /**
+     * The result of running the format prefilter over the current line, if
+     * it has already been done.
+     */
+    const std::vector<bool>* sbc_prefilter_hits{nullptr};
 };
 
 extern const string_attr_type<void> L_PREFIX;
@@ -139,10 +145,18 @@ extern const string_attr_type<void> L_OPID;
 extern const string_attr_type<bookmark_metadata*> L_META;
 
 /**
- * Metadata for a single line in a log file.
+ * Metadata for a single line in a log file.  There can be hundreds of
+ * millions of these in memory, so the fields are packed into 20 bytes.
  */
-class logline {
+class __attribute__((packed, aligned(4))) logline {
 public:
+    /**
+     * The range of timestamps that can be stored, roughly the years 828
+     * through 3112.  Times outside of this range are clamped.
+     */
+    static constexpr int64_t MAX_TIME_US = (int64_t{1} << 55) - 1;
+    static constexpr int64_t MIN_TIME_US = -(int64_t{1} << 55);
+
     /**
      * Construct a logline object with the given values.
      *
@@ -156,12 +170,11 @@ public:
             log_level_t lev,
             uint8_t mod = 0,
             uint16_t opid = 0)
-        : ll_offset(off), ll_has_ansi(false), ll_time(t), ll_opid(opid),
-          ll_sub_offset(0), ll_valid_utf(1), ll_level(lev), ll_module_id(mod),
+        : ll_offset(off), ll_sub_offset(0), ll_has_ansi(false), ll_schema(0),
+          ll_valid_utf(1), ll_opid(opid), ll_level(lev), ll_module_id(mod),
           ll_meta_mark(0), ll_expr_mark(0)
     {
-        this->ll_schema[0] = 0;
-        this->ll_schema[1] = 0;
+        this->set_time(t);
     }
 
     logline(file_off_t off,
@@ -169,13 +182,11 @@ public:
             log_level_t lev,
             uint8_t mod = 0,
             uint16_t opid = 0)
-        : ll_offset(off), ll_has_ansi(false), ll_opid(opid), ll_sub_offset(0),
-          ll_valid_utf(1), ll_level(lev), ll_module_id(mod), ll_meta_mark(0),
-          ll_expr_mark(0)
+        : ll_offset(off), ll_sub_offset(0), ll_has_ansi(false), ll_schema(0),
+          ll_valid_utf(1), ll_opid(opid), ll_level(lev), ll_module_id(mod),
+          ll_meta_mark(0), ll_expr_mark(0)
     {
         this->set_time(tv);
-        this->ll_schema[0] = 0;
-        this->ll_schema[1] = 0;
     }
 
     /** @return The offset of the line in the file. */
@@ -188,7 +199,8 @@ public:
     template<typename S>
     S get_time() const
     {
-        return std::chrono::duration_cast<S>(this->ll_time);
+        return std::chrono::duration_cast<S>(
+            std::chrono::microseconds{this->ll_time});
     }
 
     template<typename S>
@@ -196,7 +208,8 @@ public:
     {
         static constexpr auto ONE_SEC = std::chrono::seconds(1);
 
-        return std::chrono::duration_cast<S>(this->ll_time % ONE_SEC);
+        return std::chrono::duration_cast<S>(
+            std::chrono::microseconds{this->ll_time} % ONE_SEC);
     }
 
     void to_exttm(struct exttm& tm_out) const
@@ -212,8 +225,10 @@ public:
     template<typename T>
     void set_time(T t)
     {
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(t);
+
         this->ll_time
-            = std::chrono::duration_cast<std::chrono::microseconds>(t);
+            = std::clamp<int64_t>(us.count(), MIN_TIME_US, MAX_TIME_US);
     }
 
     timeval get_timeval() const
@@ -225,13 +240,14 @@ public:
         };
     }
 
-    void set_time(const timeval& tv) { this->ll_time = to_us(tv); }
+    void set_time(const timeval& tv) { this->set_time(to_us(tv)); }
 
     template<typename T>
     void set_subsecond_time(T sub)
     {
-        this->ll_time
-            += std::chrono::duration_cast<std::chrono::microseconds>(sub);
+        this->set_time(this->get_time<std::chrono::microseconds>()
+                       + std::chrono::duration_cast<std::chrono::microseconds>(
+                           sub));
     }
 
     void set_ignore(bool val)
@@ -325,10 +341,7 @@ public:
     /**
      * @return  True if there is a schema value set for this log line.
      */
-    bool has_schema() const
-    {
-        return (this->ll_schema[0] != 0 || this->ll_schema[1] != 0);
-    }
+    bool has_schema() const { return this->ll_schema != 0; }
 
     /**
      * Set the "schema" for this log line.  The schema ID is used to match log
@@ -339,21 +352,21 @@ public:
      */
     void set_schema(const byte_array<2, uint64_t>& ba)
     {
-        memcpy(this->ll_schema, ba.in(), sizeof(this->ll_schema));
+        this->ll_schema = ba.in()[0] & SCHEMA_MASK;
     }
 
     /**
      * Perform a partial match of the given schema against this log line.
-     * Storing the full schema is not practical, so we just keep the first four
-     * bytes.
+     * Storing the full schema is not practical, so we just keep the low
+     * seven bits.
      *
      * @param  ba The SHA-1 hash of the constant parts of a log line.
-     * @return    True if the first four bytes of the given schema match the
-     *   schema stored in this log line.
+     * @return    True if the low bits of the given schema match the schema
+     *   stored in this log line.
      */
     bool match_schema(const byte_array<2, uint64_t>& ba) const
     {
-        return memcmp(this->ll_schema, ba.in(), sizeof(this->ll_schema)) == 0;
+        return this->ll_schema == (ba.in()[0] & SCHEMA_MASK);
     }
 
     /**
@@ -369,7 +382,7 @@ public:
 
     bool operator<(const std::chrono::microseconds& rhs) const
     {
-        return this->ll_time < rhs;
+        return this->ll_time < rhs.count();
     }
 
     bool operator<(const struct timeval& rhs) const
@@ -383,19 +396,25 @@ public:
     }
 
 private:
-    file_off_t ll_offset : 63;
-    uint8_t ll_has_ansi : 1;
-    std::chrono::microseconds ll_time;
+    static constexpr uint64_t SCHEMA_MASK = 0x7f;
+
+    /** The offset uses 48 bits, which covers files of up to 256TB. */
+    uint64_t ll_offset : 48;
+    uint64_t ll_sub_offset : 15;
+    uint64_t ll_has_ansi : 1;
+    /** The timestamp in microseconds. */
+    int64_t ll_time : 56;
+    uint64_t ll_schema : 7;
+    uint64_t ll_valid_utf : 1;
     uint16_t ll_opid;
-    unsigned int ll_sub_offset : 15;
-    unsigned int ll_valid_utf : 1;
     uint8_t ll_level;
     uint8_t ll_module_id : 6;
     uint8_t ll_meta_mark : 1;
     uint8_t ll_expr_mark : 1;
-    char ll_schema[2];
 };
 
+static_assert(sizeof(logline) == 20);
+
 struct format_tag_def {
     explicit format_tag_def(std::string name) : ftd_name(std::move(name)) {}
 
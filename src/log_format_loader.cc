@@ -1391,6 +1391,71 @@ load_from_path(const std::filesystem::path& path,
     }
 }
 
+/**
+ * Build the multi-pattern prefilter from the literals that are required by
+ * the regexes in the text formats.
+ */
+static void
+build_format_prefilter(
+    const std::vector<std::shared_ptr<external_log_format>>& formats)
+{
+    static constexpr size_t MIN_LITERAL_LENGTH = 2;
+    static constexpr size_t MAX_LITERALS_PER_PATTERN = 3;
+
+    lnav::aho_corasick prefilter;
+    size_t filtered_patterns = 0;
+
+    for (const auto& elf : formats) {
+        if (elf->elf_type != external_log_format::elf_type_t::ELF_TYPE_TEXT) {
+            continue;
+        }
+
+        for (auto& pat : elf->elf_pattern_order) {
+            const auto* code = pat->p_pcre.pp_value.get();
+
+            pat->p_prefilter_literals.clear();
+            pat->p_min_length = 0;
+            if (code == nullptr) {
+                continue;
+            }
+
+            auto literals = code->get_required_literals();
+            literals.erase(std::remove_if(literals.begin(),
+                                          literals.end(),
+                                          [](const auto& lit) {
+                                              return lit.size()
+                                                  < MIN_LITERAL_LENGTH;
+                                          }),
+                           literals.end());
+            // The longest literals are the least likely to show up by
+            // chance, so they do the most filtering.
+            std::stable_sort(
+                literals.begin(),
+                literals.end(),
+                [](const auto& lhs, const auto& rhs) {
+                    return lhs.size() > rhs.size();
+                });
+            if (literals.size() > MAX_LITERALS_PER_PATTERN) {
+                literals.resize(MAX_LITERALS_PER_PATTERN);
+            }
+            for (const auto& lit : literals) {
+                pat->p_prefilter_literals.emplace_back(
+                    prefilter.add(string_fragment::from_str(lit)));
+            }
+            if (!literals.empty()) {
+                filtered_patterns += 1;
+            }
+            pat->p_min_length = code->get_min_length();
+        }
+    }
+
+    prefilter.compile();
+    log_info("format prefilter has %zu literals for %zu patterns",
+             prefilter.size(),
+             filtered_patterns);
+    external_log_format::PREFILTER = std::move(prefilter);
+}
+
 void
 load_formats(const std::vector<std::filesystem::path>& extra_paths,
              std::vector<lnav::console::user_message>& errors)
@@ -1507,6 +1572,8 @@ load_formats(const std::vector<std::filesystem::path>& extra_paths,
         log_info("  %s", graph_ordered_format->get_name().get());
     }
 
+    build_format_prefilter(graph_ordered_formats);
+
     auto& roots = log_format::get_root_formats();
     auto iter = std::find_if(roots.begin(), roots.end(), [](const auto& elem) {
         return elem->get_name() == "generic_log";
@@ -51,8 +51,6 @@ using namespace lnav::roles::literals;
 
 static auto intern_lifetime = intern_string::get_table_lifetime();
 
-static log_cursor log_cursor_latest;
-
 thread_local _log_vtab_data log_vtab_data;
 
 const std::unordered_set<string_fragment, frag_hasher>
@@ -132,8 +130,24 @@ log_vtab_impl::get_table_statement()
         oss << "CREATE TABLE " << this->get_name().to_string() << LOG_COLUMNS;
         this->get_columns(cols);
         this->vi_column_count = cols.size();
+        this->vi_column_orders.clear();
         for (const auto& col : cols) {
             max_name_len = std::max(max_name_len, col.vc_name.length());
+            switch (col.vc_type) {
+                case SQLITE_INTEGER:
+                case SQLITE_FLOAT:
+                    this->vi_column_orders.emplace_back(
+                        column_order_t::numeric);
+                    break;
+                case SQLITE3_TEXT:
+                    this->vi_column_orders.emplace_back(
+                        col.vc_collator.empty() ? column_order_t::binary
+                                                : column_order_t::none);
+                    break;
+                default:
+                    this->vi_column_orders.emplace_back(column_order_t::none);
+                    break;
+            }
         }
         for (const auto& col : cols) {
             std::string comment;
@@ -533,26 +547,13 @@ populate_indexed_columns(vtab_cursor* vc, log_vtab* vt)
             continue;
         }
 
-        auto value = lv_iter->to_string_fragment(ci.ci_string_arena);
-
 #ifdef DEBUG_INDEXING
-        log_debug("updated index for column %d %.*s -> %d",
+        log_debug("updated index for column %d -> %d",
                   ic.cc_column,
-                  value.length(),
-                  value.data(),
                   (int) vc->log_cursor.lc_curr_line);
 #endif
 
-        auto& line_deq = ci.ci_value_to_lines[value];
-        if (line_deq.empty()
-            || (line_deq.front() != vl && line_deq.back() != vl))
-        {
-            if (vc->log_cursor.lc_direction < 0) {
-                line_deq.push_front(vl);
-            } else {
-                line_deq.push_back(vl);
-            }
-        }
+        ci.insert(*lv_iter, vl, vc->log_cursor.lc_direction < 0);
     }
 }
 
@@ -582,10 +583,10 @@ vt_next(sqlite3_vtab_cursor* cur)
     }
     vc->log_cursor.lc_sub_index = 0;
     do {
-        log_cursor_latest = vc->log_cursor;
-        if (((log_cursor_latest.lc_curr_line % 1024) == 0)
+        log_vtab_data.lvd_cursor = vc->log_cursor;
+        if (((log_vtab_data.lvd_cursor.lc_curr_line % 1024) == 0)
             && (log_vtab_data.lvd_progress != nullptr
-                && log_vtab_data.lvd_progress(log_cursor_latest)))
+                && log_vtab_data.lvd_progress(log_vtab_data.lvd_cursor)))
         {
             break;
         }
@@ -651,10 +652,10 @@ vt_next_no_rowid(sqlite3_vtab_cursor* cur)
 
     vc->invalidate();
     do {
-        log_cursor_latest = vc->log_cursor;
-        if (((log_cursor_latest.lc_curr_line % 1024) == 0)
+        log_vtab_data.lvd_cursor = vc->log_cursor;
+        if (((log_vtab_data.lvd_cursor.lc_curr_line % 1024) == 0)
             && (log_vtab_data.lvd_progress != nullptr
-                && log_vtab_data.lvd_progress(log_cursor_latest)))
+                && log_vtab_data.lvd_progress(log_vtab_data.lvd_cursor)))
         {
             break;
         }
@@ -919,10 +920,10 @@ vt_column(sqlite3_vtab_cursor* cur, sqlite3_context* ctx, int col)
                         break;
                     }
                     case log_footer_columns::filters: {
-                        const auto& filter_mask
-                            = (*ld)->ld_filter_state.lfo_filter_state.tfs_mask;
+                        const auto& filter_state
+                            = (*ld)->ld_filter_state.lfo_filter_state;
 
-                        if (!filter_mask[line_number]) {
+                        if (!filter_state.line_has_match(line_number)) {
                             sqlite3_result_null(ctx);
                         } else {
                             const auto& filters = vt->lss->get_filters();
@@ -938,10 +939,9 @@ vt_column(sqlite3_vtab_cursor* cur, sqlite3_context* ctx, int col)
                                         continue;
                                     }
 
-                                    uint32_t mask
-                                        = (1UL << filter->get_index());
-
-                                    if (filter_mask[line_number] & mask) {
+                                    if (filter_state.line_matches(
+                                            line_number, filter->get_index()))
+                                    {
                                         arr.gen(filter->get_index());
                                     }
                                 }
@@ -1431,6 +1431,332 @@ log_cursor::string_constraint::matches(const std::string& sf) const
     }
 }
 
+template<typename T, typename C>
+static void
+sort_new_values(std::vector<T>& values, size_t& sorted_count, C cmp)
+{
+    if (sorted_count == values.size()) {
+        return;
+    }
+
+    auto mid = values.begin() + sorted_count;
+    std::sort(mid, values.end(), cmp);
+    std::inplace_merge(values.begin(), mid, values.end(), cmp);
+    sorted_count = values.size();
+}
+
+static bool
+binary_less(const string_fragment& lhs, const string_fragment& rhs)
+{
+    return lhs.to_string_view() < rhs.to_string_view();
+}
+
+static unsigned char
+ascii_fold(unsigned char ch)
+{
+    if ('A' <= ch && ch <= 'Z') {
+        return ch + ('a' - 'A');
+    }
+    return ch;
+}
+
+/**
+ * Compare strings the way the LIKE operator does, which ignores the case
+ * of ASCII characters.
+ */
+static bool
+folded_less(const string_fragment& lhs, const string_fragment& rhs)
+{
+    return std::lexicographical_compare(
+        lhs.begin(),
+        lhs.end(),
+        rhs.begin(),
+        rhs.end(),
+        [](char l, char r) { return ascii_fold(l) < ascii_fold(r); });
+}
+
+static bool
+folded_startswith(const string_fragment& sf, const string_fragment& prefix)
+{
+    if (sf.length() < prefix.length()) {
+        return false;
+    }
+
+    return std::equal(
+        prefix.begin(), prefix.end(), sf.begin(), [](char l, char r) {
+            return ascii_fold(l) == ascii_fold(r);
+        });
+}
+
+void
+log_vtab_impl::column_index::insert(const logline_value& lv,
+                                    vis_line_t vl,
+                                    bool reverse)
+{
+    auto value = lv.to_string_fragment(this->ci_string_arena);
+    auto kind = lv.lv_meta.lvm_kind;
+    double number = 0.0;
+
+    switch (kind) {
+        case value_kind_t::VALUE_INTEGER:
+            number = lv.lv_value.i;
+            break;
+        case value_kind_t::VALUE_FLOAT:
+            number = lv.lv_value.d;
+            break;
+        default:
+            break;
+    }
+
+    auto iter = this->ci_value_to_lines.find(value);
+    if (iter == this->ci_value_to_lines.end()) {
+        iter = this->ci_value_to_lines.emplace(value, indexed_value{}).first;
+        iter->second.iv_kind = kind;
+        iter->second.iv_number = number;
+        switch (kind) {
+            case value_kind_t::VALUE_INTEGER:
+            case value_kind_t::VALUE_FLOAT:
+                this->ci_numbers.emplace_back(number, value);
+                break;
+            case value_kind_t::VALUE_BOOLEAN:
+                this->ci_others.emplace_back(value);
+                break;
+            default:
+                this->ci_texts.emplace_back(value);
+                this->ci_folded_texts.emplace_back(value);
+                break;
+        }
+    } else if (iter->second.iv_kind != kind) {
+        if (iter->second.iv_kind != value_kind_t::VALUE_UNKNOWN) {
+            // The same text showed up with different types, so the
+            // ordering cannot be trusted for this value.
+            iter->second.iv_kind = value_kind_t::VALUE_UNKNOWN;
+            this->ci_others.emplace_back(value);
+        }
+    } else if (iter->second.iv_number != number) {
+        this->ci_number_spread = std::max(
+            this->ci_number_spread, std::fabs(iter->second.iv_number - number));
+    }
+
+    auto& line_deq = iter->second.iv_lines;
+    if (line_deq.empty() || (line_deq.front() != vl && line_deq.back() != vl))
+    {
+        if (reverse) {
+            line_deq.push_front(vl);
+        } else {
+            line_deq.push_back(vl);
+        }
+    }
+}
+
+void
+log_vtab_impl::column_index::clear()
+{
+    this->ci_value_to_lines.clear();
+    this->ci_indexed_range = msg_range::empty();
+    this->ci_numbers.clear();
+    this->ci_numbers_sorted = 0;
+    this->ci_number_spread = 0.0;
+    this->ci_texts.clear();
+    this->ci_texts_sorted = 0;
+    this->ci_folded_texts.clear();
+    this->ci_folded_texts_sorted = 0;
+    this->ci_others.clear();
+    this->ci_string_arena.reset();
+}
+
+void
+log_vtab_impl::column_index::truncate(vis_line_t vl)
+{
+    auto valid_opt = this->ci_indexed_range.get_valid();
+
+    if (!valid_opt || valid_opt->v_max_line <= vl) {
+        return;
+    }
+
+    if (valid_opt->v_min_line >= vl) {
+        this->ci_indexed_range = msg_range::empty();
+    } else {
+        valid_opt->v_max_line = vl;
+        this->ci_indexed_range.mr_value = valid_opt.value();
+    }
+    for (auto& pair : this->ci_value_to_lines) {
+        auto& line_deq = pair.second.iv_lines;
+
+        line_deq.erase(
+            std::remove_if(line_deq.begin(),
+                           line_deq.end(),
+                           [vl](const auto& line) { return line >= vl; }),
+            line_deq.end());
+    }
+}
+
+void
+log_vtab_impl::column_index::add_lines(string_fragment value,
+                                       std::vector<vis_line_t>& lines_out) const
+{
+    auto iter = this->ci_value_to_lines.find(value);
+
+    if (iter != this->ci_value_to_lines.end()) {
+        lines_out.insert(lines_out.end(),
+                         iter->second.iv_lines.begin(),
+                         iter->second.iv_lines.end());
+    }
+}
+
+void
+log_vtab_impl::column_index::lines_for(const log_cursor::string_constraint& sc,
+                                       column_order_t order,
+                                       std::vector<vis_line_t>& lines_out)
+{
+    auto add_all = [this, &lines_out]() {
+        for (const auto& pair : this->ci_value_to_lines) {
+            lines_out.insert(lines_out.end(),
+                             pair.second.iv_lines.begin(),
+                             pair.second.iv_lines.end());
+        }
+    };
+    auto add_numbers = [this, &lines_out]() {
+        for (const auto& pair : this->ci_numbers) {
+            this->add_lines(pair.second, lines_out);
+        }
+    };
+    auto add_values = [this, &lines_out](auto begin, auto end) {
+        for (auto iter = begin; iter != end; ++iter) {
+            this->add_lines(*iter, lines_out);
+        }
+    };
+
+    switch (sc.sc_op) {
+        case SQLITE_INDEX_CONSTRAINT_EQ:
+        case SQLITE_INDEX_CONSTRAINT_IS:
+            this->add_lines(string_fragment::from_str(sc.sc_value), lines_out);
+            break;
+        case SQLITE_INDEX_CONSTRAINT_GT:
+        case SQLITE_INDEX_CONSTRAINT_GE:
+        case SQLITE_INDEX_CONSTRAINT_LT:
+        case SQLITE_INDEX_CONSTRAINT_LE: {
+            auto is_lower_bound = sc.sc_op == SQLITE_INDEX_CONSTRAINT_GT
+                || sc.sc_op == SQLITE_INDEX_CONSTRAINT_GE;
+
+            /*
+             * The bounds are treated as inclusive since SQLite will filter
+             * out the rows that are equal.
+             */
+            switch (order) {
+                case column_order_t::numeric: {
+                    auto scan_res = scn::scan_value<double>(
+                        std::string_view{sc.sc_value});
+                    if (!scan_res || !scan_res->range().empty()) {
+                        add_all();
+                        break;
+                    }
+
+                    auto num_less = [](const auto& lhs, const auto& rhs) {
+                        return lhs.first < rhs.first;
+                    };
+                    sort_new_values(
+                        this->ci_numbers, this->ci_numbers_sorted, num_less);
+
+                    auto begin = this->ci_numbers.begin();
+                    auto end = this->ci_numbers.end();
+                    if (is_lower_bound) {
+                        begin = std::lower_bound(
+                            begin,
+                            end,
+                            std::make_pair(
+                                scan_res->value() - this->ci_number_spread,
+                                string_fragment{}),
+                            num_less);
+                    } else {
+                        end = std::upper_bound(
+                            begin,
+                            end,
+                            std::make_pair(
+                                scan_res->value() + this->ci_number_spread,
+                                string_fragment{}),
+                            num_less);
+                    }
+                    for (auto iter = begin; iter != end; ++iter) {
+                        this->add_lines(iter->second, lines_out);
+                    }
+                    // Text values sort after numbers in SQLite.
+                    if (is_lower_bound) {
+                        add_values(this->ci_texts.begin(),
+                                   this->ci_texts.end());
+                    }
+                    add_values(this->ci_others.begin(), this->ci_others.end());
+                    break;
+                }
+                case column_order_t::binary: {
+                    auto bound = string_fragment::from_str(sc.sc_value);
+
+                    sort_new_values(
+                        this->ci_texts, this->ci_texts_sorted, binary_less);
+
+                    auto begin = this->ci_texts.begin();
+                    auto end = this->ci_texts.end();
+                    if (is_lower_bound) {
+                        begin = std::lower_bound(begin, end, bound, binary_less);
+                    } else {
+                        end = std::upper_bound(begin, end, bound, binary_less);
+                    }
+                    add_values(begin, end);
+                    add_numbers();
+                    add_values(this->ci_others.begin(), this->ci_others.end());
+                    break;
+                }
+                case column_order_t::none:
+                    add_all();
+                    break;
+            }
+            break;
+        }
+        case SQLITE_INDEX_CONSTRAINT_LIKE: {
+            auto pattern_sf = string_fragment::from_str(sc.sc_value);
+            auto prefix_len = sc.sc_value.find_first_of("%_");
+            auto prefix = pattern_sf.sub_range(
+                0,
+                prefix_len == std::string::npos ? pattern_sf.length()
+                                                : prefix_len);
+
+            if (prefix.empty()) {
+                add_all();
+                break;
+            }
+
+            sort_new_values(this->ci_folded_texts,
+                            this->ci_folded_texts_sorted,
+                            folded_less);
+            for (auto iter = std::lower_bound(this->ci_folded_texts.begin(),
+                                              this->ci_folded_texts.end(),
+                                              prefix,
+                                              folded_less);
+                 iter != this->ci_folded_texts.end()
+                 && folded_startswith(*iter, prefix);
+                 ++iter)
+            {
+                auto value_str = iter->to_string();
+
+                if (sqlite3_strlike(
+                        sc.sc_value.c_str(), value_str.c_str(), 0)
+                    == 0)
+                {
+                    this->add_lines(*iter, lines_out);
+                }
+            }
+            // The text of non-string values might not match what SQLite
+            // would generate, so they are always checked.
+            add_numbers();
+            add_values(this->ci_others.begin(), this->ci_others.end());
+            break;
+        }
+        default:
+            add_all();
+            break;
+    }
+}
+
 struct vtab_time_range {
     std::optional<timeval> vtr_begin;
     std::optional<timeval> vtr_end;
@@ -1818,10 +2144,19 @@ vt_filter(sqlite3_vtab_cursor* p_vtc,
         for (const auto& icol : p_cur->log_cursor.lc_indexed_columns) {
             auto& coli = vt->vi->vi_column_indexes[icol.cc_column];
             if (coli.ci_index_generation != vt->lss->lss_index_generation) {
-                coli.ci_value_to_lines.clear();
-                coli.ci_index_generation = vt->lss->lss_index_generation;
-                coli.ci_indexed_range = msg_range::empty();
-                coli.ci_string_arena.reset();
+                auto changed_opt = vt->lss->first_changed_line_since(
+                    coli.ci_index_generation);
+
+                if (changed_opt) {
+                    log_debug("column %d index is valid up to line %d",
+                              icol.cc_column,
+                              (int) changed_opt.value());
+                    coli.truncate(changed_opt.value());
+                    coli.ci_index_generation = vt->lss->lss_index_generation;
+                } else {
+                    coli.clear();
+                    coli.ci_index_generation = vt->lss->lss_index_generation;
+                }
             }
 
             {
@@ -1837,39 +2172,50 @@ vt_filter(sqlite3_vtab_cursor* p_vtc,
             min_index_range.intersect(coli.ci_indexed_range);
         }
 
+        /*
+         * Each constraint has to be satisfied, so only the lines that are
+         * found for every indexed column need to be visited.
+         */
+        std::optional<std::vector<vis_line_t>> matched_lines;
         for (const auto& icol : p_cur->log_cursor.lc_indexed_columns) {
-            const auto& coli = vt->vi->vi_column_indexes[icol.cc_column];
-
-            auto iter
-                = coli.ci_value_to_lines.find(icol.cc_constraint.sc_value);
-            if (iter != coli.ci_value_to_lines.end()) {
-                for (auto vl : iter->second) {
-                    if (!scan_range.contains(vl)) {
-#ifdef DEBUG_INDEXING
-                        log_debug(
-                            "indexed line %d is outside of scan range [%d:%d)",
-                            vl,
-                            scan_range.v_min_line,
-                            scan_range.v_max_line);
-#endif
-                        continue;
-                    }
-
-                    if (!min_index_range.contains(vl)) {
-#ifdef DEBUG_INDEXING
-                        log_debug(
-                            "indexed line %d is outside of the min index range",
-                            vl);
-#endif
-                        continue;
-                    }
-
+            auto& coli = vt->vi->vi_column_indexes[icol.cc_column];
+            std::vector<vis_line_t> col_lines;
+
+            coli.lines_for(icol.cc_constraint,
+                           vt->vi->column_order(icol.cc_column),
+                           col_lines);
+            col_lines.erase(
+                std::remove_if(col_lines.begin(),
+                               col_lines.end(),
+                               [&scan_range, &min_index_range](auto vl) {
+                                   return !scan_range.contains(vl)
+                                       || !min_index_range.contains(vl);
+                               }),
+                col_lines.end());
+            std::sort(col_lines.begin(), col_lines.end());
+            col_lines.erase(std::unique(col_lines.begin(), col_lines.end()),
+                            col_lines.end());
+            if (matched_lines) {
+                std::vector<vis_line_t> both;
+
+                std::set_intersection(matched_lines->begin(),
+                                      matched_lines->end(),
+                                      col_lines.begin(),
+                                      col_lines.end(),
+                                      std::back_inserter(both));
+                matched_lines = std::move(both);
+            } else {
+                matched_lines = std::move(col_lines);
+            }
+        }
+        if (matched_lines) {
 #ifdef DEBUG_INDEXING
-                    log_debug("adding indexed line %d", vl);
+            log_debug("adding %zu indexed lines", matched_lines->size());
 #endif
-                    p_cur->log_cursor.lc_indexed_lines.push_back(vl);
-                }
-            }
+            p_cur->log_cursor.lc_indexed_lines.insert(
+                p_cur->log_cursor.lc_indexed_lines.end(),
+                matched_lines->begin(),
+                matched_lines->end());
         }
         p_cur->log_cursor.lc_indexed_lines_range = min_index_range;
 
@@ -2058,6 +2404,7 @@ vt_best_index(sqlite3_vtab* tab, sqlite3_index_info* p_info)
     std::vector<sqlite3_index_info::sqlite3_index_constraint> indexes;
     std::vector<std::string> index_desc;
     int argvInUse = 0;
+    int range_constraints = 0;
     auto* vt = (log_vtab*) tab;
     char direction = 1;
 
@@ -2229,6 +2576,22 @@ vt_best_index(sqlite3_vtab* tab, sqlite3_index_info* p_info)
                         fmt::format(FMT_STRING("col({}) {} ?"),
                                     col,
                                     sql_constraint_op_name(op)));
+                } else if (op == SQLITE_INDEX_CONSTRAINT_LIKE
+                           || ((op == SQLITE_INDEX_CONSTRAINT_GT
+                                || op == SQLITE_INDEX_CONSTRAINT_GE
+                                || op == SQLITE_INDEX_CONSTRAINT_LT
+                                || op == SQLITE_INDEX_CONSTRAINT_LE)
+                               && vt->vi->column_order(col)
+                                   != log_vtab_impl::column_order_t::none))
+                {
+                    argvInUse += 1;
+                    range_constraints += 1;
+                    indexes.push_back(constraint);
+                    p_info->aConstraintUsage[lpc].argvIndex = argvInUse;
+                    index_desc.emplace_back(
+                        fmt::format(FMT_STRING("col({}) {} ?"),
+                                    col,
+                                    sql_constraint_op_name(op)));
                 }
                 break;
             }
@@ -2267,7 +2630,8 @@ vt_best_index(sqlite3_vtab* tab, sqlite3_index_info* p_info)
         p_info->idxNum = argvInUse;
         p_info->idxStr = static_cast<char*>(storage);
         p_info->needToFreeIdxStr = 1;
-        p_info->estimatedCost = 10.0;
+        // Range and prefix lookups are not as selective as the others.
+        p_info->estimatedCost = argvInUse > range_constraints ? 10.0 : 1000.0;
     } else {
         static char fullscan_asc[] = "fullscan\0\001";
         static char fullscan_desc[] = "fullscan\0\377";
@@ -2518,7 +2882,7 @@ progress_callback(void* ptr)
     int retval = 0;
 
     if (log_vtab_data.lvd_progress != nullptr) {
-        retval = log_vtab_data.lvd_progress(log_cursor_latest);
+        retval = log_vtab_data.lvd_progress(log_vtab_data.lvd_cursor);
     }
     if (!log_vtab_data.lvd_looping) {
         retval = 1;
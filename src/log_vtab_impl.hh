@@ -324,17 +324,84 @@ public:
                          string_attrs_t& sa,
                          logline_value_vector& values);
 
+    /**
+     * How the values in a column can be ordered for range lookups.  The
+     * order has to match the way SQLite compares the values in the column.
+     */
+    enum class column_order_t {
+        none,
+        binary,
+        numeric,
+    };
+
     struct column_index {
+        struct indexed_value {
+            std::deque<vis_line_t> iv_lines;
+            value_kind_t iv_kind{value_kind_t::VALUE_TEXT};
+            double iv_number{0.0};
+        };
+
+        /**
+         * Add the line to the list of lines that have the given value.
+         */
+        void insert(const logline_value& lv, vis_line_t vl, bool reverse);
+
+        void clear();
+
+        /**
+         * Forget about any lines at or after the given line.
+         */
+        void truncate(vis_line_t vl);
+
+        /**
+         * Collect the lines that could match the given constraint.  The
+         * result is a superset of the matching lines since SQLite will
+         * check the constraint again.
+         */
+        void lines_for(const log_cursor::string_constraint& sc,
+                       column_order_t order,
+                       std::vector<vis_line_t>& lines_out);
+
         robin_hood::
-            unordered_map<string_fragment, std::deque<vis_line_t>, frag_hasher>
+            unordered_map<string_fragment, indexed_value, frag_hasher>
                 ci_value_to_lines;
         uint32_t ci_index_generation{0};
         msg_range ci_indexed_range = msg_range::empty();
 
+        /*
+         * The distinct values grouped by their kind.  These are sorted on
+         * demand when a range or prefix lookup is done.  Values added since
+         * the last sort are merged in the next time around.
+         */
+        std::vector<std::pair<double, string_fragment>> ci_numbers;
+        size_t ci_numbers_sorted{0};
+        /** The largest difference between numbers with the same text. */
+        double ci_number_spread{0.0};
+        std::vector<string_fragment> ci_texts;
+        size_t ci_texts_sorted{0};
+        std::vector<string_fragment> ci_folded_texts;
+        size_t ci_folded_texts_sorted{0};
+        std::vector<string_fragment> ci_others;
+
         ArenaAlloc::Alloc<char> ci_string_arena;
+
+    private:
+        void add_lines(string_fragment value,
+                       std::vector<vis_line_t>& lines_out) const;
     };
 
     std::map<int32_t, column_index> vi_column_indexes;
+    std::vector<column_order_t> vi_column_orders;
+
+    column_order_t column_order(int32_t col) const
+    {
+        auto index = col - VT_COL_MAX;
+
+        if (index < 0 || index >= (int32_t) this->vi_column_orders.size()) {
+            return column_order_t::none;
+        }
+        return this->vi_column_orders[index];
+    }
 
     void expand_indexes_to(
         const std::vector<log_cursor::column_constraint>& cons,
@@ -378,6 +445,8 @@ struct _log_vtab_data {
     sql_progress_finished_callback_t lvd_finished;
     source_location lvd_location;
     attr_line_t lvd_content;
+    /** The last position of a log table scan in the current statement. */
+    log_cursor lvd_cursor;
 };
 
 extern thread_local _log_vtab_data log_vtab_data;
@@ -394,6 +463,7 @@ public:
         log_vtab_data.lvd_finished = fcb;
         log_vtab_data.lvd_location = loc;
         log_vtab_data.lvd_content = content;
+        log_vtab_data.lvd_cursor = log_cursor();
     }
 
     ~sql_progress_guard()
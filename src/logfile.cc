@@ -38,6 +38,7 @@
 #include <fcntl.h>
 #include <string.h>
 #include <sys/param.h>
+#include <sys/mman.h>
 #include <sys/resource.h>
 #include <sys/stat.h>
 #include <time.h>
@@ -46,21 +47,27 @@
 #include "base/attr_line.builder.hh"
 #include "base/date_time_scanner.cfg.hh"
 #include "base/fs_util.hh"
+#include "base/injector.bind.hh"
 #include "base/injector.hh"
+#include "base/isc.hh"
+#include "base/paths.hh"
 #include "base/snippet_highlighters.hh"
 #include "base/string_util.hh"
 #include "base/time_util.hh"
 #include "config.h"
 #include "file_options.hh"
+#include "file_watcher.hh"
 #include "hasher.hh"
 #include "lnav_util.hh"
 #include "log.watch.hh"
 #include "log_format.hh"
+#include "log_format_ext.hh"
 #include "logfile.cfg.hh"
 #include "piper.header.hh"
 #include "yajlpp/yajlpp_def.hh"
 
 using namespace lnav::roles::literals;
+using namespace std::chrono_literals;
 
 static auto intern_lifetime = intern_string::get_table_lifetime();
 
@@ -148,6 +155,12 @@ logfile::open(std::filesystem::path filename,
     lf->lf_line_buffer.set_fd(lf_fd);
     lf->lf_index.reserve(INDEX_RESERVE_INCREMENT);
 
+    if (!resolved_path.empty() && !lf->lf_line_buffer.is_compressed()) {
+        static auto& fw = injector::get<file_watcher&>();
+
+        lf->lf_watch_state = fw.watch_file(resolved_path);
+    }
+
     lf->lf_indexing = lf->lf_options.loo_is_visible;
     lf->lf_text_format
         = lf->lf_options.loo_text_format.value_or(text_format_t::TF_UNKNOWN);
@@ -336,6 +349,50 @@ logfile::set_format_base_time(log_format* lf, const line_info& li)
                                    this->lf_cached_base_tm.value());
 }
 
+void
+logfile::update_applicable_defs()
+{
+    this->lf_applicable_taggers.clear();
+    for (auto& td_pair : this->lf_format->lf_tag_defs) {
+        bool matches = td_pair.second->ftd_paths.empty();
+        for (const auto& pr : td_pair.second->ftd_paths) {
+            if (pr.matches(this->lf_filename.c_str())) {
+                matches = true;
+                break;
+            }
+        }
+        if (!matches) {
+            continue;
+        }
+
+        log_info("%s: found applicable tag definition /%s/tags/%s",
+                 this->lf_filename.c_str(),
+                 this->lf_format->get_name().get(),
+                 td_pair.second->ftd_name.c_str());
+        this->lf_applicable_taggers.emplace_back(td_pair.second);
+    }
+
+    this->lf_applicable_partitioners.clear();
+    for (auto& pd_pair : this->lf_format->lf_partition_defs) {
+        bool matches = pd_pair.second->fpd_paths.empty();
+        for (const auto& pr : pd_pair.second->fpd_paths) {
+            if (pr.matches(this->lf_filename.c_str())) {
+                matches = true;
+                break;
+            }
+        }
+        if (!matches) {
+            continue;
+        }
+
+        log_info("%s: found applicable partition definition /%s/partitions/%s",
+                 this->lf_filename.c_str(),
+                 this->lf_format->get_name().get(),
+                 pd_pair.second->fpd_name.c_str());
+        this->lf_applicable_partitioners.emplace_back(pd_pair.second);
+    }
+}
+
 bool
 logfile::process_prefix(shared_buffer_ref& sbr,
                         const line_info& li,
@@ -379,6 +436,12 @@ logfile::process_prefix(shared_buffer_ref& sbr,
                   li.li_file_range.fr_size);
         auto starting_index_size = this->lf_index.size();
         size_t prev_index_size = this->lf_index.size();
+        auto detect_start = std::chrono::steady_clock::now();
+        thread_local std::vector<bool> prefilter_hits;
+
+        external_log_format::PREFILTER.find_all(sbr.to_string_fragment(),
+                                                prefilter_hits);
+        sbc.sbc_prefilter_hits = &prefilter_hits;
         for (const auto& curr : root_formats) {
             if (this->lf_index.size()
                 >= curr->lf_max_unrecognized_lines.value_or(
@@ -440,6 +503,7 @@ logfile::process_prefix(shared_buffer_ref& sbr,
             this->set_format_base_time(curr.get(), li);
             log_format::scan_result_t scan_res{mapbox::util::no_init{}};
             scan_batch_context sbc_tmp{this->lf_allocator};
+            sbc_tmp.sbc_prefilter_hits = &prefilter_hits;
             if (this->lf_format != nullptr
                 && this->lf_format->lf_root_format == curr.get())
             {
@@ -536,6 +600,11 @@ logfile::process_prefix(shared_buffer_ref& sbr,
                     }
                 });
         }
+        sbc.sbc_prefilter_hits = nullptr;
+        this->lf_activity.la_detect_time
+            += std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - detect_start);
+        this->lf_activity.la_detect_lines += 1;
 
         if (!scan_count) {
             log_info("%s: no formats available to scan, no longer detecting",
@@ -573,47 +642,7 @@ logfile::process_prefix(shared_buffer_ref& sbr,
                     = hasher().update(sbr.get_data(), sbr.length()).to_string();
             }
 
-            this->lf_applicable_taggers.clear();
-            for (auto& td_pair : this->lf_format->lf_tag_defs) {
-                bool matches = td_pair.second->ftd_paths.empty();
-                for (const auto& pr : td_pair.second->ftd_paths) {
-                    if (pr.matches(this->lf_filename.c_str())) {
-                        matches = true;
-                        break;
-                    }
-                }
-                if (!matches) {
-                    continue;
-                }
-
-                log_info("%s: found applicable tag definition /%s/tags/%s",
-                         this->lf_filename.c_str(),
-                         this->lf_format->get_name().get(),
-                         td_pair.second->ftd_name.c_str());
-                this->lf_applicable_taggers.emplace_back(td_pair.second);
-            }
-
-            this->lf_applicable_partitioners.clear();
-            for (auto& pd_pair : this->lf_format->lf_partition_defs) {
-                bool matches = pd_pair.second->fpd_paths.empty();
-                for (const auto& pr : pd_pair.second->fpd_paths) {
-                    if (pr.matches(this->lf_filename.c_str())) {
-                        matches = true;
-                        break;
-                    }
-                }
-                if (!matches) {
-                    continue;
-                }
-
-                log_info(
-                    "%s: found applicable partition definition "
-                    "/%s/partitions/%s",
-                    this->lf_filename.c_str(),
-                    this->lf_format->get_name().get(),
-                    pd_pair.second->fpd_name.c_str());
-                this->lf_applicable_partitioners.emplace_back(pd_pair.second);
-            }
+            this->update_applicable_defs();
 
             /*
              * We'll go ahead and assume that any previous lines were
@@ -738,6 +767,7 @@ logfile::rebuild_index(std::optional<ui_clock::time_point> deadline)
 {
     static const auto& dts_cfg
         = injector::get<const date_time_scanner_ns::config&>();
+    static auto& fw = injector::get<file_watcher&>();
 
     if (!this->lf_invalidated_opids.empty()) {
         auto writeOpids = this->lf_opids.writeAccess();
@@ -772,6 +802,13 @@ logfile::rebuild_index(std::optional<ui_clock::time_point> deadline)
         this->lf_invalidated_opids.clear();
     }
 
+    const auto watching = lnav::log::watch::is_active();
+    auto flush_watch = finally([this]() {
+        if (!this->lf_in_worker) {
+            this->flush_watch_lines();
+        }
+    });
+
     if (!this->lf_indexing) {
         if (this->lf_sort_needed) {
             this->lf_sort_needed = false;
@@ -788,6 +825,7 @@ logfile::rebuild_index(std::optional<ui_clock::time_point> deadline)
         log_info("%s: format has changed, rebuilding",
                  this->lf_filename.c_str());
         this->lf_index.clear();
+        this->lf_value_columns.clear();
         this->lf_index_size = 0;
         this->lf_partial_line = false;
         this->lf_longest_line = 0;
@@ -800,9 +838,23 @@ logfile::rebuild_index(std::optional<ui_clock::time_point> deadline)
             writable_opid_map->los_sub_in_use.clear();
         }
         this->lf_allocator.reset();
+        if (this->lf_watch_state != nullptr) {
+            this->lf_watch_state->fws_changed = true;
+        }
     }
     this->lf_zoned_to_local_state = dts_cfg.c_zoned_to_local;
 
+    if (this->lf_watch_state != nullptr
+        && !fw.check_file(*this->lf_watch_state))
+    {
+        // Nothing has been written to the file since the last poll.
+        if (this->lf_sort_needed) {
+            this->lf_sort_needed = false;
+            return rebuild_result_t::NEW_ORDER;
+        }
+        return rebuild_result_t::NO_NEW_LINES;
+    }
+
     auto retval = rebuild_result_t::NO_NEW_LINES;
     struct stat st;
 
@@ -867,6 +919,23 @@ logfile::rebuild_index(std::optional<ui_clock::time_point> deadline)
         }
     }
 
+    if (!this->lf_index_cache_checked) {
+        this->lf_index_cache_checked = true;
+        if (this->lf_index.empty() && this->lf_format == nullptr
+            && this->lf_text_format != text_format_t::TF_BINARY)
+        {
+            if (this->load_index_cache(st) && watching) {
+                // The saved index skips the indexing loop, so the restored
+                // messages still need to be checked by the watch expressions.
+                for (size_t lpc = 0; lpc < this->lf_index.size(); lpc++) {
+                    if (!this->lf_index[lpc].is_continued()) {
+                        this->lf_deferred_watch_lines.emplace_back(lpc);
+                    }
+                }
+            }
+        }
+    }
+
     if (this->lf_text_format == text_format_t::TF_BINARY) {
         this->lf_index_size = st.st_size;
         this->lf_stat = st;
@@ -1034,9 +1103,7 @@ logfile::rebuild_index(std::optional<ui_clock::time_point> deadline)
                                    .move();
                 this->lf_notes.writeAccess()->emplace(note_type::not_utf,
                                                       note_um);
-                if (this->lf_logfile_observer != nullptr) {
-                    this->lf_logfile_observer->logfile_indexing(this, 0, 0);
-                }
+                this->report_indexing(0, 0);
                 break;
             }
             size_t old_size = this->lf_index.size();
@@ -1160,16 +1227,12 @@ logfile::rebuild_index(std::optional<ui_clock::time_point> deadline)
                 }
             }
 
-            if (this->lf_logfile_observer != nullptr) {
-                auto indexing_res = this->lf_logfile_observer->logfile_indexing(
-                    this,
-                    this->lf_line_buffer.get_read_offset(
-                        li.li_file_range.next_offset()),
-                    st.st_size);
-
-                if (indexing_res == lnav::progress_result_t::interrupt) {
-                    break;
-                }
+            auto indexing_res = this->report_indexing(
+                this->lf_line_buffer.get_read_offset(
+                    li.li_file_range.next_offset()),
+                st.st_size);
+            if (indexing_res == lnav::progress_result_t::interrupt) {
+                break;
             }
 
             if (!has_format && this->lf_format != nullptr) {
@@ -1246,8 +1309,16 @@ logfile::rebuild_index(std::optional<ui_clock::time_point> deadline)
                     }
                 }
 
-                if (!this->back().is_continued()) {
-                    lnav::log::watch::eval_with(*this, this->end() - 1);
+                if (watching) {
+                    // JSON messages can add several lines at once, so look
+                    // for the start of each message that was just added.
+                    for (auto lpc = old_size; lpc < this->lf_index.size();
+                         lpc++)
+                    {
+                        if (!this->lf_index[lpc].is_continued()) {
+                            this->lf_deferred_watch_lines.emplace_back(lpc);
+                        }
+                    }
                 }
             }
 
@@ -1277,9 +1348,7 @@ logfile::rebuild_index(std::optional<ui_clock::time_point> deadline)
                       .move();
             this->lf_notes.writeAccess()->emplace(note_type::indexing_disabled,
                                                   note_um);
-            if (this->lf_logfile_observer != nullptr) {
-                this->lf_logfile_observer->logfile_indexing(this, 0, 0);
-            }
+            this->report_indexing(0, 0);
         }
 
         if (this->lf_logline_observer != nullptr) {
@@ -1301,6 +1370,9 @@ logfile::rebuild_index(std::optional<ui_clock::time_point> deadline)
                      this->lf_index.size());
             log_rusage(lnav_log_level_t::INFO,
                        this->lf_activity.la_initial_index_rusage);
+            log_info("  format detection: %lld lines in %lldus",
+                     this->lf_activity.la_detect_lines,
+                     this->lf_activity.la_detect_time.count());
         }
 
         /*
@@ -1333,6 +1405,10 @@ logfile::rebuild_index(std::optional<ui_clock::time_point> deadline)
                 this->lf_allocator.getNumBytesAllocated());
         }
 
+        if (this->lf_index_size >= st.st_size) {
+            this->save_index_cache(st);
+        }
+
         if (begin_size > this->lf_index.size()) {
             log_info("overwritten file detected, closing -- %s",
                      this->lf_filename.c_str());
@@ -1360,6 +1436,12 @@ logfile::rebuild_index(std::optional<ui_clock::time_point> deadline)
         }
     }
 
+    if (this->lf_watch_state != nullptr && this->lf_index_size < st.st_size) {
+        // The indexing loop stopped early, so keep polling until the rest of
+        // the file has been read.
+        this->lf_watch_state->fws_changed = true;
+    }
+
     this->lf_index_time
         = std::chrono::seconds{this->lf_line_buffer.get_file_time()};
     if (this->lf_index_time.count() == 0) {
@@ -1520,12 +1602,754 @@ logfile::read_full_message(const_iterator ll,
     }
 }
 
+static constexpr size_t VALUE_COLUMN_CHUNK_SIZE = 1024;
+
+std::optional<double>
+logfile::get_numeric_value(const intern_string_t name, const_iterator ll)
+{
+    auto& col = this->lf_value_columns[name];
+
+    if (col.vc_format != this->lf_format.get()
+        || col.vc_values.size() > this->lf_index.size())
+    {
+        col = value_column{};
+        col.vc_format = this->lf_format.get();
+    }
+    if (col.vc_index_size != this->lf_index_size) {
+        if (!col.vc_values.empty()) {
+            // The last message might have picked up more lines, so the
+            // chunks from its first line onward need to be filled again.
+            auto last_msg = col.vc_values.size() - 1;
+            while (last_msg > 0 && !this->lf_index[last_msg].is_message()) {
+                last_msg -= 1;
+            }
+            std::fill(col.vc_filled_chunks.begin()
+                          + last_msg / VALUE_COLUMN_CHUNK_SIZE,
+                      col.vc_filled_chunks.end(),
+                      false);
+        }
+        col.vc_values.resize(this->lf_index.size(), NAN);
+        col.vc_filled_chunks.resize(
+            (this->lf_index.size() + VALUE_COLUMN_CHUNK_SIZE - 1)
+                / VALUE_COLUMN_CHUNK_SIZE,
+            false);
+        col.vc_index_size = this->lf_index_size;
+    }
+
+    auto line_number = std::distance(this->cbegin(), ll);
+    auto chunk = line_number / VALUE_COLUMN_CHUNK_SIZE;
+    if (!col.vc_filled_chunks[chunk]) {
+        this->fill_value_column(name, col, chunk);
+        col.vc_filled_chunks[chunk] = true;
+    }
+
+    auto retval = col.vc_values[line_number];
+    if (std::isnan(retval)) {
+        return std::nullopt;
+    }
+
+    return retval;
+}
+
+void
+logfile::fill_value_column(const intern_string_t name,
+                           value_column& col,
+                           size_t chunk)
+{
+    auto begin_line = chunk * VALUE_COLUMN_CHUNK_SIZE;
+    auto end_line
+        = std::min(begin_line + VALUE_COLUMN_CHUNK_SIZE, col.vc_values.size());
+
+    std::fill(col.vc_values.begin() + begin_line,
+              col.vc_values.begin() + end_line,
+              NAN);
+    if (this->lf_format == nullptr) {
+        return;
+    }
+
+    logline_value_vector values;
+    string_attrs_t sa;
+
+    for (auto line_number = begin_line; line_number < end_line; line_number++)
+    {
+        auto ll = this->begin() + line_number;
+
+        if (!ll->is_message()) {
+            continue;
+        }
+
+        values.clear();
+        this->read_full_message(ll, values.lvv_sbr);
+        values.lvv_sbr.erase_ansi();
+        sa.clear();
+        this->lf_format->annotate(this, line_number, sa, values, false);
+
+        auto lv_iter = std::find_if(values.lvv_values.begin(),
+                                    values.lvv_values.end(),
+                                    logline_value_name_cmp(&name));
+        if (lv_iter == values.lvv_values.end()) {
+            continue;
+        }
+
+        switch (lv_iter->lv_meta.lvm_kind) {
+            case value_kind_t::VALUE_FLOAT:
+                col.vc_values[line_number] = lv_iter->lv_value.d;
+                break;
+            case value_kind_t::VALUE_INTEGER:
+                col.vc_values[line_number] = lv_iter->lv_value.i;
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+lnav::progress_result_t
+logfile::report_indexing(file_off_t off, file_ssize_t total)
+{
+    if (this->lf_logfile_observer == nullptr) {
+        return lnav::progress_result_t::ok;
+    }
+
+    if (this->lf_in_worker) {
+        this->lf_deferred_progress = std::make_pair(off, total);
+        return lnav::progress_result_t::ok;
+    }
+
+    return this->lf_logfile_observer->logfile_indexing(this, off, total);
+}
+
+bool
+logfile::can_index_in_worker() const
+{
+    if (!this->lf_indexing || this->lf_format == nullptr
+        || !this->lf_format->is_thread_safe())
+    {
+        return false;
+    }
+
+    return this->lf_logline_observer == nullptr
+        || this->lf_logline_observer->is_thread_safe();
+}
+
+logfile::rebuild_result_t
+logfile::rebuild_index_in_worker(std::optional<ui_clock::time_point> deadline)
+{
+    this->lf_in_worker = true;
+    auto fin = finally([this]() { this->lf_in_worker = false; });
+
+    return this->rebuild_index(deadline);
+}
+
+void
+logfile::flush_watch_lines()
+{
+    if (this->lf_deferred_watch_lines.empty()) {
+        return;
+    }
+
+    auto& lines = this->lf_deferred_watch_lines;
+    std::sort(lines.begin(), lines.end());
+    lines.erase(std::unique(lines.begin(), lines.end()), lines.end());
+    lines.erase(std::remove_if(lines.begin(),
+                               lines.end(),
+                               [this](const auto line_number) {
+                                   return line_number >= this->lf_index.size();
+                               }),
+                lines.end());
+    lnav::log::watch::eval_batch(*this, lines);
+    lines.clear();
+}
+
+void
+logfile::finish_worker_index()
+{
+    this->flush_watch_lines();
+
+    if (this->lf_deferred_progress && this->lf_logfile_observer != nullptr) {
+        this->lf_logfile_observer->logfile_indexing(
+            this,
+            this->lf_deferred_progress->first,
+            this->lf_deferred_progress->second);
+    }
+    this->lf_deferred_progress = std::nullopt;
+}
+
+namespace {
+
+constexpr char INDEX_CACHE_MAGIC[8] = "lnavidx";
+constexpr uint32_t INDEX_CACHE_VERSION = 1;
+constexpr file_ssize_t INDEX_CACHE_MIN_SIZE = 16 * 1024 * 1024;
+constexpr file_ssize_t INDEX_CACHE_HASH_SIZE = 4 * 1024;
+
+static_assert(std::is_trivially_copyable_v<logline>);
+
+/**
+ * The layout of a saved index is the header followed by the loglines, the
+ * pattern locks, the value stats, and then the operation IDs.
+ */
+struct index_cache_header {
+    char ich_magic[8];
+    uint32_t ich_version;
+    uint32_t ich_logline_size;
+    int64_t ich_index_size;
+    int64_t ich_mtime;
+    uint64_t ich_line_count;
+    uint64_t ich_longest_line;
+    uint32_t ich_timestamp_flags;
+    uint32_t ich_format_quality;
+    uint32_t ich_pattern_lock_count;
+    uint32_t ich_value_stats_count;
+    uint32_t ich_opid_count;
+    uint32_t ich_partial_line;
+    char ich_format_name[128];
+    char ich_format_key[hasher::STRING_SIZE];
+    char ich_head_hash[hasher::STRING_SIZE];
+    char ich_tail_hash[hasher::STRING_SIZE];
+    char ich_content_id[hasher::STRING_SIZE];
+};
+
+struct index_cache_lock {
+    uint32_t icl_line;
+    uint32_t icl_pat_index;
+};
+
+struct index_cache_opid {
+    time_range ico_range;
+    log_level_stats ico_level_stats;
+    uint32_t ico_length;
+};
+
+class fragments_producer : public string_fragment_producer {
+public:
+    explicit fragments_producer(std::vector<string_fragment> frags)
+        : fp_frags(std::move(frags))
+    {
+    }
+
+    next_result next() override
+    {
+        if (this->fp_index >= this->fp_frags.size()) {
+            return eof{};
+        }
+
+        return this->fp_frags[this->fp_index++];
+    }
+
+private:
+    std::vector<string_fragment> fp_frags;
+    size_t fp_index{0};
+};
+
+/**
+ * Saved indexes can be large, so they are written out by this service
+ * instead of on the UI thread.  Writes that are still queued when the
+ * service is stopped are flushed before the thread exits.
+ */
+class index_cache_writer : public isc::service<index_cache_writer> {
+public:
+    bool is_running() const { return this->s_started; }
+};
+
+auto bound_index_cache_writer = injector::bind_multiple<isc::service_base>()
+                                    .add_singleton<index_cache_writer>();
+
+/**
+ * A copy of the state of a logfile that is needed to write its saved index.
+ */
+struct index_cache_snapshot {
+    std::string ics_filename;
+    std::filesystem::path ics_path;
+    index_cache_header ics_header;
+    std::vector<logline> ics_index;
+    std::vector<index_cache_lock> ics_locks;
+    std::vector<logline_value_stats> ics_value_stats;
+    std::string ics_opids;
+
+    void write() const
+    {
+        auto producer = fragments_producer({
+            string_fragment::from_bytes((const char*) &this->ics_header,
+                                        sizeof(this->ics_header)),
+            string_fragment::from_bytes(
+                (const char*) this->ics_index.data(),
+                this->ics_index.size() * sizeof(logline)),
+            string_fragment::from_bytes(
+                (const char*) this->ics_locks.data(),
+                this->ics_locks.size() * sizeof(index_cache_lock)),
+            string_fragment::from_bytes(
+                (const char*) this->ics_value_stats.data(),
+                this->ics_value_stats.size() * sizeof(logline_value_stats)),
+            string_fragment::from_str(this->ics_opids),
+        });
+
+        std::error_code ec;
+        std::filesystem::create_directories(this->ics_path.parent_path(), ec);
+        auto write_res = lnav::filesystem::write_file(this->ics_path, producer);
+        if (write_res.isErr()) {
+            log_error("%s: unable to save index -- %s",
+                      this->ics_filename.c_str(),
+                      write_res.unwrapErr().c_str());
+            return;
+        }
+
+        log_info("%s: saved index -- lines=%zu; size=%lld; path=%s",
+                 this->ics_filename.c_str(),
+                 this->ics_index.size(),
+                 (long long) this->ics_header.ich_index_size,
+                 this->ics_path.c_str());
+    }
+};
+
+std::filesystem::path
+index_cache_dir()
+{
+    return lnav::paths::workdir() / "index-cache";
+}
+
+std::optional<std::string>
+hash_file_range(int fd, file_off_t off, file_ssize_t len)
+{
+    char buffer[INDEX_CACHE_HASH_SIZE];
+
+    require(len <= INDEX_CACHE_HASH_SIZE);
+
+    auto rc = pread(fd, buffer, len, off);
+    if (rc != len) {
+        return std::nullopt;
+    }
+
+    return hasher().update(buffer, len).to_string();
+}
+
+/**
+ * Combine the format's key with the settings that affect the timestamps
+ * stored in the index.
+ */
+std::string
+index_cache_format_key(
+    const std::string& format_key,
+    const std::optional<std::pair<std::string, lnav::file_options>>& fo,
+    bool zoned_to_local)
+{
+    const auto* tz = getenv("TZ");
+    auto retval = hasher();
+
+    retval.update(format_key)
+        .update(std::string(tz != nullptr ? tz : ""))
+        .update(int64_t{zoned_to_local});
+    if (fo && fo->second.fo_default_zone.pp_value != nullptr) {
+        retval.update(fo->second.fo_default_zone.pp_value->name());
+    }
+
+    return retval.to_string();
+}
+
+void
+copy_to_field(char* dst, size_t dst_size, const std::string& src)
+{
+    memset(dst, 0, dst_size);
+    memcpy(dst, src.data(), std::min(src.size(), dst_size - 1));
+}
+
+std::string
+field_to_string(const char* src, size_t src_size)
+{
+    return std::string(src, strnlen(src, src_size));
+}
+
+}  // namespace
+
+void
+logfile::cleanup_index_cache()
+{
+    (void) std::async(std::launch::async, []() {
+        static constexpr auto MAX_UNUSED_TIME = 24h * 7;
+
+        auto now = std::filesystem::file_time_type::clock::now();
+        std::vector<std::filesystem::path> to_remove;
+        std::error_code ec;
+
+        for (const auto& cache_subdir :
+             std::filesystem::directory_iterator(index_cache_dir(), ec))
+        {
+            for (const auto& entry :
+                 std::filesystem::directory_iterator(cache_subdir, ec))
+            {
+                auto mtime = std::filesystem::last_write_time(entry.path(), ec);
+                if (ec || now < mtime + MAX_UNUSED_TIME) {
+                    continue;
+                }
+
+                to_remove.emplace_back(entry.path());
+            }
+        }
+
+        for (const auto& entry : to_remove) {
+            log_debug("removing unused index: %s", entry.c_str());
+            std::filesystem::remove(entry, ec);
+        }
+    });
+}
+
+std::optional<std::filesystem::path>
+logfile::index_cache_path(const struct stat& st) const
+{
+    if (!this->lf_named_file || !this->lf_valid_filename
+        || this->is_compressed() || st.st_size < INDEX_CACHE_MIN_SIZE)
+    {
+        return std::nullopt;
+    }
+
+    auto cache_name = hasher()
+                          .update(st.st_dev)
+                          .update(st.st_ino)
+                          .update(this->lf_filename.string())
+                          .to_string();
+
+    return index_cache_dir() / cache_name.substr(0, 2)
+        / fmt::format(FMT_STRING("{}.idx"), cache_name);
+}
+
+bool
+logfile::load_index_cache(const struct stat& st)
+{
+    static const auto& root_formats = log_format::get_root_formats();
+
+    auto cache_path_opt = this->index_cache_path(st);
+    if (!cache_path_opt) {
+        return false;
+    }
+
+    const auto& cache_path = cache_path_opt.value();
+    auto open_res = lnav::filesystem::open_file(cache_path, O_RDONLY);
+    if (open_res.isErr()) {
+        return false;
+    }
+
+    auto cache_fd = open_res.unwrap();
+    struct stat cache_st;
+
+    if (fstat(cache_fd, &cache_st) == -1
+        || cache_st.st_size < (off_t) sizeof(index_cache_header))
+    {
+        return false;
+    }
+
+    auto* cache_base = (const char*) mmap(
+        nullptr, cache_st.st_size, PROT_READ, MAP_PRIVATE, cache_fd, 0);
+    if (cache_base == MAP_FAILED) {
+        log_error("%s: unable to mmap saved index -- %s",
+                  this->lf_filename.c_str(),
+                  strerror(errno));
+        return false;
+    }
+    auto unmap = finally([cache_base, &cache_st]() {
+        munmap((void*) cache_base, cache_st.st_size);
+    });
+
+    index_cache_header hdr;
+    memcpy(&hdr, cache_base, sizeof(hdr));
+    if (memcmp(hdr.ich_magic, INDEX_CACHE_MAGIC, sizeof(hdr.ich_magic)) != 0
+        || hdr.ich_version != INDEX_CACHE_VERSION
+        || hdr.ich_logline_size != sizeof(logline))
+    {
+        log_info("%s: ignoring saved index with a different version",
+                 this->lf_filename.c_str());
+        return false;
+    }
+
+    if (hdr.ich_index_size > st.st_size
+        || (hdr.ich_index_size == st.st_size && hdr.ich_mtime != st.st_mtime))
+    {
+        log_info("%s: file has changed since the index was saved",
+                 this->lf_filename.c_str());
+        return false;
+    }
+
+    auto fd = this->lf_line_buffer.get_fd();
+    auto head_len = std::min(hdr.ich_index_size, INDEX_CACHE_HASH_SIZE);
+    auto head_hash = hash_file_range(fd, 0, head_len);
+    auto tail_hash = hash_file_range(
+        fd, hdr.ich_index_size - head_len, head_len);
+    if (!head_hash || !tail_hash
+        || head_hash.value() != field_to_string(hdr.ich_head_hash,
+                                                sizeof(hdr.ich_head_hash))
+        || tail_hash.value() != field_to_string(hdr.ich_tail_hash,
+                                                sizeof(hdr.ich_tail_hash)))
+    {
+        log_info("%s: file content does not match saved index",
+                 this->lf_filename.c_str());
+        return false;
+    }
+
+    auto format_name
+        = field_to_string(hdr.ich_format_name, sizeof(hdr.ich_format_name));
+    auto format_key
+        = field_to_string(hdr.ich_format_key, sizeof(hdr.ich_format_key));
+    std::shared_ptr<log_format> root_format;
+    for (const auto& fmt : root_formats) {
+        if (fmt->get_name().to_string() != format_name) {
+            continue;
+        }
+
+        auto fmt_key = fmt->get_cache_key();
+        if (fmt_key
+            && index_cache_format_key(fmt_key.value(),
+                                      this->lf_file_options,
+                                      this->lf_zoned_to_local_state)
+                == format_key)
+        {
+            root_format = fmt;
+        }
+        break;
+    }
+    if (root_format == nullptr) {
+        log_info("%s: format for saved index has changed -- %s",
+                 this->lf_filename.c_str(),
+                 format_name.c_str());
+        return false;
+    }
+    if (!root_format->lf_tag_defs.empty()
+        || !root_format->lf_partition_defs.empty())
+    {
+        return false;
+    }
+
+    const auto lines_size = hdr.ich_line_count * sizeof(logline);
+    const auto locks_size
+        = hdr.ich_pattern_lock_count * sizeof(index_cache_lock);
+    const auto stats_size
+        = hdr.ich_value_stats_count * sizeof(logline_value_stats);
+    if (sizeof(hdr) + lines_size + locks_size + stats_size
+        > (size_t) cache_st.st_size)
+    {
+        log_error("%s: saved index is truncated", this->lf_filename.c_str());
+        return false;
+    }
+
+    const auto* curr = cache_base + sizeof(hdr);
+    const auto* cache_end = cache_base + cache_st.st_size;
+    std::vector<index_cache_lock> locks(hdr.ich_pattern_lock_count);
+
+    const auto* lines_begin = reinterpret_cast<const logline*>(curr);
+    this->lf_index.assign(lines_begin, lines_begin + hdr.ich_line_count);
+    curr += lines_size;
+    memcpy(locks.data(), curr, locks_size);
+    curr += locks_size;
+
+    auto fmt_lock = locks.empty() ? -1 : (int) locks.front().icl_pat_index;
+    auto format = root_format->specialized(fmt_lock);
+    if (format->lf_value_stats.size() != hdr.ich_value_stats_count) {
+        log_error("%s: value stats do not match format",
+                  this->lf_filename.c_str());
+        this->lf_index.clear();
+        return false;
+    }
+    memcpy(format->lf_value_stats.data(), curr, stats_size);
+    curr += stats_size;
+    format->lf_pattern_locks.clear();
+    for (const auto& lock : locks) {
+        format->lf_pattern_locks.emplace_back(lock.icl_line,
+                                              lock.icl_pat_index);
+    }
+    format->lf_timestamp_flags = hdr.ich_timestamp_flags;
+
+    {
+        safe::WriteAccess<logfile::safe_opid_state> writable_opid_map(
+            this->lf_opids);
+
+        for (uint32_t lpc = 0; lpc < hdr.ich_opid_count; lpc++) {
+            index_cache_opid ico;
+
+            if (curr + sizeof(ico) > cache_end) {
+                break;
+            }
+            memcpy(&ico, curr, sizeof(ico));
+            curr += sizeof(ico);
+            if (curr + ico.ico_length > cache_end) {
+                break;
+            }
+
+            auto opid = string_fragment::from_bytes(curr, ico.ico_length);
+            auto opid_iter = writable_opid_map->insert_op(
+                this->lf_allocator, opid, ico.ico_range.tr_begin);
+            opid_iter->second.otr_range = ico.ico_range;
+            opid_iter->second.otr_level_stats = ico.ico_level_stats;
+            curr += ico.ico_length;
+        }
+    }
+
+    this->lf_format = format;
+    this->lf_format_quality = hdr.ich_format_quality;
+    this->lf_text_format = text_format_t::TF_LOG;
+    this->lf_index_size = hdr.ich_index_size;
+    this->lf_index_cache_size = hdr.ich_index_size;
+    this->lf_longest_line = hdr.ich_longest_line;
+    this->lf_partial_line = hdr.ich_partial_line;
+    this->lf_content_id
+        = field_to_string(hdr.ich_content_id, sizeof(hdr.ich_content_id));
+    this->lf_sort_needed = true;
+    this->set_format_base_time(this->lf_format.get(), line_info{});
+    this->update_applicable_defs();
+    this->lf_format_match_messages.emplace_back(
+        lnav::console::user_message::ok(
+            attr_line_t()
+                .append(lnav::roles::identifier(format_name))
+                .append(" was loaded from a saved index")));
+
+    log_info("%s: loaded saved index -- lines=%zu; size=%lld; format=%s",
+             this->lf_filename.c_str(),
+             this->lf_index.size(),
+             (long long) this->lf_index_size,
+             format_name.c_str());
+
+    std::error_code ec;
+    std::filesystem::last_write_time(
+        cache_path, std::filesystem::file_time_type::clock::now(), ec);
+
+    if (this->lf_logline_observer != nullptr) {
+        this->set_logline_observer(this->lf_logline_observer);
+    }
+
+    return true;
+}
+
+void
+logfile::save_index_cache(const struct stat& st)
+{
+    auto cache_path_opt = this->index_cache_path(st);
+    if (!cache_path_opt) {
+        return;
+    }
+
+    auto format_key = this->lf_format->get_cache_key();
+    if (!format_key) {
+        return;
+    }
+
+    // Tags and partitions are kept in the bookmark metadata, which is not
+    // saved.
+    if (!this->lf_format->lf_tag_defs.empty()
+        || !this->lf_format->lf_partition_defs.empty())
+    {
+        return;
+    }
+
+    // Do not keep rewriting the index for a file that is slowly growing.
+    auto min_growth
+        = std::max(INDEX_CACHE_MIN_SIZE, this->lf_index_cache_size / 4);
+    if (this->lf_index_size < this->lf_index_cache_size + min_growth) {
+        return;
+    }
+
+    auto fd = this->lf_line_buffer.get_fd();
+    auto head_len = std::min(this->lf_index_size, INDEX_CACHE_HASH_SIZE);
+    auto head_hash = hash_file_range(fd, 0, head_len);
+    auto tail_hash
+        = hash_file_range(fd, this->lf_index_size - head_len, head_len);
+    if (!head_hash || !tail_hash) {
+        return;
+    }
+
+    auto snap = std::make_shared<index_cache_snapshot>();
+    uint32_t opid_count = 0;
+    {
+        safe::ReadAccess<logfile::safe_opid_state> opid_map(this->lf_opids);
+
+        if (!opid_map->los_sub_in_use.empty()) {
+            log_debug("%s: not saving index with sub-operations",
+                      this->lf_filename.c_str());
+            return;
+        }
+        for (const auto& opid_pair : opid_map->los_opid_ranges) {
+            const auto& otr = opid_pair.second;
+
+            if (otr.otr_description.lod_id
+                || !otr.otr_description.lod_elements.empty()
+                || !otr.otr_sub_ops.empty())
+            {
+                log_debug("%s: not saving index with operation descriptions",
+                          this->lf_filename.c_str());
+                return;
+            }
+
+            index_cache_opid ico{};
+            ico.ico_range = otr.otr_range;
+            ico.ico_level_stats = otr.otr_level_stats;
+            ico.ico_length = opid_pair.first.length();
+            snap->ics_opids.append((const char*) &ico, sizeof(ico));
+            snap->ics_opids.append(opid_pair.first.data(),
+                                   opid_pair.first.length());
+            opid_count += 1;
+        }
+    }
+
+    for (const auto& pfl : this->lf_format->lf_pattern_locks) {
+        snap->ics_locks.emplace_back(index_cache_lock{
+            pfl.pfl_line, static_cast<uint32_t>(pfl.pfl_pat_index)});
+    }
+
+    auto& hdr = snap->ics_header;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.ich_magic, INDEX_CACHE_MAGIC, sizeof(hdr.ich_magic));
+    hdr.ich_version = INDEX_CACHE_VERSION;
+    hdr.ich_logline_size = sizeof(logline);
+    hdr.ich_index_size = this->lf_index_size;
+    hdr.ich_mtime = st.st_mtime;
+    hdr.ich_line_count = this->lf_index.size();
+    hdr.ich_longest_line = this->lf_longest_line;
+    hdr.ich_timestamp_flags = this->lf_format->lf_timestamp_flags;
+    hdr.ich_format_quality = this->lf_format_quality;
+    hdr.ich_pattern_lock_count = snap->ics_locks.size();
+    hdr.ich_value_stats_count = this->lf_format->lf_value_stats.size();
+    hdr.ich_opid_count = opid_count;
+    hdr.ich_partial_line = this->lf_partial_line;
+    copy_to_field(hdr.ich_format_name,
+                  sizeof(hdr.ich_format_name),
+                  this->lf_format->get_name().to_string());
+    copy_to_field(hdr.ich_format_key,
+                  sizeof(hdr.ich_format_key),
+                  index_cache_format_key(format_key.value(),
+                                         this->lf_file_options,
+                                         this->lf_zoned_to_local_state));
+    copy_to_field(
+        hdr.ich_head_hash, sizeof(hdr.ich_head_hash), head_hash.value());
+    copy_to_field(
+        hdr.ich_tail_hash, sizeof(hdr.ich_tail_hash), tail_hash.value());
+    copy_to_field(hdr.ich_content_id,
+                  sizeof(hdr.ich_content_id),
+                  this->lf_content_id);
+
+    snap->ics_filename = this->lf_filename;
+    snap->ics_path = cache_path_opt.value();
+    snap->ics_index = this->lf_index;
+    snap->ics_value_stats = this->lf_format->lf_value_stats;
+
+    // Mark the index as saved now so that it is not snapshotted again while
+    // the write is still pending.
+    this->lf_index_cache_size = this->lf_index_size;
+
+    auto& writer = injector::get<index_cache_writer&>();
+    if (writer.is_running()) {
+        writer.send([snap](auto& icw) { snap->write(); });
+    } else {
+        snap->write();
+    }
+}
+
 void
 logfile::set_logline_observer(logline_observer* llo)
 {
     this->lf_logline_observer = llo;
     if (llo != nullptr) {
-        this->reobserve_from(this->begin());
+        if (llo->is_line_content_needed()) {
+            this->reobserve_from(this->begin());
+        } else {
+            llo->logline_new_lines(
+                *this, this->begin(), this->end(), shared_buffer_ref{});
+            llo->logline_eof(*this);
+        }
     }
 }
 
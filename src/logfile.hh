@@ -34,6 +34,7 @@
 
 #include <chrono>
 #include <filesystem>
+#include <map>
 #include <set>
 #include <string>
 #include <utility>
@@ -62,6 +63,8 @@
 #include "text_format.hh"
 #include "unique_path.hh"
 
+struct file_watch_state;
+
 /**
  * Observer interface for logfile indexing progress.
  *
@@ -87,6 +90,10 @@ struct logfile_activity {
     int64_t la_polls{0};
     int64_t la_reads{0};
     struct rusage la_initial_index_rusage{};
+    /** Time spent trying to detect the log format of lines. */
+    std::chrono::microseconds la_detect_time{0};
+    /** The number of lines that were checked for a log format. */
+    int64_t la_detect_lines{0};
 };
 
 /**
@@ -117,6 +124,11 @@ public:
         const logfile_open_options& loo,
         auto_fd fd = auto_fd{});
 
+    /**
+     * Remove saved indexes that have not been used in a while.
+     */
+    static void cleanup_index_cache();
+
     ~logfile() override;
 
     const logfile_activity& get_activity() const { return this->lf_activity; }
@@ -345,6 +357,20 @@ public:
 
     Result<shared_buffer_ref, std::string> read_raw_message(const_iterator ll);
 
+    /**
+     * Get the numeric value of a field in a message.  The values for a
+     * field are extracted a chunk of lines at a time and cached, so
+     * repeated queries over the same lines do not need to annotate the
+     * messages again.
+     *
+     * @param name The name of the field.
+     * @param ll The first line of the message.
+     * @return The value or nullopt if the line is not the start of a
+     *   message or the message does not have a numeric value for the field.
+     */
+    std::optional<double> get_numeric_value(const intern_string_t name,
+                                            const_iterator ll);
+
     enum class rebuild_result_t {
         INVALID,
         NO_NEW_LINES,
@@ -362,6 +388,29 @@ public:
     rebuild_result_t rebuild_index(std::optional<ui_clock::time_point> deadline
                                    = std::nullopt);
 
+    /**
+     * @return True if rebuild_index_in_worker() can be used for this file.
+     * The file needs to have settled on a format since format detection
+     * uses the shared root formats and the logline observer cannot have any
+     * work that needs to happen on the main thread.
+     */
+    bool can_index_in_worker() const;
+
+    /**
+     * Index any new data in the log file from a worker thread.  Work that
+     * needs to be done on the main thread, like reporting progress and
+     * evaluating watch expressions, is deferred until finish_worker_index()
+     * is called.
+     */
+    rebuild_result_t rebuild_index_in_worker(
+        std::optional<ui_clock::time_point> deadline);
+
+    /**
+     * Perform the work deferred by rebuild_index_in_worker().  This must be
+     * called on the main thread.
+     */
+    void finish_worker_index();
+
     void reobserve_from(iterator iter);
 
     void set_logfile_observer(logfile_observer* lo)
@@ -500,9 +549,39 @@ private:
 
     bool file_options_have_changed();
 
+    lnav::progress_result_t report_indexing(file_off_t off,
+                                            file_ssize_t total);
+
+    void update_applicable_defs();
+
+    /** Evaluate the watch expressions against the deferred messages. */
+    void flush_watch_lines();
+
+    /**
+     * @return The path to the file that the index for this file is saved in
+     * or nullopt if the index should not be saved.
+     */
+    std::optional<std::filesystem::path> index_cache_path(
+        const struct stat& st) const;
+
+    /**
+     * Try to load a previously saved index for this file.  The saved index
+     * is only used if the content that was indexed has not changed.
+     *
+     * @return True if the index was loaded.
+     */
+    bool load_index_cache(const struct stat& st);
+
+    void save_index_cache(const struct stat& st);
+
     std::filesystem::path lf_filename;
     logfile_open_options lf_options;
     logfile_activity lf_activity;
+    /**
+     * The change notifications for this file or nullptr if the file has to
+     * be polled for changes.
+     */
+    std::shared_ptr<file_watch_state> lf_watch_state;
     bool lf_named_file{true};
     bool lf_valid_filename{true};
     std::optional<std::filesystem::path> lf_actual_path;
@@ -534,7 +613,16 @@ private:
     uint32_t lf_out_of_time_order_count{0};
     safe_notes lf_notes;
     safe_opid_state lf_opids;
-    size_t lf_watch_count{0};
+    bool lf_in_worker{false};
+    bool lf_index_cache_checked{false};
+    file_off_t lf_index_cache_size{0};
+    /**
+     * The new messages that need to be checked against the watch
+     * expressions.  They are evaluated as a batch at the end of an index
+     * pass instead of as each line is indexed.
+     */
+    std::vector<uint32_t> lf_deferred_watch_lines;
+    std::optional<std::pair<file_off_t, file_ssize_t>> lf_deferred_progress;
     ArenaAlloc::Alloc<char> lf_allocator{64 * 1024};
     std::optional<time_t> lf_cached_base_time;
     std::optional<tm> lf_cached_base_tm;
@@ -543,6 +631,23 @@ private:
     std::set<intern_string_t> lf_mismatched_formats;
     robin_hood::unordered_map<uint32_t, bookmark_metadata> lf_bookmark_metadata;
 
+    /**
+     * The cached values of a numeric field for every line in the file.
+     * Lines without a value are NaN.
+     */
+    struct value_column {
+        const log_format* vc_format{nullptr};
+        file_off_t vc_index_size{0};
+        std::vector<double> vc_values;
+        std::vector<bool> vc_filled_chunks;
+    };
+
+    void fill_value_column(const intern_string_t name,
+                           value_column& col,
+                           size_t chunk);
+
+    std::map<intern_string_t, value_column> lf_value_columns;
+
     std::vector<std::shared_ptr<format_tag_def>> lf_applicable_taggers;
     std::vector<std::shared_ptr<format_partition_def>>
         lf_applicable_partitioners;
@@ -569,6 +674,19 @@ public:
         = 0;
 
     virtual void logline_eof(const logfile& lf) = 0;
+
+    /**
+     * @return True if the observer methods can be called from a thread other
+     * than the main one.
+     */
+    virtual bool is_thread_safe() const { return false; }
+
+    /**
+     * @return True if logline_new_lines() needs the content of the lines.
+     * If not, lines that were already indexed can be passed in a single call
+     * with an empty buffer.
+     */
+    virtual bool is_line_content_needed() const { return true; }
 };
 
 #endif
@@ -29,7 +29,11 @@
 
 #include <algorithm>
 #include <chrono>
+#include <condition_variable>
 #include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
 
 #include "logfile_sub_source.hh"
 
@@ -38,9 +42,11 @@
 #include "base/ansi_scrubber.hh"
 #include "base/ansi_vars.hh"
 #include "base/fs_util.hh"
+#include "base/future_util.hh"
 #include "base/injector.hh"
 #include "base/itertools.hh"
 #include "base/string_util.hh"
+#include "base/worker_pool.hh"
 #include "bookmarks.json.hh"
 #include "command_executor.hh"
 #include "config.h"
@@ -54,6 +60,7 @@
 #include "ptimec.hh"
 #include "scn/scan.h"
 #include "shlex.hh"
+#include "sql_filter_plan.hh"
 #include "sql_util.hh"
 #include "vtab_module.hh"
 #include "yajlpp/yajlpp.hh"
@@ -64,6 +71,8 @@ using namespace lnav::roles::literals;
 
 const bookmark_type_t logfile_sub_source::BM_FILES("file");
 
+static constexpr size_t MAX_PARTIAL_REBUILDS = 16;
+
 static int
 pretty_sql_callback(exec_context& ec, sqlite3_stmt* stmt)
 {
@@ -287,60 +296,98 @@ logfile_sub_source::text_value_for_line(textview_curses& tc,
     this->lss_token_attrs.clear();
     this->lss_token_values.clear();
     this->lss_share_manager.invalidate_refs();
-    if (flags & text_sub_source::RF_FULL) {
-        shared_buffer_ref sbr;
-
-        this->lss_token_file->read_full_message(this->lss_token_line, sbr);
-        this->lss_token_value = to_string(sbr);
-        if (sbr.get_metadata().m_has_ansi) {
-            scrub_ansi_string(this->lss_token_value, &this->lss_token_attrs);
-            sbr.get_metadata().m_has_ansi = false;
-        }
-    } else {
-        this->lss_token_value
-            = this->lss_token_file->read_line(this->lss_token_line)
-                  .map([](auto sbr) { return to_string(sbr); })
-                  .unwrapOr({});
-        if (this->lss_token_line->has_ansi()) {
-            scrub_ansi_string(this->lss_token_value, &this->lss_token_attrs);
-        }
-    }
     this->lss_token_shift_start = 0;
     this->lss_token_shift_size = 0;
 
     auto format = this->lss_token_file->get_format();
-
-    value_out = this->lss_token_value;
-
     auto& sbr = this->lss_token_values.lvv_sbr;
+    const auto cache_key = std::make_pair((int64_t) line, flags);
+    auto cached_line = (flags & RF_REWRITE)
+        ? std::nullopt
+        : this->lss_render_cache.get(cache_key);
+
+    if (cached_line
+        && cached_line.value()->rl_file == this->lss_token_file.get()
+        && cached_line.value()->rl_index_generation
+            == this->lss_token_file->get_index_generation())
+    {
+        const auto& rl = *cached_line.value();
+
+        this->lss_render_cache_stats.rcs_hits += 1;
+        this->lss_token_value = rl.rl_value;
+        this->lss_token_attrs = rl.rl_attrs;
+        this->lss_token_values.lvv_values = rl.rl_values.lvv_values;
+        this->lss_token_values.lvv_opid_value = rl.rl_values.lvv_opid_value;
+        this->lss_token_values.lvv_opid_provenance
+            = rl.rl_values.lvv_opid_provenance;
+        sbr.share(this->lss_share_manager,
+                  (char*) this->lss_token_value.c_str(),
+                  this->lss_token_value.size());
+        for (auto& lv : this->lss_token_values.lvv_values) {
+            if (lv.lv_frag.sf_string == rl.rl_value.c_str()) {
+                lv.lv_frag.sf_string = this->lss_token_value.c_str();
+            }
+        }
+        value_out = this->lss_token_value;
+    } else {
+        this->lss_render_cache_stats.rcs_misses += 1;
+        if (flags & text_sub_source::RF_FULL) {
+            shared_buffer_ref full_sbr;
+
+            this->lss_token_file->read_full_message(this->lss_token_line,
+                                                    full_sbr);
+            this->lss_token_value = to_string(full_sbr);
+            if (full_sbr.get_metadata().m_has_ansi) {
+                scrub_ansi_string(this->lss_token_value,
+                                  &this->lss_token_attrs);
+                full_sbr.get_metadata().m_has_ansi = false;
+            }
+        } else {
+            this->lss_token_value
+                = this->lss_token_file->read_line(this->lss_token_line)
+                      .map([](auto sbr) { return to_string(sbr); })
+                      .unwrapOr({});
+            if (this->lss_token_line->has_ansi()) {
+                scrub_ansi_string(this->lss_token_value,
+                                  &this->lss_token_attrs);
+            }
+        }
 
-    sbr.share(this->lss_share_manager,
-              (char*) this->lss_token_value.c_str(),
-              this->lss_token_value.size());
-    format->annotate(this->lss_token_file.get(),
-                     line,
-                     this->lss_token_attrs,
-                     this->lss_token_values);
-    if (flags & RF_REWRITE) {
-        exec_context ec(
-            &this->lss_token_values, pretty_sql_callback, pretty_pipe_callback);
-        std::string rewritten_line;
-        db_label_source rewrite_label_source;
-
-        ec.with_perms(exec_context::perm_t::READ_ONLY);
-        ec.ec_local_vars.push(std::map<std::string, scoped_value_t>());
-        ec.ec_top_line = vis_line_t(row);
-        ec.ec_label_source_stack.push_back(&rewrite_label_source);
-        add_ansi_vars(ec.ec_global_vars);
-        add_global_vars(ec);
-        format->rewrite(ec, sbr, this->lss_token_attrs, rewritten_line);
-        this->lss_token_value.assign(rewritten_line);
         value_out = this->lss_token_value;
-    }
 
-    {
-        auto lr = line_range{0, (int) this->lss_token_value.length()};
-        this->lss_token_attrs.emplace_back(lr, SA_ORIGINAL_LINE.value());
+        sbr.share(this->lss_share_manager,
+                  (char*) this->lss_token_value.c_str(),
+                  this->lss_token_value.size());
+        format->annotate(this->lss_token_file.get(),
+                         line,
+                         this->lss_token_attrs,
+                         this->lss_token_values);
+        if (flags & RF_REWRITE) {
+            exec_context ec(&this->lss_token_values,
+                            pretty_sql_callback,
+                            pretty_pipe_callback);
+            std::string rewritten_line;
+            db_label_source rewrite_label_source;
+
+            ec.with_perms(exec_context::perm_t::READ_ONLY);
+            ec.ec_local_vars.push(std::map<std::string, scoped_value_t>());
+            ec.ec_top_line = vis_line_t(row);
+            ec.ec_label_source_stack.push_back(&rewrite_label_source);
+            add_ansi_vars(ec.ec_global_vars);
+            add_global_vars(ec);
+            format->rewrite(ec, sbr, this->lss_token_attrs, rewritten_line);
+            this->lss_token_value.assign(rewritten_line);
+            value_out = this->lss_token_value;
+        }
+
+        {
+            auto lr = line_range{0, (int) this->lss_token_value.length()};
+            this->lss_token_attrs.emplace_back(lr, SA_ORIGINAL_LINE.value());
+        }
+
+        if (!(flags & RF_REWRITE)) {
+            this->cache_rendered_line(cache_key);
+        }
     }
 
     std::optional<exttm> adjusted_tm;
@@ -856,6 +903,64 @@ struct logline_cmp {
     logfile_sub_source& llss_controller;
 };
 
+std::vector<std::optional<logfile::rebuild_result_t>>
+logfile_sub_source::index_files_in_workers(
+    std::optional<ui_clock::time_point> deadline)
+{
+    static constexpr size_t MIN_WORKER_LINES = 1000;
+
+    std::vector<std::optional<logfile::rebuild_result_t>> retval(
+        this->lss_files.size());
+
+    if (this->tss_view->is_paused()) {
+        return retval;
+    }
+
+    std::vector<size_t> candidates;
+    for (size_t lpc = 0; lpc < this->lss_files.size(); lpc++) {
+        auto* lf = this->lss_files[lpc]->get_file_ptr();
+
+        if (lf == nullptr || !lf->can_index_in_worker()
+            || lf->estimated_remaining_lines() < MIN_WORKER_LINES)
+        {
+            continue;
+        }
+        candidates.emplace_back(lpc);
+    }
+
+    // Not worth spinning up threads when there is only one big file.
+    if (candidates.size() < 2) {
+        return retval;
+    }
+
+    log_debug("indexing %zu files in workers", candidates.size());
+    lnav::futures::future_queue<
+        std::pair<size_t, logfile::rebuild_result_t>>
+        index_queue(
+            [this, &retval](auto& fut) {
+                auto res = fut.get();
+                auto* lf = this->lss_files[res.first]->get_file_ptr();
+
+                lf->finish_worker_index();
+                retval[res.first] = res.second;
+                return lnav::progress_result_t::ok;
+            },
+            std::max(1U, std::thread::hardware_concurrency()));
+
+    for (const auto file_index : candidates) {
+        auto* lf = this->lss_files[file_index]->get_file_ptr();
+
+        index_queue.push_back(
+            std::async(std::launch::async, [lf, file_index, deadline]() {
+                return std::make_pair(file_index,
+                                      lf->rebuild_index_in_worker(deadline));
+            }));
+    }
+    index_queue.pop_to();
+
+    return retval;
+}
+
 logfile_sub_source::rebuild_result
 logfile_sub_source::rebuild_index(std::optional<ui_clock::time_point> deadline)
 {
@@ -870,7 +975,6 @@ logfile_sub_source::rebuild_index(std::optional<ui_clock::time_point> deadline)
     size_t total_lines = 0;
     size_t est_remaining_lines = 0;
     bool full_sort = false;
-    int file_count = 0;
     bool force = this->lss_force_rebuild;
     auto retval = rebuild_result::rr_no_change;
     std::optional<timeval> lowest_tv = std::nullopt;
@@ -907,6 +1011,7 @@ logfile_sub_source::rebuild_index(std::optional<ui_clock::time_point> deadline)
                          });
     }
 
+    auto worker_results = this->index_files_in_workers(deadline);
     bool time_left = true;
     this->lss_all_timestamp_flags = 0;
     for (const auto file_index : file_order) {
@@ -930,8 +1035,12 @@ logfile_sub_source::rebuild_index(std::optional<ui_clock::time_point> deadline)
             this->lss_all_timestamp_flags
                 |= lf->get_format_ptr()->lf_timestamp_flags;
 
-            if (!this->tss_view->is_paused() && time_left) {
-                switch (lf->rebuild_index(deadline)) {
+            const auto& worker_res = worker_results[file_index];
+            if (!this->tss_view->is_paused() && (time_left || worker_res)) {
+                auto rebuild_res = worker_res ? worker_res.value()
+                                              : lf->rebuild_index(deadline);
+
+                switch (rebuild_res) {
                     case logfile::rebuild_result_t::NO_NEW_LINES:
                         // No changes
                         break;
@@ -939,6 +1048,7 @@ logfile_sub_source::rebuild_index(std::optional<ui_clock::time_point> deadline)
                         if (retval == rebuild_result::rr_no_change) {
                             retval = rebuild_result::rr_appended_lines;
                         }
+                        this->invalidate_rendered_tail(ld);
                         log_debug("new lines for %s:%d",
                                   lf->get_filename().c_str(),
                                   lf->size());
@@ -1000,7 +1110,6 @@ logfile_sub_source::rebuild_index(std::optional<ui_clock::time_point> deadline)
                         break;
                 }
             }
-            file_count += 1;
             total_lines += lf->size();
 
             est_remaining_lines += lf->estimated_remaining_lines();
@@ -1008,12 +1117,7 @@ logfile_sub_source::rebuild_index(std::optional<ui_clock::time_point> deadline)
     }
 
     if (this->lss_index.reserve(total_lines + est_remaining_lines)) {
-        // The index array was reallocated, just do a full sort/rebuild since
-        // it's been cleared out.
         log_debug("expanding index capacity %zu", this->lss_index.ba_capacity);
-        force = true;
-        retval = rebuild_result::rr_full_rebuild;
-        full_sort = true;
     }
 
     auto& vis_bm = this->tss_view->get_bookmarks();
@@ -1120,6 +1224,45 @@ logfile_sub_source::rebuild_index(std::optional<ui_clock::time_point> deadline)
                 this->lss_filename_width, lf->get_filename().native().size());
         }
 
+        auto push_line = [this](logfile_data* ld, logfile::iterator lf_iter) {
+            if (lf_iter->is_ignored()) {
+                return;
+            }
+
+            int file_index = ld->ld_file_index;
+            int line_index = lf_iter - ld->get_file_ptr()->begin();
+
+            content_line_t con_line(file_index * MAX_LINES_PER_FILE
+                                    + line_index);
+
+            if (lf_iter->is_meta_marked()) {
+                auto start_iter = lf_iter;
+                while (start_iter->is_continued()) {
+                    --start_iter;
+                }
+                int start_index = start_iter - ld->get_file_ptr()->begin();
+                content_line_t start_con_line(file_index * MAX_LINES_PER_FILE
+                                              + start_index);
+
+                auto& line_meta
+                    = ld->get_file_ptr()->get_bookmark_metadata()[start_index];
+                if (line_meta.has(bookmark_metadata::categories::notes)) {
+                    this->lss_user_marks[&textview_curses::BM_META]
+                        .insert_once(start_con_line);
+                }
+                if (line_meta.has(bookmark_metadata::categories::partition)) {
+                    this->lss_user_marks[&textview_curses::BM_PARTITION]
+                        .insert_once(start_con_line);
+                }
+            }
+            this->lss_index.push_back(con_line);
+        };
+
+        // Files that are already in time-order are k-way merged below, only
+        // the lines from files that are out-of-order need to be sorted.
+        std::vector<logfile_data*> merge_files;
+        size_t sorted_size = 0;
+
         if (full_sort) {
             log_trace("rebuild_index full sort");
             for (auto& ld : this->lss_files) {
@@ -1129,71 +1272,46 @@ logfile_sub_source::rebuild_index(std::optional<ui_clock::time_point> deadline)
                     continue;
                 }
 
-                for (size_t line_index = 0; line_index < lf->size();
-                     line_index++)
-                {
-                    const auto lf_iter
-                        = ld->get_file_ptr()->begin() + line_index;
-                    if (lf_iter->is_ignored()) {
-                        continue;
-                    }
-
-                    content_line_t con_line(
-                        ld->ld_file_index * MAX_LINES_PER_FILE + line_index);
+                if (std::is_sorted(lf->begin(), lf->end())) {
+                    merge_files.emplace_back(ld.get());
+                    continue;
+                }
 
-                    if (lf_iter->is_meta_marked()) {
-                        auto start_iter = lf_iter;
-                        while (start_iter->is_continued()) {
-                            --start_iter;
-                        }
-                        int start_index
-                            = start_iter - ld->get_file_ptr()->begin();
-                        content_line_t start_con_line(ld->ld_file_index
-                                                          * MAX_LINES_PER_FILE
-                                                      + start_index);
-
-                        auto& line_meta
-                            = ld->get_file_ptr()
-                                  ->get_bookmark_metadata()[start_index];
-                        if (line_meta.has(bookmark_metadata::categories::notes))
-                        {
-                            this->lss_user_marks[&textview_curses::BM_META]
-                                .insert_once(start_con_line);
-                        }
-                        if (line_meta.has(
-                                bookmark_metadata::categories::partition))
-                        {
-                            this->lss_user_marks[&textview_curses::BM_PARTITION]
-                                .insert_once(start_con_line);
-                        }
-                    }
-                    this->lss_index.push_back(con_line);
+                log_debug("%s: lines are not in time-order, sorting",
+                          lf->get_filename().c_str());
+                for (auto lf_iter = lf->begin(); lf_iter != lf->end();
+                     ++lf_iter)
+                {
+                    push_line(ld.get(), lf_iter);
                 }
             }
 
-            // XXX get rid of this full sort on the initial run, it's not
-            // needed unless the file is not in time-order
-            if (this->lss_sorting_observer) {
-                this->lss_sorting_observer(*this, 0, this->lss_index.size());
-            }
-            std::sort(
-                this->lss_index.begin(), this->lss_index.end(), line_cmper);
-            if (this->lss_sorting_observer) {
-                this->lss_sorting_observer(
-                    *this, this->lss_index.size(), this->lss_index.size());
+            sorted_size = this->lss_index.size();
+            if (sorted_size > start_size) {
+                if (this->lss_sorting_observer) {
+                    this->lss_sorting_observer(*this, 0, sorted_size);
+                }
+                std::sort(this->lss_index.begin(),
+                          this->lss_index.end(),
+                          line_cmper);
+                if (this->lss_sorting_observer) {
+                    this->lss_sorting_observer(*this, sorted_size, sorted_size);
+                }
             }
         } else {
+            for (auto& ld : this->lss_files) {
+                if (ld->get_file_ptr() != nullptr) {
+                    merge_files.emplace_back(ld.get());
+                }
+            }
+        }
+
+        if (!merge_files.empty()) {
             kmerge_tree_c<logline, logfile_data, logfile::iterator> merge(
-                file_count);
+                merge_files.size());
 
-            for (iter = this->lss_files.begin(); iter != this->lss_files.end();
-                 iter++)
-            {
-                auto* ld = iter->get();
+            for (auto* ld : merge_files) {
                 auto* lf = ld->get_file_ptr();
-                if (lf == nullptr) {
-                    continue;
-                }
 
                 merge.add(ld, lf->begin() + ld->ld_lines_indexed, lf->end());
                 index_size += lf->size();
@@ -1213,40 +1331,7 @@ logfile_sub_source::rebuild_index(std::optional<ui_clock::time_point> deadline)
                     break;
                 }
 
-                if (!lf_iter->is_ignored()) {
-                    int file_index = ld->ld_file_index;
-                    int line_index = lf_iter - ld->get_file_ptr()->begin();
-
-                    content_line_t con_line(file_index * MAX_LINES_PER_FILE
-                                            + line_index);
-
-                    if (lf_iter->is_meta_marked()) {
-                        auto start_iter = lf_iter;
-                        while (start_iter->is_continued()) {
-                            --start_iter;
-                        }
-                        int start_index
-                            = start_iter - ld->get_file_ptr()->begin();
-                        content_line_t start_con_line(
-                            file_index * MAX_LINES_PER_FILE + start_index);
-
-                        auto& line_meta
-                            = ld->get_file_ptr()
-                                  ->get_bookmark_metadata()[start_index];
-                        if (line_meta.has(bookmark_metadata::categories::notes))
-                        {
-                            this->lss_user_marks[&textview_curses::BM_META]
-                                .insert_once(start_con_line);
-                        }
-                        if (line_meta.has(
-                                bookmark_metadata::categories::partition))
-                        {
-                            this->lss_user_marks[&textview_curses::BM_PARTITION]
-                                .insert_once(start_con_line);
-                        }
-                    }
-                    this->lss_index.push_back(con_line);
-                }
+                push_line(ld, lf_iter);
 
                 merge.next();
                 index_off += 1;
@@ -1259,6 +1344,14 @@ logfile_sub_source::rebuild_index(std::optional<ui_clock::time_point> deadline)
             }
         }
 
+        if (sorted_size > start_size && sorted_size < this->lss_index.size()) {
+            // Both sorted and merged lines were added, combine the two runs.
+            std::inplace_merge(this->lss_index.begin(),
+                               this->lss_index.begin() + sorted_size,
+                               this->lss_index.end(),
+                               line_cmper);
+        }
+
         for (iter = this->lss_files.begin(); iter != this->lss_files.end();
              iter++)
         {
@@ -1273,59 +1366,12 @@ logfile_sub_source::rebuild_index(std::optional<ui_clock::time_point> deadline)
 
         this->lss_filtered_index.reserve(this->lss_index.size());
 
-        uint32_t filter_in_mask, filter_out_mask;
-        this->get_filters().get_enabled_mask(filter_in_mask, filter_out_mask);
-
         if (start_size == 0 && this->lss_index_delegate != nullptr) {
             this->lss_index_delegate->index_start(*this);
         }
 
         log_trace("filtered index");
-        for (size_t index_index = start_size;
-             index_index < this->lss_index.size();
-             index_index++)
-        {
-            const auto cl = (content_line_t) this->lss_index[index_index];
-            uint64_t line_number;
-            auto ld = this->find_data(cl, line_number);
-
-            if (!(*ld)->is_visible()) {
-                continue;
-            }
-
-            auto* lf = (*ld)->get_file_ptr();
-            auto line_iter = lf->begin() + line_number;
-
-            if (line_iter->is_ignored()) {
-                continue;
-            }
-
-            if (!this->tss_apply_filters
-                || (!(*ld)->ld_filter_state.excluded(
-                        filter_in_mask, filter_out_mask, line_number)
-                    && this->check_extra_filters(ld, line_iter)))
-            {
-                auto eval_res = this->eval_sql_filter(
-                    this->lss_marker_stmt.in(), ld, line_iter);
-                if (eval_res.isErr()) {
-                    line_iter->set_expr_mark(false);
-                } else {
-                    auto matched = eval_res.unwrap();
-
-                    if (matched) {
-                        line_iter->set_expr_mark(true);
-                        vis_bm[&textview_curses::BM_USER_EXPR].insert_once(
-                            vis_line_t(this->lss_filtered_index.size()));
-                    } else {
-                        line_iter->set_expr_mark(false);
-                    }
-                }
-                this->lss_filtered_index.push_back(index_index);
-                if (this->lss_index_delegate != nullptr) {
-                    this->lss_index_delegate->index_line(*this, lf, line_iter);
-                }
-            }
-        }
+        this->append_filtered_lines(start_size);
 
         this->lss_indexing_in_progress = false;
 
@@ -1334,18 +1380,32 @@ logfile_sub_source::rebuild_index(std::optional<ui_clock::time_point> deadline)
         }
     }
 
+    // Files with appended lines only drop their last message from the cache
+    // above, a rebuild or reorder needs to start over.
+    if (retval == rebuild_result::rr_full_rebuild
+        || retval == rebuild_result::rr_partial_rebuild)
+    {
+        this->invalidate_rendered_lines();
+    }
+
     switch (retval) {
         case rebuild_result::rr_no_change:
             break;
         case rebuild_result::rr_full_rebuild:
             log_debug("redoing search");
             this->lss_index_generation += 1;
+            this->lss_partial_rebuilds.clear();
             this->tss_view->reload_data();
             this->tss_view->redo_search();
             break;
         case rebuild_result::rr_partial_rebuild:
             log_debug("redoing search from: %d", (int) search_start);
             this->lss_index_generation += 1;
+            this->lss_partial_rebuilds.emplace_back(this->lss_index_generation,
+                                                    search_start);
+            if (this->lss_partial_rebuilds.size() > MAX_PARTIAL_REBUILDS) {
+                this->lss_partial_rebuilds.pop_front();
+            }
             this->tss_view->reload_data();
             this->tss_view->search_new_data(search_start);
             break;
@@ -1415,10 +1475,36 @@ logfile_sub_source::text_update_marks(vis_bookmarks& bm)
     }
 }
 
+std::optional<vis_line_t>
+logfile_sub_source::first_changed_line_since(uint32_t gen) const
+{
+    std::optional<vis_line_t> retval;
+    auto expected_gen = gen + 1;
+
+    for (const auto& [rebuild_gen, rebuild_line] : this->lss_partial_rebuilds) {
+        if (rebuild_gen <= gen) {
+            continue;
+        }
+        if (rebuild_gen != expected_gen) {
+            return std::nullopt;
+        }
+        if (!retval || rebuild_line < retval.value()) {
+            retval = rebuild_line;
+        }
+        expected_gen += 1;
+    }
+    if (expected_gen != this->lss_index_generation + 1) {
+        return std::nullopt;
+    }
+
+    return retval;
+}
+
 void
 logfile_sub_source::text_filters_changed()
 {
     this->lss_index_generation += 1;
+    this->lss_partial_rebuilds.clear();
 
     if (this->lss_line_meta_changed) {
         this->invalidate_sql_filter();
@@ -1440,56 +1526,22 @@ logfile_sub_source::text_filters_changed()
     }
 
     auto& vis_bm = this->tss_view->get_bookmarks();
-    uint32_t filtered_in_mask, filtered_out_mask;
-
-    this->get_filters().get_enabled_mask(filtered_in_mask, filtered_out_mask);
 
     if (this->lss_index_delegate != nullptr) {
         this->lss_index_delegate->index_start(*this);
     }
     vis_bm[&textview_curses::BM_USER_EXPR].clear();
 
-    this->lss_filtered_index.clear();
-    for (size_t index_index = 0; index_index < this->lss_index.size();
-         index_index++)
-    {
-        content_line_t cl = (content_line_t) this->lss_index[index_index];
-        uint64_t line_number;
-        auto ld = this->find_data(cl, line_number);
-
-        if (!(*ld)->is_visible()) {
-            continue;
-        }
-
-        auto lf = (*ld)->get_file_ptr();
-        auto line_iter = lf->begin() + line_number;
-
-        if (!this->tss_apply_filters
-            || (!(*ld)->ld_filter_state.excluded(
-                    filtered_in_mask, filtered_out_mask, line_number)
-                && this->check_extra_filters(ld, line_iter)))
-        {
-            auto eval_res = this->eval_sql_filter(
-                this->lss_marker_stmt.in(), ld, line_iter);
-            if (eval_res.isErr()) {
-                line_iter->set_expr_mark(false);
-            } else {
-                auto matched = eval_res.unwrap();
+    std::optional<size_t> focus;
+    if (this->tss_view != nullptr) {
+        auto top = this->tss_view->get_top();
 
-                if (matched) {
-                    line_iter->set_expr_mark(true);
-                    vis_bm[&textview_curses::BM_USER_EXPR].insert_once(
-                        vis_line_t(this->lss_filtered_index.size()));
-                } else {
-                    line_iter->set_expr_mark(false);
-                }
-            }
-            this->lss_filtered_index.push_back(index_index);
-            if (this->lss_index_delegate != nullptr) {
-                this->lss_index_delegate->index_line(*this, lf, line_iter);
-            }
+        if (top >= 0 && top < (int) this->lss_filtered_index.size()) {
+            focus = this->lss_filtered_index[top];
         }
     }
+    this->lss_filtered_index.clear();
+    this->append_filtered_lines(0, focus);
 
     if (this->lss_index_delegate != nullptr) {
         this->lss_index_delegate->index_complete(*this);
@@ -1558,6 +1610,7 @@ logfile_sub_source::list_input_handle_key(listview_curses& lv,
                         if (state_iter != fstates.end()) {
                             format->hide_field(iter->second.ri_meta->lvm_name,
                                                !state_iter->second.is_hidden());
+                            this->invalidate_rendered_lines();
                             lv.set_needs_update();
                         }
                     }
@@ -1809,6 +1862,19 @@ logfile_sub_source::set_preview_sql_filter(sqlite3_stmt* stmt)
     return Ok();
 }
 
+std::shared_ptr<sql_filter_plan>
+logfile_sub_source::get_filter_plan(sqlite3_stmt* stmt)
+{
+    auto plan_opt = this->lss_filter_plans.get(stmt);
+    if (plan_opt && plan_opt.value()->fp_sql == sqlite3_sql(stmt)) {
+        return plan_opt.value();
+    }
+
+    auto retval = sql_filter_plan::create(stmt);
+    this->lss_filter_plans.put(stmt, retval);
+    return retval;
+}
+
 Result<bool, lnav::console::user_message>
 logfile_sub_source::eval_sql_filter(sqlite3_stmt* stmt,
                                     iterator ld,
@@ -1818,241 +1884,308 @@ logfile_sub_source::eval_sql_filter(sqlite3_stmt* stmt,
         return Ok(false);
     }
 
-    auto* lf = (*ld)->get_file_ptr();
-    char timestamp_buffer[64];
-    shared_buffer_ref raw_sbr;
-    logline_value_vector values;
-    auto& sbr = values.lvv_sbr;
-    lf->read_full_message(ll, sbr);
-    sbr.erase_ansi();
-    auto format = lf->get_format();
-    string_attrs_t sa;
-    auto line_number = std::distance(lf->cbegin(), ll);
-    format->annotate(lf, line_number, sa, values);
+    auto plan = this->get_filter_plan(stmt);
+    sql_filter_plan::line_context lc((*ld)->get_file_ptr(), ll);
+    auto native_res = plan->eval(lc);
+    if (native_res) {
+        return Ok(native_res.value());
+    }
 
     sqlite3_reset(stmt);
     sqlite3_clear_bindings(stmt);
+    plan->bind(stmt, lc);
 
-    auto count = sqlite3_bind_parameter_count(stmt);
-    for (int lpc = 0; lpc < count; lpc++) {
-        const auto* name = sqlite3_bind_parameter_name(stmt, lpc + 1);
+    auto step_res = sqlite3_step(stmt);
 
-        if (name[0] == '$') {
-            const char* env_value;
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    switch (step_res) {
+        case SQLITE_OK:
+        case SQLITE_DONE:
+            return Ok(false);
+        case SQLITE_ROW:
+            return Ok(true);
+        default:
+            return Err(sqlite3_error_to_user_message(sqlite3_db_handle(stmt)));
+    }
+}
 
-            if ((env_value = getenv(&name[1])) != nullptr) {
-                sqlite3_bind_text(stmt, lpc + 1, env_value, -1, SQLITE_STATIC);
-            }
-            continue;
-        }
-        if (strcmp(name, ":log_level") == 0) {
-            sqlite3_bind_text(
-                stmt, lpc + 1, ll->get_level_name(), -1, SQLITE_STATIC);
-            continue;
-        }
-        if (strcmp(name, ":log_time") == 0) {
-            auto len = sql_strftime(timestamp_buffer,
-                                    sizeof(timestamp_buffer),
-                                    ll->get_timeval(),
-                                    'T');
-            sqlite3_bind_text(
-                stmt, lpc + 1, timestamp_buffer, len, SQLITE_STATIC);
-            continue;
-        }
-        if (strcmp(name, ":log_time_msecs") == 0) {
-            sqlite3_bind_int64(
-                stmt,
-                lpc + 1,
-                ll->get_time<std::chrono::milliseconds>().count());
-            continue;
-        }
-        if (strcmp(name, ":log_mark") == 0) {
-            sqlite3_bind_int(stmt, lpc + 1, ll->is_marked());
-            continue;
-        }
-        if (strcmp(name, ":log_comment") == 0) {
-            const auto& bm = lf->get_bookmark_metadata();
-            auto line_number
-                = static_cast<uint32_t>(std::distance(lf->cbegin(), ll));
-            auto bm_iter = bm.find(line_number);
-            if (bm_iter != bm.end() && !bm_iter->second.bm_comment.empty()) {
-                const auto& meta = bm_iter->second;
-                sqlite3_bind_text(stmt,
-                                  lpc + 1,
-                                  meta.bm_comment.c_str(),
-                                  meta.bm_comment.length(),
-                                  SQLITE_STATIC);
-            }
-            continue;
+void
+logfile_sub_source::cache_rendered_line(
+    const std::pair<int64_t, line_flags_t>& key)
+{
+    auto rl = std::make_shared<rendered_line>();
+
+    rl->rl_file = this->lss_token_file.get();
+    rl->rl_index_generation = this->lss_token_file->get_index_generation();
+    rl->rl_value = this->lss_token_value;
+    rl->rl_attrs = this->lss_token_attrs;
+    rl->rl_values.lvv_values = this->lss_token_values.lvv_values;
+    rl->rl_values.lvv_opid_value = this->lss_token_values.lvv_opid_value;
+    rl->rl_values.lvv_opid_provenance
+        = this->lss_token_values.lvv_opid_provenance;
+    for (auto& lv : rl->rl_values.lvv_values) {
+        if (lv.lv_frag.sf_string == this->lss_token_value.c_str()) {
+            lv.lv_frag.sf_string = rl->rl_value.c_str();
+        } else if (!lv.lv_frag.empty()) {
+            // The value refers to a buffer that is not owned by this line,
+            // so it cannot be kept around.
+            return;
         }
-        if (strcmp(name, ":log_annotations") == 0) {
-            const auto& bm = lf->get_bookmark_metadata();
-            auto line_number
-                = static_cast<uint32_t>(std::distance(lf->cbegin(), ll));
-            auto bm_iter = bm.find(line_number);
-            if (bm_iter != bm.end()
-                && !bm_iter->second.bm_annotations.la_pairs.empty())
-            {
-                const auto& meta = bm_iter->second;
-                auto anno_str = logmsg_annotations_handlers.to_string(
-                    meta.bm_annotations);
+    }
 
-                sqlite3_bind_text(stmt,
-                                  lpc + 1,
-                                  anno_str.c_str(),
-                                  anno_str.length(),
-                                  SQLITE_TRANSIENT);
-            }
-            continue;
+    this->lss_render_cache.put(key, rl);
+}
+
+void
+logfile_sub_source::invalidate_rendered_lines()
+{
+    this->lss_render_cache.clear();
+}
+
+void
+logfile_sub_source::invalidate_rendered_tail(const logfile_data& ld)
+{
+    const auto* lf = ld.get_file_ptr();
+    if (lf == nullptr) {
+        return;
+    }
+
+    auto end_line = std::min(ld.ld_lines_indexed, lf->size());
+    auto start_line = end_line;
+    while (start_line > 0) {
+        start_line -= 1;
+        if (!(lf->cbegin() + start_line)->is_continued()) {
+            break;
         }
-        if (strcmp(name, ":log_tags") == 0) {
-            const auto& bm = lf->get_bookmark_metadata();
-            auto line_number
-                = static_cast<uint32_t>(std::distance(lf->cbegin(), ll));
-            auto bm_iter = bm.find(line_number);
-            if (bm_iter != bm.end() && !bm_iter->second.bm_tags.empty()) {
-                const auto& meta = bm_iter->second;
-                yajlpp_gen gen;
+    }
 
-                yajl_gen_config(gen, yajl_gen_beautify, false);
+    const int64_t base = ld.ld_file_index * MAX_LINES_PER_FILE;
+    this->lss_render_cache.erase_if([&](const auto& key) {
+        return base + (int64_t) start_line <= key.first
+            && key.first < base + (int64_t) end_line;
+    });
+}
 
-                {
-                    yajlpp_array arr(gen);
+void
+logfile_sub_source::dump_stats() const
+{
+    log_info("render cache stats: hits=%zu misses=%zu size=%zu",
+             this->lss_render_cache_stats.rcs_hits,
+             this->lss_render_cache_stats.rcs_misses,
+             this->lss_render_cache.size());
+}
 
-                    for (const auto& str : meta.bm_tags) {
-                        arr.gen(str);
-                    }
-                }
+void
+logfile_sub_source::append_filtered_lines(size_t start,
+                                          std::optional<size_t> focus)
+{
+    static constexpr size_t CHUNK_SIZE = 16 * 1024;
 
-                string_fragment sf = gen.to_string_fragment();
+    auto& vis_bm = this->tss_view->get_bookmarks();
+    filter_mask_t filter_in_mask, filter_out_mask;
 
-                sqlite3_bind_text(
-                    stmt, lpc + 1, sf.data(), sf.length(), SQLITE_TRANSIENT);
-            }
-            continue;
+    this->get_filters().get_enabled_mask(filter_in_mask, filter_out_mask);
+
+    auto passes = [this, filter_in_mask, filter_out_mask](size_t index_index) {
+        const auto cl = (content_line_t) this->lss_index[index_index];
+        uint64_t line_number;
+        auto ld = this->find_data(cl, line_number);
+
+        if (!(*ld)->is_visible()) {
+            return false;
         }
-        if (strcmp(name, ":log_format") == 0) {
-            const auto format_name = format->get_name();
-            sqlite3_bind_text(stmt,
-                              lpc + 1,
-                              format_name.get(),
-                              format_name.size(),
-                              SQLITE_STATIC);
-            continue;
+
+        auto* lf = (*ld)->get_file_ptr();
+        auto line_iter = lf->begin() + line_number;
+
+        if (line_iter->is_ignored()) {
+            return false;
         }
-        if (strcmp(name, ":log_format_regex") == 0) {
-            const auto pat_name = format->get_pattern_name(line_number);
-            sqlite3_bind_text(
-                stmt, lpc + 1, pat_name.get(), pat_name.size(), SQLITE_STATIC);
-            continue;
+
+        return !this->tss_apply_filters
+            || (!(*ld)->ld_filter_state.excluded(
+                    filter_in_mask, filter_out_mask, line_number)
+                && this->check_extra_filters(ld, line_iter));
+    };
+    // The expression marks share a word with the fields read by the
+    // workers, so they are set after all of the chunks are checked.
+    std::vector<std::pair<logfile::iterator, bool>> expr_marks;
+    auto append_line = [this, &vis_bm, &expr_marks](size_t index_index) {
+        const auto cl = (content_line_t) this->lss_index[index_index];
+        uint64_t line_number;
+        auto ld = this->find_data(cl, line_number);
+        auto* lf = (*ld)->get_file_ptr();
+        auto line_iter = lf->begin() + line_number;
+        auto expr_mark = false;
+
+        auto eval_res
+            = this->eval_sql_filter(this->lss_marker_stmt.in(), ld, line_iter);
+        if (eval_res.isOk() && eval_res.unwrap()) {
+            expr_mark = true;
+            vis_bm[&textview_curses::BM_USER_EXPR].insert_once(
+                vis_line_t(this->lss_filtered_index.size()));
         }
-        if (strcmp(name, ":log_path") == 0) {
-            const auto& filename = lf->get_filename();
-            sqlite3_bind_text(stmt,
-                              lpc + 1,
-                              filename.c_str(),
-                              filename.native().length(),
-                              SQLITE_STATIC);
-            continue;
+        if (line_iter->is_expr_marked() != expr_mark) {
+            expr_marks.emplace_back(line_iter, expr_mark);
         }
-        if (strcmp(name, ":log_unique_path") == 0) {
-            const auto& filename = lf->get_unique_path();
-            sqlite3_bind_text(stmt,
-                              lpc + 1,
-                              filename.c_str(),
-                              filename.native().length(),
-                              SQLITE_STATIC);
-            continue;
+        this->lss_filtered_index.push_back(index_index);
+        if (this->lss_index_delegate != nullptr) {
+            this->lss_index_delegate->index_line(*this, lf, line_iter);
         }
-        if (strcmp(name, ":log_text") == 0) {
-            sqlite3_bind_text(
-                stmt, lpc + 1, sbr.get_data(), sbr.length(), SQLITE_STATIC);
-            continue;
+    };
+    auto apply_expr_marks = [&expr_marks]() {
+        for (auto& [line_iter, expr_mark] : expr_marks) {
+            line_iter->set_expr_mark(expr_mark);
         }
-        if (strcmp(name, ":log_body") == 0) {
-            auto body_attr_opt = get_string_attr(sa, SA_BODY);
-            if (body_attr_opt) {
-                const auto& sar
-                    = body_attr_opt.value().saw_string_attr->sa_range;
-
-                sqlite3_bind_text(stmt,
-                                  lpc + 1,
-                                  sbr.get_data_at(sar.lr_start),
-                                  sar.length(),
-                                  SQLITE_STATIC);
-            } else {
-                sqlite3_bind_null(stmt, lpc + 1);
+    };
+
+    const auto end = this->lss_index.size();
+    if (start >= end) {
+        return;
+    }
+
+    auto& pool = lnav::worker_pool::singleton();
+    const auto chunk_count = (end - start + CHUNK_SIZE - 1) / CHUNK_SIZE;
+
+    // The marked-only check looks at the expression marks of the other
+    // lines in a message, which are updated as lines are appended, so the
+    // lines have to be checked and appended in order.
+    if (chunk_count == 1 || pool.size() == 1 || this->lss_marked_only) {
+        for (auto index_index = start; index_index < end; index_index++) {
+            if (passes(index_index)) {
+                append_line(index_index);
+                apply_expr_marks();
+                expr_marks.clear();
             }
-            continue;
         }
-        if (strcmp(name, ":log_opid") == 0) {
-            if (values.lvv_opid_value) {
-                sqlite3_bind_text(stmt,
-                                  lpc + 1,
-                                  values.lvv_opid_value->c_str(),
-                                  values.lvv_opid_value->length(),
-                                  SQLITE_STATIC);
-            } else {
-                sqlite3_bind_null(stmt, lpc + 1);
-            }
-            continue;
+        return;
+    }
+
+    struct filter_chunk {
+        std::vector<uint32_t> fc_lines;
+        bool fc_done{false};
+    };
+    struct filter_state {
+        std::mutex fs_mutex;
+        std::condition_variable fs_cond;
+        std::vector<filter_chunk> fs_chunks;
+        std::vector<size_t> fs_order;
+        size_t fs_next{0};
+    };
+
+    auto state = std::make_shared<filter_state>();
+    state->fs_chunks.resize(chunk_count);
+    // The chunk with the focused line is checked first, followed by the
+    // rest in order, so the rows on the screen are ready as soon as the
+    // chunks before them are.
+    auto first_chunk = size_t{0};
+    if (focus && start <= focus.value() && focus.value() < end) {
+        first_chunk = (focus.value() - start) / CHUNK_SIZE;
+    }
+    state->fs_order.push_back(first_chunk);
+    for (size_t lpc = 0; lpc < chunk_count; lpc++) {
+        if (lpc != first_chunk) {
+            state->fs_order.push_back(lpc);
         }
-        if (strcmp(name, ":log_raw_text") == 0) {
-            auto res = lf->read_raw_message(ll);
+    }
+
+    // Check the next unclaimed chunk, returns false when there are none
+    // left.  A chunk is only claimed while the caller is waiting for all of
+    // them, so the captured references are still valid.
+    auto filter_next = [state, passes, start, end]() {
+        size_t chunk_index;
 
-            if (res.isOk()) {
-                raw_sbr = res.unwrap();
-                sqlite3_bind_text(stmt,
-                                  lpc + 1,
-                                  raw_sbr.get_data(),
-                                  raw_sbr.length(),
-                                  SQLITE_STATIC);
+        {
+            std::lock_guard<std::mutex> lg(state->fs_mutex);
+
+            if (state->fs_next >= state->fs_order.size()) {
+                return false;
             }
-            continue;
+            chunk_index = state->fs_order[state->fs_next++];
         }
-        for (const auto& lv : values.lvv_values) {
-            if (lv.lv_meta.lvm_name != &name[1]) {
-                continue;
-            }
 
-            switch (lv.lv_meta.lvm_kind) {
-                case value_kind_t::VALUE_BOOLEAN:
-                    sqlite3_bind_int64(stmt, lpc + 1, lv.lv_value.i);
-                    break;
-                case value_kind_t::VALUE_FLOAT:
-                    sqlite3_bind_double(stmt, lpc + 1, lv.lv_value.d);
-                    break;
-                case value_kind_t::VALUE_INTEGER:
-                    sqlite3_bind_int64(stmt, lpc + 1, lv.lv_value.i);
-                    break;
-                case value_kind_t::VALUE_NULL:
-                    sqlite3_bind_null(stmt, lpc + 1);
-                    break;
-                default:
-                    sqlite3_bind_text(stmt,
-                                      lpc + 1,
-                                      lv.text_value(),
-                                      lv.text_length(),
-                                      SQLITE_TRANSIENT);
-                    break;
+        std::vector<uint32_t> lines;
+        const auto chunk_start = start + chunk_index * CHUNK_SIZE;
+        const auto chunk_end = std::min(end, chunk_start + CHUNK_SIZE);
+        for (auto index_index = chunk_start; index_index < chunk_end;
+             index_index++)
+        {
+            if (passes(index_index)) {
+                lines.push_back(index_index);
             }
-            break;
         }
+
+        {
+            std::lock_guard<std::mutex> lg(state->fs_mutex);
+            auto& chunk = state->fs_chunks[chunk_index];
+
+            chunk.fc_lines = std::move(lines);
+            chunk.fc_done = true;
+        }
+        state->fs_cond.notify_all();
+        return true;
+    };
+
+    log_debug("filtering %zu lines in %zu chunks", end - start, chunk_count);
+    for (size_t lpc = 0; lpc < std::min(chunk_count, pool.size()); lpc++) {
+        pool.submit([filter_next]() {
+            while (filter_next()) {
+            }
+        });
     }
 
-    auto step_res = sqlite3_step(stmt);
+    // Wait for the given chunk to be checked, helping out instead of
+    // waiting while there are chunks left to claim.
+    auto wait_for_chunk = [&state, &filter_next](size_t chunk_index) {
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lk(state->fs_mutex);
+                auto& chunk = state->fs_chunks[chunk_index];
 
-    sqlite3_reset(stmt);
-    sqlite3_clear_bindings(stmt);
-    switch (step_res) {
-        case SQLITE_OK:
-        case SQLITE_DONE:
-            return Ok(false);
-        case SQLITE_ROW:
-            return Ok(true);
-        default:
-            return Err(sqlite3_error_to_user_message(sqlite3_db_handle(stmt)));
+                if (chunk.fc_done) {
+                    return std::move(chunk.fc_lines);
+                }
+                if (state->fs_next >= state->fs_order.size()) {
+                    state->fs_cond.wait(lk, [&chunk]() {
+                        return chunk.fc_done;
+                    });
+                    continue;
+                }
+            }
+            filter_next();
+        }
+    };
+
+    // A marker statement reads the lines through the file, which can
+    // update them, so the passing lines are only appended while the
+    // workers are running when there is no statement.
+    std::vector<std::vector<uint32_t>> fragments(chunk_count);
+    const auto append_while_filtering = this->lss_marker_stmt.in() == nullptr;
+    for (size_t chunk_index = 0; chunk_index < chunk_count; chunk_index++) {
+        auto lines = wait_for_chunk(chunk_index);
+        if (append_while_filtering) {
+            for (const auto index_index : lines) {
+                append_line(index_index);
+            }
+        } else {
+            fragments[chunk_index] = std::move(lines);
+        }
+        if (this->lss_sorting_observer) {
+            this->lss_sorting_observer(
+                *this,
+                std::min(end, start + (chunk_index + 1) * CHUNK_SIZE) - start,
+                end - start);
+        }
     }
+    if (!append_while_filtering) {
+        for (const auto& fragment : fragments) {
+            for (const auto index_index : fragment) {
+                append_line(index_index);
+            }
+        }
+    }
+    apply_expr_marks();
 }
 
 bool
@@ -2167,22 +2300,7 @@ logfile_sub_source::remove_file(std::shared_ptr<logfile> lf)
             auto mark_curr = content_line_t(file_index * MAX_LINES_PER_FILE);
             auto mark_end
                 = content_line_t((file_index + 1) * MAX_LINES_PER_FILE);
-            auto& bv = user_mark.second;
-            auto file_range = bv.equal_range(mark_curr, mark_end);
-
-            if (file_range.first != file_range.second) {
-                auto to_del = std::vector<content_line_t>{};
-                for (auto file_iter = file_range.first;
-                     file_iter != file_range.second;
-                     ++file_iter)
-                {
-                    to_del.emplace_back(*file_iter);
-                }
-
-                for (auto cl : to_del) {
-                    bv.bv_tree.erase(cl);
-                }
-            }
+            user_mark.second.erase_range(mark_curr, mark_end);
         }
 
         this->lss_force_rebuild = true;
@@ -2405,11 +2523,7 @@ logfile_sub_source::meta_grepper::grep_value_for_line(vis_line_t line,
         value_out.append(bm.bm_opid);
     }
 
-    if (!this->lmg_done) {
-        return line_info{};
-    }
-
-    return std::nullopt;
+    return line_info{};
 }
 
 vis_line_t
@@ -2431,11 +2545,7 @@ logfile_sub_source::meta_grepper::grep_next_line(vis_line_t& line)
     auto& bm = this->lmg_source.tss_view->get_bookmarks();
     auto& bv = bm[&textview_curses::BM_META];
 
-    auto line_opt = bv.next(vis_line_t(line));
-    if (!line_opt) {
-        this->lmg_done = true;
-    }
-    line = line_opt.value_or(-1_vl);
+    line = bv.next(vis_line_t(line)).value_or(-1_vl);
 }
 
 void
@@ -3321,8 +3431,8 @@ logfile_sub_source::get_filtered_count_for(size_t filter_index) const
     int retval = 0;
 
     for (const auto& ld : this->lss_files) {
-        retval += ld->ld_filter_state.lfo_filter_state
-                      .tfs_filter_hits[filter_index];
+        retval += ld->ld_filter_state.lfo_filter_state.get_filter_hits(
+            filter_index);
     }
 
     return retval;
@@ -33,11 +33,14 @@
 #define logfile_sub_source_hh
 
 #include <array>
+#include <deque>
+#include <optional>
 #include <utility>
 #include <vector>
 
 #include <limits.h>
 
+#include "base/lrucache.hpp"
 #include "base/time_util.hh"
 #include "big_array.hh"
 #include "bookmarks.hh"
@@ -57,6 +60,7 @@ int sqlite3_finalize(sqlite3_stmt* pStmt);
 }
 
 class logfile_sub_source;
+class sql_filter_plan;
 
 class index_delegate {
 public:
@@ -688,7 +692,6 @@ public:
         void grep_match(grep_proc<vis_line_t>& gp, vis_line_t line) override;
 
         logfile_sub_source& lmg_source;
-        bool lmg_done{false};
     };
 
     std::optional<
@@ -709,6 +712,14 @@ public:
     Result<bool, lnav::console::user_message> eval_sql_filter(
         sqlite3_stmt* stmt, iterator ld, logfile::const_iterator ll);
 
+    std::shared_ptr<sql_filter_plan> get_filter_plan(sqlite3_stmt* stmt);
+
+    /**
+     * Drop the cached filter plans so they are created again for the
+     * current database settings, like "PRAGMA case_sensitive_like".
+     */
+    void clear_filter_plans() { this->lss_filter_plans.clear(); }
+
     void invalidate_sql_filter();
 
     void set_line_meta_changed() { this->lss_line_meta_changed = true; }
@@ -728,6 +739,13 @@ public:
 
     uint32_t lss_index_generation{0};
 
+    /**
+     * @param gen A previous value of lss_index_generation.
+     * @return The first visible line that might have changed since the
+     *   given generation or std::nullopt if the whole index was rebuilt.
+     */
+    std::optional<vis_line_t> first_changed_line_since(uint32_t gen) const;
+
     void quiesce();
 
     struct __attribute__((__packed__)) indexed_content {
@@ -762,6 +780,26 @@ public:
         return this->lss_indexing_in_progress;
     }
 
+    struct render_cache_stats {
+        size_t rcs_hits{0};
+        size_t rcs_misses{0};
+    };
+
+    const render_cache_stats& get_render_cache_stats() const
+    {
+        return this->lss_render_cache_stats;
+    }
+
+    /**
+     * Drop the annotated lines cached by text_value_for_line().  This needs
+     * to be called after a change that affects how lines are annotated,
+     * like hiding a field.
+     */
+    void invalidate_rendered_lines();
+
+    /** Write the render cache statistics to the debug log. */
+    void dump_stats() const;
+
 protected:
     void text_accel_display_changed() { this->clear_line_size_cache(); }
 
@@ -781,6 +819,33 @@ private:
 
     bool check_extra_filters(iterator ld, logfile::iterator ll);
 
+    void cache_rendered_line(const std::pair<int64_t, line_flags_t>& key);
+
+    /**
+     * Drop the cached lines for the last message that was indexed in the
+     * given file.  That message is scanned again when lines are appended
+     * to the file, so it might have changed.
+     */
+    void invalidate_rendered_tail(const logfile_data& ld);
+
+    /**
+     * Append the lines in lss_index, starting at the given offset, that
+     * pass the filters to lss_filtered_index.  Large ranges are split into
+     * chunks that are checked by the worker pool, starting with the chunk
+     * that holds the focus offset, and the results are appended in order.
+     */
+    void append_filtered_lines(size_t start,
+                               std::optional<size_t> focus = std::nullopt);
+
+    /**
+     * Index the files with a lot of new data concurrently.
+     *
+     * @return The rebuild result for each file that was indexed, indexed by
+     * the file's position in lss_files.
+     */
+    std::vector<std::optional<logfile::rebuild_result_t>>
+    index_files_in_workers(std::optional<ui_clock::time_point> deadline);
+
     size_t lss_basename_width = 0;
     size_t lss_filename_width = 0;
     line_context_t lss_line_context{line_context_t::none};
@@ -794,6 +859,8 @@ private:
     bookmarks<content_line_t>::type lss_user_marks;
     auto_mem<sqlite3_stmt> lss_marker_stmt{sqlite3_finalize};
     std::string lss_marker_stmt_text;
+    cache::lru_cache<sqlite3_stmt*, std::shared_ptr<sql_filter_plan>>
+        lss_filter_plans{8};
 
     line_flags_t lss_token_flags{0};
     iterator lss_token_file_data;
@@ -812,6 +879,26 @@ private:
     logfile::iterator lss_token_line;
     std::array<std::pair<int, size_t>, LINE_SIZE_CACHE_SIZE>
         lss_line_size_cache;
+
+    /**
+     * A line as it was read, scrubbed of ANSI escapes, and annotated by the
+     * format.  The values in rl_values that refer to the line text point
+     * into rl_value.
+     */
+    struct rendered_line {
+        const logfile* rl_file{nullptr};
+        int rl_index_generation{0};
+        std::string rl_value;
+        string_attrs_t rl_attrs;
+        logline_value_vector rl_values;
+    };
+
+    static constexpr size_t RENDER_CACHE_SIZE = 512;
+
+    cache::lru_cache<std::pair<int64_t, line_flags_t>,
+                     std::shared_ptr<const rendered_line>>
+        lss_render_cache{RENDER_CACHE_SIZE};
+    render_cache_stats lss_render_cache_stats;
     log_level_t lss_min_log_level{LEVEL_UNKNOWN};
     bool lss_marked_only{false};
     index_delegate* lss_index_delegate{nullptr};
@@ -824,6 +911,12 @@ private:
     bool lss_line_meta_changed{false};
 
     bool lss_indexing_in_progress{false};
+
+    /**
+     * The generations produced by recent partial rebuilds along with the
+     * first visible line that was changed by each rebuild.
+     */
+    std::deque<std::pair<uint32_t, vis_line_t>> lss_partial_rebuilds;
 };
 
 #endif
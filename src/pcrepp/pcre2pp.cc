@@ -29,6 +29,8 @@
  * @file pcrepp.cc
  */
 
+#include <cstring>
+
 #include "pcre2pp.hh"
 
 #include "config.h"
@@ -170,6 +172,428 @@ code::get_capture_count() const
     return retval;
 }
 
+uint32_t
+code::get_min_length() const
+{
+    uint32_t retval;
+
+    pcre2_pattern_info(this->p_code.in(), PCRE2_INFO_MINLENGTH, &retval);
+
+    return retval;
+}
+
+namespace {
+
+/**
+ * Walks the source of a pattern looking for runs of literal characters that
+ * are not inside an alternation or an optional group.
+ */
+class literal_extractor {
+public:
+    explicit literal_extractor(const std::string& pattern)
+        : le_pattern(pattern)
+    {
+    }
+
+    /**
+     * Collect the required literals in the sequence [start, end).
+     *
+     * @return false if the sequence contains an alternation, in which case
+     *   none of the literals in the sequence are required.
+     */
+    bool extract(size_t start, size_t end, std::vector<std::string>& out)
+    {
+        std::string run;
+        auto last_was_literal = false;
+        auto flush = [&run, &out]() {
+            if (!run.empty()) {
+                out.emplace_back(std::move(run));
+                run.clear();
+            }
+        };
+        auto index = start;
+
+        while (index < end && !this->le_give_up) {
+            auto ch = this->le_pattern[index];
+
+            switch (ch) {
+                case '|':
+                    return false;
+                case '(': {
+                    flush();
+                    last_was_literal = false;
+
+                    auto group_end = this->find_group_end(index);
+                    if (!group_end) {
+                        return false;
+                    }
+                    auto content_start = this->find_group_content(index);
+                    index = group_end.value();
+                    if (content_start && !this->is_optional(index)) {
+                        std::vector<std::string> group_out;
+
+                        if (this->extract(
+                                content_start.value(), index - 1, group_out))
+                        {
+                            out.insert(out.end(),
+                                       std::make_move_iterator(group_out.begin()),
+                                       std::make_move_iterator(group_out.end()));
+                        }
+                    }
+                    break;
+                }
+                case '[':
+                    flush();
+                    last_was_literal = false;
+                    if (!this->skip_class(index)) {
+                        return false;
+                    }
+                    break;
+                case '\\': {
+                    if (index + 1 >= end) {
+                        this->le_give_up = true;
+                        return false;
+                    }
+
+                    auto next = this->le_pattern[index + 1];
+                    if (isalnum(next)) {
+                        // Escapes that take arguments or introduce literal
+                        // text are not worth handling.
+                        if (strchr("QxpPNkgco0123456789", next) != nullptr) {
+                            this->le_give_up = true;
+                            return false;
+                        }
+                        flush();
+                        last_was_literal = false;
+                    } else if (next & 0x80) {
+                        flush();
+                        last_was_literal = false;
+                    } else {
+                        run.push_back(next);
+                        last_was_literal = true;
+                    }
+                    index += 2;
+                    break;
+                }
+                case '?':
+                case '*':
+                    if (last_was_literal) {
+                        run.pop_back();
+                    }
+                    flush();
+                    last_was_literal = false;
+                    index = this->skip_quantifier_suffix(index + 1);
+                    break;
+                case '+':
+                    flush();
+                    last_was_literal = false;
+                    index = this->skip_quantifier_suffix(index + 1);
+                    break;
+                case '{': {
+                    auto quant_end = this->le_pattern.find('}', index);
+                    auto lpc = index + 1;
+                    auto min_count = 0;
+                    auto valid = quant_end != std::string::npos;
+
+                    for (; valid && lpc < quant_end; lpc++) {
+                        auto qch = this->le_pattern[lpc];
+
+                        if (qch == ',') {
+                            break;
+                        }
+                        if (!isdigit(qch)) {
+                            valid = false;
+                            break;
+                        }
+                        min_count = min_count * 10 + (qch - '0');
+                    }
+                    for (; valid && lpc < quant_end; lpc++) {
+                        auto qch = this->le_pattern[lpc];
+
+                        if (qch != ',' && !isdigit(qch)) {
+                            valid = false;
+                        }
+                    }
+                    if (valid && last_was_literal && min_count == 0) {
+                        run.pop_back();
+                    }
+                    flush();
+                    last_was_literal = false;
+                    if (valid) {
+                        index = this->skip_quantifier_suffix(quant_end + 1);
+                    } else {
+                        index += 1;
+                    }
+                    break;
+                }
+                case '.':
+                case '^':
+                case '$':
+                    flush();
+                    last_was_literal = false;
+                    index += 1;
+                    break;
+                default:
+                    if ((ch & 0x80)
+                        || (this->le_caseless
+                            && (tolower(ch) == 'k' || tolower(ch) == 's')))
+                    {
+                        // Non-ASCII bytes are not worth the trouble and,
+                        // when matching caselessly, 'k' and 's' also match
+                        // non-ASCII characters.
+                        flush();
+                        last_was_literal = false;
+                    } else {
+                        run.push_back(tolower(ch));
+                        last_was_literal = true;
+                    }
+                    index += 1;
+                    break;
+            }
+        }
+        flush();
+
+        return !this->le_give_up;
+    }
+
+    /**
+     * @return true if the pattern was too complicated to analyze.
+     */
+    bool gave_up() const { return this->le_give_up; }
+
+    void set_caseless() { this->le_caseless = true; }
+
+    bool is_caseless() const { return this->le_caseless; }
+
+private:
+    bool skip_class(size_t& index) const
+    {
+        const auto len = this->le_pattern.size();
+
+        index += 1;
+        if (index < len && this->le_pattern[index] == '^') {
+            index += 1;
+        }
+        if (index < len && this->le_pattern[index] == ']') {
+            index += 1;
+        }
+        while (index < len && this->le_pattern[index] != ']') {
+            if (this->le_pattern[index] == '\\') {
+                index += 2;
+            } else if (this->le_pattern.compare(index, 2, "[:") == 0) {
+                auto posix_end = this->le_pattern.find(":]", index + 2);
+                if (posix_end == std::string::npos) {
+                    return false;
+                }
+                index = posix_end + 2;
+            } else {
+                index += 1;
+            }
+        }
+        if (index >= len) {
+            return false;
+        }
+        index += 1;
+
+        return true;
+    }
+
+    /**
+     * @return The index after the closing parenthesis of the group that
+     *   starts at the given index.
+     */
+    std::optional<size_t> find_group_end(size_t index)
+    {
+        const auto len = this->le_pattern.size();
+        auto depth = 0;
+
+        while (index < len) {
+            switch (this->le_pattern[index]) {
+                case '\\':
+                    if (index + 1 < len && this->le_pattern[index + 1] == 'Q')
+                    {
+                        this->le_give_up = true;
+                        return std::nullopt;
+                    }
+                    index += 2;
+                    break;
+                case '[':
+                    if (!this->skip_class(index)) {
+                        return std::nullopt;
+                    }
+                    break;
+                case '(':
+                    this->check_flags(index);
+                    if (this->le_give_up) {
+                        return std::nullopt;
+                    }
+                    depth += 1;
+                    index += 1;
+                    break;
+                case ')':
+                    depth -= 1;
+                    index += 1;
+                    if (depth == 0) {
+                        return index;
+                    }
+                    break;
+                default:
+                    index += 1;
+                    break;
+            }
+        }
+
+        return std::nullopt;
+    }
+
+    /**
+     * Look for inline option settings, like "(?i)", in the group starting
+     * at the given index.
+     */
+    void check_flags(size_t index)
+    {
+        if (this->le_pattern.compare(index, 2, "(?") != 0) {
+            return;
+        }
+        for (index += 2; index < this->le_pattern.size(); index++) {
+            auto ch = this->le_pattern[index];
+
+            if (ch == 'i') {
+                this->le_caseless = true;
+            } else if (ch == 'x' || ch == '#') {
+                this->le_give_up = true;
+            } else if (!isalpha(ch) && ch != '-' && ch != '^') {
+                break;
+            }
+        }
+    }
+
+    /**
+     * @return The index of the content of a group that must match, or
+     *   nullopt for assertions, subroutine calls and such.
+     */
+    std::optional<size_t> find_group_content(size_t index) const
+    {
+        const auto& pat = this->le_pattern;
+
+        if (pat.compare(index, 2, "(*") == 0) {
+            return std::nullopt;
+        }
+        if (pat.compare(index, 2, "(?") != 0) {
+            return index + 1;
+        }
+        if (pat.compare(index, 3, "(?:") == 0
+            || pat.compare(index, 3, "(?>") == 0)
+        {
+            return index + 3;
+        }
+        if (pat.compare(index, 4, "(?P<") == 0
+            || (pat.compare(index, 3, "(?<") == 0 && index + 3 < pat.size()
+                && (isalpha(pat[index + 3]) || pat[index + 3] == '_')))
+        {
+            auto name_end = pat.find('>', index);
+            if (name_end == std::string::npos) {
+                return std::nullopt;
+            }
+            return name_end + 1;
+        }
+        if (pat.compare(index, 3, "(?'") == 0) {
+            auto name_end = pat.find('\'', index + 3);
+            if (name_end == std::string::npos) {
+                return std::nullopt;
+            }
+            return name_end + 1;
+        }
+
+        // Option settings that apply to a group, like "(?i:...)".
+        for (index += 2; index < pat.size(); index++) {
+            auto ch = pat[index];
+
+            if (ch == ':') {
+                return index + 1;
+            }
+            if (!isalpha(ch) && ch != '-' && ch != '^') {
+                break;
+            }
+        }
+
+        return std::nullopt;
+    }
+
+    bool is_optional(size_t index) const
+    {
+        const auto& pat = this->le_pattern;
+
+        if (index >= pat.size()) {
+            return false;
+        }
+        switch (pat[index]) {
+            case '?':
+            case '*':
+                return true;
+            case '{':
+                return pat.compare(index, 2, "{0") == 0
+                    || pat.compare(index, 2, "{,") == 0;
+            default:
+                return false;
+        }
+    }
+
+    size_t skip_quantifier_suffix(size_t index) const
+    {
+        if (index < this->le_pattern.size()
+            && (this->le_pattern[index] == '?'
+                || this->le_pattern[index] == '+'))
+        {
+            index += 1;
+        }
+        return index;
+    }
+
+    const std::string& le_pattern;
+    bool le_caseless{false};
+    bool le_give_up{false};
+};
+
+}  // namespace
+
+std::vector<std::string>
+code::get_required_literals() const
+{
+    std::vector<std::string> retval;
+    uint32_t options;
+
+    pcre2_pattern_info(this->p_code.in(), PCRE2_INFO_ALLOPTIONS, &options);
+    if (options & (PCRE2_EXTENDED | PCRE2_EXTENDED_MORE | PCRE2_LITERAL)) {
+        return retval;
+    }
+
+    literal_extractor le(this->p_pattern);
+
+    if (options & PCRE2_CASELESS) {
+        le.set_caseless();
+    }
+    if (!le.extract(0, this->p_pattern.size(), retval) || le.gave_up()) {
+        retval.clear();
+        return retval;
+    }
+    if (le.is_caseless() && !(options & PCRE2_CASELESS)) {
+        // An inline "(?i)" was found after some literals were collected,
+        // redo the extraction so 'k' and 's' are handled consistently.
+        literal_extractor le_caseless(this->p_pattern);
+
+        retval.clear();
+        le_caseless.set_caseless();
+        if (!le_caseless.extract(0, this->p_pattern.size(), retval)
+            || le_caseless.gave_up())
+        {
+            retval.clear();
+        }
+    }
+
+    return retval;
+}
+
 std::vector<string_fragment>
 code::get_captures() const
 {
@@ -289,6 +289,20 @@ public:
 
     size_t get_capture_count() const;
 
+    /**
+     * @return The minimum length of a subject that could match this pattern.
+     */
+    uint32_t get_min_length() const;
+
+    /**
+     * Analyze the pattern source to find literal strings that must appear in
+     * any subject that this pattern matches.  The analysis is conservative,
+     * patterns that it does not understand will return an empty result.
+     *
+     * @return The required literals with ASCII letters lower-cased.
+     */
+    std::vector<std::string> get_required_literals() const;
+
     int name_index(const char* name) const;
 
     std::vector<string_fragment> get_captures() const;
@@ -317,3 +317,34 @@ TEST_CASE("anchored")
     CHECK_FALSE(re.find_in(sub2).ignore_error().has_value());
     CHECK_FALSE(re.find_in(sub3).ignore_error().has_value());
 }
+
+TEST_CASE("get_required_literals")
+{
+    auto re1 = lnav::pcre2pp::code::from_const(
+        R"(^(?<timestamp>\d{4}-\d{2}) \[(?<level>\w+)\] Request: (?<body>.*)$)");
+    CHECK(re1.get_required_literals()
+          == std::vector<std::string>{"-", " [", "] request: "});
+
+    auto re2 = lnav::pcre2pp::code::from_const(R"(abc?d+ef{0,2}gh{2}(?:ij)?)");
+    CHECK(re2.get_required_literals()
+          == std::vector<std::string>{"ab", "d", "e", "gh"});
+
+    auto re3 = lnav::pcre2pp::code::from_const(R"(foo(?:bar|baz)qux)");
+    CHECK(re3.get_required_literals()
+          == std::vector<std::string>{"foo", "qux"});
+
+    auto re4 = lnav::pcre2pp::code::from_const(R"(foo|bar)");
+    CHECK(re4.get_required_literals().empty());
+
+    auto re5 = lnav::pcre2pp::code::from_const(R"(Mask (?i)desk)");
+    CHECK(re5.get_required_literals()
+          == std::vector<std::string>{"ma", " ", "de"});
+
+    auto re6 = lnav::pcre2pp::code::from_const(R"(abc\x41def)");
+    CHECK(re6.get_required_literals().empty());
+
+    auto re7 = lnav::pcre2pp::code::from_const(R"([]abc]def(?=ghi))");
+    CHECK(re7.get_required_literals() == std::vector<std::string>{"def"});
+
+    CHECK(re1.get_min_length() == 21);
+}
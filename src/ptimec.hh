@@ -38,6 +38,11 @@
 #define __STDC_FORMAT_MACROS
 #include <cstdlib>
 
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
 #include <ctype.h>
 #include <inttypes.h>
 #include <stdio.h>
@@ -1340,6 +1345,79 @@ size_t ftime_fmt(char* dst,
                  const char* fmt,
                  const struct exttm& tm);
 
+bool ptime_B(struct exttm* dst, const char* str, off_t& off, ssize_t len);
+
+/**
+ * A timestamp format that has been compiled into a sequence of operations
+ * so that the format string is not interpreted again for every timestamp
+ * that is parsed.  Like the functions generated by ptimec, runs of
+ * fixed-width fields and literals are checked against the input length
+ * once and then parsed without further bounds checks.  The results are the
+ * same as ptime_fmt() for timestamps that match.  Formats that ptimec has
+ * already generated a function for just use that function.
+ */
+class ptime_program {
+public:
+    /**
+     * Get the compiled program for a format, compiling it on first use.
+     * Programs are kept for the life of the process, so the pointer that
+     * is returned is always valid.
+     */
+    static const ptime_program* lookup(const char* fmt);
+
+    /**
+     * @param fmt The format to compile.
+     * @param use_generated If true and ptimec generated a function for this
+     *   format, that function is used instead of the compiled program.
+     */
+    explicit ptime_program(const char* fmt, bool use_generated = true);
+
+    const std::string& get_format() const { return this->pp_format; }
+
+    bool parse(struct exttm* dst,
+               const char* str,
+               off_t& off_inout,
+               ssize_t len) const;
+
+private:
+    enum class op_kind : uint8_t {
+        /** Literal characters in a run of fixed-width ops. */
+        FIXED_LITERAL,
+        /**
+         * Fixed-width fields in a run of fixed-width ops.  If o_char is
+         * set, it is a separator that must follow the field.
+         */
+        FIXED_d,
+        FIXED_H,
+        FIXED_M,
+        FIXED_S,
+        FIXED_Y,
+        CONVERSION,
+        UPTO,
+        UPTO_END,
+    };
+
+    struct op {
+        op_kind o_kind;
+        char o_char{0};
+        /**
+         * The number of bytes needed by this op and the fixed-width ops
+         * that follow it.  The following ops do not check the length.
+         */
+        uint16_t o_require{0};
+        uint32_t o_len{0};
+        uint32_t o_literal_start{0};
+    };
+
+    static bool is_fixed_field(op_kind kind);
+    static std::optional<std::pair<op_kind, size_t>> spec_fixed_op(char spec);
+
+    std::string pp_format;
+    ptime_func pp_generated{nullptr};
+    std::string pp_literals;
+    std::vector<op> pp_ops;
+};
+
 struct ptime_fmt {
     const char* pf_fmt;
     ptime_func pf_func;
@@ -29,6 +29,11 @@
  * @file ptimec_rt.cc
  */
 
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+
 #include "ptimec.hh"
 
 #include <string.h>
@@ -177,6 +182,24 @@ ptime_Z_to_gmtoff(exttm* dst, const char* str, off_t& off_inout, ssize_t len)
     return true;
 }
 
+bool
+ptime_B(struct exttm* dst, const char* str, off_t& off, ssize_t len)
+{
+    size_t b_len = len - off;
+    stack_buf allocator;
+    auto* full_month = allocator.allocate(b_len + 1);
+    const char* end_of_date;
+
+    memcpy(full_month, &str[off], b_len);
+    full_month[b_len] = '\0';
+    if ((end_of_date = strptime(full_month, "%B", &dst->et_tm)) != nullptr) {
+        off += end_of_date - full_month;
+        return true;
+    }
+
+    return false;
+}
+
 #define FMT_CASE(ch, c) \
     case ch: \
         if (!ptime_##c(dst, str, off, len)) \
@@ -194,24 +217,6 @@ ptime_fmt(const char* fmt,
     for (ssize_t lpc = 0; fmt[lpc]; lpc++) {
         if (fmt[lpc] == '%') {
             switch (fmt[lpc + 1]) {
-                case 'B': {
-                    size_t b_len = len - off;
-                    stack_buf allocator;
-                    auto* full_month = allocator.allocate(b_len + 1);
-                    const char* end_of_date;
-
-                    memcpy(full_month, &str[off], b_len);
-                    full_month[b_len] = '\0';
-                    if ((end_of_date = strptime(full_month, "%B", &dst->et_tm))
-                        != nullptr)
-                    {
-                        off += end_of_date - full_month;
-                        lpc += 1;
-                    } else {
-                        return false;
-                    }
-                    break;
-                }
                 case 'a':
                 case 'Z':
                     if (fmt[lpc + 2]) {
@@ -226,6 +231,7 @@ ptime_fmt(const char* fmt,
                         lpc += 1;
                     }
                     break;
+                    FMT_CASE('B', B);
                     FMT_CASE('b', b);
                     FMT_CASE('S', S);
                     FMT_CASE('s', s);
@@ -261,6 +267,303 @@ ptime_fmt(const char* fmt,
     return true;
 }
 
+bool
+ptime_program::is_fixed_field(op_kind kind)
+{
+    switch (kind) {
+        case op_kind::FIXED_d:
+        case op_kind::FIXED_H:
+        case op_kind::FIXED_M:
+        case op_kind::FIXED_S:
+        case op_kind::FIXED_Y:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * @return The fixed-width op and its width for the given conversion, if
+ *   there is one.
+ */
+std::optional<std::pair<ptime_program::op_kind, size_t>>
+ptime_program::spec_fixed_op(char spec)
+{
+    switch (spec) {
+        case 'd':
+            return std::make_pair(op_kind::FIXED_d, 2);
+        case 'H':
+            return std::make_pair(op_kind::FIXED_H, 2);
+        case 'M':
+            return std::make_pair(op_kind::FIXED_M, 2);
+        case 'S':
+            return std::make_pair(op_kind::FIXED_S, 2);
+        case 'Y':
+            return std::make_pair(op_kind::FIXED_Y, 4);
+        default:
+            return std::nullopt;
+    }
+}
+
+static bool
+is_conversion(char spec)
+{
+    switch (spec) {
+        case 'B':
+        case 'b':
+        case 'S':
+        case 's':
+        case 'L':
+        case 'M':
+        case 'H':
+        case 'i':
+        case '6':
+        case '9':
+        case 'I':
+        case 'd':
+        case 'e':
+        case 'j':
+        case 'f':
+        case 'k':
+        case 'l':
+        case 'm':
+        case 'N':
+        case 'p':
+        case 'q':
+        case 'Y':
+        case 'y':
+        case 'z':
+        case '@':
+            return true;
+        default:
+            return false;
+    }
+}
+
+ptime_program::ptime_program(const char* fmt, bool use_generated)
+    : pp_format(fmt)
+{
+    for (int lpc = 0;
+         use_generated && PTIMEC_FORMATS[lpc].pf_fmt != nullptr;
+         lpc++)
+    {
+        if (strcmp(PTIMEC_FORMATS[lpc].pf_fmt, fmt) == 0) {
+            // A format that ptimec generated code for cannot get any faster.
+            this->pp_generated = PTIMEC_FORMATS[lpc].pf_func;
+            return;
+        }
+    }
+
+    // The index of the first op in the current run of fixed-width fields
+    // and literals.  The length of the whole run is checked by that op.
+    std::optional<size_t> run_start;
+
+    for (ssize_t lpc = 0; fmt[lpc]; lpc++) {
+        auto spec = '\0';
+        std::optional<std::pair<op_kind, size_t>> fixed_op;
+
+        if (fmt[lpc] == '%') {
+            spec = fmt[lpc + 1];
+            fixed_op = spec_fixed_op(spec);
+        }
+
+        if (fmt[lpc] == '%' && !fixed_op) {
+            run_start = std::nullopt;
+        } else if (!run_start) {
+            run_start = this->pp_ops.size();
+        }
+
+        if (fmt[lpc] != '%') {
+            auto in_run = this->pp_ops.size() > run_start.value();
+
+            if (in_run && is_fixed_field(this->pp_ops.back().o_kind)
+                && this->pp_ops.back().o_char == '\0')
+            {
+                // Fold a separator that follows a field into the field's op
+                // to save a dispatch.
+                this->pp_ops.back().o_char = fmt[lpc];
+            } else {
+                if (!in_run
+                    || this->pp_ops.back().o_kind != op_kind::FIXED_LITERAL)
+                {
+                    op lit{op_kind::FIXED_LITERAL};
+
+                    lit.o_literal_start = this->pp_literals.size();
+                    this->pp_ops.emplace_back(lit);
+                }
+                this->pp_literals.push_back(fmt[lpc]);
+                this->pp_ops.back().o_len += 1;
+            }
+            this->pp_ops[run_start.value()].o_require += 1;
+            continue;
+        }
+
+        switch (spec) {
+            case 'a':
+            case 'Z': {
+                op upto{fmt[lpc + 2] ? op_kind::UPTO : op_kind::UPTO_END};
+
+                upto.o_char = fmt[lpc + 2];
+                this->pp_ops.emplace_back(upto);
+                lpc += 1;
+                break;
+            }
+            default:
+                if (fixed_op) {
+                    op field{fixed_op->first};
+
+                    this->pp_ops.emplace_back(field);
+                    this->pp_ops[run_start.value()].o_require
+                        += fixed_op->second;
+                    lpc += 1;
+                } else if (is_conversion(spec)) {
+                    op conv{op_kind::CONVERSION};
+
+                    conv.o_char = spec;
+                    this->pp_ops.emplace_back(conv);
+                    lpc += 1;
+                }
+                // Unknown conversions are skipped in the same way as
+                // ptime_fmt() does.
+                break;
+        }
+    }
+}
+
+#define PROG_CONV_CASE(ch, c) \
+    case ch: \
+        if (!ptime_##c(dst, str, off_inout, len)) \
+            return false; \
+        break
+
+#define PROG_CHECK_REQUIRE() \
+    if (len - off_inout < (ssize_t) curr_op.o_require) { \
+        return false; \
+    }
+
+#define PROG_CHECK_SEPARATOR() \
+    if (curr_op.o_char != '\0') { \
+        if (str[off_inout] != curr_op.o_char) \
+            return false; \
+        off_inout += 1; \
+    }
+
+bool
+ptime_program::parse(struct exttm* dst,
+                     const char* str,
+                     off_t& off_inout,
+                     ssize_t len) const
+{
+    if (this->pp_generated != nullptr) {
+        return this->pp_generated(dst, str, off_inout, len);
+    }
+
+    for (const auto& curr_op : this->pp_ops) {
+        switch (curr_op.o_kind) {
+            case op_kind::FIXED_d:
+                PROG_CHECK_REQUIRE();
+                PTIME_CHECK_d(dst, str, off_inout);
+                off_inout += 2;
+                PROG_CHECK_SEPARATOR();
+                break;
+            case op_kind::FIXED_H:
+                PROG_CHECK_REQUIRE();
+                PTIME_CHECK_H(dst, str, off_inout);
+                off_inout += 2;
+                PROG_CHECK_SEPARATOR();
+                break;
+            case op_kind::FIXED_M:
+                PROG_CHECK_REQUIRE();
+                PTIME_CHECK_M(dst, str, off_inout);
+                off_inout += 2;
+                PROG_CHECK_SEPARATOR();
+                break;
+            case op_kind::FIXED_S:
+                PROG_CHECK_REQUIRE();
+                PTIME_CHECK_S(dst, str, off_inout);
+                off_inout += 2;
+                PROG_CHECK_SEPARATOR();
+                break;
+            case op_kind::FIXED_Y:
+                PROG_CHECK_REQUIRE();
+                PTIME_CHECK_Y(dst, str, off_inout);
+                off_inout += 4;
+                PROG_CHECK_SEPARATOR();
+                break;
+            case op_kind::FIXED_LITERAL: {
+                PROG_CHECK_REQUIRE();
+
+                // Literals are usually a single separator character, so a
+                // plain loop is cheaper than calling memcmp().
+                const auto* lit = &this->pp_literals[curr_op.o_literal_start];
+
+                for (uint32_t lpc = 0; lpc < curr_op.o_len; lpc++) {
+                    if (str[off_inout] != lit[lpc]) {
+                        return false;
+                    }
+                    off_inout += 1;
+                }
+                break;
+            }
+            case op_kind::CONVERSION:
+                switch (curr_op.o_char) {
+                    PROG_CONV_CASE('B', B);
+                    PROG_CONV_CASE('b', b);
+                    PROG_CONV_CASE('S', S);
+                    PROG_CONV_CASE('s', s);
+                    PROG_CONV_CASE('L', L);
+                    PROG_CONV_CASE('M', M);
+                    PROG_CONV_CASE('H', H);
+                    PROG_CONV_CASE('i', i);
+                    PROG_CONV_CASE('6', 6);
+                    PROG_CONV_CASE('9', 9);
+                    PROG_CONV_CASE('I', I);
+                    PROG_CONV_CASE('d', d);
+                    PROG_CONV_CASE('e', e);
+                    PROG_CONV_CASE('j', j);
+                    PROG_CONV_CASE('f', f);
+                    PROG_CONV_CASE('k', k);
+                    PROG_CONV_CASE('l', l);
+                    PROG_CONV_CASE('m', m);
+                    PROG_CONV_CASE('N', N);
+                    PROG_CONV_CASE('p', p);
+                    PROG_CONV_CASE('q', q);
+                    PROG_CONV_CASE('Y', Y);
+                    PROG_CONV_CASE('y', y);
+                    PROG_CONV_CASE('z', z);
+                    PROG_CONV_CASE('@', at);
+                }
+                break;
+            case op_kind::UPTO:
+                if (!ptime_upto(curr_op.o_char, str, off_inout, len)) {
+                    return false;
+                }
+                break;
+            case op_kind::UPTO_END:
+                ptime_upto_end(str, off_inout, len);
+                break;
+        }
+    }
+
+    return true;
+}
+
+const ptime_program*
+ptime_program::lookup(const char* fmt)
+{
+    static std::mutex program_mutex;
+    static std::map<std::string, std::unique_ptr<ptime_program>> programs;
+
+    std::lock_guard<std::mutex> lg(program_mutex);
+    auto& retval = programs[fmt];
+
+    if (retval == nullptr) {
+        retval = std::make_unique<ptime_program>(fmt);
+    }
+
+    return retval.get();
+}
+
 #define FTIME_FMT_CASE(ch, c) \
     case ch: \
         ftime_##c(dst, off_inout, len, tm); \
@@ -1842,6 +1842,7 @@ reset_session()
         }
         if (changed) {
             elf->elf_value_defs_state->vds_generation += 1;
+            lnav_data.ld_log_source.invalidate_rendered_lines();
         }
     }
 }
@@ -111,6 +111,36 @@ public:
     std::vector<vis_line_t> fss_lines;
 };
 
+/**
+ * Call the given function with the cached numeric values of a column for
+ * the messages in the given range of the log view.  Iteration stops when
+ * the function returns false.
+ */
+template<typename F>
+static void
+for_each_column_value(intern_string_t colname,
+                      vis_line_t begin_line,
+                      vis_line_t end_line,
+                      F func)
+{
+    auto& lss = lnav_data.ld_log_source;
+
+    for (auto curr_line = begin_line; curr_line < end_line; ++curr_line) {
+        auto cl = lss.at(curr_line);
+        auto* lf = lss.find_file_ptr(cl);
+        auto ll = lf->begin() + cl;
+
+        if (!ll->is_message()) {
+            continue;
+        }
+
+        auto value = lf->get_numeric_value(colname, ll);
+        if (!func(curr_line, *ll, value)) {
+            break;
+        }
+    }
+}
+
 log_spectro_value_source::log_spectro_value_source(intern_string_t colname)
     : lsvs_colname(colname)
 {
@@ -202,31 +232,19 @@ log_spectro_value_source::spectro_row(spectrogram_request& sr,
     auto end_line = lss.find_from_time(timeval{to_time_t(sr.sr_end_time), 0})
                         .value_or(vis_line_t(lss.text_line_count()));
 
-    for (const auto& msg_info : lss.window_at(begin_line, end_line)) {
-        const auto& ll = msg_info.get_logline();
-        if (ll.get_time<std::chrono::microseconds>() >= sr.sr_end_time) {
-            break;
-        }
-
-        const auto& values = msg_info.get_values();
-        auto lv_iter = find_if(values.lvv_values.begin(),
-                               values.lvv_values.end(),
-                               logline_value_name_cmp(&this->lsvs_colname));
-
-        if (lv_iter != values.lvv_values.end()) {
-            switch (lv_iter->lv_meta.lvm_kind) {
-                case value_kind_t::VALUE_FLOAT:
-                    row_out.add_value(sr, lv_iter->lv_value.d, ll.is_marked());
-                    break;
-                case value_kind_t::VALUE_INTEGER: {
-                    row_out.add_value(sr, lv_iter->lv_value.i, ll.is_marked());
-                    break;
-                }
-                default:
-                    break;
+    for_each_column_value(
+        this->lsvs_colname,
+        begin_line,
+        end_line,
+        [&](vis_line_t vl, const logline& ll, std::optional<double> value) {
+            if (ll.get_time<std::chrono::microseconds>() >= sr.sr_end_time) {
+                return false;
             }
-        }
-    }
+            if (value) {
+                row_out.add_value(sr, value.value(), ll.is_marked());
+            }
+            return true;
+        });
 
     row_out.sr_details_source_provider = [this](const spectrogram_request& sr,
                                                 double range_min,
@@ -243,40 +261,23 @@ log_spectro_value_source::spectro_row(spectrogram_request& sr,
         retval->fss_delegate = &lss;
         retval->fss_time_delegate = &lss;
         retval->fss_overlay_delegate = nullptr;
-        for (const auto& msg_info : lss.window_at(begin_line, end_line)) {
-            const auto& ll = msg_info.get_logline();
-            if (ll.get_time<std::chrono::microseconds>() >= sr.sr_end_time) {
-                break;
-            }
-
-            const auto& values = msg_info.get_values();
-            auto lv_iter = find_if(values.lvv_values.begin(),
-                                   values.lvv_values.end(),
-                                   logline_value_name_cmp(&this->lsvs_colname));
-
-            if (lv_iter != values.lvv_values.end()) {
-                switch (lv_iter->lv_meta.lvm_kind) {
-                    case value_kind_t::VALUE_FLOAT:
-                        if (range_min <= lv_iter->lv_value.d
-                            && lv_iter->lv_value.d < range_max)
-                        {
-                            retval->fss_lines.emplace_back(
-                                msg_info.get_vis_line());
-                        }
-                        break;
-                    case value_kind_t::VALUE_INTEGER:
-                        if (range_min <= lv_iter->lv_value.i
-                            && lv_iter->lv_value.i < range_max)
-                        {
-                            retval->fss_lines.emplace_back(
-                                msg_info.get_vis_line());
-                        }
-                        break;
-                    default:
-                        break;
+        for_each_column_value(
+            this->lsvs_colname,
+            begin_line,
+            end_line,
+            [&](vis_line_t vl, const logline& ll, std::optional<double> value) {
+                if (ll.get_time<std::chrono::microseconds>()
+                    >= sr.sr_end_time)
+                {
+                    return false;
                 }
-            }
-        }
+                if (value && range_min <= value.value()
+                    && value.value() < range_max)
+                {
+                    retval->fss_lines.emplace_back(vl);
+                }
+                return true;
+            });
 
         return retval;
     };
@@ -289,59 +290,25 @@ log_spectro_value_source::spectro_mark(textview_curses& tc,
                                        double range_min,
                                        double range_max)
 {
-    // XXX need to refactor this and the above method
     auto& log_tc = lnav_data.ld_views[LNV_LOG];
     auto& lss = lnav_data.ld_log_source;
     auto begin_line
         = lss.find_from_time(timeval{to_time_t(begin_time), 0}).value_or(0_vl);
     auto end_line = lss.find_from_time(timeval{to_time_t(end_time), 0})
                         .value_or(vis_line_t(lss.text_line_count()));
-    logline_value_vector values;
-    string_attrs_t sa;
 
-    for (vis_line_t curr_line = begin_line; curr_line < end_line; ++curr_line) {
-        content_line_t cl = lss.at(curr_line);
-        std::shared_ptr<logfile> lf = lss.find(cl);
-        auto ll = lf->begin() + cl;
-        auto format = lf->get_format();
-
-        if (!ll->is_message()) {
-            continue;
-        }
-
-        values.clear();
-        lf->read_full_message(ll, values.lvv_sbr);
-        values.lvv_sbr.erase_ansi();
-        sa.clear();
-        format->annotate(lf.get(), cl, sa, values, false);
-
-        auto lv_iter = find_if(values.lvv_values.begin(),
-                               values.lvv_values.end(),
-                               logline_value_name_cmp(&this->lsvs_colname));
-
-        if (lv_iter != values.lvv_values.end()) {
-            switch (lv_iter->lv_meta.lvm_kind) {
-                case value_kind_t::VALUE_FLOAT:
-                    if (range_min <= lv_iter->lv_value.d
-                        && lv_iter->lv_value.d <= range_max)
-                    {
-                        log_tc.toggle_user_mark(&textview_curses::BM_USER,
-                                                curr_line);
-                    }
-                    break;
-                case value_kind_t::VALUE_INTEGER:
-                    if (range_min <= lv_iter->lv_value.i
-                        && lv_iter->lv_value.i <= range_max)
-                    {
-                        log_tc.toggle_user_mark(&textview_curses::BM_USER,
-                                                curr_line);
-                    }
-                    break;
-                default:
-                    break;
+    for_each_column_value(
+        this->lsvs_colname,
+        begin_line,
+        end_line,
+        [&](vis_line_t vl, const logline& ll, std::optional<double> value) {
+            if (value && range_min <= value.value()
+                && value.value() <= range_max)
+            {
+                log_tc.toggle_user_mark(&textview_curses::BM_USER, vl);
             }
-        }
-    }
+            return true;
+        });
 }
 
 db_spectro_value_source::db_spectro_value_source(std::string colname)
@@ -0,0 +1,1526 @@
+/**
+ * Copyright (c) 2025, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cmath>
+#include <cstring>
+
+#include "sql_filter_plan.hh"
+
+#include "base/auto_mem.hh"
+#include "base/string_util.hh"
+#include "bookmarks.json.hh"
+#include "config.h"
+#include "fmt/format.h"
+#include "pcrepp/pcre2pp.hh"
+#include "sql_util.hh"
+#include "yajlpp/yajlpp.hh"
+#include "yajlpp/yajlpp_def.hh"
+
+namespace {
+
+constexpr auto STMT_PREFIX = string_fragment::from_const("SELECT 1 WHERE ");
+
+/**
+ * A value that follows the SQLite storage classes.  Bound parameters and
+ * literals do not have an affinity, so no conversions are done when they
+ * are compared.
+ */
+struct value {
+    enum class kind {
+        null,
+        integer,
+        real,
+        text,
+    };
+
+    kind v_kind{kind::null};
+    int64_t v_int{0};
+    double v_real{0.0};
+    string_fragment v_text;
+
+    static value from_int(int64_t i)
+    {
+        value retval;
+
+        retval.v_kind = kind::integer;
+        retval.v_int = i;
+        return retval;
+    }
+
+    static value from_real(double d)
+    {
+        value retval;
+
+        // sqlite3_bind_double() turns NaN into a NULL
+        if (!std::isnan(d)) {
+            retval.v_kind = kind::real;
+            retval.v_real = d;
+        }
+        return retval;
+    }
+
+    static value from_text(string_fragment sf)
+    {
+        value retval;
+
+        retval.v_kind = kind::text;
+        retval.v_text = sf;
+        return retval;
+    }
+
+    bool is_null() const { return this->v_kind == kind::null; }
+
+    bool is_numeric() const
+    {
+        return this->v_kind == kind::integer || this->v_kind == kind::real;
+    }
+};
+
+enum class tristate {
+    no,
+    yes,
+    null,
+};
+
+tristate
+to_tristate(bool b)
+{
+    return b ? tristate::yes : tristate::no;
+}
+
+/** Exact comparison of an integer and a real, like sqlite3IntFloatCompare. */
+int
+compare_int_real(int64_t i, double r)
+{
+    if (r < -9223372036854775808.0) {
+        return 1;
+    }
+    if (r >= 9223372036854775808.0) {
+        return -1;
+    }
+
+    auto y = static_cast<int64_t>(r);
+    if (i < y) {
+        return -1;
+    }
+    if (i > y) {
+        return 1;
+    }
+
+    auto s = static_cast<double>(i);
+    if (s < r) {
+        return -1;
+    }
+    if (s > r) {
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * Compare two non-NULL values using the BINARY collation.  Numbers sort
+ * before text.
+ */
+int
+compare_values(const value& lhs, const value& rhs)
+{
+    if (lhs.is_numeric() != rhs.is_numeric()) {
+        return lhs.is_numeric() ? -1 : 1;
+    }
+
+    if (lhs.is_numeric()) {
+        if (lhs.v_kind == value::kind::integer) {
+            if (rhs.v_kind == value::kind::integer) {
+                return lhs.v_int < rhs.v_int ? -1
+                                             : (lhs.v_int > rhs.v_int ? 1 : 0);
+            }
+            return compare_int_real(lhs.v_int, rhs.v_real);
+        }
+        if (rhs.v_kind == value::kind::integer) {
+            return -compare_int_real(rhs.v_int, lhs.v_real);
+        }
+        return lhs.v_real < rhs.v_real ? -1
+                                       : (lhs.v_real > rhs.v_real ? 1 : 0);
+    }
+
+    auto min_len = std::min(lhs.v_text.length(), rhs.v_text.length());
+    auto rc = min_len == 0
+        ? 0
+        : memcmp(lhs.v_text.data(), rhs.v_text.data(), min_len);
+    if (rc != 0) {
+        return rc < 0 ? -1 : 1;
+    }
+    if (lhs.v_text.length() == rhs.v_text.length()) {
+        return 0;
+    }
+    return lhs.v_text.length() < rhs.v_text.length() ? -1 : 1;
+}
+
+/** The length of the UTF-8 character at the given offset, like sqlite. */
+int
+utf8_char_length(string_fragment sf, int offset)
+{
+    auto len = 1;
+
+    if (static_cast<unsigned char>(sf.data()[offset]) >= 0xc0) {
+        while (offset + len < sf.length()
+               && (static_cast<unsigned char>(sf.data()[offset + len]) & 0xc0)
+                   == 0x80)
+        {
+            len += 1;
+        }
+    }
+
+    return len;
+}
+
+bool
+like_chars_equal(char pat_ch, char str_ch, bool case_sensitive)
+{
+    if (pat_ch == str_ch) {
+        return true;
+    }
+    if (case_sensitive || (pat_ch & 0x80) || (str_ch & 0x80)) {
+        return false;
+    }
+    return tolower(pat_ch) == tolower(str_ch);
+}
+
+/**
+ * The SQLite LIKE: '%' matches any sequence, '_' matches a single
+ * character, and ASCII letters are compared without regard to case unless
+ * "PRAGMA case_sensitive_like" is on.
+ */
+bool
+like_match(string_fragment pat, string_fragment str, bool case_sensitive)
+{
+    auto pat_index = 0;
+    auto str_index = 0;
+    auto star_pat = -1;
+    auto star_str = 0;
+
+    while (str_index < str.length()) {
+        if (pat_index < pat.length()) {
+            auto pat_ch = pat.data()[pat_index];
+
+            if (pat_ch == '%') {
+                pat_index += 1;
+                star_pat = pat_index;
+                star_str = str_index;
+                continue;
+            }
+            if (pat_ch == '_') {
+                pat_index += 1;
+                str_index += utf8_char_length(str, str_index);
+                continue;
+            }
+            if (like_chars_equal(
+                    pat_ch, str.data()[str_index], case_sensitive))
+            {
+                pat_index += 1;
+                str_index += 1;
+                continue;
+            }
+        }
+        if (star_pat == -1) {
+            return false;
+        }
+        star_str += utf8_char_length(str, star_str);
+        str_index = star_str;
+        pat_index = star_pat;
+    }
+
+    while (pat_index < pat.length() && pat.data()[pat_index] == '%') {
+        pat_index += 1;
+    }
+
+    return pat_index == pat.length();
+}
+
+/**
+ * Check how the database currently evaluates LIKE.  The case_sensitive_like
+ * pragma cannot be queried, so a comparison is run instead.
+ *
+ * @return True if LIKE is case-sensitive or nullopt if it could not be
+ *   determined.
+ */
+std::optional<bool>
+like_is_case_sensitive(sqlite3* db)
+{
+    auto_mem<sqlite3_stmt> stmt(sqlite3_finalize);
+
+    if (sqlite3_prepare_v2(db, "SELECT 'a' LIKE 'A'", -1, stmt.out(), nullptr)
+            != SQLITE_OK
+        || sqlite3_step(stmt.in()) != SQLITE_ROW)
+    {
+        return std::nullopt;
+    }
+
+    return sqlite3_column_int(stmt.in(), 0) == 0;
+}
+
+}  // namespace
+
+struct sql_filter_plan::node {
+    enum class op {
+        literal,
+        param,
+        and_,
+        or_,
+        not_,
+        eq,
+        ne,
+        lt,
+        le,
+        gt,
+        ge,
+        is_null,
+        in,
+        like,
+        regexp,
+    };
+
+    explicit node(op o) : n_op(o) {}
+
+    op n_op;
+    /** For IS NULL, IN, LIKE, and REGEXP, invert the result. */
+    bool n_negated{false};
+    /** For LIKE, compare ASCII letters exactly. */
+    bool n_case_sensitive{false};
+    value n_literal;
+    std::string n_literal_text;
+    size_t n_param{0};
+    std::vector<std::unique_ptr<node>> n_children;
+    std::shared_ptr<lnav::pcre2pp::code> n_regex;
+};
+
+namespace {
+
+using node = sql_filter_plan::node;
+
+class expr_parser {
+public:
+    enum class token_type {
+        end,
+        keyword,
+        param,
+        string,
+        integer,
+        real,
+        punct,
+    };
+
+    expr_parser(const sql_filter_plan& plan,
+                sqlite3_stmt* stmt,
+                string_fragment input)
+        : ep_plan(plan), ep_stmt(stmt), ep_input(input)
+    {
+    }
+
+    std::unique_ptr<node> parse()
+    {
+        if (!this->next_token()) {
+            return nullptr;
+        }
+
+        auto retval = this->parse_or();
+        if (retval == nullptr || this->ep_type != token_type::end) {
+            return nullptr;
+        }
+        return retval;
+    }
+
+private:
+    bool next_token()
+    {
+        while (this->ep_offset < this->ep_input.length()
+               && isspace(this->ep_input.data()[this->ep_offset]))
+        {
+            this->ep_offset += 1;
+        }
+
+        auto start = this->ep_offset;
+        if (start >= this->ep_input.length()) {
+            this->ep_type = token_type::end;
+            this->ep_token = string_fragment{};
+            return true;
+        }
+
+        auto ch = this->ep_input.data()[start];
+        auto end = start + 1;
+        if (ch == '\'') {
+            this->ep_string.clear();
+            while (true) {
+                if (end >= this->ep_input.length()) {
+                    return false;
+                }
+                auto sch = this->ep_input.data()[end];
+                end += 1;
+                if (sch == '\'') {
+                    if (end < this->ep_input.length()
+                        && this->ep_input.data()[end] == '\'')
+                    {
+                        this->ep_string.push_back('\'');
+                        end += 1;
+                        continue;
+                    }
+                    break;
+                }
+                this->ep_string.push_back(sch);
+            }
+            this->ep_type = token_type::string;
+        } else if (isdigit(ch) || ch == '.') {
+            auto is_real = false;
+
+            end = start;
+            while (end < this->ep_input.length()) {
+                auto nch = this->ep_input.data()[end];
+
+                if (isdigit(nch)) {
+                    end += 1;
+                } else if (nch == '.' || nch == 'e' || nch == 'E') {
+                    is_real = true;
+                    end += 1;
+                    if ((nch == 'e' || nch == 'E')
+                        && end < this->ep_input.length()
+                        && (this->ep_input.data()[end] == '-'
+                            || this->ep_input.data()[end] == '+'))
+                    {
+                        end += 1;
+                    }
+                } else if (isalpha(nch) || nch == '_') {
+                    // hex literals and the like are left to SQLite
+                    return false;
+                } else {
+                    break;
+                }
+            }
+            this->ep_type = is_real ? token_type::real : token_type::integer;
+        } else if (ch == ':' || ch == '$' || ch == '@') {
+            while (end < this->ep_input.length()
+                   && (isalnum(this->ep_input.data()[end])
+                       || this->ep_input.data()[end] == '_'))
+            {
+                end += 1;
+            }
+            if (end == start + 1) {
+                return false;
+            }
+            this->ep_type = token_type::param;
+        } else if (isalpha(ch) || ch == '_') {
+            while (end < this->ep_input.length()
+                   && (isalnum(this->ep_input.data()[end])
+                       || this->ep_input.data()[end] == '_'))
+            {
+                end += 1;
+            }
+            this->ep_type = token_type::keyword;
+        } else {
+            switch (ch) {
+                case '=':
+                    if (end < this->ep_input.length()
+                        && this->ep_input.data()[end] == '=')
+                    {
+                        end += 1;
+                    }
+                    break;
+                case '!':
+                    if (end >= this->ep_input.length()
+                        || this->ep_input.data()[end] != '=')
+                    {
+                        return false;
+                    }
+                    end += 1;
+                    break;
+                case '<':
+                    if (end < this->ep_input.length()
+                        && (this->ep_input.data()[end] == '='
+                            || this->ep_input.data()[end] == '>'))
+                    {
+                        end += 1;
+                    }
+                    break;
+                case '>':
+                    if (end < this->ep_input.length()
+                        && this->ep_input.data()[end] == '=')
+                    {
+                        end += 1;
+                    }
+                    break;
+                case '(':
+                case ')':
+                case ',':
+                case '-':
+                case '+':
+                    break;
+                default:
+                    return false;
+            }
+            this->ep_type = token_type::punct;
+        }
+
+        this->ep_token = this->ep_input.sub_range(start, end);
+        this->ep_offset = end;
+        return true;
+    }
+
+    bool is_keyword(const char* kw) const
+    {
+        return this->ep_type == token_type::keyword
+            && this->ep_token.iequal(string_fragment::from_c_str(kw));
+    }
+
+    bool is_punct(const char* p) const
+    {
+        return this->ep_type == token_type::punct
+            && this->ep_token == string_fragment::from_c_str(p);
+    }
+
+    std::unique_ptr<node> make_binary(node::op o,
+                                      std::unique_ptr<node> lhs,
+                                      std::unique_ptr<node> rhs)
+    {
+        if (lhs == nullptr || rhs == nullptr) {
+            return nullptr;
+        }
+
+        // Check the logline metadata before anything that needs the
+        // message to be read and annotated.
+        if ((o == node::op::and_ || o == node::op::or_)
+            && this->reads_message(*lhs) && !this->reads_message(*rhs))
+        {
+            std::swap(lhs, rhs);
+        }
+
+        auto retval = std::make_unique<node>(o);
+        retval->n_children.emplace_back(std::move(lhs));
+        retval->n_children.emplace_back(std::move(rhs));
+        return retval;
+    }
+
+    bool reads_message(const node& n) const
+    {
+        if (n.n_op == node::op::param) {
+            switch (this->ep_plan.fp_params[n.n_param].p_kind) {
+                case sql_filter_plan::param_kind::log_text:
+                case sql_filter_plan::param_kind::log_body:
+                case sql_filter_plan::param_kind::log_opid:
+                case sql_filter_plan::param_kind::value:
+                    return true;
+                default:
+                    return false;
+            }
+        }
+
+        for (const auto& child : n.n_children) {
+            if (this->reads_message(*child)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::unique_ptr<node> parse_or()
+    {
+        auto retval = this->parse_and();
+
+        while (retval != nullptr && this->is_keyword("OR")) {
+            if (!this->next_token()) {
+                return nullptr;
+            }
+            retval = this->make_binary(
+                node::op::or_, std::move(retval), this->parse_and());
+        }
+        return retval;
+    }
+
+    std::unique_ptr<node> parse_and()
+    {
+        auto retval = this->parse_not();
+
+        while (retval != nullptr && this->is_keyword("AND")) {
+            if (!this->next_token()) {
+                return nullptr;
+            }
+            retval = this->make_binary(
+                node::op::and_, std::move(retval), this->parse_not());
+        }
+        return retval;
+    }
+
+    std::unique_ptr<node> parse_not()
+    {
+        if (this->is_keyword("NOT")) {
+            if (!this->next_token()) {
+                return nullptr;
+            }
+            auto operand = this->parse_not();
+            if (operand == nullptr) {
+                return nullptr;
+            }
+            auto retval = std::make_unique<node>(node::op::not_);
+            retval->n_children.emplace_back(std::move(operand));
+            return retval;
+        }
+
+        return this->parse_equality();
+    }
+
+    std::unique_ptr<node> parse_equality()
+    {
+        auto retval = this->parse_relational();
+
+        while (retval != nullptr) {
+            auto negated = false;
+
+            if (this->is_punct("=") || this->is_punct("==")
+                || this->is_punct("!=") || this->is_punct("<>"))
+            {
+                auto o = this->is_punct("=") || this->is_punct("==")
+                    ? node::op::eq
+                    : node::op::ne;
+                if (!this->next_token()) {
+                    return nullptr;
+                }
+                retval = this->make_binary(
+                    o, std::move(retval), this->parse_relational());
+                continue;
+            }
+            if (this->is_keyword("IS")) {
+                if (!this->next_token()) {
+                    return nullptr;
+                }
+                if (this->is_keyword("NOT")) {
+                    negated = true;
+                    if (!this->next_token()) {
+                        return nullptr;
+                    }
+                }
+                if (!this->is_keyword("NULL") || !this->next_token()) {
+                    return nullptr;
+                }
+                auto is_null = std::make_unique<node>(node::op::is_null);
+                is_null->n_negated = negated;
+                is_null->n_children.emplace_back(std::move(retval));
+                retval = std::move(is_null);
+                continue;
+            }
+            if (this->is_keyword("NOT")) {
+                negated = true;
+                if (!this->next_token()) {
+                    return nullptr;
+                }
+                if (!this->is_keyword("IN") && !this->is_keyword("LIKE")
+                    && !this->is_keyword("REGEXP"))
+                {
+                    return nullptr;
+                }
+            }
+            if (this->is_keyword("IN")) {
+                if (!this->next_token() || !this->is_punct("(")
+                    || !this->next_token())
+                {
+                    return nullptr;
+                }
+                auto in_node = std::make_unique<node>(node::op::in);
+                in_node->n_negated = negated;
+                in_node->n_children.emplace_back(std::move(retval));
+                while (!this->is_punct(")")) {
+                    if (in_node->n_children.size() > 1) {
+                        if (!this->is_punct(",") || !this->next_token()) {
+                            return nullptr;
+                        }
+                    }
+                    auto elem = this->parse_primary();
+                    if (elem == nullptr || elem->n_op != node::op::literal) {
+                        return nullptr;
+                    }
+                    in_node->n_children.emplace_back(std::move(elem));
+                }
+                if (!this->next_token()) {
+                    return nullptr;
+                }
+                retval = std::move(in_node);
+                continue;
+            }
+            if (this->is_keyword("LIKE") || this->is_keyword("REGEXP")) {
+                auto is_like = this->is_keyword("LIKE");
+                if (!this->next_token()) {
+                    return nullptr;
+                }
+                auto pattern = this->parse_relational();
+                if (pattern == nullptr || pattern->n_op != node::op::literal
+                    || pattern->n_literal.v_kind != value::kind::text)
+                {
+                    return nullptr;
+                }
+                auto match_node = std::make_unique<node>(
+                    is_like ? node::op::like : node::op::regexp);
+                match_node->n_negated = negated;
+                if (is_like) {
+                    auto case_sensitive = like_is_case_sensitive(
+                        sqlite3_db_handle(this->ep_stmt));
+                    if (!case_sensitive) {
+                        return nullptr;
+                    }
+                    match_node->n_case_sensitive = case_sensitive.value();
+                } else {
+                    auto compile_res = lnav::pcre2pp::code::from(
+                        pattern->n_literal.v_text);
+                    if (compile_res.isErr()) {
+                        // let SQLite report the error
+                        return nullptr;
+                    }
+                    match_node->n_regex = compile_res.unwrap().to_shared();
+                }
+                match_node->n_children.emplace_back(std::move(retval));
+                match_node->n_children.emplace_back(std::move(pattern));
+                retval = std::move(match_node);
+                continue;
+            }
+            break;
+        }
+
+        return retval;
+    }
+
+    std::unique_ptr<node> parse_relational()
+    {
+        auto retval = this->parse_primary();
+
+        while (retval != nullptr) {
+            node::op o;
+
+            if (this->is_punct("<")) {
+                o = node::op::lt;
+            } else if (this->is_punct("<=")) {
+                o = node::op::le;
+            } else if (this->is_punct(">")) {
+                o = node::op::gt;
+            } else if (this->is_punct(">=")) {
+                o = node::op::ge;
+            } else {
+                break;
+            }
+            if (!this->next_token()) {
+                return nullptr;
+            }
+            retval
+                = this->make_binary(o, std::move(retval), this->parse_primary());
+        }
+
+        return retval;
+    }
+
+    std::unique_ptr<node> make_literal(value v)
+    {
+        auto retval = std::make_unique<node>(node::op::literal);
+
+        retval->n_literal = v;
+        return retval;
+    }
+
+    std::unique_ptr<node> parse_number(bool negative)
+    {
+        auto num_str = this->ep_token.to_string();
+        std::unique_ptr<node> retval;
+
+        errno = 0;
+        if (this->ep_type == token_type::integer) {
+            char* end = nullptr;
+            auto i = strtoll(num_str.c_str(), &end, 10);
+
+            if (errno == ERANGE || *end != '\0') {
+                return nullptr;
+            }
+            retval = this->make_literal(value::from_int(negative ? -i : i));
+        } else if (this->ep_type == token_type::real) {
+            char* end = nullptr;
+            auto d = strtod(num_str.c_str(), &end);
+
+            if (errno == ERANGE || *end != '\0') {
+                return nullptr;
+            }
+            retval = this->make_literal(value::from_real(negative ? -d : d));
+        } else {
+            return nullptr;
+        }
+
+        if (!this->next_token()) {
+            return nullptr;
+        }
+        return retval;
+    }
+
+    std::unique_ptr<node> parse_primary()
+    {
+        switch (this->ep_type) {
+            case token_type::string: {
+                auto retval = std::make_unique<node>(node::op::literal);
+
+                retval->n_literal_text = std::move(this->ep_string);
+                retval->n_literal
+                    = value::from_text(string_fragment::from_str(
+                        retval->n_literal_text));
+                if (!this->next_token()) {
+                    return nullptr;
+                }
+                return retval;
+            }
+            case token_type::integer:
+            case token_type::real:
+                return this->parse_number(false);
+            case token_type::param: {
+                auto name = this->ep_token.to_string();
+                auto index
+                    = sqlite3_bind_parameter_index(this->ep_stmt, name.c_str());
+
+                if (index <= 0) {
+                    return nullptr;
+                }
+                switch (this->ep_plan.fp_params[index - 1].p_kind) {
+                    case sql_filter_plan::param_kind::unknown:
+                    case sql_filter_plan::param_kind::log_comment:
+                    case sql_filter_plan::param_kind::log_annotations:
+                    case sql_filter_plan::param_kind::log_tags:
+                    case sql_filter_plan::param_kind::log_format_regex:
+                    case sql_filter_plan::param_kind::log_raw_text:
+                        return nullptr;
+                    default:
+                        break;
+                }
+
+                auto retval = std::make_unique<node>(node::op::param);
+                retval->n_param = index - 1;
+                if (!this->next_token()) {
+                    return nullptr;
+                }
+                return retval;
+            }
+            case token_type::keyword: {
+                std::unique_ptr<node> retval;
+
+                if (this->is_keyword("NULL")) {
+                    retval = this->make_literal(value{});
+                } else if (this->is_keyword("TRUE")) {
+                    retval = this->make_literal(value::from_int(1));
+                } else if (this->is_keyword("FALSE")) {
+                    retval = this->make_literal(value::from_int(0));
+                } else {
+                    // column names, functions, and so on are left to SQLite
+                    return nullptr;
+                }
+                if (!this->next_token()) {
+                    return nullptr;
+                }
+                return retval;
+            }
+            case token_type::punct:
+                if (this->is_punct("-") || this->is_punct("+")) {
+                    auto negative = this->is_punct("-");
+
+                    if (!this->next_token()) {
+                        return nullptr;
+                    }
+                    return this->parse_number(negative);
+                }
+                if (this->is_punct("(")) {
+                    if (!this->next_token()) {
+                        return nullptr;
+                    }
+                    auto retval = this->parse_or();
+                    if (retval == nullptr || !this->is_punct(")")
+                        || !this->next_token())
+                    {
+                        return nullptr;
+                    }
+                    return retval;
+                }
+                return nullptr;
+            default:
+                return nullptr;
+        }
+    }
+
+    const sql_filter_plan& ep_plan;
+    sqlite3_stmt* ep_stmt;
+    string_fragment ep_input;
+    int ep_offset{0};
+    token_type ep_type{token_type::end};
+    string_fragment ep_token;
+    std::string ep_string;
+};
+
+class evaluator {
+public:
+    evaluator(const sql_filter_plan& plan, sql_filter_plan::line_context& lc)
+        : e_plan(plan), e_context(lc)
+    {
+    }
+
+    std::optional<tristate> eval_bool(const node& n)
+    {
+        switch (n.n_op) {
+            case node::op::and_: {
+                auto lhs = this->eval_bool(*n.n_children[0]);
+                if (!lhs || lhs.value() == tristate::no) {
+                    return lhs;
+                }
+                auto rhs = this->eval_bool(*n.n_children[1]);
+                if (!rhs || rhs.value() == tristate::no) {
+                    return rhs;
+                }
+                if (lhs.value() == tristate::null
+                    || rhs.value() == tristate::null)
+                {
+                    return tristate::null;
+                }
+                return tristate::yes;
+            }
+            case node::op::or_: {
+                auto lhs = this->eval_bool(*n.n_children[0]);
+                if (!lhs || lhs.value() == tristate::yes) {
+                    return lhs;
+                }
+                auto rhs = this->eval_bool(*n.n_children[1]);
+                if (!rhs || rhs.value() == tristate::yes) {
+                    return rhs;
+                }
+                if (lhs.value() == tristate::null
+                    || rhs.value() == tristate::null)
+                {
+                    return tristate::null;
+                }
+                return tristate::no;
+            }
+            case node::op::not_: {
+                auto operand = this->eval_bool(*n.n_children[0]);
+                if (!operand) {
+                    return std::nullopt;
+                }
+                return negate(operand.value());
+            }
+            case node::op::eq:
+            case node::op::ne:
+            case node::op::lt:
+            case node::op::le:
+            case node::op::gt:
+            case node::op::ge: {
+                auto lhs = this->eval_value(*n.n_children[0]);
+                if (!lhs) {
+                    return std::nullopt;
+                }
+                auto rhs = this->eval_value(*n.n_children[1]);
+                if (!rhs) {
+                    return std::nullopt;
+                }
+                if (lhs->is_null() || rhs->is_null()) {
+                    return tristate::null;
+                }
+
+                auto rc = compare_values(lhs.value(), rhs.value());
+                switch (n.n_op) {
+                    case node::op::eq:
+                        return to_tristate(rc == 0);
+                    case node::op::ne:
+                        return to_tristate(rc != 0);
+                    case node::op::lt:
+                        return to_tristate(rc < 0);
+                    case node::op::le:
+                        return to_tristate(rc <= 0);
+                    case node::op::gt:
+                        return to_tristate(rc > 0);
+                    default:
+                        return to_tristate(rc >= 0);
+                }
+            }
+            case node::op::is_null: {
+                auto operand = this->eval_value(*n.n_children[0]);
+                if (!operand) {
+                    return std::nullopt;
+                }
+                return to_tristate(operand->is_null() != n.n_negated);
+            }
+            case node::op::in: {
+                if (n.n_children.size() == 1) {
+                    return to_tristate(n.n_negated);
+                }
+                auto lhs = this->eval_value(*n.n_children[0]);
+                if (!lhs) {
+                    return std::nullopt;
+                }
+                if (lhs->is_null()) {
+                    return tristate::null;
+                }
+
+                auto saw_null = false;
+                for (size_t lpc = 1; lpc < n.n_children.size(); lpc++) {
+                    const auto& elem = n.n_children[lpc]->n_literal;
+
+                    if (elem.is_null()) {
+                        saw_null = true;
+                    } else if (compare_values(lhs.value(), elem) == 0) {
+                        return to_tristate(!n.n_negated);
+                    }
+                }
+                if (saw_null) {
+                    return tristate::null;
+                }
+                return to_tristate(n.n_negated);
+            }
+            case node::op::like:
+            case node::op::regexp: {
+                auto lhs = this->eval_value(*n.n_children[0]);
+                if (!lhs) {
+                    return std::nullopt;
+                }
+                if (lhs->is_null()) {
+                    return tristate::null;
+                }
+
+                auto text = this->to_text(lhs.value());
+                if (!text) {
+                    return std::nullopt;
+                }
+
+                bool matched;
+                if (n.n_op == node::op::like) {
+                    matched = like_match(n.n_children[1]->n_literal.v_text,
+                                         text.value(),
+                                         n.n_case_sensitive);
+                } else {
+                    matched = n.n_regex->find_in(text.value())
+                                  .ignore_error()
+                                  .has_value();
+                }
+                return to_tristate(matched != n.n_negated);
+            }
+            default: {
+                auto val = this->eval_value(n);
+                if (!val) {
+                    return std::nullopt;
+                }
+                switch (val->v_kind) {
+                    case value::kind::null:
+                        return tristate::null;
+                    case value::kind::integer:
+                        return to_tristate(val->v_int != 0);
+                    case value::kind::real:
+                        return to_tristate(val->v_real != 0.0);
+                    case value::kind::text:
+                        // SQLite converts a prefix of the text to a number
+                        return std::nullopt;
+                }
+                return std::nullopt;
+            }
+        }
+    }
+
+private:
+    static tristate negate(tristate t)
+    {
+        switch (t) {
+            case tristate::no:
+                return tristate::yes;
+            case tristate::yes:
+                return tristate::no;
+            default:
+                return tristate::null;
+        }
+    }
+
+    std::optional<string_fragment> to_text(const value& val)
+    {
+        switch (val.v_kind) {
+            case value::kind::text:
+                return val.v_text;
+            case value::kind::integer:
+                this->e_context.lc_scratch = fmt::to_string(val.v_int);
+                return string_fragment::from_str(this->e_context.lc_scratch);
+            default:
+                // SQLite's formatting of reals is not reproduced here
+                return std::nullopt;
+        }
+    }
+
+    std::optional<value> eval_value(const node& n)
+    {
+        switch (n.n_op) {
+            case node::op::literal:
+                return n.n_literal;
+            case node::op::param:
+                return this->eval_param(this->e_plan.fp_params[n.n_param]);
+            default: {
+                auto res = this->eval_bool(n);
+                if (!res) {
+                    return std::nullopt;
+                }
+                switch (res.value()) {
+                    case tristate::no:
+                        return value::from_int(0);
+                    case tristate::yes:
+                        return value::from_int(1);
+                    default:
+                        return value{};
+                }
+            }
+        }
+    }
+
+    std::optional<value> eval_param(const sql_filter_plan::param& p)
+    {
+        auto& lc = this->e_context;
+        const auto& ll = lc.lc_line;
+
+        switch (p.p_kind) {
+            case sql_filter_plan::param_kind::env: {
+                const auto* env_value = getenv(p.p_name.c_str());
+
+                if (env_value == nullptr) {
+                    return value{};
+                }
+                return value::from_text(
+                    string_fragment::from_c_str(env_value));
+            }
+            case sql_filter_plan::param_kind::log_level:
+                return value::from_text(
+                    string_fragment::from_c_str(ll->get_level_name()));
+            case sql_filter_plan::param_kind::log_time: {
+                auto len = sql_strftime(lc.lc_timestamp,
+                                        sizeof(lc.lc_timestamp),
+                                        ll->get_timeval(),
+                                        'T');
+                return value::from_text(
+                    string_fragment::from_bytes(lc.lc_timestamp, len));
+            }
+            case sql_filter_plan::param_kind::log_time_msecs:
+                return value::from_int(
+                    ll->get_time<std::chrono::milliseconds>().count());
+            case sql_filter_plan::param_kind::log_mark:
+                return value::from_int(ll->is_marked());
+            case sql_filter_plan::param_kind::log_format: {
+                const auto format_name = lc.lc_file->get_format()->get_name();
+                return value::from_text(format_name.to_string_fragment());
+            }
+            case sql_filter_plan::param_kind::log_path:
+                return value::from_text(string_fragment::from_str(
+                    lc.lc_file->get_filename().native()));
+            case sql_filter_plan::param_kind::log_unique_path:
+                return value::from_text(string_fragment::from_str(
+                    lc.lc_file->get_unique_path().native()));
+            case sql_filter_plan::param_kind::log_text: {
+                const auto& sbr = lc.text();
+                return value::from_text(
+                    string_fragment::from_bytes(sbr.get_data(), sbr.length()));
+            }
+            case sql_filter_plan::param_kind::log_body: {
+                const auto& sa = lc.attrs();
+                auto body_attr_opt = get_string_attr(sa, SA_BODY);
+                if (!body_attr_opt) {
+                    return value{};
+                }
+                const auto& sar
+                    = body_attr_opt.value().saw_string_attr->sa_range;
+                return value::from_text(string_fragment::from_bytes(
+                    lc.text().get_data_at(sar.lr_start), sar.length()));
+            }
+            case sql_filter_plan::param_kind::log_opid: {
+                const auto& values = lc.values();
+                if (!values.lvv_opid_value) {
+                    return value{};
+                }
+                return value::from_text(
+                    string_fragment::from_str(values.lvv_opid_value.value()));
+            }
+            case sql_filter_plan::param_kind::value: {
+                for (const auto& lv : lc.values().lvv_values) {
+                    if (lv.lv_meta.lvm_name != p.p_value_name) {
+                        continue;
+                    }
+
+                    switch (lv.lv_meta.lvm_kind) {
+                        case value_kind_t::VALUE_BOOLEAN:
+                        case value_kind_t::VALUE_INTEGER:
+                            return value::from_int(lv.lv_value.i);
+                        case value_kind_t::VALUE_FLOAT:
+                            return value::from_real(lv.lv_value.d);
+                        case value_kind_t::VALUE_NULL:
+                            return value{};
+                        default:
+                            return value::from_text(string_fragment::from_bytes(
+                                lv.text_value(), lv.text_length()));
+                    }
+                }
+                return value{};
+            }
+            default:
+                return std::nullopt;
+        }
+    }
+
+    const sql_filter_plan& e_plan;
+    sql_filter_plan::line_context& e_context;
+};
+
+}  // namespace
+
+const shared_buffer_ref&
+sql_filter_plan::line_context::text()
+{
+    if (!this->lc_read) {
+        auto& sbr = this->lc_values.lvv_sbr;
+
+        this->lc_file->read_full_message(this->lc_line, sbr);
+        sbr.erase_ansi();
+        this->lc_read = true;
+    }
+
+    return this->lc_values.lvv_sbr;
+}
+
+const string_attrs_t&
+sql_filter_plan::line_context::attrs()
+{
+    if (!this->lc_annotated) {
+        this->text();
+        this->lc_file->get_format()->annotate(
+            this->lc_file, this->line_number(), this->lc_attrs, this->lc_values);
+        this->lc_annotated = true;
+    }
+
+    return this->lc_attrs;
+}
+
+const logline_value_vector&
+sql_filter_plan::line_context::values()
+{
+    this->attrs();
+
+    return this->lc_values;
+}
+
+std::shared_ptr<sql_filter_plan>
+sql_filter_plan::create(sqlite3_stmt* stmt)
+{
+    static const auto PARAM_KINDS = std::vector<std::pair<const char*, param_kind>>{
+        {":log_level", param_kind::log_level},
+        {":log_time", param_kind::log_time},
+        {":log_time_msecs", param_kind::log_time_msecs},
+        {":log_mark", param_kind::log_mark},
+        {":log_comment", param_kind::log_comment},
+        {":log_annotations", param_kind::log_annotations},
+        {":log_tags", param_kind::log_tags},
+        {":log_format", param_kind::log_format},
+        {":log_format_regex", param_kind::log_format_regex},
+        {":log_path", param_kind::log_path},
+        {":log_unique_path", param_kind::log_unique_path},
+        {":log_text", param_kind::log_text},
+        {":log_body", param_kind::log_body},
+        {":log_opid", param_kind::log_opid},
+        {":log_raw_text", param_kind::log_raw_text},
+    };
+
+    auto retval = std::make_shared<sql_filter_plan>();
+    const auto* sql = sqlite3_sql(stmt);
+
+    retval->fp_sql = sql != nullptr ? sql : "";
+
+    auto count = sqlite3_bind_parameter_count(stmt);
+    for (int lpc = 0; lpc < count; lpc++) {
+        const auto* name = sqlite3_bind_parameter_name(stmt, lpc + 1);
+        param p;
+
+        if (name == nullptr) {
+            retval->fp_params.emplace_back(p);
+            continue;
+        }
+
+        if (name[0] == '$') {
+            p.p_kind = param_kind::env;
+            p.p_name = &name[1];
+        } else {
+            p.p_kind = param_kind::value;
+            for (const auto& pk : PARAM_KINDS) {
+                if (strcmp(name, pk.first) == 0) {
+                    p.p_kind = pk.second;
+                    break;
+                }
+            }
+            if (p.p_kind == param_kind::value) {
+                p.p_name = &name[1];
+                p.p_value_name = intern_string::lookup(p.p_name);
+            }
+        }
+        retval->fp_params.emplace_back(p);
+    }
+
+    auto sql_sf = string_fragment::from_str(retval->fp_sql);
+    if (sql_sf.startswith(STMT_PREFIX.data())) {
+        expr_parser parser(
+            *retval, stmt, sql_sf.substr(STMT_PREFIX.length()));
+
+        retval->fp_root = parser.parse();
+    }
+
+    return retval;
+}
+
+sql_filter_plan::~sql_filter_plan() = default;
+
+std::optional<bool>
+sql_filter_plan::eval(line_context& lc) const
+{
+    if (this->fp_root == nullptr) {
+        return std::nullopt;
+    }
+
+    evaluator ev(*this, lc);
+    auto res = ev.eval_bool(*this->fp_root);
+    if (!res) {
+        return std::nullopt;
+    }
+
+    return res.value() == tristate::yes;
+}
+
+void
+sql_filter_plan::bind(sqlite3_stmt* stmt, line_context& lc) const
+{
+    const auto& ll = lc.lc_line;
+    auto* lf = lc.lc_file;
+
+    for (size_t lpc = 0; lpc < this->fp_params.size(); lpc++) {
+        const auto& p = this->fp_params[lpc];
+        auto index = lpc + 1;
+
+        switch (p.p_kind) {
+            case param_kind::unknown:
+                break;
+            case param_kind::env: {
+                const auto* env_value = getenv(p.p_name.c_str());
+
+                if (env_value != nullptr) {
+                    sqlite3_bind_text(stmt, index, env_value, -1, SQLITE_STATIC);
+                }
+                break;
+            }
+            case param_kind::log_level:
+                sqlite3_bind_text(
+                    stmt, index, ll->get_level_name(), -1, SQLITE_STATIC);
+                break;
+            case param_kind::log_time: {
+                auto len = sql_strftime(lc.lc_timestamp,
+                                        sizeof(lc.lc_timestamp),
+                                        ll->get_timeval(),
+                                        'T');
+                sqlite3_bind_text(
+                    stmt, index, lc.lc_timestamp, len, SQLITE_STATIC);
+                break;
+            }
+            case param_kind::log_time_msecs:
+                sqlite3_bind_int64(
+                    stmt,
+                    index,
+                    ll->get_time<std::chrono::milliseconds>().count());
+                break;
+            case param_kind::log_mark:
+                sqlite3_bind_int(stmt, index, ll->is_marked());
+                break;
+            case param_kind::log_comment: {
+                const auto& bm = lf->get_bookmark_metadata();
+                auto bm_iter = bm.find(lc.line_number());
+                if (bm_iter != bm.end() && !bm_iter->second.bm_comment.empty())
+                {
+                    const auto& meta = bm_iter->second;
+                    sqlite3_bind_text(stmt,
+                                      index,
+                                      meta.bm_comment.c_str(),
+                                      meta.bm_comment.length(),
+                                      SQLITE_STATIC);
+                }
+                break;
+            }
+            case param_kind::log_annotations: {
+                const auto& bm = lf->get_bookmark_metadata();
+                auto bm_iter = bm.find(lc.line_number());
+                if (bm_iter != bm.end()
+                    && !bm_iter->second.bm_annotations.la_pairs.empty())
+                {
+                    const auto& meta = bm_iter->second;
+                    auto anno_str = logmsg_annotations_handlers.to_string(
+                        meta.bm_annotations);
+
+                    sqlite3_bind_text(stmt,
+                                      index,
+                                      anno_str.c_str(),
+                                      anno_str.length(),
+                                      SQLITE_TRANSIENT);
+                }
+                break;
+            }
+            case param_kind::log_tags: {
+                const auto& bm = lf->get_bookmark_metadata();
+                auto bm_iter = bm.find(lc.line_number());
+                if (bm_iter != bm.end() && !bm_iter->second.bm_tags.empty()) {
+                    const auto& meta = bm_iter->second;
+                    yajlpp_gen gen;
+
+                    yajl_gen_config(gen, yajl_gen_beautify, false);
+
+                    {
+                        yajlpp_array arr(gen);
+
+                        for (const auto& str : meta.bm_tags) {
+                            arr.gen(str);
+                        }
+                    }
+
+                    string_fragment sf = gen.to_string_fragment();
+
+                    sqlite3_bind_text(
+                        stmt, index, sf.data(), sf.length(), SQLITE_TRANSIENT);
+                }
+                break;
+            }
+            case param_kind::log_format: {
+                const auto format_name = lf->get_format()->get_name();
+                sqlite3_bind_text(stmt,
+                                  index,
+                                  format_name.get(),
+                                  format_name.size(),
+                                  SQLITE_STATIC);
+                break;
+            }
+            case param_kind::log_format_regex: {
+                const auto pat_name
+                    = lf->get_format()->get_pattern_name(lc.line_number());
+                sqlite3_bind_text(
+                    stmt, index, pat_name.get(), pat_name.size(), SQLITE_STATIC);
+                break;
+            }
+            case param_kind::log_path: {
+                const auto& filename = lf->get_filename();
+                sqlite3_bind_text(stmt,
+                                  index,
+                                  filename.c_str(),
+                                  filename.native().length(),
+                                  SQLITE_STATIC);
+                break;
+            }
+            case param_kind::log_unique_path: {
+                const auto& filename = lf->get_unique_path();
+                sqlite3_bind_text(stmt,
+                                  index,
+                                  filename.c_str(),
+                                  filename.native().length(),
+                                  SQLITE_STATIC);
+                break;
+            }
+            case param_kind::log_text: {
+                const auto& sbr = lc.text();
+                sqlite3_bind_text(
+                    stmt, index, sbr.get_data(), sbr.length(), SQLITE_STATIC);
+                break;
+            }
+            case param_kind::log_body: {
+                auto body_attr_opt = get_string_attr(lc.attrs(), SA_BODY);
+                if (body_attr_opt) {
+                    const auto& sar
+                        = body_attr_opt.value().saw_string_attr->sa_range;
+
+                    sqlite3_bind_text(stmt,
+                                      index,
+                                      lc.text().get_data_at(sar.lr_start),
+                                      sar.length(),
+                                      SQLITE_STATIC);
+                } else {
+                    sqlite3_bind_null(stmt, index);
+                }
+                break;
+            }
+            case param_kind::log_opid: {
+                const auto& values = lc.values();
+                if (values.lvv_opid_value) {
+                    sqlite3_bind_text(stmt,
+                                      index,
+                                      values.lvv_opid_value->c_str(),
+                                      values.lvv_opid_value->length(),
+                                      SQLITE_STATIC);
+                } else {
+                    sqlite3_bind_null(stmt, index);
+                }
+                break;
+            }
+            case param_kind::log_raw_text: {
+                auto res = lf->read_raw_message(ll);
+
+                if (res.isOk()) {
+                    lc.lc_raw_sbr = res.unwrap();
+                    sqlite3_bind_text(stmt,
+                                      index,
+                                      lc.lc_raw_sbr.get_data(),
+                                      lc.lc_raw_sbr.length(),
+                                      SQLITE_STATIC);
+                }
+                break;
+            }
+            case param_kind::value: {
+                for (const auto& lv : lc.values().lvv_values) {
+                    if (lv.lv_meta.lvm_name != p.p_value_name) {
+                        continue;
+                    }
+
+                    switch (lv.lv_meta.lvm_kind) {
+                        case value_kind_t::VALUE_BOOLEAN:
+                            sqlite3_bind_int64(stmt, index, lv.lv_value.i);
+                            break;
+                        case value_kind_t::VALUE_FLOAT:
+                            sqlite3_bind_double(stmt, index, lv.lv_value.d);
+                            break;
+                        case value_kind_t::VALUE_INTEGER:
+                            sqlite3_bind_int64(stmt, index, lv.lv_value.i);
+                            break;
+                        case value_kind_t::VALUE_NULL:
+                            sqlite3_bind_null(stmt, index);
+                            break;
+                        default:
+                            sqlite3_bind_text(stmt,
+                                              index,
+                                              lv.text_value(),
+                                              lv.text_length(),
+                                              SQLITE_TRANSIENT);
+                            break;
+                    }
+                    break;
+                }
+                break;
+            }
+        }
+    }
+}
@@ -0,0 +1,139 @@
+/**
+ * Copyright (c) 2025, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef lnav_sql_filter_plan_hh
+#define lnav_sql_filter_plan_hh
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <sqlite3.h>
+
+#include "base/intern_string.hh"
+#include "log_format.hh"
+#include "logfile.hh"
+
+/**
+ * The evaluation plan for a ":filter-expr" or ":mark-expr" statement.  The
+ * bind parameters are resolved once when the plan is created instead of
+ * being compared by name for every line.  If the expression only uses
+ * comparisons, AND/OR/NOT, IN, IS NULL, LIKE, and REGEXP against literals,
+ * it is also compiled into a native predicate that can be evaluated without
+ * going through SQLite.
+ */
+class sql_filter_plan {
+public:
+    enum class param_kind {
+        unknown,
+        env,
+        log_level,
+        log_time,
+        log_time_msecs,
+        log_mark,
+        log_comment,
+        log_annotations,
+        log_tags,
+        log_format,
+        log_format_regex,
+        log_path,
+        log_unique_path,
+        log_text,
+        log_body,
+        log_opid,
+        log_raw_text,
+        value,
+    };
+
+    struct param {
+        param_kind p_kind{param_kind::unknown};
+        /** The environment variable or log value name. */
+        std::string p_name;
+        intern_string_t p_value_name;
+    };
+
+    /**
+     * The data for a single line.  The message is only read and annotated
+     * when a parameter that needs it is accessed.
+     */
+    class line_context {
+    public:
+        line_context(logfile* lf, logfile::const_iterator ll)
+            : lc_file(lf), lc_line(ll)
+        {
+        }
+
+        const shared_buffer_ref& text();
+
+        const logline_value_vector& values();
+
+        const string_attrs_t& attrs();
+
+        uint32_t line_number() const
+        {
+            return std::distance(this->lc_file->cbegin(), this->lc_line);
+        }
+
+        logfile* lc_file;
+        logfile::const_iterator lc_line;
+        bool lc_read{false};
+        bool lc_annotated{false};
+        logline_value_vector lc_values;
+        string_attrs_t lc_attrs;
+        shared_buffer_ref lc_raw_sbr;
+        char lc_timestamp[64];
+        std::string lc_scratch;
+    };
+
+    struct node;
+
+    static std::shared_ptr<sql_filter_plan> create(sqlite3_stmt* stmt);
+
+    ~sql_filter_plan();
+
+    /** Bind the statement parameters to the values for the given line. */
+    void bind(sqlite3_stmt* stmt, line_context& lc) const;
+
+    /**
+     * Evaluate the native predicate for the given line.
+     *
+     * @return The result of the WHERE clause or nullopt if the expression
+     *   was not compiled or this line needs SQLite to get the right answer.
+     */
+    std::optional<bool> eval(line_context& lc) const;
+
+    bool is_native() const { return this->fp_root != nullptr; }
+
+    std::string fp_sql;
+    std::vector<param> fp_params;
+    std::unique_ptr<node> fp_root;
+};
+
+#endif
@@ -56,8 +56,8 @@ read_err_pipe(auto_fd& err, std::string& eq)
 int
 main(int argc, char* const* argv)
 {
-    if (argc != 3) {
-        fprintf(stderr, "usage: %s <cmd> <path>\n", argv[0]);
+    if (argc != 3 && argc != 4) {
+        fprintf(stderr, "usage: %s <cmd> <path> [<prefilter>]\n", argv[0]);
         exit(EXIT_FAILURE);
     }
 
@@ -119,8 +119,13 @@ main(int argc, char* const* argv)
     auto& to_child = in_pipe.write_end();
     auto& from_child = out_pipe.read_end();
     auto cmd = std::string(argv[1]);
+    tailer::frame_decoder decoder;
+    int64_t wire_bytes = 0;
+    int64_t data_bytes = 0;
 
-    if (cmd == "open") {
+    if (cmd == "tail") {
+        // The path is opened after the capabilities have been negotiated.
+    } else if (cmd == "open") {
         send_packet(
             to_child.get(), TPT_OPEN_PATH, TPPT_STRING, argv[2], TPPT_DONE);
     } else if (cmd == "preview") {
@@ -139,7 +144,9 @@ main(int argc, char* const* argv)
         exit(EXIT_FAILURE);
     }
 
-    close(to_child.get());
+    if (cmd != "tail") {
+        to_child.reset();
+    }
 
     bool done = false;
     while (!done) {
@@ -157,6 +164,27 @@ main(int argc, char* const* argv)
                 done = true;
             },
             [&](const tailer::packet_announce& pa) {},
+            [&](const tailer::packet_capabilities& pc) {
+                if (cmd != "tail") {
+                    return;
+                }
+
+                printf("capabilities: %s\n", pc.pc_features.c_str());
+                if (pc.has_feature(TAILER_FEATURE_DEFLATE)) {
+                    send_packet(to_child.get(),
+                                TPT_CONFIGURE,
+                                TPPT_STRING,
+                                TAILER_FEATURE_DEFLATE,
+                                TPPT_STRING,
+                                argc == 4 ? argv[3] : "",
+                                TPPT_DONE);
+                }
+                send_packet(to_child.get(),
+                            TPT_OPEN_PATH,
+                            TPPT_STRING,
+                            argv[2],
+                            TPPT_DONE);
+            },
             [&](const tailer::packet_log& te) {
                 printf("log: %s\n", te.pl_msg.c_str());
             },
@@ -177,6 +205,15 @@ main(int argc, char* const* argv)
                        pob.pob_offset,
                        pob.pob_length);
 
+                if (cmd == "tail") {
+                    send_packet(to_child.get(),
+                                TPT_NEED_BLOCK,
+                                TPPT_STRING,
+                                pob.pob_path.c_str(),
+                                TPPT_DONE);
+                    return;
+                }
+
                 auto remote_path = std::filesystem::absolute(
                                        std::filesystem::path(pob.pob_path))
                                        .relative_path();
@@ -230,7 +267,24 @@ main(int argc, char* const* argv)
                             TPPT_DONE);
 #endif
             },
-            [&](const tailer::packet_tail_block& ptb) {
+            [&](tailer::packet_tail_block& ptb) {
+                wire_bytes += ptb.ptb_bits.size();
+                data_bytes += ptb.ptb_length;
+
+                auto decode_res = decoder.decode(ptb);
+                if (decode_res.isErr()) {
+                    fprintf(stderr,
+                            "decode error: %s\n",
+                            decode_res.unwrapErr().c_str());
+                    exit(EXIT_FAILURE);
+                }
+                printf("tail of file: %s %lld/%lld%s\n%.*s",
+                       ptb.ptb_path.c_str(),
+                       ptb.ptb_offset,
+                       ptb.ptb_length,
+                       (ptb.ptb_flags & TFF_FILTERED) ? " (filtered)" : "",
+                       (int) ptb.ptb_bits.size(),
+                       ptb.ptb_bits.data());
 #if 0
                 //printf("got a tail: %s %lld %ld\n", ptb.ptb_path.c_str(),
                 //       ptb.ptb_offset, ptb.ptb_bits.size());
@@ -252,7 +306,12 @@ main(int argc, char* const* argv)
 #endif
             },
             [&](const tailer::packet_synced& ps) {
-
+                if (cmd == "tail") {
+                    printf("synced: %s -- compressed %s\n",
+                           ps.ps_path.c_str(),
+                           wire_bytes < data_bytes ? "yes" : "no");
+                    to_child.reset();
+                }
             },
             [&](const tailer::packet_link& pl) {
                 printf("link value: %s -> %s\n",
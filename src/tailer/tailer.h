@@ -59,8 +59,28 @@ typedef enum {
     TPT_COMPLETE_PATH,
     TPT_POSSIBLE_PATH,
     TPT_ANNOUNCE,
+    TPT_CAPABILITIES,
+    TPT_CONFIGURE,
+    TPT_TAIL_FRAME,
 } tailer_packet_type_t;
 
+/**
+ * The features the tailer lists in the TPT_CAPABILITIES packet.  The client
+ * only sends a TPT_CONFIGURE packet if the tailer advertised the features.
+ */
+#define TAILER_FEATURE_DEFLATE "deflate"
+#define TAILER_FEATURE_PREFILTER "prefilter"
+
+typedef enum {
+    /** The payload is the next chunk of the connection's deflate stream. */
+    TFF_DEFLATE = 0x1,
+    /**
+     * The payload only contains the lines that matched the prefilter, so it
+     * should be appended to the local copy instead of written at the offset.
+     */
+    TFF_FILTERED = 0x2,
+} tailer_frame_flags_t;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -35,6 +35,7 @@
 
 #include "base/auto_pid.hh"
 #include "base/fs_util.hh"
+#include "base/humanize.hh"
 #include "base/humanize.network.hh"
 #include "base/lnav_log.hh"
 #include "base/paths.hh"
@@ -635,9 +636,36 @@ tailer::looper::host_tailer::loop_body()
                 return state_v{disconnected()};
             },
             [&](const tailer::packet_announce& pa) {
-                update_tailer_description(
-                    this->ht_netloc, conn.c_desired_paths, pa.pa_uname);
                 this->ht_uname = pa.pa_uname;
+                update_tailer_description(this->ht_netloc,
+                                          conn.c_desired_paths,
+                                          this->get_description());
+                return std::move(this->ht_state);
+            },
+            [&](const tailer::packet_capabilities& pc) {
+                const auto& cfg = injector::get<const config&>();
+                std::string compression;
+                std::string prefilter;
+
+                log_info("tailer capabilities: %s", pc.pc_features.c_str());
+                if (cfg.c_compress && pc.has_feature(TAILER_FEATURE_DEFLATE))
+                {
+                    compression = TAILER_FEATURE_DEFLATE;
+                }
+                if (!cfg.c_prefilter.empty()
+                    && pc.has_feature(TAILER_FEATURE_PREFILTER))
+                {
+                    prefilter = cfg.c_prefilter;
+                }
+                if (!compression.empty() || !prefilter.empty()) {
+                    send_packet(conn.ht_to_child.get(),
+                                TPT_CONFIGURE,
+                                TPPT_STRING,
+                                compression.c_str(),
+                                TPPT_STRING,
+                                prefilter.c_str(),
+                                TPPT_DONE);
+                }
                 return std::move(this->ht_state);
             },
             [&](const tailer::packet_log& pl) {
@@ -723,8 +751,9 @@ tailer::looper::host_tailer::loop_body()
                     loo = std::move(child_iter->second);
                 }
 
-                update_tailer_description(
-                    this->ht_netloc, conn.c_desired_paths, this->ht_uname);
+                update_tailer_description(this->ht_netloc,
+                                          conn.c_desired_paths,
+                                          this->get_description());
 
                 auto remote_path = std::filesystem::absolute(
                                        std::filesystem::path(pob.pob_path))
@@ -866,12 +895,24 @@ tailer::looper::host_tailer::loop_body()
                             TPPT_DONE);
                 return std::move(this->ht_state);
             },
-            [&](const tailer::packet_tail_block& ptb) {
+            [&](tailer::packet_tail_block& ptb) {
                 auto remote_path = std::filesystem::absolute(
                                        std::filesystem::path(ptb.ptb_path))
                                        .relative_path();
                 auto local_path = this->ht_local_path / remote_path;
 
+                this->ht_wire_bytes += ptb.ptb_bits.size();
+                this->ht_data_bytes += ptb.ptb_length;
+                auto decode_res = conn.c_frame_decoder.decode(ptb);
+                if (decode_res.isErr()) {
+                    log_error("tail frame for %s: %s",
+                              ptb.ptb_path.c_str(),
+                              decode_res.unwrapErr().c_str());
+                    auto finished_child = std::move(conn).close();
+                    report_error(this->ht_netloc, decode_res.unwrapErr());
+                    return state_v{disconnected()};
+                }
+
                 log_debug("writing tail to: %lld/%ld %s",
                           ptb.ptb_offset,
                           ptb.ptb_bits.size(),
@@ -884,19 +925,39 @@ tailer::looper::host_tailer::loop_body()
                     log_error("open: %s", create_res.unwrapErr().c_str());
                 } else {
                     auto fd = create_res.unwrap();
-                    ftruncate(fd, ptb.ptb_offset);
-                    pwrite(fd,
-                           ptb.ptb_bits.data(),
-                           ptb.ptb_bits.size(),
-                           ptb.ptb_offset);
+                    if (ptb.ptb_flags & TFF_FILTERED) {
+                        // The offsets are for the remote file, so the
+                        // filtered lines are just appended to the local copy.
+                        if (ptb.ptb_offset == 0) {
+                            ftruncate(fd, 0);
+                        }
+                        write(fd, ptb.ptb_bits.data(), ptb.ptb_bits.size());
+                    } else {
+                        ftruncate(fd, ptb.ptb_offset);
+                        pwrite(fd,
+                               ptb.ptb_bits.data(),
+                               ptb.ptb_bits.size(),
+                               ptb.ptb_offset);
+                    }
                     auto mtime = std::filesystem::file_time_type{
                         std::chrono::seconds{ptb.ptb_mtime}};
                     // XXX This isn't atomic with the write...
                     std::filesystem::last_write_time(local_path, mtime);
                 }
+
+                auto now = std::chrono::steady_clock::now();
+                if (now - this->ht_last_description_update >= 1s) {
+                    this->ht_last_description_update = now;
+                    update_tailer_description(this->ht_netloc,
+                                              conn.c_desired_paths,
+                                              this->get_description());
+                }
                 return std::move(this->ht_state);
             },
             [&](const tailer::packet_synced& ps) {
+                update_tailer_description(this->ht_netloc,
+                                          conn.c_desired_paths,
+                                          this->get_description());
                 if (ps.ps_root_path == ps.ps_path) {
                     auto iter = conn.c_desired_paths.find(ps.ps_path);
 
@@ -1096,6 +1157,21 @@ tailer::looper::host_tailer::get_display_path(
     return fmt::format(FMT_STRING("{}{}"), this->ht_netloc, remote_path);
 }
 
+std::string
+tailer::looper::host_tailer::get_description() const
+{
+    if (this->ht_wire_bytes == 0 || this->ht_wire_bytes == this->ht_data_bytes)
+    {
+        return this->ht_uname;
+    }
+
+    return fmt::format(
+        FMT_STRING("{} ({} transferred for {})"),
+        this->ht_uname,
+        humanize::file_size(this->ht_wire_bytes, humanize::alignment::none),
+        humanize::file_size(this->ht_data_bytes, humanize::alignment::none));
+}
+
 void*
 tailer::looper::host_tailer::run()
 {
@@ -46,6 +46,8 @@ struct config {
         {"BatchMode", "yes"},
         {"ConnectTimeout", "10"},
     };
+    bool c_compress{true};
+    std::string c_prefilter;
 };
 
 }  // namespace tailer
@@ -40,6 +40,7 @@
 #include "base/network.tcp.hh"
 #include <filesystem>
 #include "mapbox/variant.hpp"
+#include "tailerpp.hh"
 
 namespace tailer {
 
@@ -105,6 +106,8 @@ private:
 
         std::string get_display_path(const std::string& remote_path) const;
 
+        std::string get_description() const;
+
         struct connected {
             auto_pid<process_state::running> ht_child;
             auto_fd ht_to_child;
@@ -114,6 +117,7 @@ private:
             std::map<std::string, logfile_open_options_base> c_child_paths;
             std::set<std::string> c_synced_child_paths;
             bool c_initial_sync_done{false};
+            frame_decoder c_frame_decoder;
 
             auto_pid<process_state::finished> close() &&;
         };
@@ -131,6 +135,11 @@ private:
         std::thread ht_error_reader;
         state_v ht_state{disconnected()};
         uint64_t ht_cycle_count{0};
+        /** The number of file bytes received over the connection. */
+        uint64_t ht_wire_bytes{0};
+        /** The number of bytes of the remote files that were covered. */
+        uint64_t ht_data_bytes{0};
+        std::chrono::steady_clock::time_point ht_last_description_update;
     };
 
     static void report_error(std::string path, std::string msg);
@@ -44,6 +44,8 @@
 #include <sys/utsname.h>
 #include <ctype.h>
 #include <stdint.h>
+#include <regex.h>
+#include <zlib.h>
 #endif
 
 #include "sha-256.h"
@@ -346,6 +348,18 @@ static int readint64(recv_state_t *state, int sock, int64_t *i)
 
 struct list client_path_list;
 
+/**
+ * The protocol extensions requested by the client with TPT_CONFIGURE.
+ */
+struct tail_config {
+    int tc_deflate;
+    z_stream tc_deflate_stream;
+    int tc_prefilter;
+    regex_t tc_prefilter_regex;
+};
+
+struct tail_config tail_config;
+
 struct client_path_state *find_client_path_state(struct list *path_list, const char *path)
 {
     struct client_path_state *curr = (struct client_path_state *) path_list->l_head;
@@ -388,6 +402,170 @@ void send_preview_data(int64_t id, const char *path, int32_t len, const char *bi
                 TPPT_DONE);
 }
 
+/**
+ * Copy the lines in the buffer that match the prefilter to the output.
+ *
+ * @return The number of bytes copied to the output.
+ */
+static int32_t filter_lines(unsigned char *buffer, int32_t len, unsigned char *out)
+{
+    int32_t out_len = 0;
+    int32_t start = 0;
+
+    while (start < len) {
+        int32_t end = start;
+
+        while (end < len && buffer[end] != '\n') {
+            end += 1;
+        }
+
+        // The buffer has room for a terminator after the last byte.
+        unsigned char saved = buffer[end];
+        buffer[end] = '\0';
+        int matched = regexec(&tail_config.tc_prefilter_regex,
+                              (const char *) &buffer[start],
+                              0, NULL, 0) == 0;
+        buffer[end] = saved;
+
+        if (end < len) {
+            end += 1;
+        }
+        if (matched) {
+            memcpy(&out[out_len], &buffer[start], end - start);
+            out_len += end - start;
+        }
+        start = end;
+    }
+
+    return out_len;
+}
+
+/**
+ * Compress the data as the next chunk of the deflate stream.
+ *
+ * @return The compressed data, which is valid until the next call, or NULL
+ *   if there was an error.
+ */
+static unsigned char *deflate_bits(unsigned char *bits, int32_t len, int32_t *len_out)
+{
+    static unsigned char *out = NULL;
+    static size_t out_capacity = 0;
+    z_stream *zs = &tail_config.tc_deflate_stream;
+    size_t needed = deflateBound(zs, len) + 64;
+    size_t out_len = 0;
+
+    if (out_capacity < needed) {
+        unsigned char *new_out = realloc(out, needed);
+
+        if (new_out == NULL) {
+            return NULL;
+        }
+        out = new_out;
+        out_capacity = needed;
+    }
+
+    zs->next_in = bits;
+    zs->avail_in = len;
+    do {
+        if (out_len == out_capacity) {
+            unsigned char *new_out = realloc(out, out_capacity * 2);
+
+            if (new_out == NULL) {
+                return NULL;
+            }
+            out = new_out;
+            out_capacity *= 2;
+        }
+        zs->next_out = &out[out_len];
+        zs->avail_out = out_capacity - out_len;
+        if (deflate(zs, Z_SYNC_FLUSH) == Z_STREAM_ERROR) {
+            return NULL;
+        }
+        out_len = out_capacity - zs->avail_out;
+    } while (zs->avail_out == 0);
+
+    *len_out = out_len;
+    return out;
+}
+
+/**
+ * Send a block of a file to the client using the protocol extensions that
+ * were requested.  When prefiltering, only whole lines are consumed, so a
+ * partial line at the end of the block is left for the next poll unless
+ * the file has stopped growing.
+ *
+ * @return The number of bytes of the block that were consumed.
+ */
+static int32_t send_tail(struct client_path_state *root_cps,
+                         struct client_path_state *cps,
+                         const struct stat *st,
+                         unsigned char *buffer,
+                         int32_t bytes_read,
+                         int32_t buffer_size)
+{
+    static unsigned char filter_buffer[4 * 1024 * 1024];
+    unsigned char *payload = buffer;
+    int32_t payload_len = bytes_read;
+    int32_t consumed = bytes_read;
+    int64_t flags = 0;
+
+    if (!tail_config.tc_deflate && !tail_config.tc_prefilter) {
+        send_packet(STDOUT_FILENO,
+                    TPT_TAIL_BLOCK,
+                    TPPT_STRING, root_cps->cps_path,
+                    TPPT_STRING, cps->cps_path,
+                    TPPT_INT64, (int64_t) st->st_mtime,
+                    TPPT_INT64, cps->cps_client_file_offset,
+                    TPPT_BITS, bytes_read, buffer,
+                    TPPT_DONE);
+        return bytes_read;
+    }
+
+    if (tail_config.tc_prefilter) {
+        while (consumed > 0 && buffer[consumed - 1] != '\n') {
+            consumed -= 1;
+        }
+        if (consumed == 0) {
+            if (bytes_read < buffer_size &&
+                st->st_size != cps->cps_last_stat.st_size) {
+                return 0;
+            }
+            consumed = bytes_read;
+        }
+
+        payload = filter_buffer;
+        payload_len = filter_lines(buffer, consumed, filter_buffer);
+        flags |= TFF_FILTERED;
+        if (payload_len == 0 && cps->cps_client_file_offset > 0) {
+            // Nothing to send, the client only needs the first frame to
+            // know that the local copy should be truncated.
+            return consumed;
+        }
+    }
+
+    if (tail_config.tc_deflate) {
+        payload = deflate_bits(payload, payload_len, &payload_len);
+        if (payload == NULL) {
+            fprintf(stderr, "error: unable to compress tail block\n");
+            return 0;
+        }
+        flags |= TFF_DEFLATE;
+    }
+
+    send_packet(STDOUT_FILENO,
+                TPT_TAIL_FRAME,
+                TPPT_STRING, root_cps->cps_path,
+                TPPT_STRING, cps->cps_path,
+                TPPT_INT64, (int64_t) st->st_mtime,
+                TPPT_INT64, cps->cps_client_file_offset,
+                TPPT_INT64, (int64_t) consumed,
+                TPPT_INT64, flags,
+                TPPT_BITS, payload_len, payload,
+                TPPT_DONE);
+
+    return consumed;
+}
+
 int poll_paths(struct list *path_list, struct client_path_state *root_cps)
 {
     struct client_path_state *curr = (struct client_path_state *) path_list->l_head;
@@ -519,13 +697,17 @@ int poll_paths(struct list *path_list, struct client_path_state *root_cps)
                         if (fd == -1) {
                             set_client_path_state_error(curr, "open");
                         } else {
-                            static unsigned char buffer[4 * 1024 * 1024];
+                            // The extra byte is used to terminate lines
+                            // when prefiltering.
+                            static unsigned char buffer[4 * 1024 * 1024 + 1];
+                            const int64_t buffer_size = sizeof(buffer) - 1;
 
                             int64_t file_offset =
                                 curr->cps_client_file_offset < 0 ?
                                 0 :
                                 curr->cps_client_file_offset;
-                            int64_t nbytes = sizeof(buffer);
+                            int64_t nbytes = buffer_size;
+                            int busy = 1;
                             if (curr->cps_client_state == CS_INIT) {
                                 if (curr->cps_client_file_size == 0) {
                                     // initial state, haven't heard from client yet.
@@ -533,8 +715,8 @@ int poll_paths(struct list *path_list, struct client_path_state *root_cps)
                                 } else if (file_offset < curr->cps_client_file_size) {
                                     // heard from client, try to catch up
                                     nbytes = curr->cps_client_file_size - file_offset;
-                                    if (nbytes > sizeof(buffer)) {
-                                        nbytes = sizeof(buffer);
+                                    if (nbytes > buffer_size) {
+                                        nbytes = buffer_size;
                                     }
                                 }
                             }
@@ -543,6 +725,7 @@ int poll_paths(struct list *path_list, struct client_path_state *root_cps)
                             if (bytes_read == -1) {
                                 set_client_path_state_error(curr, "pread");
                             } else if (curr->cps_client_state == CS_INIT &&
+                                       !tail_config.tc_prefilter &&
                                        (curr->cps_client_file_offset < 0 ||
                                         bytes_read > 0)) {
                                 static unsigned char
@@ -612,20 +795,21 @@ int poll_paths(struct list *path_list, struct client_path_state *root_cps)
                                     curr->cps_client_file_offset = 0;
                                 }
 
-                                send_packet(STDOUT_FILENO,
-                                            TPT_TAIL_BLOCK,
-                                            TPPT_STRING, root_cps->cps_path,
-                                            TPPT_STRING, curr->cps_path,
-                                            TPPT_INT64, (int64_t) st.st_mtime,
-                                            TPPT_INT64, curr->cps_client_file_offset,
-                                            TPPT_BITS, bytes_read, buffer,
-                                            TPPT_DONE);
-                                curr->cps_client_file_offset += bytes_read;
+                                int32_t consumed = send_tail(root_cps,
+                                                             curr,
+                                                             &st,
+                                                             buffer,
+                                                             bytes_read,
+                                                             buffer_size);
+                                curr->cps_client_file_offset += consumed;
                                 curr->cps_client_state = CS_TAILING;
+                                busy = consumed > 0;
                             }
                             close(fd);
 
-                            retval = 1;
+                            if (busy) {
+                                retval = 1;
+                            }
                         }
                     } else if (curr->cps_client_state != CS_SYNCED) {
                         send_packet(STDOUT_FILENO,
@@ -884,6 +1068,67 @@ void handle_load_preview_request(const char *path, int64_t preview_id)
     }
 }
 
+/**
+ * Start sending the paths from the beginning, used when the prefilter
+ * changes and the client's copies of the files need to be replaced.
+ */
+static
+void restart_client_paths(struct list *path_list)
+{
+    struct client_path_state *curr = (struct client_path_state *) path_list->l_head;
+
+    while (curr->cps_node.n_succ != NULL) {
+        curr->cps_client_file_offset = -1;
+        curr->cps_client_file_size = 0;
+        curr->cps_client_state = CS_INIT;
+        delete_client_path_list(&curr->cps_children);
+
+        curr = (struct client_path_state *) curr->cps_node.n_succ;
+    }
+}
+
+static
+void handle_configure_request(const char *compression, const char *prefilter)
+{
+    if (strcmp(compression, TAILER_FEATURE_DEFLATE) == 0 &&
+        !tail_config.tc_deflate) {
+        memset(&tail_config.tc_deflate_stream, 0,
+               sizeof(tail_config.tc_deflate_stream));
+        if (deflateInit(&tail_config.tc_deflate_stream,
+                        Z_DEFAULT_COMPRESSION) != Z_OK) {
+            fprintf(stderr, "error: unable to initialize compression\n");
+        } else {
+            fprintf(stderr, "info: compressing tail blocks\n");
+            tail_config.tc_deflate = 1;
+        }
+    }
+
+    int had_prefilter = tail_config.tc_prefilter;
+
+    if (tail_config.tc_prefilter) {
+        regfree(&tail_config.tc_prefilter_regex);
+        tail_config.tc_prefilter = 0;
+    }
+    if (prefilter[0] != '\0') {
+        int rc = regcomp(&tail_config.tc_prefilter_regex,
+                         prefilter,
+                         REG_EXTENDED | REG_NOSUB);
+
+        if (rc != 0) {
+            char msg[1024];
+
+            regerror(rc, &tail_config.tc_prefilter_regex, msg, sizeof(msg));
+            fprintf(stderr, "error: invalid prefilter -- %s\n", msg);
+        } else {
+            fprintf(stderr, "info: prefiltering lines with: %s\n", prefilter);
+            tail_config.tc_prefilter = 1;
+        }
+    }
+    if (had_prefilter || tail_config.tc_prefilter) {
+        restart_client_paths(&client_path_list);
+    }
+}
+
 static
 void handle_complete_path_request(const char *path)
 {
@@ -939,6 +1184,11 @@ int main(int argc, char *argv[])
         }
     }
 
+    send_packet(STDOUT_FILENO,
+                TPT_CAPABILITIES,
+                TPPT_STRING, TAILER_FEATURE_DEFLATE " " TAILER_FEATURE_PREFILTER,
+                TPPT_DONE);
+
     while (!done) {
         struct pollfd pfds[1];
 
@@ -1007,6 +1257,27 @@ int main(int argc, char *argv[])
                         free(path);
                         break;
                     }
+                    case TPT_CONFIGURE: {
+                        char *compression = readstr(&rstate, STDIN_FILENO);
+                        char *prefilter = NULL;
+
+                        if (compression != NULL) {
+                            prefilter = readstr(&rstate, STDIN_FILENO);
+                        }
+                        if (compression == NULL || prefilter == NULL) {
+                            fprintf(stderr, "error: unable to read configuration\n");
+                            done = 1;
+                        } else if (read_payload_type(&rstate, STDIN_FILENO) != TPPT_DONE) {
+                            fprintf(stderr, "error: invalid configure packet\n");
+                            done = 1;
+                        } else {
+                            handle_configure_request(compression, prefilter);
+                        }
+
+                        free(compression);
+                        free(prefilter);
+                        break;
+                    }
                     case TPT_ACK_BLOCK:
                     case TPT_NEED_BLOCK: {
                         char *path = readstr(&rstate, STDIN_FILENO);
@@ -1035,6 +1306,13 @@ int main(int argc, char *argv[])
                             } else if (type == TPT_NEED_BLOCK) {
                                 fprintf(stderr, "info: client is tailing: %s\n", path);
                                 cps->cps_client_state = CS_TAILING;
+                            } else if (type == TPT_ACK_BLOCK &&
+                                       tail_config.tc_prefilter) {
+                                // The offer was made before the prefilter
+                                // was set, the file is being resent.
+                                fprintf(stderr,
+                                        "info: ignoring ack while prefiltering: %s\n",
+                                        path);
                             } else if (type == TPT_ACK_BLOCK) {
                                 fprintf(stderr,
                                         "info: client acked: %s %lld\n",
@@ -27,9 +27,12 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <algorithm>
+
 #include "tailerpp.hh"
 
 #include <unistd.h>
+#include <zlib.h>
 
 namespace tailer {
 
@@ -83,6 +86,12 @@ read_packet(int fd)
             TRY(read_payloads_into(fd, pa.pa_uname));
             return Ok(packet{pa});
         }
+        case TPT_CAPABILITIES: {
+            packet_capabilities pc;
+
+            TRY(read_payloads_into(fd, pc.pc_features));
+            return Ok(packet{pc});
+        }
         case TPT_OFFER_BLOCK: {
             packet_offer_block pob;
 
@@ -104,6 +113,20 @@ read_packet(int fd)
                                    ptb.ptb_mtime,
                                    ptb.ptb_offset,
                                    ptb.ptb_bits));
+            ptb.ptb_length = ptb.ptb_bits.size();
+            return Ok(packet{ptb});
+        }
+        case TPT_TAIL_FRAME: {
+            packet_tail_block ptb;
+
+            TRY(read_payloads_into(fd,
+                                   ptb.ptb_root_path,
+                                   ptb.ptb_path,
+                                   ptb.ptb_mtime,
+                                   ptb.ptb_offset,
+                                   ptb.ptb_length,
+                                   ptb.ptb_flags,
+                                   ptb.ptb_bits));
             return Ok(packet{ptb});
         }
         case TPT_SYNCED: {
@@ -143,4 +166,90 @@ read_packet(int fd)
     }
 }
 
+bool
+packet_capabilities::has_feature(const char* name) const
+{
+    size_t start = 0;
+
+    while (start < this->pc_features.size()) {
+        auto end = this->pc_features.find(' ', start);
+
+        if (end == std::string::npos) {
+            end = this->pc_features.size();
+        }
+        if (this->pc_features.compare(start, end - start, name) == 0) {
+            return true;
+        }
+        start = end + 1;
+    }
+
+    return false;
+}
+
+struct frame_decoder::impl {
+    z_stream i_stream{};
+    bool i_initialized{false};
+
+    ~impl()
+    {
+        if (this->i_initialized) {
+            inflateEnd(&this->i_stream);
+        }
+    }
+};
+
+frame_decoder::frame_decoder() : fd_impl(std::make_unique<impl>()) {}
+
+frame_decoder::frame_decoder(frame_decoder&& other) noexcept = default;
+
+frame_decoder& frame_decoder::operator=(frame_decoder&& other) noexcept
+    = default;
+
+frame_decoder::~frame_decoder() = default;
+
+Result<void, std::string>
+frame_decoder::decode(packet_tail_block& ptb)
+{
+    if (!(ptb.ptb_flags & TFF_DEFLATE)) {
+        return Ok();
+    }
+
+    auto& zs = this->fd_impl->i_stream;
+    if (!this->fd_impl->i_initialized) {
+        if (inflateInit(&zs) != Z_OK) {
+            return Err(std::string("unable to initialize inflate"));
+        }
+        this->fd_impl->i_initialized = true;
+    }
+
+    std::vector<uint8_t> out;
+
+    // The frames are flushed at the end, so all of the input is consumed.
+    out.resize(std::max(ptb.ptb_bits.size() * 4, size_t{4096}));
+    zs.next_in = ptb.ptb_bits.data();
+    zs.avail_in = ptb.ptb_bits.size();
+    size_t out_len = 0;
+    while (zs.avail_in > 0 || out_len == out.size()) {
+        if (out_len == out.size()) {
+            out.resize(out.size() * 2);
+        }
+        zs.next_out = &out[out_len];
+        zs.avail_out = out.size() - out_len;
+
+        auto rc = inflate(&zs, Z_SYNC_FLUSH);
+        out_len = out.size() - zs.avail_out;
+        if (rc == Z_BUF_ERROR) {
+            break;
+        }
+        if (rc != Z_OK) {
+            return Err(fmt::format(FMT_STRING("unable to inflate frame: {}"),
+                                   zs.msg != nullptr ? zs.msg : "unknown"));
+        }
+    }
+    out.resize(out_len);
+    ptb.ptb_bits = std::move(out);
+
+    return Ok();
+}
+
 }  // namespace tailer
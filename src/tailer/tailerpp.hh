@@ -30,6 +30,7 @@
 #ifndef lnav_tailerpp_hh
 #define lnav_tailerpp_hh
 
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -75,11 +76,25 @@ struct packet_offer_block {
     hash_frag pob_hash;
 };
 
+struct packet_capabilities {
+    std::string pc_features;
+
+    bool has_feature(const char* name) const;
+};
+
+/**
+ * A block of a remote file, from either a TPT_TAIL_BLOCK or a TPT_TAIL_FRAME
+ * packet.
+ */
 struct packet_tail_block {
     std::string ptb_root_path;
     std::string ptb_path;
     int64_t ptb_mtime;
     int64_t ptb_offset;
+    /** The number of bytes of the remote file covered by this block. */
+    int64_t ptb_length{0};
+    /** The tailer_frame_flags_t for the block. */
+    int64_t ptb_flags{0};
     std::vector<uint8_t> ptb_bits;
 };
 
@@ -112,6 +127,7 @@ struct packet_possible_path {
 
 using packet = mapbox::util::variant<packet_eof,
                                      packet_announce,
+                                     packet_capabilities,
                                      packet_error,
                                      packet_offer_block,
                                      packet_tail_block,
@@ -310,6 +326,34 @@ read_payloads_into(int fd, std::string& str, Ts&... args)
 
 Result<packet, std::string> read_packet(int fd);
 
+/**
+ * Decodes the payloads of the TPT_TAIL_FRAME packets received over a
+ * connection.  The compressed frames are chunks of a single deflate stream,
+ * so one decoder must see all of the frames in order.
+ */
+class frame_decoder {
+public:
+    frame_decoder();
+
+    frame_decoder(const frame_decoder&) = delete;
+    frame_decoder(frame_decoder&& other) noexcept;
+
+    ~frame_decoder();
+
+    frame_decoder& operator=(const frame_decoder&) = delete;
+    frame_decoder& operator=(frame_decoder&& other) noexcept;
+
+    /**
+     * Replace the bits of the block with the decoded data.
+     */
+    Result<void, std::string> decode(packet_tail_block& ptb);
+
+private:
+    struct impl;
+
+    std::unique_ptr<impl> fd_impl;
+};
+
 }  // namespace tailer
 
 #endif
@@ -48,3 +48,37 @@ tailer stderr:
 info: monitoring path: foo
 info: exiting...
 EOF
+
+run_test ./drive_tailer tail ${test_dir}/logfile_access_log.0
+
+check_output "compressed tail of file failed?" <<EOF
+capabilities: deflate prefilter
+Got an offer: {test_dir}/logfile_access_log.0  0 - 351
+tail of file: {test_dir}/logfile_access_log.0 0/351
+192.168.202.254 - - [20/Jul/2009:22:59:26 +0000] "GET /vmw/cgi/tramp HTTP/1.0" 200 134 "-" "gPXE/0.9.7"
+192.168.202.254 - - [20/Jul/2009:22:59:29 +0000] "GET /vmw/vSphere/default/vmkboot.gz HTTP/1.0" 404 46210 "-" "gPXE/0.9.7"
+192.168.202.254 - - [20/Jul/2009:22:59:29 +0000] "GET /vmw/vSphere/default/vmkernel.gz HTTP/1.0" 200 78929 "-" "gPXE/0.9.7"
+synced: {test_dir}/logfile_access_log.0 -- compressed yes
+all done!
+tailer stderr:
+info: compressing tail blocks
+info: monitoring path: {test_dir}/logfile_access_log.0
+info: prepping offer: init=351; remaining=0; {test_dir}/logfile_access_log.0
+info: client is tailing: {test_dir}/logfile_access_log.0
+info: exiting...
+EOF
+
+run_test ./drive_tailer tail ${test_dir}/logfile_access_log.0 vmkboot
+
+check_output "prefiltered tail of file failed?" <<EOF
+capabilities: deflate prefilter
+tail of file: {test_dir}/logfile_access_log.0 0/351 (filtered)
+192.168.202.254 - - [20/Jul/2009:22:59:29 +0000] "GET /vmw/vSphere/default/vmkboot.gz HTTP/1.0" 404 46210 "-" "gPXE/0.9.7"
+synced: {test_dir}/logfile_access_log.0 -- compressed yes
+all done!
+tailer stderr:
+info: compressing tail blocks
+info: prefiltering lines with: vmkboot
+info: monitoring path: {test_dir}/logfile_access_log.0
+info: exiting...
+EOF
@@ -430,7 +430,7 @@ textfile_sub_source::text_filters_changed()
     }
 
     auto* lfo = (line_filter_observer*) lf->get_logline_observer();
-    uint32_t filter_in_mask, filter_out_mask;
+    filter_mask_t filter_in_mask, filter_out_mask;
 
     lfo->clear_deleted_filter_state();
     lf->reobserve_from(lf->begin() + lfo->get_min_count(lf->size()));
@@ -521,7 +521,7 @@ textfile_sub_source::get_filtered_count_for(size_t filter_index) const
     }
 
     auto* lfo = dynamic_cast<line_filter_observer*>(lf->get_logline_observer());
-    return lfo->lfo_filter_state.tfs_filter_hits[filter_index];
+    return lfo->lfo_filter_state.get_filter_hits(filter_index);
 }
 
 text_format_t
@@ -880,7 +880,7 @@ textfile_sub_source::rescan_files(textfile_sub_source::scan_callback& callback,
                 }
             }
 
-            uint32_t filter_in_mask, filter_out_mask;
+            filter_mask_t filter_in_mask, filter_out_mask;
 
             this->get_filters().get_enabled_mask(filter_in_mask,
                                                  filter_out_mask);
@@ -1603,13 +1603,26 @@ textinput_curses::apply_highlights()
         return;
     }
 
+    if (!this->tc_highlight_prefilter.is_for(this->tc_highlights)) {
+        this->tc_highlight_prefilter.rebuild(this->tc_highlights);
+    }
+
     for (auto& line : this->tc_lines) {
+        const auto& str = line.get_string();
+        size_t hl_index = 0;
+
+        this->tc_highlight_prefilter.start_line(string_fragment::from_str_range(
+            str, 0, std::min(size_t{8192}, str.size())));
         for (const auto& hl_pair : this->tc_highlights) {
             const auto& hl = hl_pair.second;
+            auto index = hl_index++;
 
             if (!hl.applies_to_format(this->tc_text_format)) {
                 continue;
             }
+            if (!this->tc_highlight_prefilter.may_match(index)) {
+                continue;
+            }
             hl.annotate(line, line_range{0, -1});
         }
     }
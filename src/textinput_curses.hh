@@ -480,6 +480,7 @@ public:
     std::map<input_point, lnav::console::user_message> tc_marks;
     lnav::document::metadata tc_doc_meta;
     highlight_map_t tc_highlights;
+    highlight_prefilter tc_highlight_prefilter;
     attr_line_t tc_prefix;
 
     std::string tc_suggestion;
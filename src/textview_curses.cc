@@ -51,6 +51,8 @@ constexpr auto REVERSE_SEARCH_OFFSET = 2000_vl;
 void
 text_filter::revert_to_last(logfile_filter_state& lfs, size_t rollback_size)
 {
+    lfs.ensure_filter_capacity(this->lf_index + 1);
+
     require(lfs.tfs_lines_for_message[this->lf_index] == 0);
 
     lfs.tfs_message_matched[this->lf_index]
@@ -66,7 +68,7 @@ text_filter::revert_to_last(logfile_filter_state& lfs, size_t rollback_size)
         lfs.tfs_filter_count[this->lf_index] -= 1;
         size_t line_number = lfs.tfs_filter_count[this->lf_index];
 
-        lfs.tfs_mask[line_number] &= ~(((uint32_t) 1) << this->lf_index);
+        lfs.set_line_match(line_number, this->lf_index, false);
     }
     if (lfs.tfs_lines_for_message[this->lf_index] > 0) {
         require(lfs.tfs_lines_for_message[this->lf_index] >= rollback_size);
@@ -83,24 +85,33 @@ text_filter::add_line(logfile_filter_state& lfs,
                       logfile::const_iterator ll,
                       const shared_buffer_ref& line)
 {
+    auto retval = this->matches(line_source{*lfs.tfs_logfile, ll}, line);
+
+    this->add_match(lfs, ll, retval);
+
+    return retval;
+}
+
+void
+text_filter::add_match(logfile_filter_state& lfs,
+                       logfile::const_iterator ll,
+                       bool matched)
+{
+    lfs.ensure_filter_capacity(this->lf_index + 1);
+
     if (ll->is_message()) {
         this->end_of_message(lfs);
     }
-    auto retval = this->matches(line_source{*lfs.tfs_logfile, ll}, line);
 
     lfs.tfs_message_matched[this->lf_index]
-        = lfs.tfs_message_matched[this->lf_index] || retval;
+        = lfs.tfs_message_matched[this->lf_index] || matched;
     lfs.tfs_lines_for_message[this->lf_index] += 1;
-
-    return retval;
 }
 
 void
 text_filter::end_of_message(logfile_filter_state& lfs)
 {
-    uint32_t mask = 0;
-
-    mask = ((uint32_t) 1U << this->lf_index);
+    lfs.ensure_filter_capacity(this->lf_index + 1);
 
     for (size_t lpc = 0; lpc < lfs.tfs_lines_for_message[this->lf_index]; lpc++)
     {
@@ -109,11 +120,9 @@ text_filter::end_of_message(logfile_filter_state& lfs)
 
         size_t line_number = lfs.tfs_filter_count[this->lf_index];
 
-        if (lfs.tfs_message_matched[this->lf_index]) {
-            lfs.tfs_mask[line_number] |= mask;
-        } else {
-            lfs.tfs_mask[line_number] &= ~mask;
-        }
+        lfs.set_line_match(line_number,
+                           this->lf_index,
+                           lfs.tfs_message_matched[this->lf_index]);
         lfs.tfs_filter_count[this->lf_index] += 1;
         if (lfs.tfs_message_matched[this->lf_index]) {
             lfs.tfs_filter_hits[this->lf_index] += 1;
@@ -206,6 +215,8 @@ textview_curses::reload_config(error_reporter& reporter)
     const static auto DEFAULT_THEME_NAME = std::string("default");
     const auto& vc = view_colors::singleton();
 
+    this->invalidate_highlight_cache();
+
     for (auto iter = this->tc_highlights.begin();
          iter != this->tc_highlights.end();)
     {
@@ -335,17 +346,10 @@ textview_curses::grep_begin(grep_proc<vis_line_t>& gp,
                 this->tc_sub_source->text_mark(&BM_SEARCH, *mark_iter, false);
             }
         }
-        if (pair.first != pair.second) {
-            auto to_del = std::vector<vis_line_t>{};
-            for (auto file_iter = pair.first; file_iter != pair.second;
-                 ++file_iter)
-            {
-                to_del.emplace_back(*file_iter);
-            }
-
-            for (auto cl : to_del) {
-                search_bv.bv_tree.erase(cl);
-            }
+        if (stop == -1_vl) {
+            search_bv.erase_range(start, vis_line_t(INT_MAX));
+        } else {
+            search_bv.erase_range(start, stop + 1_vl);
         }
     }
 
@@ -808,7 +812,54 @@ textview_curses::apply_highlights(attr_line_t& al,
     if (source_format == text_format_t::TF_BINARY) {
         return;
     }
+
+    if (!this->tc_highlight_prefilter.is_for(this->tc_highlights)) {
+        this->tc_highlight_prefilter.rebuild(this->tc_highlights);
+        this->invalidate_highlight_cache();
+    }
+
+    // The highlighters only depend on the text, the ranges, the format and
+    // the existing style attributes that they might overlap with.
+    const auto& str = al.get_string();
+    auto& sa = al.get_attrs();
+    auto line_hasher = hasher();
+    line_hasher.update(str)
+        .update(body.lr_start)
+        .update(body.lr_end)
+        .update(orig_line.lr_start)
+        .update(orig_line.lr_end)
+        .update(format_name.to_string_fragment())
+        .update((int64_t) source_format);
+    for (const auto& attr : sa) {
+        if (attr.sa_range.lr_end == -1) {
+            continue;
+        }
+        if (attr.sa_type == &VC_STYLE || attr.sa_type == &VC_ROLE
+            || attr.sa_type == &VC_FOREGROUND || attr.sa_type == &VC_BACKGROUND)
+        {
+            line_hasher.update(attr.sa_range.lr_start)
+                .update(attr.sa_range.lr_end)
+                .update((int64_t) (uintptr_t) attr.sa_type);
+        }
+    }
+    const auto cache_key = line_hasher.to_array();
+    auto cached = this->tc_highlight_cache.get(cache_key);
+    if (cached) {
+        this->tc_highlight_cache_stats.hcs_hits += 1;
+        sa.insert(sa.end(), cached->begin(), cached->end());
+        return;
+    }
+    this->tc_highlight_cache_stats.hcs_misses += 1;
+    const auto attrs_before = sa.size();
+
+    // Highlighters do not look past the first 8K of the line, so there is
+    // no need to scan past that for literals.
+    this->tc_highlight_prefilter.start_line(string_fragment::from_str_range(
+        str, 0, std::min(size_t{8192}, str.size())));
+
+    size_t hl_index = 0;
     for (const auto& tc_highlight : this->tc_highlights) {
+        auto index = hl_index++;
         bool internal_hl
             = tc_highlight.first.first == highlight_source_t::INTERNAL
             || tc_highlight.first.first == highlight_source_t::THEME;
@@ -827,6 +878,10 @@ textview_curses::apply_highlights(attr_line_t& al,
             continue;
         }
 
+        if (!this->tc_highlight_prefilter.may_match(index)) {
+            continue;
+        }
+
         // Internal highlights should only apply to the log message body so
         // that we don't start highlighting other fields.  User-provided
         // highlights should apply only to the line itself and not any of
@@ -835,6 +890,21 @@ textview_curses::apply_highlights(attr_line_t& al,
         auto lr = internal_hl ? body : orig_line;
         tc_highlight.second.annotate(al, lr);
     }
+
+    this->tc_highlight_cache.put(
+        cache_key,
+        std::vector<string_attr>(std::next(sa.begin(), attrs_before),
+                                 sa.end()));
+}
+
+void
+textview_curses::log_state()
+{
+    listview_curses::log_state();
+    log_debug("  highlight cache: hits=%zu; misses=%zu; size=%zu",
+              this->tc_highlight_cache_stats.hcs_hits,
+              this->tc_highlight_cache_stats.hcs_misses,
+              this->tc_highlight_cache.size());
 }
 
 void
@@ -1211,12 +1281,106 @@ empty_filter::to_command() const
     return "";
 }
 
-std::optional<size_t>
+combined_filter_matcher::combined_filter_matcher(
+    std::vector<std::shared_ptr<pcre_filter>> filters)
+{
+    static constexpr size_t MAX_LITERALS_PER_FILTER = 3;
+
+    this->cfm_entries.reserve(filters.size());
+    for (auto& pf : filters) {
+        auto lits = pf->get_code()->get_required_literals();
+
+        std::stable_sort(lits.begin(),
+                         lits.end(),
+                         [](const auto& lhs, const auto& rhs) {
+                             return lhs.size() > rhs.size();
+                         });
+
+        entry ent;
+        ent.e_filter = std::move(pf);
+        for (const auto& lit : lits) {
+            if (ent.e_literals.size() >= MAX_LITERALS_PER_FILTER
+                || lit.size() < 2)
+            {
+                break;
+            }
+            ent.e_literals.emplace_back(
+                this->cfm_literals.add(string_fragment::from_str(lit)));
+        }
+        this->cfm_entries.emplace_back(std::move(ent));
+    }
+    this->cfm_literals.compile();
+
+    for (const auto& ent : this->cfm_entries) {
+        auto index = ent.e_filter->get_index();
+
+        if (index >= this->cfm_by_index.size()) {
+            this->cfm_by_index.resize(index + 1);
+        }
+        this->cfm_by_index[index] = &ent;
+    }
+}
+
+bool
+combined_filter_matcher::same_filters(
+    const std::vector<std::shared_ptr<pcre_filter>>& filters) const
+{
+    if (filters.size() != this->cfm_entries.size()) {
+        return false;
+    }
+
+    for (size_t lpc = 0; lpc < filters.size(); lpc++) {
+        if (filters[lpc] != this->cfm_entries[lpc].e_filter) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void
+combined_filter_matcher::match(string_fragment line,
+                               const filter_mask_t& needed,
+                               std::vector<bool>& literal_hits,
+                               filter_mask_t& hits_out) const
+{
+    auto scanned = false;
+
+    hits_out.clear();
+    for (const auto& ent : this->cfm_entries) {
+        auto index = ent.e_filter->get_index();
+
+        if (!needed.test(index)) {
+            continue;
+        }
+
+        if (!ent.e_literals.empty()) {
+            if (!scanned) {
+                this->cfm_literals.find_all(line, literal_hits);
+                scanned = true;
+            }
+
+            auto has_literals = std::all_of(
+                ent.e_literals.begin(),
+                ent.e_literals.end(),
+                [&literal_hits](auto id) { return literal_hits[id]; });
+            if (!has_literals) {
+                continue;
+            }
+        }
+
+        if (ent.e_filter->get_code()->find_in(line).ignore_error().has_value())
+        {
+            hits_out.set(index);
+        }
+    }
+}
+
+size_t
 filter_stack::next_index()
 {
-    bool used[32];
+    std::vector<bool> used(this->index_limit());
 
-    memset(used, 0, sizeof(used));
     for (auto& iter : *this) {
         if (iter->lf_deleted) {
             continue;
@@ -1228,15 +1392,27 @@ filter_stack::next_index()
 
         used[index] = true;
     }
-    for (size_t lpc = this->fs_reserved;
-         lpc < logfile_filter_state::MAX_FILTERS;
-         lpc++)
-    {
+    for (size_t lpc = this->fs_reserved; lpc < used.size(); lpc++) {
         if (!used[lpc]) {
             return lpc;
         }
     }
-    return std::nullopt;
+    return std::max(this->fs_reserved, used.size());
+}
+
+size_t
+filter_stack::index_limit() const
+{
+    size_t retval = 0;
+
+    for (const auto& iter : *this) {
+        if (iter->lf_deleted) {
+            continue;
+        }
+        retval = std::max(retval, iter->get_index() + 1);
+    }
+
+    return retval;
 }
 
 std::shared_ptr<text_filter>
@@ -1271,9 +1447,9 @@ filter_stack::delete_filter(const std::string& id)
 }
 
 void
-filter_stack::get_mask(uint32_t& filter_mask)
+filter_stack::get_mask(filter_mask_t& filter_mask)
 {
-    filter_mask = 0;
+    filter_mask.clear();
     for (auto& iter : *this) {
         std::shared_ptr<text_filter> tf = iter;
 
@@ -1281,12 +1457,10 @@ filter_stack::get_mask(uint32_t& filter_mask)
             continue;
         }
         if (tf->is_enabled()) {
-            uint32_t bit = (1UL << tf->get_index());
-
             switch (tf->get_type()) {
                 case text_filter::EXCLUDE:
                 case text_filter::INCLUDE:
-                    filter_mask |= bit;
+                    filter_mask.set(tf->get_index());
                     break;
                 default:
                     ensure(0);
@@ -1297,10 +1471,11 @@ filter_stack::get_mask(uint32_t& filter_mask)
 }
 
 void
-filter_stack::get_enabled_mask(uint32_t& filter_in_mask,
-                               uint32_t& filter_out_mask)
+filter_stack::get_enabled_mask(filter_mask_t& filter_in_mask,
+                               filter_mask_t& filter_out_mask)
 {
-    filter_in_mask = filter_out_mask = 0;
+    filter_in_mask.clear();
+    filter_out_mask.clear();
     for (auto& iter : *this) {
         std::shared_ptr<text_filter> tf = iter;
 
@@ -1308,14 +1483,12 @@ filter_stack::get_enabled_mask(uint32_t& filter_in_mask,
             continue;
         }
         if (tf->is_enabled()) {
-            uint32_t bit = (1UL << tf->get_index());
-
             switch (tf->get_type()) {
                 case text_filter::EXCLUDE:
-                    filter_out_mask |= bit;
+                    filter_out_mask.set(tf->get_index());
                     break;
                 case text_filter::INCLUDE:
-                    filter_in_mask |= bit;
+                    filter_in_mask.set(tf->get_index());
                     break;
                 default:
                     ensure(0);
@@ -1325,6 +1498,32 @@ filter_stack::get_enabled_mask(uint32_t& filter_in_mask,
     }
 }
 
+std::shared_ptr<const combined_filter_matcher>
+filter_stack::get_matcher()
+{
+    std::vector<std::shared_ptr<pcre_filter>> filters;
+
+    for (const auto& tf : this->fs_filters) {
+        if (tf->lf_deleted) {
+            continue;
+        }
+        auto pf = std::dynamic_pointer_cast<pcre_filter>(tf);
+        if (pf != nullptr) {
+            filters.emplace_back(std::move(pf));
+        }
+    }
+
+    std::lock_guard<std::mutex> lg(this->fs_matcher_mutex);
+
+    if (this->fs_matcher == nullptr || !this->fs_matcher->same_filters(filters))
+    {
+        this->fs_matcher
+            = std::make_shared<combined_filter_matcher>(std::move(filters));
+    }
+
+    return this->fs_matcher;
+}
+
 void
 filter_stack::add_filter(const std::shared_ptr<text_filter>& filter)
 {
@@ -1415,16 +1614,6 @@ text_sub_source::text_crumbs_for_line(int line,
 logfile_filter_state::logfile_filter_state(std::shared_ptr<logfile> lf)
     : tfs_logfile(std::move(lf))
 {
-    memset(this->tfs_filter_count, 0, sizeof(this->tfs_filter_count));
-    memset(this->tfs_filter_hits, 0, sizeof(this->tfs_filter_hits));
-    memset(this->tfs_message_matched, 0, sizeof(this->tfs_message_matched));
-    memset(this->tfs_lines_for_message, 0, sizeof(this->tfs_lines_for_message));
-    memset(this->tfs_last_message_matched,
-           0,
-           sizeof(this->tfs_last_message_matched));
-    memset(this->tfs_last_lines_for_message,
-           0,
-           sizeof(this->tfs_last_lines_for_message));
     this->tfs_mask.reserve(64 * 1024);
 }
 
@@ -1432,23 +1621,24 @@ void
 logfile_filter_state::clear()
 {
     this->tfs_logfile = nullptr;
-    memset(this->tfs_filter_count, 0, sizeof(this->tfs_filter_count));
-    memset(this->tfs_filter_hits, 0, sizeof(this->tfs_filter_hits));
-    memset(this->tfs_message_matched, 0, sizeof(this->tfs_message_matched));
-    memset(this->tfs_lines_for_message, 0, sizeof(this->tfs_lines_for_message));
-    memset(this->tfs_last_message_matched,
-           0,
-           sizeof(this->tfs_last_message_matched));
-    memset(this->tfs_last_lines_for_message,
-           0,
-           sizeof(this->tfs_last_lines_for_message));
+    this->tfs_filter_count.clear();
+    this->tfs_filter_hits.clear();
+    this->tfs_message_matched.clear();
+    this->tfs_lines_for_message.clear();
+    this->tfs_last_message_matched.clear();
+    this->tfs_last_lines_for_message.clear();
     this->tfs_mask.clear();
+    this->tfs_mask_stride = 1;
     this->tfs_index.clear();
 }
 
 void
 logfile_filter_state::clear_filter_state(size_t index)
 {
+    if (index >= this->tfs_filter_count.size()) {
+        return;
+    }
+
     this->tfs_filter_count[index] = 0;
     this->tfs_filter_hits[index] = 0;
     this->tfs_message_matched[index] = false;
@@ -1458,35 +1648,74 @@ logfile_filter_state::clear_filter_state(size_t index)
 }
 
 void
-logfile_filter_state::clear_deleted_filter_state(uint32_t used_mask)
+logfile_filter_state::clear_deleted_filter_state(const filter_mask_t& used_mask)
 {
-    for (int lpc = 0; lpc < MAX_FILTERS; lpc++) {
-        if (!(used_mask & (1L << lpc))) {
+    for (size_t lpc = 0; lpc < this->tfs_filter_count.size(); lpc++) {
+        if (!used_mask.test(lpc)) {
             this->clear_filter_state(lpc);
         }
     }
     for (size_t lpc = 0; lpc < this->tfs_mask.size(); lpc++) {
-        this->tfs_mask[lpc] &= used_mask;
+        this->tfs_mask[lpc] &= used_mask.word(lpc % this->tfs_mask_stride);
     }
 }
 
 void
-logfile_filter_state::resize(size_t newsize)
+logfile_filter_state::ensure_filter_capacity(size_t count)
+{
+    if (count <= this->tfs_filter_count.size()) {
+        return;
+    }
+
+    this->tfs_filter_count.resize(count);
+    this->tfs_filter_hits.resize(count);
+    this->tfs_message_matched.resize(count);
+    this->tfs_lines_for_message.resize(count);
+    this->tfs_last_message_matched.resize(count);
+    this->tfs_last_lines_for_message.resize(count);
+
+    auto new_stride = filter_mask_t::words_for(count);
+    if (new_stride <= this->tfs_mask_stride) {
+        return;
+    }
+
+    auto line_count = this->tfs_mask.size() / this->tfs_mask_stride;
+    std::vector<filter_mask_t::word_t> new_mask(line_count * new_stride);
+
+    for (size_t line = 0; line < line_count; line++) {
+        std::copy_n(&this->tfs_mask[line * this->tfs_mask_stride],
+                    this->tfs_mask_stride,
+                    &new_mask[line * new_stride]);
+    }
+    this->tfs_mask = std::move(new_mask);
+    this->tfs_mask_stride = new_stride;
+}
+
+void
+logfile_filter_state::set_line_match(size_t line, size_t index, bool matched)
 {
-    size_t old_mask_size = this->tfs_mask.size();
+    auto& word = this->tfs_mask[line * this->tfs_mask_stride
+                                + index / filter_mask_t::BITS_PER_WORD];
+    auto bit = filter_mask_t::word_t{1}
+        << (index % filter_mask_t::BITS_PER_WORD);
 
-    this->tfs_mask.resize(newsize);
-    if (newsize > old_mask_size) {
-        memset(&this->tfs_mask[old_mask_size],
-               0,
-               sizeof(uint32_t) * (newsize - old_mask_size));
+    if (matched) {
+        word |= bit;
+    } else {
+        word &= ~bit;
     }
 }
 
+void
+logfile_filter_state::resize(size_t newsize)
+{
+    this->tfs_mask.resize(newsize * this->tfs_mask_stride);
+}
+
 void
 logfile_filter_state::reserve(size_t expected)
 {
-    this->tfs_mask.reserve(expected);
+    this->tfs_mask.reserve(expected * this->tfs_mask_stride);
 }
 
 std::optional<size_t>
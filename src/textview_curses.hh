@@ -32,10 +32,14 @@
 #ifndef textview_curses_hh
 #define textview_curses_hh
 
+#include <algorithm>
+#include <mutex>
 #include <utility>
 #include <vector>
 
+#include "base/aho_corasick.hh"
 #include "base/func_util.hh"
+#include "base/lrucache.hpp"
 #include "base/lnav_log.hh"
 #include "bookmarks.hh"
 #include "breadcrumb.hh"
@@ -55,6 +59,62 @@ class textview_curses;
 
 using vis_bookmarks = bookmarks<vis_line_t>::type;
 
+/**
+ * Set of filter indexes that grows to fit the highest index that is set.
+ */
+class filter_mask_t {
+public:
+    using word_t = uint64_t;
+
+    static constexpr size_t BITS_PER_WORD = sizeof(word_t) * 8;
+
+    static size_t words_for(size_t bits)
+    {
+        return (bits + BITS_PER_WORD - 1) / BITS_PER_WORD;
+    }
+
+    void set(size_t index)
+    {
+        auto word = index / BITS_PER_WORD;
+
+        if (word >= this->fm_words.size()) {
+            this->fm_words.resize(word + 1);
+        }
+        this->fm_words[word] |= word_t{1} << (index % BITS_PER_WORD);
+    }
+
+    bool test(size_t index) const
+    {
+        auto word = index / BITS_PER_WORD;
+
+        return word < this->fm_words.size()
+            && (this->fm_words[word] & (word_t{1} << (index % BITS_PER_WORD)))
+            != 0;
+    }
+
+    bool none() const
+    {
+        for (const auto word : this->fm_words) {
+            if (word != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void clear() { this->fm_words.clear(); }
+
+    size_t word_count() const { return this->fm_words.size(); }
+
+    word_t word(size_t index) const
+    {
+        return index < this->fm_words.size() ? this->fm_words[index] : 0;
+    }
+
+private:
+    std::vector<word_t> fm_words;
+};
+
 class logfile_filter_state {
 public:
     logfile_filter_state(std::shared_ptr<logfile> lf = nullptr);
@@ -63,7 +123,13 @@ public:
 
     void clear_filter_state(size_t index);
 
-    void clear_deleted_filter_state(uint32_t used_mask);
+    void clear_deleted_filter_state(const filter_mask_t& used_mask);
+
+    /**
+     * Make room for the state of filters with indexes less than the given
+     * count.
+     */
+    void ensure_filter_capacity(size_t count);
 
     void resize(size_t newsize);
 
@@ -71,16 +137,73 @@ public:
 
     std::optional<size_t> content_line_to_vis_line(uint32_t line);
 
-    const static int MAX_FILTERS = 32;
+    size_t get_filter_count(size_t index) const
+    {
+        return index < this->tfs_filter_count.size()
+            ? this->tfs_filter_count[index]
+            : 0;
+    }
+
+    int get_filter_hits(size_t index) const
+    {
+        return index < this->tfs_filter_hits.size()
+            ? this->tfs_filter_hits[index]
+            : 0;
+    }
+
+    /** @return True if any filter matched the given line. */
+    bool line_has_match(size_t line) const
+    {
+        const auto* words = &this->tfs_mask[line * this->tfs_mask_stride];
+
+        for (size_t lpc = 0; lpc < this->tfs_mask_stride; lpc++) {
+            if (words[lpc] != 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool line_matches(size_t line, size_t index) const
+    {
+        auto word = index / filter_mask_t::BITS_PER_WORD;
+
+        return word < this->tfs_mask_stride
+            && (this->tfs_mask[line * this->tfs_mask_stride + word]
+                & (filter_mask_t::word_t{1}
+                   << (index % filter_mask_t::BITS_PER_WORD)))
+            != 0;
+    }
+
+    /** @return True if any filter in the mask matched the given line. */
+    bool line_intersects(size_t line, const filter_mask_t& mask) const
+    {
+        const auto* words = &this->tfs_mask[line * this->tfs_mask_stride];
+        auto count = std::min(this->tfs_mask_stride, mask.word_count());
+
+        for (size_t lpc = 0; lpc < count; lpc++) {
+            if (words[lpc] & mask.word(lpc)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void set_line_match(size_t line, size_t index, bool matched);
 
     std::shared_ptr<logfile> tfs_logfile;
-    size_t tfs_filter_count[MAX_FILTERS];
-    int tfs_filter_hits[MAX_FILTERS];
-    bool tfs_message_matched[MAX_FILTERS];
-    size_t tfs_lines_for_message[MAX_FILTERS];
-    bool tfs_last_message_matched[MAX_FILTERS];
-    size_t tfs_last_lines_for_message[MAX_FILTERS];
-    std::vector<uint32_t> tfs_mask;
+    std::vector<size_t> tfs_filter_count;
+    std::vector<int> tfs_filter_hits;
+    std::vector<bool> tfs_message_matched;
+    std::vector<size_t> tfs_lines_for_message;
+    std::vector<bool> tfs_last_message_matched;
+    std::vector<size_t> tfs_last_lines_for_message;
+    /**
+     * The filter bits for each line, stored as tfs_mask_stride words per
+     * line.  The stride is widened as filters with higher indexes are added.
+     */
+    std::vector<filter_mask_t::word_t> tfs_mask;
+    size_t tfs_mask_stride{1};
     std::vector<uint32_t> tfs_index;
 };
 
@@ -121,6 +244,14 @@ public:
                   logfile_const_iterator ll,
                   const shared_buffer_ref& line);
 
+    /**
+     * Record the result of matching this filter against a line that was
+     * evaluated elsewhere, like in a combined_filter_matcher.
+     */
+    void add_match(logfile_filter_state& lfs,
+                   logfile_const_iterator ll,
+                   bool matched);
+
     void end_of_message(logfile_filter_state& lfs);
 
     struct line_source {
@@ -187,10 +318,63 @@ public:
             + this->lf_id;
     }
 
+    const std::shared_ptr<lnav::pcre2pp::code>& get_code() const
+    {
+        return this->pf_pcre;
+    }
+
 protected:
     std::shared_ptr<lnav::pcre2pp::code> pf_pcre;
 };
 
+/**
+ * Evaluates the regex filters in a filter_stack together.  The literals
+ * that each pattern requires are found with a single multi-literal scan
+ * over the line and only the patterns whose literals are all present are
+ * confirmed with the regex engine.
+ */
+class combined_filter_matcher {
+public:
+    explicit combined_filter_matcher(
+        std::vector<std::shared_ptr<pcre_filter>> filters);
+
+    /** @return True if the given filter is evaluated by this matcher. */
+    bool covers(const text_filter& tf) const
+    {
+        auto index = tf.get_index();
+
+        return index < this->cfm_by_index.size()
+            && this->cfm_by_index[index] != nullptr
+            && this->cfm_by_index[index]->e_filter.get() == &tf;
+    }
+
+    /**
+     * Match a line against the filters.
+     *
+     * @param line The line content.
+     * @param needed The indexes of the filters that need to be evaluated.
+     * @param literal_hits Scratch space for the literal scan.
+     * @param hits_out Receives the indexes of the filters that matched.
+     */
+    void match(string_fragment line,
+               const filter_mask_t& needed,
+               std::vector<bool>& literal_hits,
+               filter_mask_t& hits_out) const;
+
+    bool same_filters(
+        const std::vector<std::shared_ptr<pcre_filter>>& filters) const;
+
+private:
+    struct entry {
+        std::shared_ptr<pcre_filter> e_filter;
+        std::vector<lnav::aho_corasick::literal_id> e_literals;
+    };
+
+    lnav::aho_corasick cfm_literals;
+    std::vector<entry> cfm_entries;
+    std::vector<const entry*> cfm_by_index;
+};
+
 class filter_stack {
 public:
     using iterator = std::vector<std::shared_ptr<text_filter>>::iterator;
@@ -212,13 +396,10 @@ public:
 
     bool empty() const { return this->fs_filters.empty(); };
 
-    bool full() const
-    {
-        return (this->fs_reserved + this->fs_filters.size())
-            == logfile_filter_state::MAX_FILTERS;
-    }
+    size_t next_index();
 
-    std::optional<size_t> next_index();
+    /** @return One more than the highest index in use by a filter. */
+    size_t index_limit() const;
 
     void add_filter(const std::shared_ptr<text_filter>& filter);
 
@@ -245,15 +426,25 @@ public:
 
     bool delete_filter(const std::string& id);
 
-    void get_mask(uint32_t& filter_mask);
+    void get_mask(filter_mask_t& filter_mask);
 
-    void get_enabled_mask(uint32_t& filter_in_mask, uint32_t& filter_out_mask);
+    void get_enabled_mask(filter_mask_t& filter_in_mask,
+                          filter_mask_t& filter_out_mask);
+
+    /**
+     * Get a matcher for the current regex filters.  The matcher is rebuilt
+     * when the set of filters changes.  This method can be called from
+     * indexing worker threads.
+     */
+    std::shared_ptr<const combined_filter_matcher> get_matcher();
 
     uint32_t fs_generation{0};
 
 private:
     const size_t fs_reserved;
     std::vector<std::shared_ptr<text_filter>> fs_filters;
+    std::mutex fs_matcher_mutex;
+    std::shared_ptr<const combined_filter_matcher> fs_matcher;
 };
 
 class text_time_translator {
@@ -738,13 +929,6 @@ public:
     std::optional<line_info> grep_value_for_line(vis_line_t line,
                                                  std::string& value_out);
 
-    void grep_quiesce()
-    {
-        if (this->tc_sub_source != nullptr) {
-            this->tc_sub_source->quiesce();
-        }
-    }
-
     void grep_begin(grep_proc<vis_line_t>& gp,
                     vis_line_t start,
                     vis_line_t stop);
@@ -775,7 +959,11 @@ public:
         }
     }
 
-    highlight_map_t& get_highlights() { return this->tc_highlights; }
+    highlight_map_t& get_highlights()
+    {
+        this->invalidate_highlight_cache();
+        return this->tc_highlights;
+    }
 
     const highlight_map_t& get_highlights() const
     {
@@ -784,9 +972,28 @@ public:
 
     std::set<highlight_source_t>& get_disabled_highlights()
     {
+        this->invalidate_highlight_cache();
         return this->tc_disabled_highlights;
     }
 
+    struct highlight_cache_stats {
+        size_t hcs_hits{0};
+        size_t hcs_misses{0};
+    };
+
+    const highlight_cache_stats& get_highlight_cache_stats() const
+    {
+        return this->tc_highlight_cache_stats;
+    }
+
+    /**
+     * Drop the highlights cached by apply_highlights().  This is done
+     * automatically when the highlighters or the theme are changed.
+     */
+    void invalidate_highlight_cache() { this->tc_highlight_cache.clear(); }
+
+    void log_state() override;
+
     bool handle_mouse(mouse_event& me);
 
     void reload_data();
@@ -908,6 +1115,9 @@ public:
         tc_on_click;
 
 protected:
+    /** The number of lines whose highlights are cached. */
+    static constexpr size_t HIGHLIGHT_CACHE_SIZE = 1024;
+
     class grep_highlighter {
     public:
         grep_highlighter(std::shared_ptr<grep_proc<vis_line_t>>& gp,
@@ -949,7 +1159,15 @@ protected:
     action tc_search_action;
 
     highlight_map_t tc_highlights;
+    highlight_prefilter tc_highlight_prefilter;
     std::set<highlight_source_t> tc_disabled_highlights;
+    /**
+     * The attributes added by apply_highlights(), keyed by a hash of the
+     * line and of everything else that affects the highlighters.
+     */
+    cache::lru_cache<hasher::array_t, std::vector<string_attr>>
+        tc_highlight_cache{HIGHLIGHT_CACHE_SIZE};
+    highlight_cache_stats tc_highlight_cache_stats;
 
     std::optional<vis_line_t> tc_selection_start;
     mouse_event tc_press_event;
@@ -766,7 +766,8 @@ timeline_source::rebuild_indexes()
             filtered_in_count += 1;
         }
     }
-    this->gs_filter_hits = {};
+    this->gs_filter_hits.clear();
+    this->gs_filter_hits.resize(this->tss_filters.index_limit());
     this->gs_time_order.clear();
     this->gs_time_order.reserve(this->gs_active_opids.size());
     for (auto& pair : this->gs_active_opids) {
@@ -1076,6 +1077,10 @@ timeline_source::get_filtered_count() const
 int
 timeline_source::get_filtered_count_for(size_t filter_index) const
 {
+    if (filter_index >= this->gs_filter_hits.size()) {
+        return 0;
+    }
+
     return this->gs_filter_hits[filter_index];
 }
 
@@ -186,7 +186,7 @@ public:
     timeval gs_lower_bound{};
     timeval gs_upper_bound{};
     size_t gs_filtered_count{0};
-    std::array<size_t, logfile_filter_state::MAX_FILTERS> gs_filter_hits{};
+    std::vector<size_t> gs_filter_hits;
     exec_context* gs_exec_context{nullptr};
     bool gs_preview_focused{false};
     std::vector<row_info> gs_preview_rows;
@@ -0,0 +1,167 @@
+/**
+ * Copyright (c) 2025, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * Micro-benchmark for the UTF-8/newline scanner used by the line_buffer.
+ * Reports the throughput in GB/s of scanning buffers of plain ASCII, mixed
+ * UTF-8, and invalid input with both the bulk line scanner and a per-line
+ * call to is_utf8().
+ */
+
+#include <chrono>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "base/is_utf8.hh"
+#include "config.h"
+
+static std::string
+generate_input(const char* kind, size_t size)
+{
+    static const char* WORDS[] = {
+        "GET",
+        "/api/v1/users",
+        "200",
+        "connection",
+        "established",
+        "timeout=30s",
+        "user=admin",
+        "\t",
+    };
+    static const char* UTF8_WORDS[] = {
+        "caf\xc3\xa9",
+        "\xe2\x9c\x93",
+        "na\xc3\xafve",
+        "\xf0\x9f\x98\x80",
+    };
+
+    std::mt19937 gen(1234);
+    std::string retval;
+
+    retval.reserve(size + 256);
+    while (retval.size() < size) {
+        retval.append("2025-01-01T12:34:56.789Z host app[1234]: ");
+        for (int lpc = 0; lpc < 12; lpc++) {
+            retval.append(WORDS[gen() % 8]);
+            retval.push_back(' ');
+            if (strcmp(kind, "ascii") != 0 && gen() % 4 == 0) {
+                retval.append(UTF8_WORDS[gen() % 4]);
+                retval.push_back(' ');
+            }
+            if (strcmp(kind, "invalid") == 0 && gen() % 16 == 0) {
+                retval.append("\xc3\x28 ");
+            }
+        }
+        retval.push_back('\n');
+    }
+
+    return retval;
+}
+
+template<typename F>
+static double
+measure(const std::string& buf, int iterations, F func)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int lpc = 0; lpc < iterations; lpc++) {
+        func();
+    }
+    auto end = std::chrono::steady_clock::now();
+    std::chrono::duration<double> diff = end - start;
+
+    return ((double) buf.size() * iterations) / diff.count() / 1e9;
+}
+
+int
+main(int argc, char* argv[])
+{
+    size_t size = 64 * 1024 * 1024;
+    int iterations = 5;
+    int c;
+
+    while ((c = getopt(argc, argv, "s:n:")) != -1) {
+        switch (c) {
+            case 's':
+                size = strtoull(optarg, nullptr, 10) * 1024 * 1024;
+                break;
+            case 'n':
+                iterations = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-s size-in-mb] [-n iters]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    for (const auto* kind : {"ascii", "utf8", "invalid"}) {
+        auto buf = generate_input(kind, size);
+        auto frag = string_fragment::from_str(buf);
+        std::vector<uint32_t> starts;
+        std::vector<bool> is_utf;
+        std::vector<bool> has_ansi;
+        size_t lines = 0;
+
+        auto bulk_gbs = measure(buf, iterations, [&]() {
+            starts.clear();
+            is_utf.clear();
+            has_ansi.clear();
+            scan_utf8_lines(frag, starts, is_utf, has_ansi);
+        });
+        auto per_line_gbs = measure(buf, iterations, [&]() {
+            auto remaining = std::make_optional(frag);
+
+            lines = 0;
+            while (remaining && !remaining->empty()) {
+                auto scan_res = is_utf8(remaining.value(), '\n');
+
+                remaining = scan_res.usr_remaining;
+                lines += 1;
+            }
+        });
+
+        printf("%-8s %8zu lines  scan_utf8_lines %6.2f GB/s  is_utf8 %6.2f GB/s\n",
+               kind,
+               starts.size(),
+               bulk_gbs,
+               per_line_gbs);
+        if (starts.size() != lines) {
+            fprintf(stderr, "error: line count mismatch %zu != %zu\n", starts.size(), lines);
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
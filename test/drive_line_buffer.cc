@@ -42,6 +42,8 @@
 #include <unistd.h>
 
 #include "base/auto_fd.hh"
+#include "base/injector.hh"
+#include "base/isc.hh"
 #include "base/string_util.hh"
 #include "config.h"
 #include "line_buffer.hh"
@@ -137,6 +139,9 @@ main(int argc, char* argv[])
         perror("fstat-cmp");
         retval = EXIT_FAILURE;
     } else {
+        // The line_buffer preloads data on the I/O service thread.
+        isc::supervisor root_superv(injector::get<isc::service_list>());
+
         try {
             file_range last_range{offset};
             line_buffer lb;
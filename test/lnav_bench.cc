@@ -0,0 +1,768 @@
+/**
+ * Copyright (c) 2025, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * Benchmark suite for the main data paths: parsing timestamps, reading
+ * lines with the line_buffer, indexing a logfile, merging files in the log
+ * view, searching with grep_proc, scanning the log SQL tables, and rendering
+ * lines.  The input files are generated from a fixed seed so that runs are
+ * comparable.  The results are written as JSON with the rates and the peak
+ * RSS of the process after each benchmark.
+ */
+
+#include <chrono>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <locale.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "base/auto_fd.hh"
+#include "base/injector.bind.hh"
+#include "base/injector.hh"
+#include "base/isc.hh"
+#include "config.h"
+#include "file_options.hh"
+#include "grep_proc.hh"
+#include "line_buffer.hh"
+#include "log_format.hh"
+#include "log_format_loader.hh"
+#include "log_vtab_impl.hh"
+#include "logfile.hh"
+#include "logfile_sub_source.hh"
+#include "ptimec.hh"
+#include "sqlite-extension-func.hh"
+#include "textview_curses.hh"
+#include "view_curses.hh"
+#include "xterm_mouse.hh"
+#include "yajlpp/yajlpp.hh"
+
+static auto bound_file_options_hier
+    = injector::bind<lnav::safe_file_options_hier>::to_singleton();
+static auto bound_xterm_mouse = injector::bind<xterm_mouse>::to_singleton();
+
+namespace {
+
+constexpr time_t BASE_TIME = 1700000000;
+
+const char* const WORDS[] = {
+    "connection", "established", "timeout",  "request", "completed",
+    "user",       "session",     "error",    "retry",   "cache",
+    "miss",       "upstream",    "latency",  "closed",  "worker",
+    "queue",      "flushed",     "snapshot", "db",      "write",
+};
+
+const char* const LEVELS[] = {"info", "info", "info", "warn", "error", "debug"};
+
+std::string
+random_message(std::mt19937& gen)
+{
+    std::string retval;
+    auto word_count = 4 + gen() % 12;
+
+    for (size_t lpc = 0; lpc < word_count; lpc++) {
+        if (lpc > 0) {
+            retval.push_back(' ');
+        }
+        retval.append(WORDS[gen() % std::size(WORDS)]);
+        if (gen() % 5 == 0) {
+            retval.append(fmt::format(FMT_STRING("={}"), gen() % 10000));
+        }
+    }
+
+    return retval;
+}
+
+struct generator {
+    const char* g_name;
+    std::function<void(std::mt19937&, size_t, std::string&)> g_func;
+};
+
+/** The time for a line, ten lines per second. */
+std::pair<struct tm, int>
+line_time(size_t line_number)
+{
+    time_t secs = BASE_TIME + line_number / 10;
+    struct tm tm;
+
+    gmtime_r(&secs, &tm);
+    return {tm, (int) (line_number % 10) * 100};
+}
+
+const generator GENERATORS[] = {
+    {
+        "syslog_log",
+        [](std::mt19937& gen, size_t line_number, std::string& out) {
+            auto [tm, millis] = line_time(line_number);
+            char ts[64];
+
+            strftime(ts, sizeof(ts), "%b %e %H:%M:%S", &tm);
+            out.append(fmt::format(FMT_STRING("{} host{} app{}[{}]: {}\n"),
+                                   ts,
+                                   gen() % 4,
+                                   gen() % 8,
+                                   1000 + gen() % 100,
+                                   random_message(gen)));
+        },
+    },
+    {
+        "access_log",
+        [](std::mt19937& gen, size_t line_number, std::string& out) {
+            static const char* METHODS[] = {"GET", "GET", "POST", "PUT"};
+            static const int STATUSES[] = {200, 200, 200, 304, 404, 500};
+            auto [tm, millis] = line_time(line_number);
+            char ts[64];
+
+            strftime(ts, sizeof(ts), "%d/%b/%Y:%H:%M:%S +0000", &tm);
+            out.append(fmt::format(
+                FMT_STRING("10.0.{}.{} - - [{}] \"{} /api/v1/{}/{} "
+                           "HTTP/1.1\" {} {} \"-\" \"bench/1.0\"\n"),
+                gen() % 256,
+                gen() % 256,
+                ts,
+                METHODS[gen() % std::size(METHODS)],
+                WORDS[gen() % std::size(WORDS)],
+                gen() % 100000,
+                STATUSES[gen() % std::size(STATUSES)],
+                gen() % 50000));
+        },
+    },
+    {
+        "bunyan_log",
+        [](std::mt19937& gen, size_t line_number, std::string& out) {
+            static const int LEVEL_NUMS[] = {30, 30, 30, 40, 50, 20};
+            auto [tm, millis] = line_time(line_number);
+            char ts[64];
+
+            strftime(ts, sizeof(ts), "%Y-%m-%dT%H:%M:%S", &tm);
+            out.append(fmt::format(
+                FMT_STRING("{{\"name\":\"app{}\",\"hostname\":\"host{}\","
+                           "\"pid\":{},\"level\":{},\"msg\":\"{}\","
+                           "\"time\":\"{}.{:03}Z\",\"v\":0}}\n"),
+                gen() % 8,
+                gen() % 4,
+                1000 + gen() % 100,
+                LEVEL_NUMS[gen() % std::size(LEVEL_NUMS)],
+                random_message(gen),
+                ts,
+                millis));
+        },
+    },
+    {
+        "pino_log",
+        [](std::mt19937& gen, size_t line_number, std::string& out) {
+            auto [tm, millis] = line_time(line_number);
+
+            out.append(fmt::format(
+                FMT_STRING("{{\"level\":\"{}\",\"time\":{},\"pid\":{},"
+                           "\"hostname\":\"host{}\",\"msg\":\"{}\"}}\n"),
+                LEVELS[gen() % std::size(LEVELS)],
+                (BASE_TIME + line_number / 10) * 1000 + millis,
+                1000 + gen() % 100,
+                gen() % 4,
+                random_message(gen)));
+        },
+    },
+    {
+        "glog_log",
+        [](std::mt19937& gen, size_t line_number, std::string& out) {
+            static const char LEVEL_CHARS[] = {'I', 'I', 'I', 'W', 'E'};
+            auto [tm, millis] = line_time(line_number);
+            char ts[64];
+
+            strftime(ts, sizeof(ts), "%m%d %H:%M:%S", &tm);
+            out.append(fmt::format(FMT_STRING("{}{}.{:06} {:>5} {}.cc:{}] {}\n"),
+                                   LEVEL_CHARS[gen() % std::size(LEVEL_CHARS)],
+                                   ts,
+                                   millis * 1000,
+                                   1000 + gen() % 100,
+                                   WORDS[gen() % std::size(WORDS)],
+                                   gen() % 1000,
+                                   random_message(gen)));
+        },
+    },
+};
+
+struct bench_result {
+    std::string br_name;
+    std::string br_format;
+    size_t br_lines{0};
+    size_t br_bytes{0};
+    double br_seconds{0};
+    long br_peak_rss_kb{0};
+};
+
+class bench_timer {
+public:
+    bench_timer() : bt_start(std::chrono::steady_clock::now()) {}
+
+    double elapsed() const
+    {
+        std::chrono::duration<double> diff
+            = std::chrono::steady_clock::now() - this->bt_start;
+
+        return diff.count();
+    }
+
+private:
+    std::chrono::steady_clock::time_point bt_start;
+};
+
+long
+peak_rss_kb()
+{
+    struct rusage ru;
+
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_maxrss;
+}
+
+/**
+ * Record the result along with the peak RSS so far and report the progress
+ * on stderr.
+ */
+void
+add_result(std::vector<bench_result>& results, bench_result br)
+{
+    br.br_peak_rss_kb = peak_rss_kb();
+    fprintf(stderr,
+            "%-34s %-12s %9zu lines %8.3fs %12.0f lines/s\n",
+            br.br_name.c_str(),
+            br.br_format.c_str(),
+            br.br_lines,
+            br.br_seconds,
+            br.br_seconds > 0 ? br.br_lines / br.br_seconds : 0.0);
+    results.emplace_back(std::move(br));
+}
+
+class count_sink : public grep_proc_sink<vis_line_t> {
+public:
+    void grep_match(grep_proc<vis_line_t>& gp, vis_line_t line) override
+    {
+        this->cs_matches += 1;
+    }
+
+    void grep_end(grep_proc<vis_line_t>& gp) override
+    {
+        this->cs_finished = true;
+    }
+
+    size_t cs_matches{0};
+    bool cs_finished{false};
+};
+
+std::filesystem::path
+generate_file(const std::filesystem::path& dir,
+              const generator& gen_def,
+              size_t line_count)
+{
+    auto path = dir / fmt::format(FMT_STRING("bench-{}.log"), gen_def.g_name);
+    std::mt19937 gen(1234);
+    std::string buffer;
+    auto_fd fd;
+
+    fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        fprintf(stderr,
+                "error: unable to create %s -- %s\n",
+                path.c_str(),
+                strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    for (size_t lpc = 0; lpc < line_count; lpc++) {
+        gen_def.g_func(gen, lpc, buffer);
+        if (buffer.size() > 1024 * 1024 || lpc + 1 == line_count) {
+            if (write(fd, buffer.data(), buffer.size()) == -1) {
+                perror("write");
+                exit(EXIT_FAILURE);
+            }
+            buffer.clear();
+        }
+    }
+
+    return path;
+}
+
+bench_result
+bench_line_buffer(const std::filesystem::path& path, const char* format)
+{
+    bench_result retval{"line_buffer", format};
+    auto_fd fd(open(path.c_str(), O_RDONLY));
+    line_buffer lb;
+    file_range range;
+    bench_timer timer;
+
+    lb.set_fd(fd);
+    while (true) {
+        auto load_res = lb.load_next_line(range);
+        if (load_res.isErr()) {
+            break;
+        }
+
+        auto li = load_res.unwrap();
+        if (li.li_file_range.empty()) {
+            break;
+        }
+        range = li.li_file_range;
+
+        auto read_res = lb.read_range(range);
+        if (read_res.isErr()) {
+            break;
+        }
+        retval.br_lines += 1;
+        retval.br_bytes += read_res.unwrap().length();
+    }
+    retval.br_seconds = timer.elapsed();
+
+    return retval;
+}
+
+std::shared_ptr<logfile>
+open_logfile(const std::filesystem::path& path)
+{
+    logfile_open_options loo;
+    auto open_res = logfile::open(path, loo);
+
+    if (open_res.isErr()) {
+        fprintf(stderr,
+                "error: unable to open %s -- %s\n",
+                path.c_str(),
+                open_res.unwrapErr().c_str());
+        exit(EXIT_FAILURE);
+    }
+
+    return open_res.unwrap();
+}
+
+bench_result
+bench_logfile_index(const std::shared_ptr<logfile>& lf, const char* format)
+{
+    bench_result retval{"logfile_rebuild_index", format};
+    bench_timer timer;
+
+    while (lf->rebuild_index() != logfile::rebuild_result_t::NO_NEW_LINES) {
+    }
+    retval.br_seconds = timer.elapsed();
+    retval.br_lines = lf->size();
+    retval.br_bytes = lf->get_index_size();
+
+    if (lf->get_format() == nullptr
+        || lf->get_format()->get_name().to_string() != format)
+    {
+        fprintf(stderr,
+                "warning: %s was detected as %s\n",
+                lf->get_filename().c_str(),
+                lf->get_format() == nullptr
+                    ? "text"
+                    : lf->get_format()->get_name().get());
+    }
+
+    return retval;
+}
+
+/**
+ * Parse the same timestamps with the ptime_fmt() interpreter, a compiled
+ * ptime_program, and the function generated by ptimec for the format.
+ */
+void
+bench_ptime(std::vector<bench_result>& results, size_t line_count)
+{
+    static const char* const FORMATS[] = {
+        "%Y-%m-%d %H:%M:%S,%L",
+        "%d/%b/%Y:%H:%M:%S %z",
+    };
+
+    for (const auto* fmt : FORMATS) {
+        std::vector<std::string> stamps;
+        ptime_func generated = nullptr;
+
+        for (size_t lpc = 0; PTIMEC_FORMATS[lpc].pf_fmt != nullptr; lpc++) {
+            if (strcmp(PTIMEC_FORMATS[lpc].pf_fmt, fmt) == 0) {
+                generated = PTIMEC_FORMATS[lpc].pf_func;
+                break;
+            }
+        }
+
+        stamps.reserve(line_count);
+        for (size_t lpc = 0; lpc < line_count; lpc++) {
+            auto lt = line_time(lpc);
+            exttm tm;
+            char buf[128];
+
+            tm.et_tm = lt.first;
+            tm.et_nsec = lt.second * 1000 * 1000;
+            tm.et_flags |= ETF_ZONE_SET;
+
+            ftime_fmt(buf, sizeof(buf), fmt, tm);
+            stamps.emplace_back(buf);
+        }
+
+        // Do not let the program defer to the generated function so that
+        // the compiled ops are what is measured.
+        const ptime_program prog{fmt, false};
+        const std::vector<
+            std::pair<const char*, std::function<bool(const std::string&)>>>
+            parsers = {
+                {"ptime_interpreted",
+                 [fmt](const std::string& str) {
+                     exttm tm;
+                     off_t off = 0;
+
+                     return ptime_fmt(fmt, &tm, str.data(), off, str.size());
+                 }},
+                {"ptime_compiled",
+                 [&prog](const std::string& str) {
+                     exttm tm;
+                     off_t off = 0;
+
+                     return prog.parse(&tm, str.data(), off, str.size());
+                 }},
+                {"ptime_generated",
+                 [generated](const std::string& str) {
+                     exttm tm;
+                     off_t off = 0;
+
+                     return generated(&tm, str.data(), off, str.size());
+                 }},
+            };
+
+        for (const auto& parser : parsers) {
+            if (generated == nullptr
+                && strcmp(parser.first, "ptime_generated") == 0)
+            {
+                continue;
+            }
+
+            bench_result br{parser.first, fmt};
+            bench_timer timer;
+
+            for (const auto& stamp : stamps) {
+                if (!parser.second(stamp)) {
+                    fprintf(stderr,
+                            "warning: %s failed to parse %s\n",
+                            parser.first,
+                            stamp.c_str());
+                    break;
+                }
+                br.br_lines += 1;
+                br.br_bytes += stamp.size();
+            }
+            br.br_seconds = timer.elapsed();
+            add_result(results, br);
+        }
+    }
+}
+
+}  // namespace
+
+int
+main(int argc, char* argv[])
+{
+    size_t line_count = 100000;
+    std::optional<std::filesystem::path> dir;
+    const char* output_path = nullptr;
+    int c;
+
+    while ((c = getopt(argc, argv, "n:d:o:")) != -1) {
+        switch (c) {
+            case 'n':
+                line_count = strtoull(optarg, nullptr, 10);
+                break;
+            case 'd':
+                dir = optarg;
+                break;
+            case 'o':
+                output_path = optarg;
+                break;
+            default:
+                fprintf(stderr,
+                        "usage: %s [-n lines-per-format] [-d work-dir] "
+                        "[-o output.json]\n",
+                        argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    setenv("LANG", "en_US.UTF-8", 1);
+    setenv("TZ", "UTC", 1);
+    setlocale(LC_ALL, "");
+
+    auto remove_dir = false;
+    if (!dir) {
+        auto tmpl
+            = (std::filesystem::temp_directory_path() / "lnav-bench.XXXXXX")
+                  .string();
+
+        if (mkdtemp(tmpl.data()) == nullptr) {
+            perror("mkdtemp");
+            return EXIT_FAILURE;
+        }
+        dir = tmpl;
+        remove_dir = true;
+    }
+
+    {
+        static auto builtin_formats
+            = injector::get<std::vector<std::shared_ptr<log_format>>>();
+        auto& root_formats = log_format::get_root_formats();
+
+        root_formats.insert(
+            root_formats.begin(), builtin_formats.begin(), builtin_formats.end());
+        builtin_formats.clear();
+    }
+
+    {
+        std::vector<lnav::console::user_message> errors;
+
+        load_formats({}, errors);
+    }
+
+    // The line_buffer preloads data on the I/O service thread.
+    isc::supervisor root_superv(injector::get<isc::service_list>());
+    std::vector<bench_result> results;
+    std::vector<std::shared_ptr<logfile>> files;
+
+    bench_ptime(results, line_count);
+
+    for (const auto& gen_def : GENERATORS) {
+        auto path = generate_file(dir.value(), gen_def, line_count);
+
+        add_result(results, bench_line_buffer(path, gen_def.g_name));
+
+        auto lf = open_logfile(path);
+        add_result(results, bench_logfile_index(lf, gen_def.g_name));
+        files.emplace_back(lf);
+    }
+
+    logfile_sub_source lss;
+    textview_curses tc;
+    size_t total_lines = 0;
+    size_t total_bytes = 0;
+
+    tc.set_sub_source(&lss);
+    for (const auto& lf : files) {
+        lss.insert_file(lf);
+        total_lines += lf->size();
+        total_bytes += lf->get_index_size();
+    }
+    {
+        bench_result br{"logfile_sub_source_rebuild_index", "all"};
+        bench_timer timer;
+
+        lss.rebuild_index();
+        br.br_seconds = timer.elapsed();
+        br.br_lines = lss.text_line_count();
+        br.br_bytes = total_bytes;
+        add_result(results, br);
+    }
+    tc.reload_data();
+
+    {
+        bench_result br{"grep_proc", "all"};
+        auto code = lnav::pcre2pp::code::from_const("timeout=\\d+|error")
+                        .to_shared();
+        auto psuperv = std::make_shared<pollable_supervisor>();
+        count_sink sink;
+        bench_timer timer;
+
+        {
+            grep_proc<vis_line_t> gp(code, tc, psuperv);
+
+            gp.set_sink(&sink);
+            gp.queue_request();
+            gp.start();
+            while (!sink.cs_finished) {
+                std::vector<struct pollfd> pollfds;
+
+                psuperv->update_poll_set(pollfds);
+                poll(pollfds.data(), pollfds.size(), -1);
+                psuperv->check_poll_set(pollfds);
+            }
+        }
+        br.br_seconds = timer.elapsed();
+        br.br_lines = lss.text_line_count();
+        br.br_bytes = total_bytes;
+        add_result(results, br);
+    }
+
+    {
+        auto_mem<sqlite3> db(sqlite3_close);
+
+        sqlite3_open(":memory:", db.out());
+        {
+            int register_collation_functions(sqlite3 * db);
+
+            register_sqlite_funcs(db.in(), sqlite_registration_funcs);
+            register_collation_functions(db.in());
+        }
+
+        log_vtab_manager vtab_manager(db.in(), tc, lss);
+
+        for (const auto& gen_def : GENERATORS) {
+            auto format = log_format::find_root_format(gen_def.g_name);
+            if (format == nullptr) {
+                continue;
+            }
+            auto reg_err = vtab_manager.register_vtab(format->get_vtab_impl());
+            if (!reg_err.empty()) {
+                fprintf(stderr,
+                        "error: unable to register %s table -- %s\n",
+                        gen_def.g_name,
+                        reg_err.c_str());
+                return EXIT_FAILURE;
+            }
+
+            auto query = fmt::format(
+                FMT_STRING("SELECT count(*), sum(length(log_body)) FROM {}"),
+                gen_def.g_name);
+            bench_result br{"log_vtab_scan", gen_def.g_name};
+            auto_mem<sqlite3_stmt> stmt(sqlite3_finalize);
+            bench_timer timer;
+
+            if (sqlite3_prepare_v2(
+                    db.in(), query.c_str(), -1, stmt.out(), nullptr)
+                != SQLITE_OK)
+            {
+                fprintf(stderr,
+                        "error: unable to prepare %s -- %s\n",
+                        query.c_str(),
+                        sqlite3_errmsg(db.in()));
+                return EXIT_FAILURE;
+            }
+            if (sqlite3_step(stmt.in()) == SQLITE_ROW) {
+                br.br_lines = sqlite3_column_int64(stmt.in(), 0);
+                br.br_bytes = sqlite3_column_int64(stmt.in(), 1);
+            }
+            br.br_seconds = timer.elapsed();
+            add_result(results, br);
+        }
+    }
+
+    // notcurses needs a terminal to query, even though nothing is drawn.
+    if (!isatty(STDIN_FILENO)) {
+        fprintf(stderr, "warning: skipping mvwattrline, stdin is not a tty\n");
+    } else {
+        auto_mem<FILE> null_file(fclose);
+        notcurses_options nco;
+
+        memset(&nco, 0, sizeof(nco));
+        nco.flags |= NCOPTION_SUPPRESS_BANNERS | NCOPTION_NO_WINCH_SIGHANDLER
+            | NCOPTION_NO_QUIT_SIGHANDLERS | NCOPTION_NO_ALTERNATE_SCREEN
+            | NCOPTION_DRAIN_INPUT;
+        null_file = fopen("/dev/null", "w");
+
+        auto* nc = notcurses_core_init(&nco, null_file.in());
+        if (nc == nullptr) {
+            fprintf(stderr, "warning: unable to initialize notcurses\n");
+        } else {
+            bench_result br{"mvwattrline", "all"};
+            auto* plane = notcurses_stdplane(nc);
+            line_range lr{0, 200};
+            attr_line_t al;
+            bench_timer timer;
+
+            view_colors::singleton().init(nc);
+            for (vis_line_t vl{0}; vl < tc.get_inner_height(); ++vl) {
+                tc.textview_value_for_row(vl, al);
+                br.br_bytes += al.length();
+                view_curses::mvwattrline(plane, 0, 0, al, lr);
+                br.br_lines += 1;
+            }
+            br.br_seconds = timer.elapsed();
+            add_result(results, br);
+            notcurses_stop(nc);
+        }
+    }
+
+    yajlpp_gen gen;
+
+    yajl_gen_config(gen, yajl_gen_beautify, true);
+    {
+        yajlpp_map root(gen);
+
+        root.gen("lines_per_format");
+        root.gen(line_count);
+        root.gen("total_lines");
+        root.gen(total_lines);
+        root.gen("results");
+
+        yajlpp_array results_array(gen);
+        for (const auto& br : results) {
+            yajlpp_map result_map(gen);
+
+            result_map.gen("name");
+            result_map.gen(br.br_name);
+            result_map.gen("format");
+            result_map.gen(br.br_format);
+            result_map.gen("lines");
+            result_map.gen(br.br_lines);
+            result_map.gen("bytes");
+            result_map.gen(br.br_bytes);
+            result_map.gen("seconds");
+            result_map.gen(br.br_seconds);
+            result_map.gen("lines_per_sec");
+            result_map.gen(br.br_seconds > 0 ? br.br_lines / br.br_seconds
+                                             : 0.0);
+            result_map.gen("bytes_per_sec");
+            result_map.gen(br.br_seconds > 0 ? br.br_bytes / br.br_seconds
+                                             : 0.0);
+            result_map.gen("peak_rss_kb");
+            result_map.gen(br.br_peak_rss_kb);
+        }
+    }
+
+    if (remove_dir) {
+        std::error_code ec;
+
+        std::filesystem::remove_all(dir.value(), ec);
+    }
+
+    auto json = gen.to_string_fragment();
+    if (output_path == nullptr) {
+        printf("%.*s\n", json.length(), json.data());
+    } else {
+        auto_mem<FILE> out(fclose);
+
+        out = fopen(output_path, "w");
+        if (out.in() == nullptr) {
+            perror("fopen");
+            return EXIT_FAILURE;
+        }
+        fprintf(out.in(), "%.*s\n", json.length(), json.data());
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -30,23 +30,95 @@
 #include "config.h"
 
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <chrono>
+#include <fstream>
+#include <thread>
+
 #include <data_parser.hh>
 
+#include "arrow_ipc.hh"
 #include "base/from_trait.hh"
+#include "base/injector.bind.hh"
+#include "base/injector.hh"
+#include "base/isc.hh"
 #include "byte_array.hh"
 #include "cmd.parser.hh"
 #include "data_scanner.hh"
 #include "doctest/doctest.h"
+#include "file_collection.hh"
+#include "file_options.hh"
+#include "file_watcher.hh"
+#include "fmt/format.h"
 #include "lnav_config.hh"
 #include "lnav_util.hh"
+#include "log_format_loader.hh"
+#include "logfile.hh"
+#include "logfile_sub_source.hh"
+#include "plain_text_source.hh"
 #include "ptimec.hh"
 #include "relative_time.hh"
 #include "shlex.hh"
+#include "sql_filter_plan.hh"
+#include "sqlitepp.hh"
+#include "textview_curses.hh"
 #include "unique_path.hh"
 
 #include "terminfo/terminfo.h"
 
 using namespace std;
+using namespace std::chrono_literals;
+
+static auto bound_file_options_hier
+    = injector::bind<lnav::safe_file_options_hier>::to_singleton();
+
+namespace {
+
+/**
+ * A file in the current directory that is removed when the test case is
+ * done, even if a REQUIRE() failed.
+ */
+struct temp_test_file {
+    explicit temp_test_file(std::string name, const std::string& content)
+        : ttf_name(std::move(name))
+    {
+        ofstream(this->ttf_name, ios::trunc) << content;
+    }
+
+    ~temp_test_file() { remove(this->ttf_name.c_str()); }
+
+    void append(const std::string& content) const
+    {
+        ofstream(this->ttf_name, ios::app) << content;
+    }
+
+    const std::string ttf_name;
+};
+
+/**
+ * Load the built-in log formats the first time a test needs them.  The
+ * formats are global, so they are only loaded once for the whole run.
+ */
+void
+ensure_formats_loaded()
+{
+    static const auto loaded = []() {
+        auto builtin_formats
+            = injector::get<std::vector<std::shared_ptr<log_format>>>();
+        auto& root_formats = log_format::get_root_formats();
+
+        root_formats.insert(
+            root_formats.begin(), builtin_formats.begin(), builtin_formats.end());
+
+        std::vector<lnav::console::user_message> errors;
+
+        load_formats({}, errors);
+        return true;
+    }();
+
+    (void) loaded;
+}
+
+}  // namespace
 
 #if 0
 TEST_CASE("overwritten-logfile") {
@@ -393,3 +465,347 @@ TEST_CASE("data_scanner quote3")
         CHECK(tok_res->tr_token == DT_QUOTED_STRING);
     }
 }
+
+TEST_CASE("logfile_sub_source render cache survives appends")
+{
+    static const char* LINES[] = {
+        "Nov  3 09:23:38 veridian automount[7998]: lookup(file): lookup for "
+        "foobar failed\n",
+        "Nov  3 09:23:38 veridian automount[16442]: attempting to mount entry "
+        "/auto/opt\n",
+        "Nov  3 09:23:38 veridian automount[7999]: lookup(file): lookup for "
+        "opt failed\n",
+    };
+
+    ensure_formats_loaded();
+
+    temp_test_file ttf("render_cache.0",
+                       std::string(LINES[0]) + std::string(LINES[1]));
+    logfile_open_options loo;
+    auto lf = logfile::open(ttf.ttf_name, loo).unwrap();
+    logfile_sub_source lss;
+    textview_curses tc;
+    std::string value;
+
+    lf->rebuild_index();
+    REQUIRE(lf->get_format_ptr() != nullptr);
+
+    tc.set_sub_source(&lss);
+    lss.insert_file(lf);
+    lss.rebuild_index();
+    REQUIRE(lss.text_line_count() == 2);
+
+    for (int lpc = 0; lpc < 2; lpc++) {
+        lss.text_value_for_line(tc, lpc, value, 0);
+    }
+    CHECK(lss.get_render_cache_stats().rcs_misses == 2);
+
+    ttf.append(LINES[2]);
+    lss.rebuild_index();
+    REQUIRE(lss.text_line_count() == 3);
+
+    // Only the last message of the file is rendered again.
+    for (int lpc = 0; lpc < 3; lpc++) {
+        lss.text_value_for_line(tc, lpc, value, 0);
+    }
+    CHECK(lss.get_render_cache_stats().rcs_hits == 1);
+    CHECK(lss.get_render_cache_stats().rcs_misses == 4);
+}
+
+TEST_CASE("textview_curses highlight cache")
+{
+    static auto count_roles = [](const attr_line_t& al, role_t role) {
+        return std::count_if(
+            al.get_attrs().begin(), al.get_attrs().end(), [role](auto& sa) {
+                return sa.sa_type == &VC_ROLE
+                    && sa.sa_value.template get<role_t>() == role;
+            });
+    };
+
+    plain_text_source pts(
+        std::vector<std::string>{"hello world", "world, hello"});
+    textview_curses tc;
+
+    tc.set_sub_source(&pts);
+    tc.get_highlights()[{highlight_source_t::INTERACTIVE, "world"}]
+        = highlighter(lnav::pcre2pp::code::from_const("world").to_shared())
+              .with_role(role_t::VCR_KEYWORD);
+
+    attr_line_t first, second;
+    tc.textview_value_for_row(0_vl, first);
+    tc.textview_value_for_row(0_vl, second);
+    CHECK(tc.get_highlight_cache_stats().hcs_misses == 1);
+    CHECK(tc.get_highlight_cache_stats().hcs_hits == 1);
+    CHECK(count_roles(first, role_t::VCR_KEYWORD) == 1);
+    CHECK(count_roles(second, role_t::VCR_KEYWORD) == 1);
+
+    // A different line is not served from the cache.
+    attr_line_t other;
+    tc.textview_value_for_row(1_vl, other);
+    CHECK(tc.get_highlight_cache_stats().hcs_misses == 2);
+    CHECK(count_roles(other, role_t::VCR_KEYWORD) == 1);
+
+    // Changing the highlighters drops the cached attributes.
+    tc.get_highlights().erase({highlight_source_t::INTERACTIVE, "world"});
+    attr_line_t after;
+    tc.textview_value_for_row(0_vl, after);
+    CHECK(tc.get_highlight_cache_stats().hcs_misses == 3);
+    CHECK(count_roles(after, role_t::VCR_KEYWORD) == 0);
+}
+
+TEST_CASE("highlight_prefilter")
+{
+    highlight_map_t hm;
+
+    hm[{highlight_source_t::INTERACTIVE, "literal"}] = highlighter(
+        lnav::pcre2pp::code::from_const("connection refused").to_shared());
+    hm[{highlight_source_t::INTERACTIVE, "caseless"}] = highlighter(
+        lnav::pcre2pp::code::from_const("(?i)timeout").to_shared());
+    hm[{highlight_source_t::INTERACTIVE, "no-literal"}]
+        = highlighter(lnav::pcre2pp::code::from_const("\\d+").to_shared());
+
+    // The map is ordered by name, so the indexes follow the names.
+    static constexpr size_t CASELESS = 0;
+    static constexpr size_t LITERAL = 1;
+    static constexpr size_t NO_LITERAL = 2;
+
+    highlight_prefilter hp;
+
+    CHECK_FALSE(hp.is_for(hm));
+    hp.rebuild(hm);
+    CHECK(hp.is_for(hm));
+
+    hp.start_line(string_fragment::from_const("error: connection refused"));
+    CHECK(hp.may_match(LITERAL));
+    CHECK_FALSE(hp.may_match(CASELESS));
+    CHECK(hp.may_match(NO_LITERAL));
+
+    hp.start_line(string_fragment::from_const("error: connection reset"));
+    CHECK_FALSE(hp.may_match(LITERAL));
+    CHECK(hp.may_match(NO_LITERAL));
+
+    // The literals are compared without regard to case, so a caseless
+    // pattern is not skipped when its literal is in a different case.
+    hp.start_line(string_fragment::from_const("request TIMEOUT after 5s"));
+    CHECK_FALSE(hp.may_match(LITERAL));
+    CHECK(hp.may_match(CASELESS));
+    CHECK(hp.may_match(NO_LITERAL));
+
+    hp.start_line(string_fragment::from_const("nothing to see"));
+    CHECK_FALSE(hp.may_match(LITERAL));
+    CHECK_FALSE(hp.may_match(CASELESS));
+    CHECK(hp.may_match(NO_LITERAL));
+
+    hm.erase({highlight_source_t::INTERACTIVE, "no-literal"});
+    CHECK_FALSE(hp.is_for(hm));
+}
+
+TEST_CASE("sql_filter_plan native matches sqlite")
+{
+    static const char* EXPRS[] = {
+        "1 = 1.0",
+        "1 < 1.5",
+        "2 > '1'",
+        "'10' < '9'",
+        "'a' < 'ab'",
+        "'ab' > 'a'",
+        "'ab' = 'ab'",
+        "'abc' = 'ABC'",
+        "NULL = NULL",
+        "NULL <> 1",
+        "NULL IS NULL",
+        "1 IS NOT NULL",
+        "NOT (NULL = 1)",
+        "NULL OR 1",
+        "NULL AND 0",
+        "1 IN (1.0, 2)",
+        "'1' IN (1, 2)",
+        "3 IN (1, NULL)",
+        "3 NOT IN (1, 2)",
+        "3 NOT IN (1, NULL)",
+        "1 NOT IN (1, NULL)",
+        "NULL NOT IN (1, 2)",
+        "'abc' LIKE 'A%C'",
+        "'abc' NOT LIKE '%b%'",
+        "NULL LIKE '%'",
+        "'Héllo' LIKE 'h_llo'",
+        "'Héllo' LIKE 'hé%'",
+        "'Héllo' LIKE 'HÉ%'",
+        "'Äb' LIKE 'äB'",
+        "$FP_TEXT = 'Déjà'",
+        "$FP_TEXT LIKE 'dé%'",
+        "$FP_TEXT > 5",
+        "$FP_MISSING IS NULL",
+        "$FP_MISSING = 1",
+    };
+
+    setenv("FP_TEXT", "Déjà", 1);
+    unsetenv("FP_MISSING");
+
+    auto_sqlite3 db;
+    REQUIRE(sqlite3_open(":memory:", db.out()) == SQLITE_OK);
+
+    for (const auto* case_sensitive : {"0", "1"}) {
+        auto pragma = fmt::format(FMT_STRING("PRAGMA case_sensitive_like = {}"),
+                                  case_sensitive);
+        REQUIRE(sqlite3_exec(db.in(), pragma.c_str(), nullptr, nullptr, nullptr)
+                == SQLITE_OK);
+
+        for (const auto* expr : EXPRS) {
+            auto sql = fmt::format(FMT_STRING("SELECT 1 WHERE {}"), expr);
+            auto_mem<sqlite3_stmt> stmt(sqlite3_finalize);
+
+            INFO(pragma);
+            INFO(sql);
+            REQUIRE(sqlite3_prepare_v2(
+                        db.in(), sql.c_str(), -1, stmt.out(), nullptr)
+                    == SQLITE_OK);
+
+            auto plan = sql_filter_plan::create(stmt.in());
+            sql_filter_plan::line_context lc(nullptr, {});
+            CHECK(plan->is_native());
+
+            auto native = plan->eval(lc);
+            REQUIRE(native.has_value());
+
+            plan->bind(stmt.in(), lc);
+            auto step_rc = sqlite3_step(stmt.in());
+            REQUIRE((step_rc == SQLITE_ROW || step_rc == SQLITE_DONE));
+            CHECK(native.value() == (step_rc == SQLITE_ROW));
+        }
+    }
+}
+
+TEST_CASE("file_watcher appended lines are indexed")
+{
+    temp_test_file ttf("file_watcher.0", "first line\n");
+
+    isc::supervisor root_superv(injector::get<isc::service_list>());
+    auto& fw = injector::get<file_watcher&>();
+
+    auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (!fw.is_active() && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(10ms);
+    }
+    REQUIRE(fw.is_active());
+
+    logfile_open_options loo;
+    auto lf = logfile::open(ttf.ttf_name, loo).unwrap();
+    while (lf->rebuild_index() != logfile::rebuild_result_t::NO_NEW_LINES) {
+    }
+    REQUIRE(lf->size() == 1);
+
+    // Without a notification, the file would not be read again until the
+    // poll interval has passed.
+    ttf.append("second line\n");
+    deadline = std::chrono::steady_clock::now() + 5s;
+    while (lf->size() < 2 && std::chrono::steady_clock::now() < deadline) {
+        lf->rebuild_index();
+        std::this_thread::sleep_for(10ms);
+    }
+    CHECK(lf->size() == 2);
+}
+
+TEST_CASE("archive_looper runs every submitted extraction")
+{
+    auto looper = std::make_shared<archive_looper>();
+    std::atomic<size_t> ran{0};
+    std::atomic<size_t> cancelled{0};
+    auto task = [&ran, &cancelled](archive_looper& al) {
+        ran += 1;
+        if (!al.is_looping()) {
+            cancelled += 1;
+        }
+    };
+
+    {
+        isc::supervisor superv(isc::service_list{looper});
+
+        for (int lpc = 0; lpc < 100; lpc++) {
+            looper->submit(task);
+        }
+        superv.stop_children();
+
+        // The thread has been joined, so these are run on this thread and
+        // see that the looper was stopped.
+        for (int lpc = 0; lpc < 10; lpc++) {
+            looper->submit(task);
+        }
+        CHECK(ran == 110);
+        CHECK(cancelled >= 10);
+    }
+}
+
+TEST_CASE("arrow_ipc stream_writer")
+{
+    using namespace lnav::arrow_ipc;
+
+    auto_mem<FILE> file(fclose);
+    file = tmpfile();
+    REQUIRE(file.in() != nullptr);
+
+    stream_writer sw(file.in(), {"num", "text"});
+    for (int lpc = 0; lpc < 2; lpc++) {
+        batch b(2);
+
+        b.b_columns[0].append_integer(lpc);
+        b.b_columns[1].append_text(string_fragment::from_const("abc"));
+        b.b_columns[0].append_null();
+        b.b_columns[1].append_text(string_fragment::from_const("abc"));
+        if (lpc == 1) {
+            b.b_columns[0].append_text(string_fragment::from_const("def"));
+        } else {
+            b.b_columns[0].append_integer(10);
+        }
+        b.b_columns[1].append_integer(10);
+
+        auto res = sw.write_batch(b);
+        REQUIRE(res.isOk());
+        CHECK(res.unwrap() == size_t(lpc));
+    }
+    REQUIRE(sw.finish().isOk());
+
+    CHECK(sw.get_columns()[0].c_type == column_type::int64);
+    CHECK(sw.get_columns()[1].c_type == column_type::dict_utf8);
+
+    std::string content(ftell(file.in()), '\0');
+    rewind(file.in());
+    REQUIRE(fread(content.data(), 1, content.size(), file.in())
+            == content.size());
+
+    // The schema, a dictionary and record batch for each batch, and the
+    // end-of-stream marker should follow each other with no gaps.
+    size_t messages = 0;
+    size_t pos = 0;
+    while (true) {
+        REQUIRE(pos + 8 <= content.size());
+        uint32_t marker, metadata_len;
+        memcpy(&marker, &content[pos], sizeof(marker));
+        memcpy(&metadata_len, &content[pos + 4], sizeof(metadata_len));
+        CHECK(marker == 0xffffffff);
+        CHECK(metadata_len % 8 == 0);
+        pos += 8;
+        if (metadata_len == 0) {
+            break;
+        }
+
+        // Follow the root table's vtable to the bodyLength field.
+        const auto* metadata = &content[pos];
+        uint32_t root;
+        int32_t vtable_off;
+        uint16_t body_len_off;
+        int64_t body_len;
+        memcpy(&root, metadata, sizeof(root));
+        memcpy(&vtable_off, metadata + root, sizeof(vtable_off));
+        memcpy(&body_len_off,
+               metadata + root - vtable_off + 4 + 2 * 3,
+               sizeof(body_len_off));
+        REQUIRE(body_len_off != 0);
+        memcpy(&body_len, metadata + root + body_len_off, sizeof(body_len));
+        CHECK(body_len % 8 == 0);
+        pos += metadata_len + body_len;
+        messages += 1;
+    }
+    CHECK(messages == 5);
+    CHECK(pos == content.size());
+}
@@ -135,6 +135,14 @@ run_cap_test ${lnav_test} -n -d /tmp/lnav.err \
     -c ":filter-expr :sc_bytes # ff" \
     "${test_dir}/logfile_access_log.*"
 
+run_cap_test ${lnav_test} -n -d /tmp/lnav.err \
+    -c ":filter-expr :sc_bytes > 2000 AND (:log_level = 'error' OR :cs_uri_stem REGEXP '\.gz$')" \
+    "${test_dir}/logfile_access_log.*"
+
+run_cap_test ${lnav_test} -n -d /tmp/lnav.err \
+    -c ":filter-expr :sc_status IN (200, 404) AND :cs_method NOT LIKE 'p_st' AND :nosuch IS NULL" \
+    "${test_dir}/logfile_access_log.*"
+
 run_cap_test ${lnav_test} -n -d /tmp/lnav.err \
     -c ":goto 0" \
     -c ":close" \
@@ -361,13 +369,14 @@ run_cap_test ${lnav_test} -n \
     -c ":filter-out World" \
     ${test_dir}/logfile_plain.0
 
-#TOO_MANY_FILTERS=""
-#for i in `seq 1 32`; do
-#    TOO_MANY_FILTERS="$TOO_MANY_FILTERS -c ':filter-out $i'"
-#done
-#run_cap_test ${lnav_test} -d /tmp/lnav.err -n \
-#    $TOO_MANY_FILTERS \
-#    ${test_dir}/logfile_filter.0
+MANY_FILTERS=()
+for i in `seq 1 40`; do
+    MANY_FILTERS+=(-c ":filter-out nomatch$i")
+done
+run_cap_test ${lnav_test} -n \
+    "${MANY_FILTERS[@]}" \
+    -c ":filter-out avahi" \
+    ${test_dir}/logfile_filter.0
 
 run_cap_test ${lnav_test} -n \
     -c ":close" \
@@ -407,6 +416,14 @@ run_cap_test ${lnav_test} -n \
     -c ':write-jsonlines-to -' \
     ${test_dir}/logfile_access_log.0
 
+run_cap_test ${lnav_test} -n \
+    -c ":export-csv-to - SELECT c_ip, sc_bytes, 'a,\"b' AS c3, NULL AS c4 FROM access_log" \
+    ${test_dir}/logfile_access_log.0
+
+run_cap_test ${lnav_test} -n \
+    -c ":export-jsonlines-to - SELECT log_line, c_ip, json_array(sc_bytes) AS c3 FROM access_log" \
+    ${test_dir}/logfile_access_log.0
+
 # By setting the LNAVSECURE mode before executing the command, we will disable
 # the access to the write-json-to command and the output would just be the
 # actual display of select query rather than json output.
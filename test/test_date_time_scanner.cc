@@ -312,4 +312,43 @@ TEST_CASE("date_time_scanner")
         assert(rc == 19);
         assert(strcmp(ts, buf) == 0);
     }
+
+    {
+        static const struct {
+            const char* fmt;
+            const char* str;
+        } CASES[] = {
+            {"%Y-%m-%d %H:%M:%S,%L", "2024-03-02 10:11:12,345"},
+            {"%d/%b/%Y:%H:%M:%S %z", "02/Mar/2024:10:11:12 -0800"},
+            {"%a %b %e %H:%M:%S %Z %Y", "Sat Mar  2 10:11:12 UTC 2024"},
+            {"[%B %d %Y]", "[March 02 2024]"},
+            {"%Y-%m-%d %H:%M:%S", "2024-03-02T10:11:12"},
+            {"%%%Y", "%2024"},
+            {"ts %s ]", "ts 1428721664 ]"},
+            {"ts %s ]", "ts 1428721664"},
+            {"%Y-%m-%d", "2024-03-0"},
+            {"%Y%Q%d", "2024Q02"},
+            {"%H:%M:%S.%f", "10:11:12.123456"},
+        };
+
+        for (const auto& tc : CASES) {
+            exttm interp_tm{}, compiled_tm{};
+            off_t interp_off = 0, compiled_off = 0;
+            auto len = strlen(tc.str);
+            const ptime_program prog{tc.fmt, false};
+
+            auto interp_rc
+                = ptime_fmt(tc.fmt, &interp_tm, tc.str, interp_off, len);
+            auto compiled_rc
+                = prog.parse(&compiled_tm, tc.str, compiled_off, len);
+            CHECK(interp_rc == compiled_rc);
+            if (interp_rc) {
+                CHECK(interp_off == compiled_off);
+                CHECK(tm2sec(&interp_tm.et_tm) == tm2sec(&compiled_tm.et_tm));
+                CHECK(interp_tm.et_nsec == compiled_tm.et_nsec);
+                CHECK(interp_tm.et_flags == compiled_tm.et_flags);
+            }
+        }
+        CHECK(ptime_program::lookup("%Y %H") == ptime_program::lookup("%Y %H"));
+    }
 }
@@ -22,6 +22,11 @@ run_cap_test env TEST_COMMENT="watch expression generate detect event" ${lnav_te
    -c ':write-jsonlines-to -' \
    ${test_dir}/logfile_access_log.0
 
+run_cap_test env TEST_COMMENT="watch expression stats" ${lnav_test} -n \
+   -c ';SELECT name, enabled, native, lines, prefiltered, native_evals, sqlite_evals, matches FROM lnav_watch_expr_stats' \
+   -c ':write-csv-to -' \
+   ${test_dir}/logfile_access_log.0
+
 run_cap_test env TEST_COMMENT="show the configuration" ${lnav_test} -nN \
    -c ':config /log/watch-expressions'
 
@@ -27,11 +27,13 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <chrono>
+#include <thread>
+
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/types.h>
-#include <sys/wait.h>
 
 #include "config.h"
 #include "grep_proc.hh"
@@ -70,34 +72,58 @@ public:
     int ms_current_line;
 };
 
-class my_sleeper_source : public grep_proc_source<vis_line_t> {
+class my_counting_source : public grep_proc_source<vis_line_t> {
+public:
+    explicit my_counting_source(int count) : mcs_count(count) {}
+
     std::optional<line_info> grep_value_for_line(vis_line_t line_number,
                                                  string& value_out) override
     {
-        sleep(1000);
-        return {};
+        if (line_number >= this->mcs_count) {
+            return std::nullopt;
+        }
+
+        value_out = (line_number % 3) == 0 ? "abc FooBar def" : "abc def";
+
+        return line_info{};
     }
+
+    int mcs_count;
 };
 
-class my_sink : public grep_proc_sink<vis_line_t> {
+class my_slow_source : public my_counting_source {
 public:
-    my_sink() : ms_finished(false) {};
+    explicit my_slow_source(int count) : my_counting_source(count) {}
+
+    std::optional<line_info> grep_value_for_line(vis_line_t line_number,
+                                                 string& value_out) override
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
 
-    void grep_match(grep_proc<vis_line_t>& gp, vis_line_t line) override {}
+        return my_counting_source::grep_value_for_line(line_number, value_out);
+    }
+};
+
+class my_sink : public grep_proc_sink<vis_line_t> {
+public:
+    void grep_match(grep_proc<vis_line_t>& gp, vis_line_t line) override
+    {
+        assert(this->ms_matches.empty() || this->ms_matches.back() < line);
+        this->ms_matches.emplace_back(line);
+    }
 
     void grep_end(grep_proc<vis_line_t>& gp) override
     {
         this->ms_finished = true;
     }
 
-    bool ms_finished;
+    vector<vis_line_t> ms_matches;
+    bool ms_finished{false};
 };
 
 static void
-looper(grep_proc<vis_line_t>& gp)
+looper(grep_proc<vis_line_t>& gp, my_sink& msink)
 {
-    my_sink msink;
-
     gp.set_sink(&msink);
 
     while (!msink.ms_finished) {
@@ -123,27 +149,84 @@ main(int argc, char* argv[])
         my_source ms;
         grep_proc<vis_line_t> gp(code, ms, psuperv);
 
+        my_sink msink;
+
         gp.queue_request(10_vl, 14_vl);
         gp.queue_request(0_vl, 3_vl);
         gp.start();
-        looper(gp);
+        looper(gp, msink);
     }
 
     {
-        my_sleeper_source mss;
-        grep_proc<vis_line_t>* gp
-            = new grep_proc<vis_line_t>(code, mss, psuperv);
-        int status;
+        my_counting_source mcs(100000);
+        grep_proc<vis_line_t> gp(code, mcs, psuperv);
+        my_sink msink;
 
-        gp->queue_request();
-        gp->start();
+        gp.queue_request();
+        gp.start();
+        looper(gp, msink);
+
+        assert(msink.ms_matches.size() == 33334);
+        assert(msink.ms_matches.back() == 99999_vl);
 
-        assert(wait3(&status, WNOHANG, NULL) == 0);
+        // Only the appended lines should be searched when continuing.
+        my_sink msink2;
 
-        delete gp;
+        mcs.mcs_count += 30;
+        gp.queue_request(-1_vl);
+        gp.start();
+        looper(gp, msink2);
+
+        assert(msink2.ms_matches.size() == 10);
+        assert(msink2.ms_matches.front() == 100002_vl);
+    }
+
+    {
+        my_counting_source mcs(10000000);
+        grep_proc<vis_line_t> gp(code, mcs, psuperv);
+        my_sink msink;
+        vector<struct pollfd> pollfds;
+
+        gp.set_sink(&msink);
+        gp.queue_request();
+        gp.start();
+        gp.update_poll_set(pollfds);
+        assert(!pollfds.empty());
+        poll(&pollfds[0], pollfds.size(), -1);
+        gp.check_poll_set(pollfds);
+        assert(!msink.ms_finished);
+
+        gp.invalidate();
+        assert(msink.ms_finished);
+        assert(msink.ms_matches.size() < 3333334);
+
+        pollfds.clear();
+        gp.update_poll_set(pollfds);
+        assert(pollfds.empty());
+    }
+
+    {
+        // Reading all of these lines takes at least a second, a single pass
+        // through the event loop should only read for a time slice.
+        my_slow_source mss(10000);
+        grep_proc<vis_line_t> gp(code, mss, psuperv);
+        my_sink msink;
+        vector<struct pollfd> pollfds;
+
+        gp.set_sink(&msink);
+        gp.queue_request();
+        gp.start();
+        gp.update_poll_set(pollfds);
+        poll(&pollfds[0], pollfds.size(), -1);
+
+        auto start_time = std::chrono::steady_clock::now();
+        gp.check_poll_set(pollfds);
+        auto elapsed = std::chrono::steady_clock::now() - start_time;
+        assert(elapsed < std::chrono::milliseconds(500));
+        assert(!msink.ms_finished);
 
-        assert(wait(&status) == -1);
-        assert(errno == ECHILD);
+        looper(gp, msink);
+        assert(msink.ms_matches.size() == 3334);
     }
 
     return retval;
@@ -154,6 +154,21 @@ run_cap_test ${lnav_test} -n \
     -I ${test_dir} \
     ${test_dir}/logfile_json_subsec.json
 
+# unused containers should be skipped without losing any values
+run_cap_test ${lnav_test} -n \
+    -I ${test_dir} \
+    -c ';select * from ntest_log' \
+    -c ':write-csv-to -' \
+    ${test_dir}/logfile_nested_json2.json
+
+# the nested timestamp should be found and fields without a definition
+# should not set the level
+run_cap_test ${lnav_test} -n \
+    -I ${test_dir} \
+    -c ';select log_time, log_level, log_body from subsec_json_log' \
+    -c ':write-csv-to -' \
+    ${test_dir}/logfile_json_subsec2.json
+
 run_cap_test ${lnav_test} -n \
     ${test_dir}/logfile_bunyan.0
 
@@ -70,9 +70,56 @@ while test $(wc -c < lb-3.gz) -le 5000000 ; do
 done | gzip -c -1 > lb-3.gz
 gzip -dc lb-3.gz > lb-3.dat
 grep -b '$' lb-3.dat | cut -f 1 -d : > lb-3.index
+awk 'NR % 200 == 1' lb-3.index > lb-3-sample.index
 
 run_test ./drive_line_buffer -i lb-3.index -n 10 lb-3.gz lb-3.dat
 
 check_output "Random gzipped reads don't match input" <<EOF
 All done
-EOF
\ No newline at end of file
+EOF
+
+if [ "$BZIP2_SUPPORT" -eq 1 ] && [ x"$BZIP2_CMD" != x"" ] ; then
+    $BZIP2_CMD -z -c -1 lb-3.dat > lb-3.bz2
+
+    run_test ./drive_line_buffer -i lb-3-sample.index -n 10 lb-3.bz2 lb-3.dat
+
+    check_output "Random bzip2 reads don't match input" <<EOF
+All done
+EOF
+
+    $BZIP2_CMD -z -c ${test_dir}/logfile_access_log.1 > lb-double.bz2
+    $BZIP2_CMD -z -c ${test_dir}/logfile_access_log.1 >> lb-double.bz2
+    run_test ${lnav_test} -n lb-double.bz2
+
+    $BZIP2_CMD -dc lb-double.bz2 | \
+        check_output "concatenated bzip2 files don't parse correctly"
+fi
+
+if [ "$ZSTD_SUPPORT" -eq 1 ] && [ x"$ZSTD_CMD" != x"" ] ; then
+    $ZSTD_CMD -q -c lb-3.dat > lb-3.zst
+
+    run_test ./drive_line_buffer -i lb-3-sample.index -n 2 lb-3.zst lb-3.dat
+
+    check_output "Random zstd reads don't match input" <<EOF
+All done
+EOF
+
+    split -b 1000000 lb-3.dat lb-3-part.
+    for part in lb-3-part.*; do
+        $ZSTD_CMD -q -c $part
+    done > lb-3-frames.zst
+    rm lb-3-part.*
+
+    run_test ./drive_line_buffer -i lb-3-sample.index -n 10 lb-3-frames.zst lb-3.dat
+
+    check_output "Random multi-frame zstd reads don't match input" <<EOF
+All done
+EOF
+
+    $ZSTD_CMD -q -c ${test_dir}/logfile_access_log.1 > lb-double.zst
+    $ZSTD_CMD -q -c ${test_dir}/logfile_access_log.1 >> lb-double.zst
+    run_test ${lnav_test} -n lb-double.zst
+
+    $ZSTD_CMD -dc lb-double.zst | \
+        check_output "concatenated zstd files don't parse correctly"
+fi
@@ -774,3 +774,33 @@ cat ${test_dir}/logfile_generic.0 | run_cap_test ${lnav_test} -n \
     -c ':test-comment generic before piper'
 
 run_cap_test ${lnav_test} -n ${test_dir}/logfile_logfmt.0
+
+# a large file should have its index saved and reloaded on the next open
+awk 'BEGIN { for (lpc = 0; lpc < 300000; lpc++) { printf("Nov  3 09:23:38 veridian automount[16442]: attempting to mount entry /auto/opt/%d\n", lpc); } }' > index_cache.0
+
+run_test ${lnav_test} -n \
+    -c ";SELECT count(*) AS total FROM syslog_log" \
+    -c ":write-csv-to -" \
+    index_cache.0
+
+check_output "large file not indexed" <<EOF
+total
+300000
+EOF
+
+echo "Nov  3 09:23:39 veridian automount[16442]: appended entry" >> index_cache.0
+
+run_test ${lnav_test} -d index_cache.err -n \
+    -c ";SELECT count(*) AS total FROM syslog_log" \
+    -c ":write-csv-to -" \
+    index_cache.0
+
+check_output "appended lines not indexed after loading saved index" <<EOF
+total
+300001
+EOF
+
+if ! grep -q "loaded saved index" index_cache.err; then
+    echo "error: saved index was not loaded"
+    exit 1
+fi
@@ -564,7 +564,7 @@ EOF
 
 
 schema_dump() {
-    ${lnav_test} -n -c ';.schema' ${test_dir}/logfile_access_log.0 | head -n21
+    ${lnav_test} -n -c ';.schema' ${test_dir}/logfile_access_log.0 | head -n22
 }
 
 run_test schema_dump
@@ -574,6 +574,7 @@ ATTACH DATABASE '' AS 'main';
 CREATE VIRTUAL TABLE environ USING environ_vtab_impl();
 CREATE VIRTUAL TABLE lnav_static_files USING lnav_static_file_vtab_impl();
 CREATE VIRTUAL TABLE lnav_view_filter_stats USING lnav_view_filter_stats_impl();
+CREATE VIRTUAL TABLE lnav_watch_expr_stats USING lnav_watch_expr_stats_impl();
 CREATE VIRTUAL TABLE lnav_views USING lnav_views_impl();
 CREATE VIRTUAL TABLE lnav_view_files USING lnav_view_files_impl();
 CREATE VIRTUAL TABLE lnav_view_stack USING lnav_view_stack_impl();
@@ -733,6 +734,12 @@ EOF
 run_cap_test ${lnav_test} -n -c ";select * from person order by age asc" \
     simple-db.db
 
+# Queries that use lnav functions cannot run on the SQL worker connection, so
+# they are run on the main one.
+run_cap_test ${lnav_test} -n \
+    -c ";select regexp_match('^(\w)', first_name) as initial from person order by age asc" \
+    simple-db.db
+
 # Test to see if lnav can recognize a sqlite3 db file passed in as an argument.
 # XXX: Need to pass in a file, otherwise lnav keeps trying to open syslog
 # and we might not have sufficient privileges on the system the tests are being
@@ -978,3 +985,17 @@ run_cap_test ${lnav_test} -n \
     -c ";UPDATE lnav_focused_msg SET log_mark = 1" \
     -c ":switch-to-view log" \
     ${test_dir}/logfile_access_log.0
+
+run_test ${lnav_test} -n -d sql_rows.err \
+    -c ";SELECT log_line FROM access_log" \
+    -c ";SELECT 1" \
+    ${test_dir}/logfile_access_log.0
+
+if ! grep -q "rows returned -> 3$" sql_rows.err; then
+    echo "error: rows returned by the first query were not counted"
+    exit 1
+fi
+if ! grep -q "rows returned -> 1$" sql_rows.err; then
+    echo "error: row count was not reset for the second query"
+    exit 1
+fi
@@ -94,3 +94,25 @@ run_cap_test ${lnav_test} -d sql_index.err -n \
     -c ":write-csv-to -" \
     -c ":switch-to-view log" \
     ${test_dir}/logfile_shop_access_log.0
+
+run_cap_test ${lnav_test} -n \
+    -c ";EXPLAIN QUERY PLAN SELECT * FROM access_log WHERE sc_bytes > 10000" \
+    -c ";SELECT \$id, \$parent, replace(\$detail, 'SCAN TABLE', 'SCAN')" \
+    ${test_dir}/logfile_access_log.*
+
+rm -f sql_index.err
+run_cap_test ${lnav_test} -d sql_index.err -n \
+    -c ";SELECT count(*), sum(sc_bytes) FROM access_log WHERE sc_bytes > 60000" \
+    -c ":write-csv-to -" \
+    -c ";SELECT count(*), sum(sc_bytes) FROM access_log WHERE sc_bytes <= 100" \
+    -c ":write-csv-to -" \
+    -c ";SELECT count(*) FROM access_log WHERE cs_uri_stem LIKE '/IMAGE/6%'" \
+    -c ":write-csv-to -" \
+    -c ";SELECT count(*) FROM access_log WHERE cs_uri_stem LIKE '/image/61%'" \
+    -c ":write-csv-to -" \
+    -c ";SELECT count(*) FROM access_log WHERE cs_uri_stem >= '/image/7' AND sc_bytes > 5000" \
+    -c ":write-csv-to -" \
+    ${test_dir}/logfile_shop_access_log.0
+
+grep "vt_next at EOF" sql_index.err > sql_index_range.err
+run_cap_test sed -e 's/^.*\(vt_next at EOF.*\)$/\1/g' sql_index_range.err